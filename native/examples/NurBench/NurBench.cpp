@@ -0,0 +1,802 @@
+#include <NurAPI.h>
+
+// Conflicts w/ g++ stdlib
+#undef min
+#undef max
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "NurEmulator.h"
+#include "NurApiExt.h"
+
+#define BENCH_VERSION			1
+#define BENCH_MAX_POPULATIONS	16
+#define BENCH_RING_CAPACITY		65536
+
+enum BENCH_MODE
+{
+	BENCH_INVENTORY = 0,	// NurApiSimpleInventory + NurApiFetchTags
+	BENCH_STREAM,			// NurApiStartInventoryStream
+	BENCH_INVENTORYEX,		// NurApiStartInventoryEx
+	BENCH_TAGTRACKING,		// NurApiStartTagTracking
+	BENCH_STREAM_DRAIN,		// NurApiStartInventoryStream, NurExtDrainTags
+	BENCH_STREAM_RING,		// NurApiStartInventoryStream, NurExtEnableTagRing
+	BENCH_BULKREAD,			// NurApiSimpleInventory + NurApiFetchTags, NurExtBulkRead of the stored tags
+	BENCH_MODE_COUNT
+};
+
+static const char *gModeNames[BENCH_MODE_COUNT] = { "inventory", "stream", "inventoryex", "tagtracking", "streamdrain", "streamring", "bulkread" };
+
+/// <summary>
+/// Result of one mode / population run.
+/// </summary>
+struct BenchResult
+{
+	int mode;
+	int population;
+	double elapsedMs;
+	long calls;				// Inventory+fetch cycles or handled notifications
+	long tagReads;			// Tag records delivered to the host, changed tags in tag tracking mode
+	long uniqueTags;		// -1 if not known for the mode
+	long errors;
+	long dropped;			// Tags lost on the host side
+	double cpuMs;			// User + system time of this process
+	std::vector<double> latencyUs;
+};
+
+/// <summary>
+/// Benchmark options.
+/// </summary>
+struct BenchOptions
+{
+	const char *host;		// NULL = spawn the emulator for each population
+	int port;
+	const char *serialPort;
+	int modeMask;
+	int populations[BENCH_MAX_POPULATIONS];
+	int populationCount;
+	int durationMs;
+	long callCount;			// Inventory and bulkread modes: stop after this many calls instead of durationMs, 0 = not used
+	int roundTimeMs;
+	int visibility;
+	int epcLen;
+	const char *outFile;
+	BOOL quiet;
+};
+
+// State shared with the notification callback while a stream mode is running
+static std::mutex gLock;
+static BenchResult *gRun = NULL;
+static volatile bool gRunning = false;
+static struct NUR_INVEX_PARAMS gInvExParams;
+static std::vector<struct NUR_TT_TAG> gTTBuffer;
+static std::vector<struct NUR_TAG_DATA_EX> gDrainBuffer(1024);
+static int gMode;
+
+static double NowUs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static double CpuMs()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3
+		+ (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+static void Log(const BenchOptions &opt, const char *fmt, ...)
+{
+	if (opt.quiet)
+		return;
+	va_list args;
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+}
+
+/// <summary>
+/// Moves all tags from the NurApi tag storage to host the way applications do it today:
+/// lock, count, NurApiGetTagDataEx per index, clear.
+/// </summary>
+/// <returns>Number of tags drained.</returns>
+static int DrainTagStorage(HANDLE hApi)
+{
+	struct NUR_TAG_DATA_EX tag;
+	int count = 0;
+
+	NurApiLockTagStorage(hApi, TRUE);
+	NurApiGetTagCount(hApi, &count);
+	for (int i = 0; i < count; i++)
+		NurApiGetTagDataEx(hApi, i, &tag, sizeof(tag));
+	NurApiClearTags(hApi);
+	NurApiLockTagStorage(hApi, FALSE);
+	return count;
+}
+
+/// <summary>
+/// Moves all tags from the NurApi tag storage to host with NurExtDrainTags.
+/// </summary>
+/// <returns>Number of tags drained.</returns>
+static int DrainTagStorageBulk(HANDLE hApi)
+{
+	int total = 0;
+	int count;
+
+	do
+	{
+		count = (int)gDrainBuffer.size();
+		if (NurExtDrainTags(hApi, gDrainBuffer.data(), &count, sizeof(struct NUR_TAG_DATA_EX)) != NUR_NO_ERROR)
+			break;
+		total += count;
+	} while (count == (int)gDrainBuffer.size());
+	return total;
+}
+
+static void RecordCall(double t0, int tags, int error)
+{
+	double t1 = NowUs();
+	std::lock_guard<std::mutex> guard(gLock);
+	if (!gRun)
+		return;
+	gRun->calls++;
+	gRun->tagReads += tags;
+	if (error != NUR_NO_ERROR)
+		gRun->errors++;
+	gRun->latencyUs.push_back(t1 - t0);
+}
+
+static void NURAPICALLBACK BenchNotificationFunc(HANDLE hApi, DWORD timestamp, int type, LPVOID data, int dataLen)
+{
+	if (!gRunning)
+		return;
+
+	switch (type)
+	{
+	case NUR_NOTIFICATION_INVENTORYSTREAM:
+	case NUR_NOTIFICATION_INVENTORYEX:
+		{
+			const struct NUR_INVENTORYSTREAM_DATA *streamData = (const struct NUR_INVENTORYSTREAM_DATA *)data;
+			double t0 = NowUs();
+
+			if (gMode == BENCH_STREAM_RING)
+			{
+				// Tags already moved to the ring by the extension, read on the main thread
+				if (streamData->stopped && gRunning)
+					NurApiStartInventoryStream(hApi, 0, 0, 0);
+				break;
+			}
+
+			int tags = (gMode == BENCH_STREAM_DRAIN) ? DrainTagStorageBulk(hApi) : DrainTagStorage(hApi);
+			int error = NUR_NO_ERROR;
+
+			if (streamData->stopped && gRunning)
+			{
+				// Module stops streaming after a while, restart
+				if (type == NUR_NOTIFICATION_INVENTORYSTREAM)
+					error = NurApiStartInventoryStream(hApi, 0, 0, 0);
+				else
+					error = NurApiStartInventoryEx(hApi, &gInvExParams, NULL, 0);
+			}
+			RecordCall(t0, tags, error);
+		}
+		break;
+
+	case NUR_NOTIFICATION_TT_CHANGED:
+		{
+			const struct NUR_TTCHANGED_DATA *ttData = (const struct NUR_TTCHANGED_DATA *)data;
+			double t0 = NowUs();
+			int count = ttData->changedCount;
+			int error = NUR_NO_ERROR;
+			if (count > 0)
+			{
+				if ((int)gTTBuffer.size() < count)
+					gTTBuffer.resize(count);
+				error = NurApiTagTrackingGetTags(hApi, ttData->changedEventMask, gTTBuffer.data(), &count, sizeof(struct NUR_TT_TAG));
+			}
+			if (ttData->stopped && gRunning)
+				error = NurApiStartTagTracking(hApi, NULL, 0);
+			RecordCall(t0, count, error);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void RunInventory(HANDLE hApi, const BenchOptions &opt)
+{
+	double end = NowUs() + opt.durationMs * 1e3;
+
+	// A fixed call count gives the same command sequence on every run, e.g. against a NurCapture replay
+	while (opt.callCount > 0 ? gRun->calls < opt.callCount : NowUs() < end)
+	{
+		struct NUR_INVENTORY_RESPONSE resp;
+		double t0 = NowUs();
+		int tags = 0;
+		int error = NurApiSimpleInventory(hApi, &resp);
+		if (error == NUR_NO_ERROR && resp.numTagsMem > 0)
+		{
+			error = NurApiFetchTags(hApi, TRUE, &tags);
+		}
+		else if (error == NUR_ERROR_NO_TAG)
+		{
+			error = NUR_NO_ERROR;
+		}
+		RecordCall(t0, tags, error);
+	}
+
+	int count = 0;
+	if (NurApiGetTagCount(hApi, &count) == NUR_NO_ERROR)
+		gRun->uniqueTags = count;
+}
+
+/// <summary>
+/// Bulk read mode: inventories the tags to the storage and reads 6 words of TID from them with NurExtBulkRead.
+/// A call is one job, its tag reads the tags read.
+/// </summary>
+static void RunBulkRead(HANDLE hApi, const BenchOptions &opt)
+{
+	std::vector<struct NUR_EXT_BULKREAD_TAG> tags(256);
+	struct NUR_EXT_BULKREAD_CONFIG cfg;
+	double end = NowUs() + opt.durationMs * 1e3;
+
+	NurExtBulkReadDefaultConfig(&cfg);
+	cfg.wordCount = 6;
+	cfg.flags = NUR_EXT_BULKREAD_STORAGE;
+
+	while (opt.callCount > 0 ? gRun->calls < opt.callCount : NowUs() < end)
+	{
+		struct NUR_INVENTORY_RESPONSE resp;
+		struct NUR_EXT_BULKREAD_STATS stats;
+		double t0 = NowUs();
+		int error = NurApiSimpleInventory(hApi, &resp);
+		if (error == NUR_NO_ERROR && resp.numTagsMem > 0)
+			error = NurApiFetchTags(hApi, TRUE, NULL);
+		else if (error == NUR_ERROR_NO_TAG)
+			error = NUR_NO_ERROR;
+
+		memset(&stats, 0, sizeof(stats));
+		if (error == NUR_NO_ERROR)
+		{
+			// The job ends with the run
+			cfg.timeoutMs = (opt.callCount > 0) ? 0 : (DWORD)std::max(1.0, (end - NowUs()) / 1e3);
+			int count = (int)tags.size();
+			error = NurExtBulkRead(hApi, &cfg, tags.data(), &count, sizeof(struct NUR_EXT_BULKREAD_TAG), &stats, sizeof(stats));
+			if (error == NUR_ERROR_BUFFER_TOO_SMALL)
+			{
+				tags.resize(count);
+				error = NurExtBulkRead(hApi, &cfg, tags.data(), &count, sizeof(struct NUR_EXT_BULKREAD_TAG), &stats, sizeof(stats));
+			}
+		}
+		RecordCall(t0, stats.read, error);
+	}
+}
+
+/// <summary>
+/// Consumer side of the streamring mode: polls the ring every millisecond.
+/// </summary>
+static void ReadTagRing(HANDLE hApi, const BenchOptions &opt)
+{
+	double end = NowUs() + opt.durationMs * 1e3;
+
+	while (NowUs() < end)
+	{
+		double t0 = NowUs();
+		int count = (int)gDrainBuffer.size();
+		int error = NurExtReadTagRing(hApi, gDrainBuffer.data(), &count, sizeof(struct NUR_TAG_DATA_EX));
+		if (error != NUR_NO_ERROR || count > 0)
+			RecordCall(t0, count, error);
+		if (count < (int)gDrainBuffer.size())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+static int StartMode(HANDLE hApi, int mode)
+{
+	switch (mode)
+	{
+	case BENCH_STREAM:
+	case BENCH_STREAM_DRAIN:
+		return NurApiStartInventoryStream(hApi, 0, 0, 0);
+
+	case BENCH_STREAM_RING:
+		{
+			int error = NurExtEnableTagRing(hApi, BENCH_RING_CAPACITY);
+			if (error == NUR_NO_ERROR)
+				error = NurExtSetNotificationCallback(hApi, BenchNotificationFunc);
+			if (error == NUR_NO_ERROR)
+				error = NurApiStartInventoryStream(hApi, 0, 0, 0);
+			return error;
+		}
+
+	case BENCH_INVENTORYEX:
+		memset(&gInvExParams, 0, sizeof(gInvExParams));
+		gInvExParams.session = NUR_SESSION_S0;
+		gInvExParams.inventoryTarget = NUR_INVTARGET_A;
+		gInvExParams.inventorySelState = NUR_SELSTATE_ALL;
+		return NurApiStartInventoryEx(hApi, &gInvExParams, NULL, 0);
+
+	case BENCH_TAGTRACKING:
+		{
+			struct NUR_TAGTRACKING_CONFIG ttConfig;
+			memset(&ttConfig, 0, sizeof(ttConfig));
+			ttConfig.events = NUR_TTEV_VISIBILITY;
+			ttConfig.visibilityTimeout = 3000;
+			return NurApiStartTagTracking(hApi, &ttConfig, sizeof(ttConfig));
+		}
+	}
+	return NUR_ERROR_INVALID_PARAMETER;
+}
+
+static void StopMode(HANDLE hApi, int mode)
+{
+	switch (mode)
+	{
+	case BENCH_STREAM:
+	case BENCH_STREAM_DRAIN:
+		NurApiStopInventoryStream(hApi);
+		break;
+	case BENCH_STREAM_RING:
+		{
+			struct NUR_EXT_TAGRING_STATS stats;
+			NurApiStopInventoryStream(hApi);
+			if (NurExtGetTagRingStats(hApi, &stats, sizeof(stats)) == NUR_NO_ERROR)
+				gRun->dropped = (long)stats.overflow;
+			// Also gives the notifications back to BenchNotificationFunc directly
+			NurExtFree(hApi);
+		}
+		break;
+	case BENCH_INVENTORYEX:
+		NurApiStopInventoryEx(hApi);
+		break;
+	case BENCH_TAGTRACKING:
+		NurApiStopTagTracking(hApi);
+		break;
+	}
+}
+
+/// <summary>
+/// Runs one mode against a connected module and fills the result.
+/// </summary>
+static int RunMode(HANDLE hApi, const BenchOptions &opt, int mode, BenchResult *res)
+{
+	int error;
+
+	res->mode = mode;
+	gMode = mode;
+	res->calls = res->tagReads = res->errors = res->dropped = 0;
+	res->uniqueTags = -1;
+	res->latencyUs.clear();
+
+	error = NurApiClearTags(hApi);
+	if (error != NUR_NO_ERROR)
+		return error;
+
+	{
+		std::lock_guard<std::mutex> guard(gLock);
+		gRun = res;
+	}
+	double cpu0 = CpuMs();
+	double t0 = NowUs();
+
+	if (mode == BENCH_INVENTORY)
+	{
+		RunInventory(hApi, opt);
+	}
+	else if (mode == BENCH_BULKREAD)
+	{
+		RunBulkRead(hApi, opt);
+	}
+	else
+	{
+		gRunning = true;
+		error = StartMode(hApi, mode);
+		if (error == NUR_NO_ERROR && mode == BENCH_STREAM_RING)
+			ReadTagRing(hApi, opt);
+		else if (error == NUR_NO_ERROR)
+			std::this_thread::sleep_for(std::chrono::milliseconds(opt.durationMs));
+		gRunning = false;
+		StopMode(hApi, mode);
+	}
+
+	res->elapsedMs = (NowUs() - t0) / 1e3;
+	res->cpuMs = CpuMs() - cpu0;
+	{
+		std::lock_guard<std::mutex> guard(gLock);
+		gRun = NULL;
+	}
+	return error;
+}
+
+/// <summary>
+/// Starts the emulator in a child process so that its CPU time is not accounted to the benchmark.
+/// </summary>
+/// <returns>Child pid, or -1 on failure. Listening port is returned in port.</returns>
+static pid_t SpawnEmulator(const BenchOptions &opt, int population, int *port)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+		return -1;
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		struct NUR_EMU_CONFIG cfg;
+		int emuPort = -1;
+
+		close(fds[0]);
+		NurEmuDefaultConfig(&cfg);
+		cfg.port = 0;
+		cfg.tagCount = population;
+		cfg.visibility = opt.visibility;
+		cfg.roundTimeMs = opt.roundTimeMs;
+		cfg.epcLen = opt.epcLen;
+
+		HANDLE hEmu = NurEmuCreate(&cfg);
+		if (hEmu && NurEmuStart(hEmu) == NUR_NO_ERROR)
+			emuPort = NurEmuGetPort(hEmu);
+		if (write(fds[1], &emuPort, sizeof(emuPort)) != sizeof(emuPort) || emuPort < 0)
+			_exit(1);
+		close(fds[1]);
+		// Serve until the parent kills us
+		for (;;)
+			pause();
+	}
+
+	close(fds[1]);
+	if (pid < 0 || read(fds[0], port, sizeof(*port)) != sizeof(*port) || *port < 0)
+	{
+		if (pid > 0)
+		{
+			kill(pid, SIGKILL);
+			waitpid(pid, NULL, 0);
+		}
+		pid = -1;
+	}
+	close(fds[0]);
+	return pid;
+}
+
+static void StopEmulator(pid_t pid)
+{
+	if (pid > 0)
+	{
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+	}
+}
+
+static double Percentile(const std::vector<double> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+	size_t idx = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static std::string JsonEscape(const char *str)
+{
+	std::string out;
+	for (; *str; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			out += '\\';
+		if ((unsigned char)*str >= 0x20)
+			out += *str;
+	}
+	return out;
+}
+
+static void WriteResultJson(FILE *fp, const BenchResult &r, bool last)
+{
+	std::vector<double> lat(r.latencyUs);
+	std::sort(lat.begin(), lat.end());
+
+	double seconds = r.elapsedMs / 1e3;
+	fprintf(fp, "    {\n");
+	fprintf(fp, "      \"mode\": \"%s\",\n", gModeNames[r.mode]);
+	if (r.population > 0)
+		fprintf(fp, "      \"population\": %d,\n", r.population);
+	else
+		fprintf(fp, "      \"population\": null,\n");
+	fprintf(fp, "      \"elapsedMs\": %.1f,\n", r.elapsedMs);
+	fprintf(fp, "      \"calls\": %ld,\n", r.calls);
+	fprintf(fp, "      \"errors\": %ld,\n", r.errors);
+	fprintf(fp, "      \"droppedTags\": %ld,\n", r.dropped);
+	fprintf(fp, "      \"tagReads\": %ld,\n", r.tagReads);
+	if (r.uniqueTags >= 0)
+		fprintf(fp, "      \"uniqueTags\": %ld,\n", r.uniqueTags);
+	else
+		fprintf(fp, "      \"uniqueTags\": null,\n");
+	fprintf(fp, "      \"tagsPerSecond\": %.1f,\n", seconds > 0 ? r.tagReads / seconds : 0.0);
+	fprintf(fp, "      \"callsPerSecond\": %.1f,\n", seconds > 0 ? r.calls / seconds : 0.0);
+	fprintf(fp, "      \"latencyUs\": { \"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f },\n",
+		lat.empty() ? 0.0 : lat.front(), Percentile(lat, 50), Percentile(lat, 90),
+		Percentile(lat, 99), Percentile(lat, 99.9), lat.empty() ? 0.0 : lat.back());
+	fprintf(fp, "      \"cpuMs\": %.1f,\n", r.cpuMs);
+	if (r.tagReads > 0)
+		fprintf(fp, "      \"cpuMsPer1000Tags\": %.3f\n", r.cpuMs * 1000.0 / r.tagReads);
+	else
+		fprintf(fp, "      \"cpuMsPer1000Tags\": null\n");
+	fprintf(fp, "    }%s\n", last ? "" : ",");
+}
+
+static void WriteJson(FILE *fp, const BenchOptions &opt, const char *target,
+					  const struct NUR_READERINFO *ri, const std::vector<BenchResult> &results)
+{
+	TCHAR apiVersion[64] = { 0 };
+	NurApiGetFileVersion(apiVersion, 64);
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"tool\": \"nurbench\",\n");
+	fprintf(fp, "  \"version\": %d,\n", BENCH_VERSION);
+	fprintf(fp, "  \"nurApiVersion\": \"%s\",\n", JsonEscape(apiVersion).c_str());
+	fprintf(fp, "  \"target\": \"%s\",\n", JsonEscape(target).c_str());
+	fprintf(fp, "  \"module\": { \"name\": \"%s\", \"version\": \"%d.%d-%c\" },\n",
+		JsonEscape(ri->name).c_str(), ri->swVerMajor, ri->swVerMinor, ri->devBuild);
+	fprintf(fp, "  \"durationMs\": %d,\n", opt.durationMs);
+	if (!opt.host && !opt.serialPort)
+		fprintf(fp, "  \"emulator\": { \"roundTimeMs\": %d, \"visibility\": %d, \"epcLen\": %d },\n",
+			opt.roundTimeMs, opt.visibility, opt.epcLen);
+	fprintf(fp, "  \"results\": [\n");
+	for (size_t i = 0; i < results.size(); i++)
+		WriteResultJson(fp, results[i], i + 1 == results.size());
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+}
+
+static int Connect(HANDLE hApi, const BenchOptions &opt, const char *host, int port)
+{
+	if (opt.serialPort)
+		return NurApiConnectSerialPortEx(hApi, opt.serialPort, NUR_DEFAULT_BAUDRATE);
+	return NurApiConnectSocket(hApi, host, port);
+}
+
+static void PrintUsage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options]\n", prog);
+	fprintf(stderr, "Inventory throughput and latency benchmark. Results are written as JSON.\n\n");
+	fprintf(stderr, "  -m modes       Comma separated: inventory,stream,inventoryex,tagtracking,streamdrain,\n"
+		"                 streamring,bulkread (default all)\n");
+	fprintf(stderr, "  -n counts      Comma separated emulated tag populations (default 10,100,1000,10000,50000)\n");
+	fprintf(stderr, "  -t ms          Duration of each run in milliseconds (default 5000)\n");
+	fprintf(stderr, "  -k calls       Stop inventory and bulkread modes after this many calls instead of the duration\n");
+	fprintf(stderr, "  -r ms          Emulated inventory round time (default 20)\n");
+	fprintf(stderr, "  -v percent     Emulated population visibility per inventory (default 100)\n");
+	fprintf(stderr, "  -l bytes       Emulated EPC length (default 12)\n");
+	fprintf(stderr, "  -c host:port   Benchmark a reader over TCP instead of the emulator\n");
+	fprintf(stderr, "  -s device      Benchmark a module over serial port instead of the emulator\n");
+	fprintf(stderr, "  -o file        Write JSON to file instead of stdout\n");
+	fprintf(stderr, "  -q             No progress output\n");
+	fprintf(stderr, "  -h             Show this help\n");
+}
+
+static bool ParseModes(const char *arg, int *mask)
+{
+	std::string list(arg);
+	size_t pos = 0;
+
+	*mask = 0;
+	while (pos <= list.size())
+	{
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos)
+			end = list.size();
+		std::string name = list.substr(pos, end - pos);
+		int m;
+		for (m = 0; m < BENCH_MODE_COUNT; m++)
+		{
+			if (name == gModeNames[m])
+				break;
+		}
+		if (m == BENCH_MODE_COUNT)
+			return false;
+		*mask |= (1 << m);
+		pos = end + 1;
+	}
+	return *mask != 0;
+}
+
+static bool ParsePopulations(const char *arg, BenchOptions *opt)
+{
+	const char *p = arg;
+
+	opt->populationCount = 0;
+	while (*p)
+	{
+		char *end;
+		long n = strtol(p, &end, 10);
+		if (end == p || n < 1 || opt->populationCount == BENCH_MAX_POPULATIONS)
+			return false;
+		opt->populations[opt->populationCount++] = (int)n;
+		p = (*end == ',') ? end + 1 : end;
+		if (*end && *end != ',')
+			return false;
+	}
+	return opt->populationCount > 0;
+}
+
+int main(int argc, char* argv[])
+{
+	static const int defaultPopulations[] = { 10, 100, 1000, 10000, 50000 };
+	BenchOptions opt;
+	std::vector<BenchResult> results;
+	struct NUR_READERINFO ri;
+	std::string host;
+	char target[128];
+	int c;
+
+	memset(&opt, 0, sizeof(opt));
+	memset(&ri, 0, sizeof(ri));
+	opt.modeMask = (1 << BENCH_MODE_COUNT) - 1;
+	opt.populationCount = sizeof(defaultPopulations) / sizeof(defaultPopulations[0]);
+	memcpy(opt.populations, defaultPopulations, sizeof(defaultPopulations));
+	opt.durationMs = 5000;
+	opt.roundTimeMs = 20;
+	opt.visibility = 100;
+	opt.epcLen = 12;
+
+	while ((c = getopt(argc, argv, "m:n:t:k:r:v:l:c:s:o:qh")) != -1)
+	{
+		switch (c)
+		{
+		case 'm':
+			if (!ParseModes(optarg, &opt.modeMask))
+			{
+				fprintf(stderr, "Invalid mode list: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'n':
+			if (!ParsePopulations(optarg, &opt))
+			{
+				fprintf(stderr, "Invalid population list: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 't': opt.durationMs = atoi(optarg); break;
+		case 'k': opt.callCount = atol(optarg); break;
+		case 'r': opt.roundTimeMs = atoi(optarg); break;
+		case 'v': opt.visibility = atoi(optarg); break;
+		case 'l': opt.epcLen = atoi(optarg); break;
+		case 'c':
+			{
+				host = optarg;
+				size_t colon = host.rfind(':');
+				opt.port = NUR_EMU_DEFAULT_PORT;
+				if (colon != std::string::npos)
+				{
+					opt.port = atoi(host.c_str() + colon + 1);
+					host.resize(colon);
+				}
+				opt.host = host.c_str();
+			}
+			break;
+		case 's': opt.serialPort = optarg; break;
+		case 'o': opt.outFile = optarg; break;
+		case 'q': opt.quiet = TRUE; break;
+		default:
+			PrintUsage(argv[0]);
+			return (c == 'h') ? 0 : 1;
+		}
+	}
+	if (opt.durationMs <= 0 || opt.callCount < 0)
+	{
+		fprintf(stderr, "Invalid duration\n");
+		return 1;
+	}
+
+	// A real reader has one population, the one in front of its antennas
+	bool emulated = (!opt.host && !opt.serialPort);
+	int populationCount = emulated ? opt.populationCount : 1;
+	if (emulated)
+		snprintf(target, sizeof(target), "emulator");
+	else if (opt.serialPort)
+		snprintf(target, sizeof(target), "serial:%s", opt.serialPort);
+	else
+		snprintf(target, sizeof(target), "tcp:%s:%d", opt.host, opt.port);
+
+	for (int p = 0; p < populationCount; p++)
+	{
+		pid_t emuPid = -1;
+		int port = opt.port;
+		int error;
+
+		if (emulated)
+		{
+			emuPid = SpawnEmulator(opt, opt.populations[p], &port);
+			if (emuPid < 0)
+			{
+				fprintf(stderr, "Could not start emulator\n");
+				return 1;
+			}
+		}
+
+		HANDLE hApi = NurApiCreate();
+		if (hApi == INVALID_HANDLE_VALUE)
+		{
+			StopEmulator(emuPid);
+			fprintf(stderr, "Could not create NurApi object\n");
+			return 1;
+		}
+		NurApiSetLogLevel(hApi, NUR_LOG_ERROR);
+		NurApiSetNotificationCallback(hApi, BenchNotificationFunc);
+
+		error = Connect(hApi, opt, emulated ? "127.0.0.1" : opt.host, port);
+		if (error == NUR_NO_ERROR)
+			error = NurApiGetReaderInfo(hApi, &ri, sizeof(ri));
+		if (error != NUR_NO_ERROR)
+		{
+			TCHAR errorMsg[128+1];
+			NurApiGetErrorMessage(error, errorMsg, 128);
+			fprintf(stderr, "Connect failed, error %d: [%s]\n", error, errorMsg);
+			NurApiFree(hApi);
+			StopEmulator(emuPid);
+			return 1;
+		}
+
+		for (int m = 0; m < BENCH_MODE_COUNT; m++)
+		{
+			if (!(opt.modeMask & (1 << m)))
+				continue;
+
+			BenchResult res;
+			res.population = emulated ? opt.populations[p] : 0;
+			Log(opt, "%s: %s", target, gModeNames[m]);
+			if (emulated)
+				Log(opt, ", %d tags", res.population);
+			Log(opt, "...\n");
+
+			error = RunMode(hApi, opt, m, &res);
+			if (error != NUR_NO_ERROR)
+			{
+				Log(opt, "  failed to start, error %d\n", error);
+				res.errors++;
+			}
+			else
+			{
+				Log(opt, "  %.0f tags/s, %ld calls, cpu %.1f ms\n",
+					res.tagReads * 1000.0 / res.elapsedMs, res.calls, res.cpuMs);
+			}
+			results.push_back(res);
+		}
+
+		NurExtFree(hApi);
+		NurApiFree(hApi);
+		StopEmulator(emuPid);
+	}
+
+	FILE *fp = stdout;
+	if (opt.outFile)
+	{
+		fp = fopen(opt.outFile, "w");
+		if (!fp)
+		{
+			fprintf(stderr, "Could not open %s\n", opt.outFile);
+			return 1;
+		}
+	}
+	WriteJson(fp, opt, target, &ri, results);
+	if (fp != stdout)
+		fclose(fp);
+
+	return 0;
+}
@@ -0,0 +1,754 @@
+#include "NurCapture.h"
+#include "NurExtCRC.h"
+
+// Conflicts w/ g++ stdlib
+#undef min
+#undef max
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Capture file: header, then records until end of file. Integers are little endian,
+// varints are LEB128.
+//   header: "NURCAP" version(1) reserved(1) realtime ns at start(8)
+//   record: type(1) ns since previous record(varint) [length(varint) data] for data records
+#define CAP_FILE_MAGIC		"NURCAP"
+#define CAP_FILE_VERSION	1
+#define CAP_HEADER_SIZE		16
+
+#define CAP_REC_CONNECT		0	// Host connected, session starts
+#define CAP_REC_HOST		1	// Bytes from host to module
+#define CAP_REC_MODULE		2	// Bytes from module to host
+#define CAP_REC_CLOSE		3	// Session ended
+
+// NUR protocol framing
+#define NUR_PREAMBLE		0xA5
+#define NUR_HDR_SIZE		6
+#define NUR_CRC_SIZE		2
+#define NUR_HDRFL_UNSOL		0x0001
+#define NUR_MAX_COMMANDS	256
+
+#define CAP_DIR_HOST		0
+#define CAP_DIR_MODULE		1
+
+// Replay: how long to wait for the host to send what it sent in the capture
+#define CAP_SYNC_TIMEOUT_NS	(5000ULL * 1000000ULL)
+
+struct CapRecord
+{
+	BYTE type;
+	ULONGLONG ts;			// ns since capture start
+	size_t offset;			// Data position in NurCapture::data
+	size_t length;
+	size_t hostOffset;		// Position in NurCapture::hostStream before this record
+};
+
+struct NurCapture
+{
+	struct NUR_CAP_CONFIG cfg;
+	std::string file;
+	std::string device;
+	std::string host;
+
+	// Record
+	FILE *out;
+	ULONGLONG startNs;
+	ULONGLONG lastNs;
+
+	// Replay
+	std::vector<CapRecord> records;
+	std::vector<BYTE> data;
+	std::vector<BYTE> hostStream;		// All host to module bytes, to compare the replaying host against
+	std::vector<size_t> sessions;		// Index of the first record of each session
+	size_t nextSession;
+
+	// Frame tracking of the current session, protected by statsLock
+	std::mutex statsLock;
+	struct NUR_CAP_STATS stats;
+	std::vector<BYTE> frameRx[2];			// Partial frame per direction
+	ULONGLONG sentNs[NUR_MAX_COMMANDS];		// Send time of the command waiting for response, 0 if none
+	struct NUR_CAP_COMMAND_STATS commands[NUR_MAX_COMMANDS];
+
+	int listenFd;
+	int port;
+	std::atomic<bool> running;
+	std::thread acceptThread;
+};
+
+static ULONGLONG CapNow(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (ULONGLONG)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void PutVarint(std::vector<BYTE> &buf, ULONGLONG value)
+{
+	while (value >= 0x80)
+	{
+		buf.push_back((BYTE)(value | 0x80));
+		value >>= 7;
+	}
+	buf.push_back((BYTE)value);
+}
+
+static bool GetVarint(const std::vector<BYTE> &buf, size_t *pos, ULONGLONG *value)
+{
+	*value = 0;
+	for (int shift = 0; shift < 64 && *pos < buf.size(); shift += 7)
+	{
+		BYTE b = buf[(*pos)++];
+		*value |= (ULONGLONG)(b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool SendAll(int fd, const BYTE *buf, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = write(fd, buf, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+/// <summary>
+/// A command ended without response. Caller holds cap->statsLock.
+/// </summary>
+static void DropPending(NurCapture *cap, int cmd)
+{
+	if (cap->sentNs[cmd] != 0)
+	{
+		cap->commands[cmd].unanswered++;
+		cap->sentNs[cmd] = 0;
+	}
+}
+
+static void TrackFrame(NurCapture *cap, int dir, const BYTE *payload, WORD flags, ULONGLONG now)
+{
+	int cmd = payload[0];
+
+	if (dir == CAP_DIR_HOST)
+	{
+		cap->stats.hostFrames++;
+		cap->commands[cmd].sent++;
+
+		// NurApi waits for each response, so an earlier command is either being retried or was given up
+		if (cap->sentNs[cmd] != 0)
+			cap->commands[cmd].retries++;
+		for (int i = 0; i < NUR_MAX_COMMANDS; i++)
+		{
+			if (i != cmd)
+				DropPending(cap, i);
+		}
+		cap->sentNs[cmd] = now;
+		return;
+	}
+
+	cap->stats.moduleFrames++;
+	if (flags & NUR_HDRFL_UNSOL)
+	{
+		cap->stats.notifications++;
+		return;
+	}
+
+	cap->commands[cmd].responses++;
+	if (cap->sentNs[cmd] != 0)
+	{
+		ULONGLONG us = (now - cap->sentNs[cmd]) / 1000;
+		NurExtHistogramAdd(&cap->commands[cmd].latency, (DWORD)std::min(us, (ULONGLONG)0xFFFFFFFF));
+		cap->sentNs[cmd] = 0;
+	}
+}
+
+/// <summary>
+/// Splits the bytes of one direction into NUR frames and updates the frame counters.
+/// </summary>
+static void TrackFrames(NurCapture *cap, int dir, const BYTE *buf, size_t len, ULONGLONG now)
+{
+	std::lock_guard<std::mutex> guard(cap->statsLock);
+	std::vector<BYTE> &rx = cap->frameRx[dir];
+	size_t pos = 0;
+
+	rx.insert(rx.end(), buf, buf + len);
+	while (rx.size() - pos >= NUR_HDR_SIZE)
+	{
+		const BYTE *hdr = &rx[pos];
+		if (hdr[0] != NUR_PREAMBLE)
+		{
+			pos++;
+			continue;
+		}
+
+		BYTE cs = 0xFF;
+		for (int i = 0; i < NUR_HDR_SIZE - 1; i++)
+			cs ^= hdr[i];
+		WORD frameLen = (WORD)(hdr[1] | (hdr[2] << 8));
+		if (cs != hdr[5] || frameLen <= NUR_CRC_SIZE)
+		{
+			cap->stats.frameErrors++;
+			pos++;
+			continue;
+		}
+		if (rx.size() - pos < (size_t)(NUR_HDR_SIZE + frameLen))
+			break;
+
+		const BYTE *payload = hdr + NUR_HDR_SIZE;
+		int plen = frameLen - NUR_CRC_SIZE;
+		if (NurExtCRC16(NUR_EXT_CRC16_INIT, payload, plen) == (WORD)(payload[plen] | (payload[plen + 1] << 8)))
+			TrackFrame(cap, dir, payload, (WORD)(hdr[3] | (hdr[4] << 8)), now);
+		else
+			cap->stats.frameErrors++;
+		pos += NUR_HDR_SIZE + frameLen;
+	}
+	rx.erase(rx.begin(), rx.begin() + pos);
+}
+
+/// <summary>
+/// Resets frame tracking for a new session and counts it.
+/// </summary>
+static void BeginSession(NurCapture *cap)
+{
+	std::lock_guard<std::mutex> guard(cap->statsLock);
+	cap->stats.sessions++;
+	cap->frameRx[CAP_DIR_HOST].clear();
+	cap->frameRx[CAP_DIR_MODULE].clear();
+	memset(cap->sentNs, 0, sizeof(cap->sentNs));
+}
+
+static void EndSession(NurCapture *cap)
+{
+	std::lock_guard<std::mutex> guard(cap->statsLock);
+	for (int i = 0; i < NUR_MAX_COMMANDS; i++)
+		DropPending(cap, i);
+}
+
+/// <summary>
+/// Appends a record to the capture file. Only called by the session thread.
+/// </summary>
+static void WriteRecord(NurCapture *cap, BYTE type, ULONGLONG now, const BYTE *buf, size_t len)
+{
+	std::vector<BYTE> hdr;
+
+	hdr.push_back(type);
+	PutVarint(hdr, now - cap->lastNs);
+	if (type == CAP_REC_HOST || type == CAP_REC_MODULE)
+		PutVarint(hdr, len);
+	cap->lastNs = now;
+
+	fwrite(hdr.data(), 1, hdr.size(), cap->out);
+	if (len > 0)
+		fwrite(buf, 1, len, cap->out);
+
+	if (cap->cfg.verbose)
+		_tprintf(_T("%10.3f ms  %s %zu bytes\r\n"), (now - cap->startNs) / 1e6,
+			type == CAP_REC_HOST ? "host  ->" : type == CAP_REC_MODULE ? "module->" : "session ", len);
+}
+
+static speed_t BaudToSpeed(int baudRate)
+{
+	switch (baudRate)
+	{
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 500000: return B500000;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	case 1500000: return B1500000;
+	case 2000000: return B2000000;
+	case 3000000: return B3000000;
+	default: return B0;
+	}
+}
+
+/// <summary>
+/// Opens the reader the recorder proxies to.
+/// </summary>
+/// <returns>Descriptor, or -1 on failure.</returns>
+static int OpenUpstream(NurCapture *cap)
+{
+	if (!cap->device.empty())
+	{
+		int fd = open(cap->device.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+		if (fd < 0)
+			return -1;
+
+		struct termios tio;
+		if (tcgetattr(fd, &tio) == 0)
+		{
+			cfmakeraw(&tio);
+			cfsetspeed(&tio, BaudToSpeed(cap->cfg.baudRate));
+			tcsetattr(fd, TCSANOW, &tio);
+		}
+		tcflush(fd, TCIOFLUSH);
+		return fd;
+	}
+
+	struct addrinfo hints, *res, *ai;
+	char portStr[16];
+	int fd = -1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(portStr, sizeof(portStr), "%d", cap->cfg.hostPort);
+	if (getaddrinfo(cap->host.c_str(), portStr, &hints, &res) != 0)
+		return -1;
+
+	for (ai = res; ai != NULL && fd < 0; ai = ai->ai_next)
+	{
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(res);
+
+	if (fd >= 0)
+	{
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+	return fd;
+}
+
+/// <summary>
+/// Record mode session: forwards both directions between host and reader and writes them to the file.
+/// </summary>
+static void RecordSession(NurCapture *cap, int clientFd)
+{
+	BYTE buf[4096];
+	int upFd = OpenUpstream(cap);
+
+	if (upFd < 0)
+	{
+		_tprintf(_T("Could not open reader %s\r\n"), cap->device.empty() ? cap->host.c_str() : cap->device.c_str());
+		return;
+	}
+
+	WriteRecord(cap, CAP_REC_CONNECT, CapNow(CLOCK_MONOTONIC), NULL, 0);
+
+	while (cap->running)
+	{
+		struct pollfd pfd[2] = { { clientFd, POLLIN, 0 }, { upFd, POLLIN, 0 } };
+		int ret = poll(pfd, 2, 100);
+		if (ret < 0 && errno != EINTR)
+			break;
+		if (ret <= 0)
+			continue;
+
+		bool closed = false;
+		for (int i = 0; i < 2 && !closed; i++)
+		{
+			if (pfd[i].revents == 0)
+				continue;
+
+			ssize_t n = read(pfd[i].fd, buf, sizeof(buf));
+			ULONGLONG now = CapNow(CLOCK_MONOTONIC);
+			if (n <= 0 || !SendAll(pfd[1 - i].fd, buf, n))
+			{
+				closed = true;
+				break;
+			}
+
+			BYTE type = (i == 0) ? CAP_REC_HOST : CAP_REC_MODULE;
+			WriteRecord(cap, type, now, buf, n);
+			TrackFrames(cap, (i == 0) ? CAP_DIR_HOST : CAP_DIR_MODULE, buf, n, now);
+
+			std::lock_guard<std::mutex> guard(cap->statsLock);
+			cap->stats.records++;
+			if (type == CAP_REC_HOST)
+				cap->stats.hostBytes += n;
+			else
+				cap->stats.moduleBytes += n;
+		}
+		if (closed)
+			break;
+	}
+
+	WriteRecord(cap, CAP_REC_CLOSE, CapNow(CLOCK_MONOTONIC), NULL, 0);
+	fflush(cap->out);
+	close(upFd);
+}
+
+/// <summary>
+/// Loads and indexes the capture file for replay.
+/// </summary>
+static bool LoadCapture(NurCapture *cap)
+{
+	std::vector<BYTE> file;
+	BYTE buf[65536];
+	size_t n;
+
+	FILE *in = fopen(cap->file.c_str(), "rb");
+	if (in == NULL)
+		return false;
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+		file.insert(file.end(), buf, buf + n);
+	fclose(in);
+
+	if (file.size() < CAP_HEADER_SIZE || memcmp(&file[0], CAP_FILE_MAGIC, 6) != 0 || file[6] != CAP_FILE_VERSION)
+		return false;
+
+	size_t pos = CAP_HEADER_SIZE;
+	ULONGLONG ts = 0;
+	while (pos < file.size())
+	{
+		CapRecord rec;
+		ULONGLONG delta, len = 0;
+
+		rec.type = file[pos++];
+		if (rec.type > CAP_REC_CLOSE || !GetVarint(file, &pos, &delta))
+			return false;
+		if ((rec.type == CAP_REC_HOST || rec.type == CAP_REC_MODULE)
+			&& (!GetVarint(file, &pos, &len) || len > file.size() - pos))
+			return false;
+
+		ts += delta;
+		rec.ts = ts;
+		rec.offset = cap->data.size();
+		rec.length = (size_t)len;
+		rec.hostOffset = cap->hostStream.size();
+		cap->data.insert(cap->data.end(), file.begin() + pos, file.begin() + pos + len);
+		if (rec.type == CAP_REC_HOST)
+			cap->hostStream.insert(cap->hostStream.end(), file.begin() + pos, file.begin() + pos + len);
+		pos += len;
+
+		if (rec.type == CAP_REC_CONNECT)
+			cap->sessions.push_back(cap->records.size());
+		cap->records.push_back(rec);
+	}
+
+	if (cap->sessions.empty())
+		cap->sessions.push_back(0);
+	if (!cap->records.empty())
+		cap->stats.durationNs = cap->records.back().ts;
+	return true;
+}
+
+/// <summary>
+/// Reads what the replaying host sent and compares it to the capture.
+/// </summary>
+/// <returns>false if the host disconnected.</returns>
+static bool ReadHost(NurCapture *cap, int fd, ULONGLONG timeoutNs, size_t *hostPos)
+{
+	BYTE buf[4096];
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	struct timespec timeout;
+
+	timeout.tv_sec = (time_t)(timeoutNs / 1000000000ULL);
+	timeout.tv_nsec = (long)(timeoutNs % 1000000000ULL);
+	int ret = ppoll(&pfd, 1, &timeout, NULL);
+	if (ret < 0)
+		return errno == EINTR;
+	if (ret == 0)
+		return true;
+
+	ssize_t n = recv(fd, buf, sizeof(buf), 0);
+	if (n <= 0)
+		return false;
+	TrackFrames(cap, CAP_DIR_HOST, buf, n, CapNow(CLOCK_MONOTONIC));
+
+	DWORD mismatch = 0;
+	for (ssize_t i = 0; i < n; i++, (*hostPos)++)
+	{
+		if (*hostPos >= cap->hostStream.size() || cap->hostStream[*hostPos] != buf[i])
+			mismatch++;
+	}
+
+	std::lock_guard<std::mutex> guard(cap->statsLock);
+	cap->stats.hostBytes += n;
+	cap->stats.mismatchBytes += mismatch;
+	return true;
+}
+
+/// <summary>
+/// Replay mode session: sends the module records of the next captured session with their original spacing.
+/// Whenever the capture has the host sending, waits until the host has sent as many bytes, and measures
+/// following delays from that point. Replay thus follows the pace of the host under test.
+/// </summary>
+static void ReplaySession(NurCapture *cap, int fd)
+{
+	size_t first = cap->sessions[cap->nextSession];
+	cap->nextSession = (cap->nextSession + 1) % cap->sessions.size();
+
+	size_t hostPos = (first < cap->records.size()) ? cap->records[first].hostOffset : 0;
+	ULONGLONG baseNs = CapNow(CLOCK_MONOTONIC);
+	ULONGLONG baseTs = (first < cap->records.size()) ? cap->records[first].ts : 0;
+
+	for (size_t i = first; i < cap->records.size() && cap->running; i++)
+	{
+		const CapRecord &rec = cap->records[i];
+
+		if (rec.type == CAP_REC_CLOSE || (rec.type == CAP_REC_CONNECT && i != first))
+			break;
+
+		if (rec.type == CAP_REC_HOST)
+		{
+			size_t target = rec.hostOffset + rec.length;
+			ULONGLONG waitStart = CapNow(CLOCK_MONOTONIC);
+			while (hostPos < target && cap->running && CapNow(CLOCK_MONOTONIC) - waitStart < CAP_SYNC_TIMEOUT_NS)
+			{
+				if (!ReadHost(cap, fd, 100 * 1000000ULL, &hostPos))
+					return;
+			}
+			baseNs = CapNow(CLOCK_MONOTONIC);
+			baseTs = rec.ts;
+		}
+		else if (rec.type == CAP_REC_MODULE)
+		{
+			if (cap->cfg.speed > 0)
+			{
+				ULONGLONG due = baseNs + (ULONGLONG)((rec.ts - baseTs) / cap->cfg.speed);
+				ULONGLONG now;
+				while ((now = CapNow(CLOCK_MONOTONIC)) < due && cap->running)
+				{
+					if (!ReadHost(cap, fd, due - now, &hostPos))
+						return;
+				}
+			}
+			if (!SendAll(fd, &cap->data[rec.offset], rec.length))
+				return;
+			TrackFrames(cap, CAP_DIR_MODULE, &cap->data[rec.offset], rec.length, CapNow(CLOCK_MONOTONIC));
+		}
+		else
+		{
+			continue;
+		}
+
+		if (cap->cfg.verbose)
+			_tprintf(_T("%10.3f ms  %s %zu bytes\r\n"), rec.ts / 1e6, rec.type == CAP_REC_HOST ? "host  ->" : "module->", rec.length);
+
+		std::lock_guard<std::mutex> guard(cap->statsLock);
+		cap->stats.records++;
+		if (rec.type == CAP_REC_MODULE)
+			cap->stats.moduleBytes += rec.length;
+	}
+
+	// Keep reading until the host disconnects, so that it is not cut off mid command
+	while (cap->running && ReadHost(cap, fd, 100 * 1000000ULL, &hostPos))
+		;
+}
+
+static void AcceptThread(NurCapture *cap)
+{
+	while (cap->running)
+	{
+		struct pollfd pfd = { cap->listenFd, POLLIN, 0 };
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+
+		int fd = accept(cap->listenFd, NULL, NULL);
+		if (fd < 0)
+			continue;
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		// One session at a time: the reader has a single host
+		BeginSession(cap);
+		if (cap->cfg.mode == NUR_CAP_MODE_RECORD)
+			RecordSession(cap, fd);
+		else
+			ReplaySession(cap, fd);
+		EndSession(cap);
+
+		shutdown(fd, SHUT_RDWR);
+		close(fd);
+	}
+}
+
+void NurCapDefaultConfig(struct NUR_CAP_CONFIG *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->mode = NUR_CAP_MODE_RECORD;
+	cfg->port = NUR_CAP_DEFAULT_PORT;
+	cfg->baudRate = 115200;
+	cfg->hostPort = 4333;
+	cfg->speed = 1.0;
+	cfg->verbose = FALSE;
+}
+
+HANDLE NurCapCreate(const struct NUR_CAP_CONFIG *cfg)
+{
+	if (cfg == NULL || cfg->file == NULL || cfg->speed < 0)
+		return NULL;
+	if (cfg->mode == NUR_CAP_MODE_RECORD)
+	{
+		if (cfg->device == NULL && cfg->host == NULL)
+			return NULL;
+		if (cfg->device != NULL && BaudToSpeed(cfg->baudRate) == B0)
+			return NULL;
+	}
+	else if (cfg->mode != NUR_CAP_MODE_REPLAY)
+	{
+		return NULL;
+	}
+
+	NurCapture *cap = new NurCapture();
+	cap->cfg = *cfg;
+	cap->file = cfg->file;
+	cap->device = cfg->device ? cfg->device : "";
+	cap->host = cfg->host ? cfg->host : "";
+	cap->cfg.file = cap->file.c_str();
+	cap->cfg.device = cfg->device ? cap->device.c_str() : NULL;
+	cap->cfg.host = cfg->host ? cap->host.c_str() : NULL;
+	cap->out = NULL;
+	cap->startNs = cap->lastNs = 0;
+	cap->nextSession = 0;
+	memset(&cap->stats, 0, sizeof(cap->stats));
+	memset(cap->sentNs, 0, sizeof(cap->sentNs));
+	memset(cap->commands, 0, sizeof(cap->commands));
+	cap->listenFd = -1;
+	cap->port = -1;
+	cap->running = false;
+
+	if (cfg->mode == NUR_CAP_MODE_REPLAY && !LoadCapture(cap))
+	{
+		delete cap;
+		return NULL;
+	}
+	return (HANDLE)cap;
+}
+
+int NurCapStart(HANDLE hCap)
+{
+	NurCapture *cap = (NurCapture *)hCap;
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int one = 1;
+
+	if (cap == NULL)
+		return NUR_ERROR_INVALID_PARAMETER;
+	if (cap->running)
+		return NUR_NO_ERROR;
+
+	if (cap->cfg.mode == NUR_CAP_MODE_RECORD)
+	{
+		BYTE hdr[CAP_HEADER_SIZE] = { 0 };
+		ULONGLONG wall = CapNow(CLOCK_REALTIME);
+
+		cap->out = fopen(cap->file.c_str(), "wb");
+		if (cap->out == NULL)
+			return NUR_ERROR_FILE_NOT_FOUND;
+		memcpy(hdr, CAP_FILE_MAGIC, 6);
+		hdr[6] = CAP_FILE_VERSION;
+		for (int i = 0; i < 8; i++)
+			hdr[8 + i] = (BYTE)(wall >> (8 * i));
+		fwrite(hdr, 1, sizeof(hdr), cap->out);
+		cap->startNs = cap->lastNs = CapNow(CLOCK_MONOTONIC);
+	}
+
+	cap->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if (cap->listenFd < 0)
+		return NUR_ERROR_TR_NOT_CONNECTED;
+	setsockopt(cap->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons((uint16_t)cap->cfg.port);
+	if (bind(cap->listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(cap->listenFd, 1) < 0
+		|| getsockname(cap->listenFd, (struct sockaddr *)&addr, &addrLen) < 0)
+	{
+		close(cap->listenFd);
+		cap->listenFd = -1;
+		return NUR_ERROR_TR_NOT_CONNECTED;
+	}
+
+	cap->port = ntohs(addr.sin_port);
+	cap->running = true;
+	cap->acceptThread = std::thread(AcceptThread, cap);
+	return NUR_NO_ERROR;
+}
+
+int NurCapStop(HANDLE hCap)
+{
+	NurCapture *cap = (NurCapture *)hCap;
+	if (cap == NULL)
+		return NUR_ERROR_INVALID_PARAMETER;
+	if (!cap->running)
+		return NUR_NO_ERROR;
+
+	cap->running = false;
+	cap->acceptThread.join();
+
+	if (cap->out)
+	{
+		fclose(cap->out);
+		cap->out = NULL;
+	}
+	close(cap->listenFd);
+	cap->listenFd = -1;
+	cap->port = -1;
+	return NUR_NO_ERROR;
+}
+
+int NurCapGetPort(HANDLE hCap)
+{
+	NurCapture *cap = (NurCapture *)hCap;
+	return cap ? cap->port : -1;
+}
+
+int NurCapGetStats(HANDLE hCap, struct NUR_CAP_STATS *stats)
+{
+	NurCapture *cap = (NurCapture *)hCap;
+	if (cap == NULL || stats == NULL)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> guard(cap->statsLock);
+	*stats = cap->stats;
+	if (cap->cfg.mode == NUR_CAP_MODE_RECORD && cap->startNs != 0)
+		stats->durationNs = CapNow(CLOCK_MONOTONIC) - cap->startNs;
+	return NUR_NO_ERROR;
+}
+
+int NurCapGetCommandStats(HANDLE hCap, int cmd, struct NUR_CAP_COMMAND_STATS *stats)
+{
+	NurCapture *cap = (NurCapture *)hCap;
+	if (cap == NULL || stats == NULL || cmd < 0 || cmd >= NUR_MAX_COMMANDS)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> guard(cap->statsLock);
+	*stats = cap->commands[cmd];
+	return NUR_NO_ERROR;
+}
+
+void NurCapFree(HANDLE hCap)
+{
+	NurCapture *cap = (NurCapture *)hCap;
+	if (cap == NULL)
+		return;
+	NurCapStop(hCap);
+	delete cap;
+}
@@ -0,0 +1,129 @@
+#ifndef _NURCAPTURE_H_
+#define _NURCAPTURE_H_ 1
+
+#include <NurAPI.h>
+#include "NurExtStats.h"
+
+/// <summary>
+/// Default TCP port of the capture proxy and the replay server.
+/// </summary>
+#define NUR_CAP_DEFAULT_PORT	4334
+
+/// <summary>
+/// Capture instance modes.
+/// </summary>
+#define NUR_CAP_MODE_RECORD		0	// Proxy to a reader, write traffic of both directions to the file
+#define NUR_CAP_MODE_REPLAY		1	// Play module traffic of the file back to the connecting host
+
+/// <summary>
+/// Capture configuration. NurApi connects to the instance with NurApiConnectSocket(hApi, "127.0.0.1", port).
+/// </summary>
+struct NUR_CAP_CONFIG
+{
+	int mode;				/**< NUR_CAP_MODE_RECORD or NUR_CAP_MODE_REPLAY. */
+	int port;				/**< TCP port to listen on. 0 = pick a free port, see NurCapGetPort(). */
+	const char *file;		/**< Capture file, written when recording, read when replaying. */
+	const char *device;		/**< Record: serial device of the reader, e.g. /dev/ttyACM0 (USB readers) or /dev/ttyUSB0. */
+	int baudRate;			/**< Record: serial baud rate. */
+	const char *host;		/**< Record: address of a TCP/IP reader, used when device is NULL. */
+	int hostPort;			/**< Record: port of the TCP/IP reader. */
+	double speed;			/**< Replay: 1.0 = original timing, 2.0 = twice as fast, 0 = no delays. */
+	BOOL verbose;			/**< TRUE to print every record to stdout. */
+};
+
+/// <summary>
+/// Capture counters.
+/// </summary>
+struct NUR_CAP_STATS
+{
+	DWORD sessions;			/**< Host connections handled. */
+	DWORD records;			/**< Data records written or replayed. */
+	ULONGLONG hostBytes;	/**< Bytes from host to module. */
+	ULONGLONG moduleBytes;	/**< Bytes from module to host. */
+	ULONGLONG mismatchBytes;/**< Replay: host bytes that differ from the capture. */
+	ULONGLONG durationNs;	/**< Record: time since start. Replay: length of the loaded capture. */
+	DWORD hostFrames;		/**< NUR command frames from host. */
+	DWORD moduleFrames;		/**< NUR response and notification frames from module. */
+	DWORD notifications;	/**< Unsolicited frames from module. */
+	DWORD frameErrors;		/**< Frames with bad header checksum or CRC, both directions. */
+};
+
+/// <summary>
+/// Per command code counters from the NUR frames passing the capture instance.
+/// </summary>
+struct NUR_CAP_COMMAND_STATS
+{
+	DWORD sent;				/**< Command frames from host. */
+	DWORD responses;		/**< Response frames from module. */
+	DWORD retries;			/**< Commands sent again before the previous one got a response. */
+	DWORD unanswered;		/**< Commands without response when another command was sent or the session ended. */
+	struct NUR_EXT_HISTOGRAM latency;	/**< Time from the command frame to the response frame. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// <summary>
+/// Fills the configuration with defaults: record mode, port NUR_CAP_DEFAULT_PORT, 115200 baud, original speed.
+/// </summary>
+/// <param name="cfg">The configuration.</param>
+void NurCapDefaultConfig(struct NUR_CAP_CONFIG *cfg);
+
+/// <summary>
+/// Creates a capture instance. In replay mode the file is loaded here.
+/// </summary>
+/// <param name="cfg">The configuration. Copied.</param>
+/// <returns>Capture handle, or NULL on invalid configuration or unreadable file.</returns>
+HANDLE NurCapCreate(const struct NUR_CAP_CONFIG *cfg);
+
+/// <summary>
+/// Starts listening. In record mode the capture file is created here.
+/// Each host connection is a session: the recorder opens the reader for it, the replayer plays the next session of the file.
+/// </summary>
+/// <param name="hCap">The capture instance.</param>
+/// <returns>NUR_NO_ERROR or NurApi error code.</returns>
+int NurCapStart(HANDLE hCap);
+
+/// <summary>
+/// Stops listening, ends the session and closes the capture file.
+/// </summary>
+/// <param name="hCap">The capture instance.</param>
+/// <returns>NUR_NO_ERROR or NurApi error code.</returns>
+int NurCapStop(HANDLE hCap);
+
+/// <summary>
+/// Gets the TCP port the instance is listening on.
+/// </summary>
+/// <param name="hCap">The capture instance.</param>
+/// <returns>Port number, or -1 if not started.</returns>
+int NurCapGetPort(HANDLE hCap);
+
+/// <summary>
+/// Gets the capture counters.
+/// </summary>
+/// <param name="hCap">The capture instance.</param>
+/// <param name="stats">Counters are received here.</param>
+/// <returns>NUR_NO_ERROR or NurApi error code.</returns>
+int NurCapGetStats(HANDLE hCap, struct NUR_CAP_STATS *stats);
+
+/// <summary>
+/// Gets the counters of one command code, e.g. 0x31 for inventory.
+/// </summary>
+/// <param name="hCap">The capture instance.</param>
+/// <param name="cmd">Command code 0 - 255.</param>
+/// <param name="stats">Counters are received here.</param>
+/// <returns>NUR_NO_ERROR or NurApi error code.</returns>
+int NurCapGetCommandStats(HANDLE hCap, int cmd, struct NUR_CAP_COMMAND_STATS *stats);
+
+/// <summary>
+/// Stops the instance if needed and frees it.
+/// </summary>
+/// <param name="hCap">The capture instance.</param>
+void NurCapFree(HANDLE hCap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
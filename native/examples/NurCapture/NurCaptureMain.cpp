@@ -0,0 +1,123 @@
+#include "NurCapture.h"
+
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+
+static volatile sig_atomic_t gQuit = 0;
+
+static void OnSignal(int sig)
+{
+	gQuit = 1;
+}
+
+/// <summary>
+/// Prints the command line usage.
+/// </summary>
+static void PrintUsage(const char *prog)
+{
+	_tprintf(_T("Usage: %s -w <file> (-d <device> | -c <host:port>) [options]\r\n"), prog);
+	_tprintf(_T("       %s -r <file> [options]\r\n"), prog);
+	_tprintf(_T("  -w <file>       Record traffic between NurApi and the reader to file\r\n"));
+	_tprintf(_T("  -d <device>     Serial device of the reader, e.g. /dev/ttyACM0\r\n"));
+	_tprintf(_T("  -b <baud>       Serial baud rate (default 115200)\r\n"));
+	_tprintf(_T("  -c <host:port>  TCP/IP reader\r\n"));
+	_tprintf(_T("  -r <file>       Replay recorded module traffic\r\n"));
+	_tprintf(_T("  -x <speed>      Replay speed, 1 = original, 0 = no delays (default 1)\r\n"));
+	_tprintf(_T("  -p <port>       TCP port to listen on (default %d)\r\n"), NUR_CAP_DEFAULT_PORT);
+	_tprintf(_T("  -v              Print every record\r\n"));
+}
+
+/// <summary>
+/// Prints frame counters and response latency of each command code seen.
+/// </summary>
+static void PrintCommandStats(HANDLE hCap)
+{
+	struct NUR_CAP_STATS stats;
+	struct NUR_CAP_COMMAND_STATS cmd;
+
+	NurCapGetStats(hCap, &stats);
+	_tprintf(_T("%u command frames, %u module frames (%u notifications), %u frame errors\r\n"),
+		stats.hostFrames, stats.moduleFrames, stats.notifications, stats.frameErrors);
+	_tprintf(_T(" cmd     sent  resp retry noresp   p50 us   p99 us   max us\r\n"));
+	for (int i = 0; i < 256; i++)
+	{
+		if (NurCapGetCommandStats(hCap, i, &cmd) != NUR_NO_ERROR || cmd.sent == 0)
+			continue;
+		_tprintf(_T("0x%02X %8u %5u %5u %6u %8u %8u %8u\r\n"), i, cmd.sent, cmd.responses, cmd.retries, cmd.unanswered,
+			NurExtHistogramPercentile(&cmd.latency, 50), NurExtHistogramPercentile(&cmd.latency, 99), cmd.latency.maxUs);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	struct NUR_CAP_CONFIG cfg;
+	struct NUR_CAP_STATS stats;
+	HANDLE hCap;
+	char *sep;
+	int opt, error;
+
+	NurCapDefaultConfig(&cfg);
+	while ((opt = getopt(argc, argv, "w:d:b:c:r:x:p:vh")) != -1)
+	{
+		switch (opt)
+		{
+		case 'w': cfg.mode = NUR_CAP_MODE_RECORD; cfg.file = optarg; break;
+		case 'r': cfg.mode = NUR_CAP_MODE_REPLAY; cfg.file = optarg; break;
+		case 'd': cfg.device = optarg; break;
+		case 'b': cfg.baudRate = atoi(optarg); break;
+		case 'c':
+			cfg.host = optarg;
+			sep = strrchr(optarg, ':');
+			if (sep)
+			{
+				*sep = 0;
+				cfg.hostPort = atoi(sep + 1);
+			}
+			break;
+		case 'x': cfg.speed = atof(optarg); break;
+		case 'p': cfg.port = atoi(optarg); break;
+		case 'v': cfg.verbose = TRUE; break;
+		default:
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	hCap = NurCapCreate(&cfg);
+	if (hCap == NULL)
+	{
+		_tprintf(_T("Invalid configuration or capture file\r\n"));
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	error = NurCapStart(hCap);
+	if (error != NUR_NO_ERROR)
+	{
+		_tprintf(_T("Could not start (error %d)\r\n"), error);
+		NurCapFree(hCap);
+		return 1;
+	}
+
+	if (cfg.mode == NUR_CAP_MODE_RECORD)
+		_tprintf(_T("Recording %s to %s\r\n"), cfg.device ? cfg.device : cfg.host, cfg.file);
+	else
+		_tprintf(_T("Replaying %s at %.2fx\r\n"), cfg.file, cfg.speed);
+	_tprintf(_T("Connect with NurApiConnectSocket(hApi, \"127.0.0.1\", %d)\r\n"), NurCapGetPort(hCap));
+	fflush(stdout);
+
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+	while (!gQuit)
+		usleep(100 * 1000);
+
+	NurCapStop(hCap);
+	NurCapGetStats(hCap, &stats);
+	_tprintf(_T("%u sessions, %u records, host %llu bytes, module %llu bytes, %llu mismatching host bytes, %.3f s\r\n"),
+		stats.sessions, stats.records, (unsigned long long)stats.hostBytes, (unsigned long long)stats.moduleBytes,
+		(unsigned long long)stats.mismatchBytes, stats.durationNs / 1e9);
+	PrintCommandStats(hCap);
+	NurCapFree(hCap);
+	return 0;
+}
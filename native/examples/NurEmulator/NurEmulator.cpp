@@ -0,0 +1,1583 @@
+#include "NurEmulator.h"
+#include "NurExtCRC.h"
+
+// Conflicts w/ g++ stdlib
+#undef min
+#undef max
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// NUR protocol framing
+#define NUR_PREAMBLE		0xA5
+#define NUR_HDR_SIZE		6
+#define NUR_CRC_SIZE		2
+#define NUR_HDRFL_UNSOL		0x0001
+#define NUR_HDRFL_IRDATA	0x0002
+#define NUR_MAX_PAYLOAD		(0x8000 - NUR_CRC_SIZE)	// NurApi host receive buffer is 32kB
+
+// NUR protocol command and notification codes (embedded/NUR_protocol.pdf)
+#define NURCMD_PING				0x01
+#define NURCMD_GETMODE			0x04
+#define NURCMD_CLEARIDBUF		0x05
+#define NURCMD_GETIDBUF			0x06
+#define NURCMD_GETMETABUF		0x07
+#define NURCMD_GETREADERINFO	0x09
+#define NURCMD_GETDEVCAPS		0x0B
+#define NURCMD_VERSIONS			0x0C
+#define NURCMD_STOPCONT			0x0E
+#define NURCMD_LOADSETUP		0x22
+#define NURCMD_INVENTORY		0x31
+#define NURCMD_INVENTORYSEL		0x32
+#define NURCMD_READ				0x33
+#define NURCMD_INVSTREAM		0x39
+#define NURCMD_INVENTORYEX		0x3B
+#define NURCMD_INVENTORYREAD	0x41
+#define NURCMD_TAGTRACKING		0x45
+#define NURCMD_DIAG				0x2B
+
+#define NURDIAG_GETREPORT		0x01
+#define NURDIAG_CONFIG			0x02
+
+#define NURNOTIF_INVENTORY		0x82
+#define NURNOTIF_TAGTRACKING	0x83
+#define NURNOTIF_INVENTORYEX	0x88
+#define NURNOTIF_DIAGREPORT		0x8F
+
+// Per tag block in the meta buffer response: length byte + 12 bytes meta + EPC.
+#define META_BLOCK_SIZE(epcLen)	(1 + 12 + (epcLen))
+
+// Gen2 error codes backscattered by the tag, reported with NUR_ERROR_G2_TAG_RESP
+#define G2_TAGERR_NOT_SUPPORTED	0x01
+#define G2_TAGERR_MEM_OVERRUN	0x03
+
+// Emulated tag memory bank sizes in bytes; EPC bank is CRC + PC + EPC
+#define EMU_PASSWD_BYTES	8
+#define EMU_TID_BYTES		12
+#define EMU_USER_BYTES		64
+
+// Module setup field sizes in the order of the NUR_SETUP_* flag bits.
+static const int gSetupFieldSize[] = {
+	4, 1, 1, 1, 1, 1, 1, 1,		// linkFreq ... inventory rounds
+	1, 2, 2, 1, 4, 1, 1, 2,		// antenna mask ... read RSSI filter
+	2, 2, 2, 2, 2, 2, 2, 4,		// write RSSI filter ... per antenna power
+	4, 4, 2, 32, 1				// power offset ... receiver sensitivity
+};
+#define NUM_SETUP_FIELDS	((int)(sizeof(gSetupFieldSize) / sizeof(gSetupFieldSize[0])))
+
+struct EmuTag
+{
+	BYTE epc[NUR_MAX_EPC_LENGTH];
+	signed char rssi;		// Base RSSI, jittered per read
+	BYTE antennaId;
+	BYTE flags;				// Inventoried flag per session, bit set = B
+	DWORD flagTime[4];		// Tick when the flag was set to B
+};
+
+struct EmuBufferEntry
+{
+	int tagIdx;
+	signed char rssi;
+	WORD timestamp;
+	DWORD freq;
+	BYTE channel;
+	BYTE antennaId;
+};
+
+struct EmuInventoryParams
+{
+	int Q;
+	int session;
+	int rounds;
+	int target;				// NUR_INVTARGET_A, NUR_INVTARGET_B or NUR_INVTARGET_AB
+	int selState;			// NUR_SELSTATE_*
+	int filterCount;
+	struct NUR_INVEX_FILTER filters[NUR_MAX_FILTERS];
+};
+
+struct EmuInventoryResult
+{
+	int tagsFound;
+	int roundsDone;
+	int collisions;
+	int Q;
+};
+
+struct NurEmulator;
+
+struct EmuClient
+{
+	NurEmulator *emu;
+	int fd;
+	std::mutex sendLock;
+	std::thread rxThread;
+	std::thread streamThread;
+	std::atomic<bool> streamRunning;
+	BYTE streamNotification;
+	EmuInventoryParams streamParams;
+	DWORD diagFlags;		// NUR_DIAG_CFG_* set by the host
+	DWORD diagInterval;		// Periodic report interval in seconds
+	DWORD diagSentTick;
+
+	EmuClient() : emu(NULL), fd(-1), streamRunning(false), streamNotification(NURNOTIF_INVENTORY),
+		diagFlags(0), diagInterval(0), diagSentTick(0) { }
+};
+
+struct NurEmulator
+{
+	struct NUR_EMU_CONFIG cfg;
+	std::vector<EmuTag> population;
+	std::mt19937 rng;
+	std::mutex lock;				// Population flags, tag buffer and setup
+
+	std::vector<EmuBufferEntry> tagBuffer;
+	std::vector<int> bufferSlot;	// Population index -> tagBuffer index, -1 if not stored
+	int tagBufferSize;
+	DWORD startTick;
+
+	std::vector<BYTE> setupField[NUM_SETUP_FIELDS];
+
+	// Inventory + read set by the host; while active, inventoried tags carry irWords of the bank
+	bool irActive;
+	BYTE irType;					// NUR_IR_EPCDATA or NUR_IR_DATAONLY
+	BYTE irBank;
+	DWORD irAddress;
+	BYTE irWords;
+
+	// Diagnostics counters; uptime is taken from startTick, bytes are counted outside of lock
+	struct NUR_DIAG_REPORT diag;
+	std::atomic<DWORD> bytesIn;
+	std::atomic<DWORD> bytesOut;
+	std::atomic<DWORD> bytesIgnored;
+
+	int listenFd;
+	int port;
+	std::atomic<bool> running;
+	std::thread acceptThread;
+	std::mutex clientLock;
+	std::vector<EmuClient*> clients;
+};
+
+static DWORD EmuTick()
+{
+	return (DWORD)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// <summary>
+/// Module millisecond clock: time since start, running clockDriftPpm fast or slow.
+/// </summary>
+static DWORD EmuUptime(NurEmulator *emu)
+{
+	long long ms = (long long)(DWORD)(EmuTick() - emu->startTick);
+	return (DWORD)(ms + ms * emu->cfg.clockDriftPpm / 1000000);
+}
+
+static void PutWord(std::vector<BYTE> &buf, WORD w)
+{
+	buf.push_back(w & 0xFF);
+	buf.push_back(w >> 8);
+}
+
+static void PutDword(std::vector<BYTE> &buf, DWORD dw)
+{
+	PutWord(buf, dw & 0xFFFF);
+	PutWord(buf, dw >> 16);
+}
+
+static void PutString(std::vector<BYTE> &buf, const char *str)
+{
+	size_t len = strlen(str);
+	buf.push_back((BYTE)len);
+	buf.insert(buf.end(), str, str + len);
+}
+
+static DWORD GetDword(const BYTE *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static WORD GetWord(const BYTE *p)
+{
+	return (WORD)(p[0] | (p[1] << 8));
+}
+
+static bool SendAll(int fd, const BYTE *buf, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			if (n < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+/// <summary>
+/// Frames the payload (command / notification byte, status, data) and sends it.
+/// </summary>
+static bool SendPacket(EmuClient *client, WORD flags, const std::vector<BYTE> &payload)
+{
+	std::vector<BYTE> pkt;
+	DWORD len = (DWORD)payload.size() + NUR_CRC_SIZE;
+	BYTE cs = 0xFF;
+
+	pkt.reserve(NUR_HDR_SIZE + len);
+	pkt.push_back(NUR_PREAMBLE);
+	PutWord(pkt, (WORD)len);
+	PutWord(pkt, flags);
+	for (int i = 0; i < NUR_HDR_SIZE - 1; i++)
+		cs ^= pkt[i];
+	pkt.push_back(cs);
+	pkt.insert(pkt.end(), payload.begin(), payload.end());
+	PutWord(pkt, NurExtCRC16(NUR_EXT_CRC16_INIT, payload.data(), (DWORD)payload.size()));
+
+	client->emu->bytesOut += (DWORD)pkt.size();
+	std::lock_guard<std::mutex> guard(client->sendLock);
+	return SendAll(client->fd, pkt.data(), pkt.size());
+}
+
+static bool SendStatus(EmuClient *client, BYTE cmd, BYTE status)
+{
+	std::vector<BYTE> payload;
+	payload.push_back(cmd);
+	payload.push_back(status);
+	return SendPacket(client, 0, payload);
+}
+
+static void InitSetup(NurEmulator *emu)
+{
+	for (int i = 0; i < NUM_SETUP_FIELDS; i++)
+		emu->setupField[i].assign(gSetupFieldSize[i], 0);
+
+	std::vector<BYTE> &lf = emu->setupField[0];
+	DWORD linkFreq = 256000;
+	memcpy(lf.data(), &linkFreq, 4);
+	emu->setupField[1][0] = NUR_RXDECODING_M4;
+	emu->setupField[7][0] = 0;						// Automatic rounds
+	emu->setupField[8][0] = (BYTE)((1 << std::min(emu->cfg.antennaCount, 8)) - 1);
+	emu->setupField[9][0] = 100;					// Scan single timeout
+	emu->setupField[10][0] = 0xE8; emu->setupField[10][1] = 0x03;
+	emu->setupField[11][0] = 0xFF;					// NUR_ANTENNAID_AUTOSELECT
+	emu->setupField[14][0] = 0xFF;					// Any EPC length
+	emu->setupField[18][0] = 0xF4; emu->setupField[18][1] = 0x01;
+	for (int i = 19; i < 22; i++)
+	{
+		emu->setupField[i][0] = 0xE8;
+		emu->setupField[i][1] = 0x03;
+	}
+	std::fill(emu->setupField[23].begin(), emu->setupField[23].end(), 0xFF);
+	DWORD antMaskEx = (emu->cfg.antennaCount >= 32) ? 0xFFFFFFFF : ((1u << emu->cfg.antennaCount) - 1);
+	memcpy(emu->setupField[25].data(), &antMaskEx, 4);
+	std::fill(emu->setupField[27].begin(), emu->setupField[27].end(), 0xFF);
+}
+
+static void GeneratePopulation(NurEmulator *emu)
+{
+	std::mt19937 gen(emu->cfg.seed);
+	std::uniform_int_distribution<int> byteDist(0, 255);
+	std::uniform_int_distribution<int> rssiDist(-75, -35);
+
+	emu->population.resize(emu->cfg.tagCount);
+	for (int i = 0; i < emu->cfg.tagCount; i++)
+	{
+		EmuTag &tag = emu->population[i];
+		memset(&tag, 0, sizeof(tag));
+		for (int n = 0; n < emu->cfg.epcLen; n++)
+			tag.epc[n] = (BYTE)byteDist(gen);
+		// Last 4 bytes carry the tag number so that every EPC is unique
+		for (int n = 0; n < 4 && n < emu->cfg.epcLen; n++)
+			tag.epc[emu->cfg.epcLen - 1 - n] = (BYTE)(i >> (8 * n));
+		tag.rssi = (signed char)rssiDist(gen);
+		tag.antennaId = (BYTE)(i % (emu->cfg.taggedAntennas > 0 ? emu->cfg.taggedAntennas : emu->cfg.antennaCount));
+	}
+}
+
+/// <summary>
+/// Contents of a memory bank of a population tag: zero passwords, CRC + PC + EPC, a TID with the tag number
+/// as serial and user memory derived from the EPC, so that every tag reads back differently.
+/// </summary>
+static void TagMemory(const NurEmulator *emu, int idx, BYTE bank, std::vector<BYTE> &mem)
+{
+	const EmuTag &tag = emu->population[idx];
+	int epcLen = emu->cfg.epcLen;
+
+	mem.clear();
+	switch (bank)
+	{
+	case NUR_BANK_PASSWD:
+		mem.assign(EMU_PASSWD_BYTES, 0);
+		break;
+	case NUR_BANK_EPC:
+		{
+			WORD pc = (WORD)((epcLen / 2) << 11);
+			mem.push_back(0);
+			mem.push_back(0);
+			mem.push_back(pc >> 8);
+			mem.push_back(pc & 0xFF);
+			mem.insert(mem.end(), tag.epc, tag.epc + epcLen);
+			WORD crc = (WORD)~NurExtCRC16(NUR_EXT_CRC16_INIT, &mem[2], (DWORD)mem.size() - 2);
+			mem[0] = crc >> 8;
+			mem[1] = crc & 0xFF;
+		}
+		break;
+	case NUR_BANK_TID:
+		mem.assign(EMU_TID_BYTES, 0);
+		mem[0] = 0xE2;
+		mem[1] = 0x80;
+		mem[2] = 0x11;
+		mem[3] = 0x30;
+		for (int n = 0; n < 4; n++)
+			mem[EMU_TID_BYTES - 1 - n] = (BYTE)(idx >> (8 * n));
+		break;
+	case NUR_BANK_USER:
+		mem.resize(EMU_USER_BYTES);
+		for (int n = 0; n < EMU_USER_BYTES; n++)
+			mem[n] = (BYTE)(tag.epc[n % epcLen] ^ (n * 0x1D) ^ idx);
+		break;
+	}
+}
+
+/// <summary>
+/// Reads words from a memory bank of a population tag.
+/// </summary>
+/// <returns>0 on success, otherwise the Gen2 error code the tag backscatters.</returns>
+static BYTE ReadTagMemory(const NurEmulator *emu, int idx, BYTE bank, DWORD wordAddress, int words, std::vector<BYTE> &data)
+{
+	std::vector<BYTE> mem;
+
+	TagMemory(emu, idx, bank, mem);
+	if (mem.empty())
+		return G2_TAGERR_NOT_SUPPORTED;
+	if ((wordAddress + words) * 2 > mem.size())
+		return G2_TAGERR_MEM_OVERRUN;
+	data.assign(mem.begin() + wordAddress * 2, mem.begin() + (wordAddress + words) * 2);
+	return 0;
+}
+
+/// <summary>
+/// Size of one tag in the meta buffer response. Inventory + read adds the data length byte and the data.
+/// </summary>
+static int MetaBlockSize(const NurEmulator *emu)
+{
+	if (!emu->irActive)
+		return META_BLOCK_SIZE(emu->cfg.epcLen);
+	if (emu->irType == NUR_IR_DATAONLY)
+		return META_BLOCK_SIZE(emu->irWords * 2) + 1;
+	return META_BLOCK_SIZE(emu->cfg.epcLen + emu->irWords * 2) + 1;
+}
+
+/// <summary>
+/// Tags the buffer holds; fewer while inventory + read data makes the entries longer.
+/// </summary>
+static int BufferCapacity(const NurEmulator *emu)
+{
+	return std::min(emu->tagBufferSize, (NUR_MAX_PAYLOAD - 2) / MetaBlockSize(emu));
+}
+
+/// <summary>
+/// Tests filter mask against the tag EPC memory. EPC bank bit address 0x20 is the first EPC bit.
+/// </summary>
+static bool FilterMatch(const NurEmulator *emu, const EmuTag &tag, const struct NUR_INVEX_FILTER &f)
+{
+	if (f.bank != NUR_BANK_EPC)
+		return true;	// Only EPC bank content is emulated
+
+	for (int bit = 0; bit < f.maskBitLength; bit++)
+	{
+		int epcBit = (int)f.address + bit - 0x20;
+		if (epcBit < 0 || epcBit >= emu->cfg.epcLen * 8)
+			return false;
+		int tagBit = (tag.epc[epcBit / 8] >> (7 - (epcBit % 8))) & 1;
+		int maskBit = (f.maskData[bit / 8] >> (7 - (bit % 8))) & 1;
+		if (tagBit != maskBit)
+			return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// Evaluates the select filters in order like the G2 select commands would. Returns TRUE if tag participates.
+/// </summary>
+static bool Selected(const NurEmulator *emu, const EmuTag &tag, const EmuInventoryParams &p)
+{
+	if (p.filterCount == 0 || p.selState == NUR_SELSTATE_ALL)
+		return true;
+
+	bool sl = false;
+	for (int i = 0; i < p.filterCount; i++)
+	{
+		const struct NUR_INVEX_FILTER &f = p.filters[i];
+		bool match = FilterMatch(emu, tag, f);
+		switch (f.action)
+		{
+		case NUR_FACTION_0: sl = match; break;
+		case NUR_FACTION_1: if (match) sl = true; break;
+		case NUR_FACTION_2: if (!match) sl = false; break;
+		case NUR_FACTION_3: if (match) sl = !sl; break;
+		case NUR_FACTION_4: sl = !match; break;
+		case NUR_FACTION_5: if (match) sl = false; break;
+		case NUR_FACTION_6: if (!match) sl = true; break;
+		case NUR_FACTION_7: if (!match) sl = !sl; break;
+		}
+	}
+	return (p.selState == NUR_SELSTATE_SL) ? sl : !sl;
+}
+
+/// <summary>
+/// Simulates Gen2 Q rounds over the population and stores the singulated tags in the tag buffer.
+/// Session 1 flags persist for 2 seconds, session 2 and 3 flags until re-targeted.
+/// Caller must hold emu->lock.
+/// </summary>
+static void RunInventory(NurEmulator *emu, const EmuInventoryParams &p, EmuInventoryResult *res)
+{
+	std::uniform_int_distribution<int> pctDist(0, 99);
+	std::uniform_int_distribution<int> jitterDist(-3, 3);
+	std::vector<int> participants;
+	DWORD now = EmuTick();
+	int session = p.session & 3;
+	BYTE sflag = (BYTE)(1 << session);
+	BYTE selectedAntenna = emu->setupField[11][0];	// 0xFF = NUR_ANTENNAID_AUTOSELECT, all antennas
+
+	memset(res, 0, sizeof(*res));
+
+	for (int i = 0; i < (int)emu->population.size(); i++)
+	{
+		EmuTag &tag = emu->population[i];
+		if (session == 1 && (tag.flags & sflag) && now - tag.flagTime[1] > 2000)
+			tag.flags &= ~sflag;
+		if (selectedAntenna != 0xFF && tag.antennaId != selectedAntenna)
+			continue;
+		if (pctDist(emu->rng) >= emu->cfg.visibility)
+			continue;
+		if (!Selected(emu, tag, p))
+			continue;
+		bool isB = (session != 0) && (tag.flags & sflag);
+		if (p.target == NUR_INVTARGET_A && isB)
+			continue;
+		if (p.target == NUR_INVTARGET_B && !isB)
+			continue;
+		participants.push_back(i);
+	}
+
+	int rounds = p.rounds > 0 ? p.rounds : 3;
+	int Q = p.Q;
+	std::vector<int> slotCount;
+	std::vector<int> slotTag;
+
+	for (int r = 0; r < rounds && !participants.empty(); r++)
+	{
+		if (p.Q == 0)
+		{
+			// Generic auto-Q: slot count close to the remaining population
+			Q = 0;
+			while (Q < 15 && (1 << Q) < (int)participants.size())
+				Q++;
+		}
+		int slots = 1 << Q;
+		slotCount.assign(slots, 0);
+		slotTag.assign(slots, -1);
+		std::uniform_int_distribution<int> slotDist(0, slots - 1);
+
+		for (size_t n = 0; n < participants.size(); n++)
+		{
+			int s = slotDist(emu->rng);
+			slotCount[s]++;
+			slotTag[s] = (int)n;
+		}
+
+		std::vector<bool> singulated(participants.size(), false);
+		for (int s = 0; s < slots; s++)
+		{
+			if (slotCount[s] > 1)
+				res->collisions++;
+			else if (slotCount[s] == 1)
+				singulated[slotTag[s]] = true;
+		}
+
+		std::vector<int> remaining;
+		for (size_t n = 0; n < participants.size(); n++)
+		{
+			if (!singulated[n])
+			{
+				remaining.push_back(participants[n]);
+				continue;
+			}
+			int idx = participants[n];
+			EmuTag &tag = emu->population[idx];
+			if (session != 0)
+			{
+				if (p.target == NUR_INVTARGET_B)
+					tag.flags &= ~sflag;
+				else
+					tag.flags |= sflag;
+				tag.flagTime[session] = now;
+			}
+
+			// Inventory + read reports only the tags whose read succeeded
+			std::vector<BYTE> irData;
+			if (emu->irActive && ReadTagMemory(emu, idx, emu->irBank, emu->irAddress, emu->irWords, irData) != 0)
+				continue;
+
+			res->tagsFound++;
+			int channel = (int)(now / 200) % 4;
+			EmuBufferEntry entry;
+			entry.tagIdx = idx;
+			entry.rssi = (signed char)(tag.rssi + jitterDist(emu->rng));
+			entry.timestamp = (WORD)EmuUptime(emu);
+			entry.channel = (BYTE)channel;
+			entry.freq = 865700 + channel * 600;
+			entry.antennaId = tag.antennaId;
+
+			int slot = emu->bufferSlot[idx];
+			if (slot >= 0)
+			{
+				if (entry.rssi > emu->tagBuffer[slot].rssi)
+					emu->tagBuffer[slot] = entry;
+			}
+			else if ((int)emu->tagBuffer.size() < BufferCapacity(emu))
+			{
+				emu->bufferSlot[idx] = (int)emu->tagBuffer.size();
+				emu->tagBuffer.push_back(entry);
+			}
+		}
+		participants.swap(remaining);
+		res->roundsDone++;
+	}
+	res->Q = Q;
+
+	emu->diag.invTags += res->tagsFound;
+	emu->diag.invColl += res->collisions;
+	emu->diag.rfActiveTime += std::max(1, emu->cfg.roundTimeMs);
+}
+
+static void ClearTagBuffer(NurEmulator *emu)
+{
+	for (size_t i = 0; i < emu->tagBuffer.size(); i++)
+		emu->bufferSlot[emu->tagBuffer[i].tagIdx] = -1;
+	emu->tagBuffer.clear();
+}
+
+/// <summary>
+/// Appends tag buffer entries [first, last) in "get ID buffer with metadata" format.
+/// </summary>
+static void AppendMetaBlocks(NurEmulator *emu, std::vector<BYTE> &payload, size_t first, size_t last)
+{
+	int epcLen = emu->cfg.epcLen;
+	for (size_t i = first; i < last; i++)
+	{
+		const EmuBufferEntry &e = emu->tagBuffer[i];
+		const EmuTag &tag = emu->population[e.tagIdx];
+		int scaled = std::max(0, std::min(100, (e.rssi + 90) * 2));
+		std::vector<BYTE> id(tag.epc, tag.epc + epcLen);
+		std::vector<BYTE> data;
+
+		if (emu->irActive)
+		{
+			// Read data follows the EPC, or replaces it in data only mode
+			ReadTagMemory(emu, e.tagIdx, emu->irBank, emu->irAddress, emu->irWords, data);
+			if (emu->irType == NUR_IR_DATAONLY)
+				id.clear();
+			id.insert(id.end(), data.begin(), data.end());
+		}
+
+		payload.push_back((BYTE)(META_BLOCK_SIZE(id.size()) - 1 + (emu->irActive ? 1 : 0)));
+		payload.push_back((BYTE)e.rssi);
+		payload.push_back((BYTE)scaled);
+		PutWord(payload, e.timestamp);
+		PutDword(payload, e.freq);
+		if (emu->irActive)
+			payload.push_back((BYTE)(emu->irType == NUR_IR_DATAONLY ? 0 : data.size()));
+		PutWord(payload, (WORD)((epcLen / 2) << 11));	// PC: EPC length in words
+		payload.push_back(e.channel);
+		payload.push_back(e.antennaId);
+		payload.insert(payload.end(), id.begin(), id.end());
+	}
+}
+
+static void AppendInventoryResponse(NurEmulator *emu, std::vector<BYTE> &payload, const EmuInventoryResult &res)
+{
+	PutWord(payload, (WORD)res.tagsFound);
+	PutWord(payload, (WORD)emu->tagBuffer.size());
+	payload.push_back((BYTE)res.roundsDone);
+	PutWord(payload, (WORD)res.collisions);
+	payload.push_back((BYTE)res.Q);
+}
+
+static void DefaultInventoryParams(NurEmulator *emu, EmuInventoryParams *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->Q = emu->setupField[5][0];
+	p->session = emu->setupField[6][0];
+	p->rounds = emu->setupField[7][0];
+	p->target = emu->setupField[13][0];
+	p->selState = NUR_SELSTATE_ALL;
+}
+
+/// <summary>
+/// Parses the 32-bit select block of inventory select and inventory stream commands.
+/// </summary>
+static bool ParseSelectBlock(const BYTE *p, int len, EmuInventoryParams *params)
+{
+	if (len < 8)
+		return false;
+	int blockLen = p[0];
+	if (blockLen + 1 > len || (p[2] & 0x02))
+		return false;	// 64-bit addressing is not emulated
+
+	struct NUR_INVEX_FILTER &f = params->filters[0];
+	memset(&f, 0, sizeof(f));
+	f.bank = p[1];
+	f.address = GetDword(&p[3]);
+	f.maskBitLength = p[7];
+	int maskBytes = (f.maskBitLength + 7) / 8;
+	if (maskBytes > NUR_MAX_SELMASK || 8 + maskBytes > len)
+		return false;
+	memcpy(f.maskData, &p[8], maskBytes);
+	f.action = (p[2] & 0x01) ? NUR_FACTION_4 : NUR_FACTION_0;
+	f.target = NUR_SESSION_SL;
+	params->filterCount = 1;
+	params->selState = NUR_SELSTATE_SL;
+	return true;
+}
+
+/// <summary>
+/// Parses the extended inventory (0x3B) parameters and filters.
+/// </summary>
+static bool ParseInventoryEx(const BYTE *p, int len, EmuInventoryParams *params, BOOL *continuous)
+{
+	if (len < 9)
+		return false;
+
+	memset(params, 0, sizeof(*params));
+	*continuous = (p[0] & 1) ? TRUE : FALSE;
+	params->Q = p[1];
+	params->session = p[2];
+	params->rounds = p[3];
+	params->target = p[6];
+	params->selState = p[7];
+	params->filterCount = p[8];
+	if (params->Q > 15 || params->session > 3 || params->filterCount > NUR_MAX_FILTERS)
+		return false;
+
+	int pos = 9;
+	for (int i = 0; i < params->filterCount; i++)
+	{
+		struct NUR_INVEX_FILTER &f = params->filters[i];
+		if (pos + 9 > len)
+			return false;
+		memset(&f, 0, sizeof(f));
+		f.truncate = p[pos];
+		f.target = p[pos + 1];
+		f.action = p[pos + 2];
+		f.bank = p[pos + 3];
+		f.address = GetDword(&p[pos + 4]);
+		f.maskBitLength = p[pos + 8];
+		int maskBytes = (f.maskBitLength + 7) / 8;
+		pos += 9;
+		if (maskBytes > NUR_MAX_SELMASK || pos + maskBytes > len)
+			return false;
+		memcpy(f.maskData, &p[pos], maskBytes);
+		pos += maskBytes;
+	}
+	return true;
+}
+
+static void StopStream(EmuClient *client)
+{
+	client->streamRunning = false;
+	if (client->streamThread.joinable() && client->streamThread.get_id() != std::this_thread::get_id())
+		client->streamThread.join();
+}
+
+/// <summary>
+/// Inventory stream: one inventory per round time, notify and clear the tag buffer like the module does.
+/// </summary>
+static void StreamThread(EmuClient *client)
+{
+	NurEmulator *emu = client->emu;
+
+	while (client->streamRunning && emu->running)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(std::max(1, emu->cfg.roundTimeMs)));
+		if (!client->streamRunning)
+			break;
+
+		std::vector<BYTE> payload;
+		EmuInventoryResult res;
+		{
+			std::lock_guard<std::mutex> guard(emu->lock);
+			RunInventory(emu, client->streamParams, &res);
+
+			// Tag tracking needs the empty rounds too for its visibility timeouts
+			DWORD opFlags = GetDword(emu->setupField[12].data());
+			bool tracking = (client->streamNotification == NURNOTIF_TAGTRACKING);
+			if (emu->tagBuffer.empty() && !tracking && !(opFlags & NUR_OPFLAGS_INVSTREAM_ZEROS))
+				continue;
+
+			size_t count = std::min(emu->tagBuffer.size(), (size_t)((NUR_MAX_PAYLOAD - 8) / MetaBlockSize(emu)));
+			payload.push_back(client->streamNotification);
+			payload.push_back(NUR_NO_ERROR);
+			payload.push_back(0);		// Not stopped
+			payload.push_back((BYTE)res.roundsDone);
+			PutWord(payload, (WORD)res.collisions);
+			payload.push_back((BYTE)res.Q);
+			if (tracking)
+			{
+				PutDword(payload, 0);	// Scan events
+				PutDword(payload, 0);
+			}
+			AppendMetaBlocks(emu, payload, 0, count);
+			ClearTagBuffer(emu);
+		}
+		if (!SendPacket(client, NUR_HDRFL_UNSOL, payload))
+			break;
+	}
+}
+
+static void StartStream(EmuClient *client, BYTE notification, const EmuInventoryParams &params)
+{
+	StopStream(client);
+	client->streamParams = params;
+	client->streamNotification = notification;
+	client->streamRunning = true;
+	client->streamThread = std::thread(StreamThread, client);
+}
+
+static void HandleLoadSetup(EmuClient *client, const BYTE *p, int len)
+{
+	NurEmulator *emu = client->emu;
+	std::vector<BYTE> payload;
+
+	if (len < 4)
+	{
+		SendStatus(client, NURCMD_LOADSETUP, NUR_ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	DWORD flags = GetDword(p);
+	int pos = 4;
+
+	std::lock_guard<std::mutex> guard(emu->lock);
+	if (len > 4)
+	{
+		// Write: fields are present in flag bit order
+		for (int i = 0; i < NUM_SETUP_FIELDS; i++)
+		{
+			if (!(flags & (1u << i)))
+				continue;
+			if (pos + gSetupFieldSize[i] > len)
+				break;
+			memcpy(emu->setupField[i].data(), &p[pos], gSetupFieldSize[i]);
+			pos += gSetupFieldSize[i];
+		}
+	}
+
+	payload.push_back(NURCMD_LOADSETUP);
+	payload.push_back(NUR_NO_ERROR);
+	DWORD known = flags & ((1u << NUM_SETUP_FIELDS) - 1);
+	PutDword(payload, known);
+	for (int i = 0; i < NUM_SETUP_FIELDS; i++)
+	{
+		if (known & (1u << i))
+			payload.insert(payload.end(), emu->setupField[i].begin(), emu->setupField[i].end());
+	}
+	SendPacket(client, 0, payload);
+}
+
+static void HandleGetMetaBuffer(EmuClient *client, BYTE cmd, const BYTE *p, int len)
+{
+	NurEmulator *emu = client->emu;
+	std::vector<BYTE> payload;
+
+	std::lock_guard<std::mutex> guard(emu->lock);
+	if (emu->tagBuffer.empty())
+	{
+		SendStatus(client, cmd, NUR_ERROR_NO_TAG);
+		return;
+	}
+
+	payload.push_back(cmd);
+	payload.push_back(NUR_NO_ERROR);
+
+	if (len == 4)
+	{
+		// Single tag by tag number
+		DWORD idx = GetDword(p);
+		if (idx >= emu->tagBuffer.size())
+		{
+			SendStatus(client, cmd, NUR_ERROR_INVALID_PARAMETER);
+			return;
+		}
+		AppendMetaBlocks(emu, payload, idx, idx + 1);
+	}
+	else
+	{
+		AppendMetaBlocks(emu, payload, 0, emu->tagBuffer.size());
+		if (len >= 1 && p[0] == 1)
+			ClearTagBuffer(emu);
+	}
+
+	if (cmd == NURCMD_GETIDBUF)
+	{
+		// Plain ID buffer: length, antenna id, EPC
+		std::vector<BYTE> plain;
+		plain.push_back(cmd);
+		plain.push_back(NUR_NO_ERROR);
+		int meta = META_BLOCK_SIZE(0) + (emu->irActive ? 1 : 0);	// Bytes before the EPC, antenna id last
+		for (size_t pos = 2; pos < payload.size(); pos += payload[pos] + 1)
+		{
+			int idLen = payload[pos] + 1 - meta;
+			plain.push_back((BYTE)(idLen + 1));
+			plain.push_back(payload[pos + meta - 1]);
+			plain.insert(plain.end(), payload.begin() + pos + meta, payload.begin() + pos + meta + idLen);
+		}
+		payload.swap(plain);
+	}
+	// Flag tells the host that the blocks carry the inventory + read data length byte
+	SendPacket(client, (cmd == NURCMD_GETMETABUF && emu->irActive) ? NUR_HDRFL_IRDATA : 0, payload);
+}
+
+static void HandleInventory(EmuClient *client, BYTE cmd, const EmuInventoryParams &params)
+{
+	NurEmulator *emu = client->emu;
+	std::vector<BYTE> payload;
+	EmuInventoryResult res;
+
+	if (emu->cfg.roundTimeMs > 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(emu->cfg.roundTimeMs));
+
+	std::lock_guard<std::mutex> guard(emu->lock);
+	RunInventory(emu, params, &res);
+
+	payload.push_back(cmd);
+	payload.push_back(res.tagsFound > 0 ? NUR_NO_ERROR : NUR_ERROR_NO_TAG);
+	AppendInventoryResponse(emu, payload, res);
+	SendPacket(client, 0, payload);
+}
+
+/// <summary>
+/// Read command: flags, password, optional singulation block (bank, bit address, mask bit length, mask)
+/// and read block (bank, word address, word count). The first visible tag matching the singulation is read.
+/// </summary>
+static void HandleRead(EmuClient *client, const BYTE *p, int len)
+{
+	NurEmulator *emu = client->emu;
+	EmuInventoryParams params;
+	int pos = 5;
+
+	if (len < pos)
+	{
+		SendStatus(client, NURCMD_READ, NUR_ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	if (p[0] & 0x0C)
+	{
+		SendStatus(client, NURCMD_READ, NUR_ERROR_INVALID_PARAMETER);	// 64-bit addressing is not emulated
+		return;
+	}
+
+	memset(&params, 0, sizeof(params));
+	params.selState = NUR_SELSTATE_ALL;
+	if (p[0] & 0x02)
+	{
+		int blockLen = (pos < len) ? p[pos] : 0;
+		if (blockLen < 7 || pos + 1 + blockLen > len)
+		{
+			SendStatus(client, NURCMD_READ, NUR_ERROR_INVALID_LENGTH);
+			return;
+		}
+		struct NUR_INVEX_FILTER &f = params.filters[0];
+		f.action = NUR_FACTION_0;
+		f.bank = p[pos + 1];
+		f.address = GetDword(&p[pos + 2]);
+		f.maskBitLength = GetWord(&p[pos + 6]);
+		int maskBytes = (f.maskBitLength + 7) / 8;
+		if (maskBytes > NUR_MAX_SELMASK || 7 + maskBytes > blockLen)
+		{
+			SendStatus(client, NURCMD_READ, NUR_ERROR_INVALID_PARAMETER);
+			return;
+		}
+		memcpy(f.maskData, &p[pos + 8], maskBytes);
+		params.filterCount = 1;
+		params.selState = NUR_SELSTATE_SL;
+		pos += 1 + blockLen;
+	}
+	if (pos + 7 > len)
+	{
+		SendStatus(client, NURCMD_READ, NUR_ERROR_INVALID_LENGTH);
+		return;
+	}
+	BYTE bank = p[pos + 1];
+	DWORD wordAddress = GetDword(&p[pos + 2]);
+	int words = p[pos + 6];
+	if (bank > NUR_BANK_USER || words == 0)
+	{
+		SendStatus(client, NURCMD_READ, NUR_ERROR_INVALID_PARAMETER);
+		return;
+	}
+
+	if (emu->cfg.accessTimeMs > 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(emu->cfg.accessTimeMs));
+
+	std::vector<BYTE> payload;
+	std::vector<BYTE> data;
+	int status = NUR_ERROR_NO_TAG;
+	BYTE tagError = 0;
+	{
+		std::lock_guard<std::mutex> guard(emu->lock);
+		std::uniform_int_distribution<int> pctDist(0, 99);
+		BYTE selectedAntenna = emu->setupField[11][0];
+
+		for (int i = 0; i < (int)emu->population.size(); i++)
+		{
+			const EmuTag &tag = emu->population[i];
+			if (selectedAntenna != 0xFF && tag.antennaId != selectedAntenna)
+				continue;
+			if (!Selected(emu, tag, params) || pctDist(emu->rng) >= emu->cfg.visibility)
+				continue;
+			tagError = ReadTagMemory(emu, i, bank, wordAddress, words, data);
+			status = (tagError != 0) ? NUR_ERROR_G2_TAG_RESP : NUR_NO_ERROR;
+			break;
+		}
+	}
+
+	payload.push_back(NURCMD_READ);
+	payload.push_back((BYTE)status);
+	if (status == NUR_NO_ERROR)
+		payload.insert(payload.end(), data.begin(), data.end());
+	else if (status == NUR_ERROR_G2_TAG_RESP)
+		payload.push_back(tagError);
+	SendPacket(client, 0, payload);
+}
+
+/// <summary>
+/// Inventory + read: 8 bytes (on, type, bank, word address, word count) configure, 1 byte turns on or off
+/// as configured, none gets the configuration in the same layout.
+/// </summary>
+static void HandleInventoryRead(EmuClient *client, const BYTE *p, int len)
+{
+	NurEmulator *emu = client->emu;
+	std::lock_guard<std::mutex> guard(emu->lock);
+
+	if (len == 0)
+	{
+		std::vector<BYTE> payload;
+		payload.push_back(NURCMD_INVENTORYREAD);
+		payload.push_back(NUR_NO_ERROR);
+		payload.push_back(emu->irActive ? 1 : 0);
+		payload.push_back(emu->irType);
+		payload.push_back(emu->irBank);
+		PutDword(payload, emu->irAddress);
+		payload.push_back(emu->irWords);
+		SendPacket(client, 0, payload);
+		return;
+	}
+	if (len == 1)
+	{
+		emu->irActive = (p[0] != 0 && emu->irWords > 0);
+		SendStatus(client, NURCMD_INVENTORYREAD, NUR_NO_ERROR);
+		return;
+	}
+	if (len < 8)
+	{
+		SendStatus(client, NURCMD_INVENTORYREAD, NUR_ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	// XTID types are not emulated
+	if (p[1] > NUR_IR_DATAONLY || p[2] < NUR_BANK_EPC || p[2] > NUR_BANK_USER || p[7] < 1 || p[7] > NUR_MAX_IRDATA_LENGTH / 2)
+	{
+		SendStatus(client, NURCMD_INVENTORYREAD, NUR_ERROR_INVALID_PARAMETER);
+		return;
+	}
+	emu->irActive = (p[0] != 0);
+	emu->irType = p[1];
+	emu->irBank = p[2];
+	emu->irAddress = GetDword(&p[3]);
+	emu->irWords = p[7];
+	SendStatus(client, NURCMD_INVENTORYREAD, NUR_NO_ERROR);
+}
+
+static void HandleReaderInfo(EmuClient *client)
+{
+	NurEmulator *emu = client->emu;
+	std::vector<BYTE> payload;
+
+	payload.push_back(NURCMD_GETREADERINFO);
+	payload.push_back(NUR_NO_ERROR);
+	PutDword(payload, 0x52444901);	// Version 1 magic
+	PutString(payload, "EMU00001");
+	PutString(payload, "");
+	PutString(payload, "NUR Emulator");
+	PutString(payload, "");
+	PutString(payload, "EMU");
+	payload.push_back(5);		// swVerMajor
+	payload.push_back(11);		// swVerMinor
+	payload.push_back('A');		// devBuild
+	payload.push_back(4);		// GPIO
+	payload.push_back(0);		// Sensors
+	payload.push_back(16);		// Regions
+	payload.push_back((BYTE)emu->cfg.antennaCount);
+	SendPacket(client, 0, payload);
+}
+
+static void HandleDeviceCaps(EmuClient *client)
+{
+	NurEmulator *emu = client->emu;
+	std::vector<BYTE> payload;
+
+	payload.push_back(NURCMD_GETDEVCAPS);
+	payload.push_back(NUR_NO_ERROR);
+	PutDword(payload, SZ_NUR_DEVCAPS);
+	PutDword(payload, NUR_DC_RXDECFM0 | NUR_DC_RXDECM2 | NUR_DC_RXDECM4 | NUR_DC_RXDECM8
+		| NUR_DC_RXLF160k | NUR_DC_RXLF256k | NUR_DC_RXLF320k
+		| NUR_DC_INVREAD | NUR_DC_ANTPOWER);
+	PutDword(payload, 0);
+	PutDword(payload, 27);		// maxTxdBm
+	PutDword(payload, 1);		// txAttnStep
+	PutWord(payload, 500);		// maxTxmW
+	PutWord(payload, 20);		// txSteps
+	PutWord(payload, (WORD)emu->tagBufferSize);
+	PutWord(payload, (WORD)emu->cfg.antennaCount);
+	PutWord(payload, 4);		// GPIO
+	PutWord(payload, NUR_CHIPVER_AS3993);
+	PutWord(payload, NUR_MODULETYPE_NUR05WL2);
+	PutDword(payload, 0);
+	payload.resize(2 + SZ_NUR_DEVCAPS, 0);
+	SendPacket(client, 0, payload);
+}
+
+/// <summary>
+/// Appends the diagnostics report in NUR_DIAG_REPORT field order. Caller must hold emu->lock.
+/// </summary>
+static void AppendDiagReport(NurEmulator *emu, std::vector<BYTE> &payload)
+{
+	struct NUR_DIAG_REPORT &d = emu->diag;
+
+	d.uptime = EmuUptime(emu);
+	d.bytesIn = emu->bytesIn;
+	d.bytesOut = emu->bytesOut;
+	d.bytesIgnored = emu->bytesIgnored;
+
+	PutDword(payload, d.flags);
+	PutDword(payload, d.uptime);
+	PutDword(payload, d.rfActiveTime);
+	PutDword(payload, (DWORD)d.temperature);
+	PutDword(payload, d.bytesIn);
+	PutDword(payload, d.bytesOut);
+	PutDword(payload, d.bytesIgnored);
+	PutDword(payload, d.antennaErrors);
+	PutDword(payload, d.hwErrors);
+	PutDword(payload, d.invTags);
+	PutDword(payload, d.invColl);
+	PutDword(payload, d.readTags);
+	PutDword(payload, d.readErrors);
+	PutDword(payload, d.writeTags);
+	PutDword(payload, d.writeErrors);
+	PutDword(payload, d.errorConds);
+	PutDword(payload, d.setupErrs);
+	PutDword(payload, d.invalidCmds);
+}
+
+/// <summary>
+/// Clears the diagnostics counters, uptime keeps running.
+/// </summary>
+static void ResetDiag(NurEmulator *emu)
+{
+	memset(&emu->diag, 0, sizeof(emu->diag));
+	emu->diag.temperature = 35;
+	emu->bytesIn = 0;
+	emu->bytesOut = 0;
+	emu->bytesIgnored = 0;
+}
+
+/// <summary>
+/// Diagnostics command: subcommand 1 gets the report, 2 gets (no data) or sets the notification config.
+/// </summary>
+static void HandleDiag(EmuClient *client, const BYTE *p, int len)
+{
+	NurEmulator *emu = client->emu;
+	std::vector<BYTE> payload;
+
+	if (len < 1)
+	{
+		SendStatus(client, NURCMD_DIAG, NUR_ERROR_INVALID_LENGTH);
+		return;
+	}
+
+	payload.push_back(NURCMD_DIAG);
+	payload.push_back(NUR_NO_ERROR);
+	if (p[0] == NURDIAG_GETREPORT && len >= 5)
+	{
+		std::lock_guard<std::mutex> guard(emu->lock);
+		AppendDiagReport(emu, payload);
+		if (GetDword(p + 1) & NUR_DIAG_GETREPORT_RESET_STATS)
+			ResetDiag(emu);
+	}
+	else if (p[0] == NURDIAG_CONFIG && len == 1)
+	{
+		PutDword(payload, client->diagFlags);
+		PutDword(payload, client->diagInterval);
+	}
+	else if (p[0] == NURDIAG_CONFIG && len >= 9)
+	{
+		client->diagFlags = GetDword(p + 1);
+		client->diagInterval = GetDword(p + 5);
+		client->diagSentTick = EmuTick();
+	}
+	else
+	{
+		SendStatus(client, NURCMD_DIAG, NUR_ERROR_INVALID_PARAMETER);
+		return;
+	}
+	SendPacket(client, 0, payload);
+}
+
+/// <summary>
+/// Sends the periodic diagnostics report notification when due. Called on the client receive thread.
+/// </summary>
+static void PollDiagNotify(EmuClient *client)
+{
+	NurEmulator *emu = client->emu;
+	DWORD now = EmuTick();
+
+	if (!(client->diagFlags & NUR_DIAG_CFG_NOTIFY_PERIODIC) || client->diagInterval == 0
+		|| now - client->diagSentTick < client->diagInterval * 1000)
+		return;
+	client->diagSentTick = now;
+
+	std::vector<BYTE> payload;
+	payload.push_back(NURNOTIF_DIAGREPORT);
+	payload.push_back(NUR_NO_ERROR);
+	{
+		std::lock_guard<std::mutex> guard(emu->lock);
+		AppendDiagReport(emu, payload);
+	}
+	SendPacket(client, NUR_HDRFL_UNSOL, payload);
+}
+
+static void HandleCommand(EmuClient *client, const BYTE *payload, int len)
+{
+	NurEmulator *emu = client->emu;
+	BYTE cmd = payload[0];
+	const BYTE *p = payload + 1;
+	int plen = len - 1;
+	std::vector<BYTE> resp;
+
+	if (emu->cfg.verbose)
+	{
+		printf("EMU: cmd 0x%02x len %d\r\n", cmd, plen);
+		fflush(stdout);
+	}
+
+	switch (cmd)
+	{
+	case NURCMD_PING:
+		resp.push_back(cmd);
+		resp.push_back(NUR_NO_ERROR);
+		resp.push_back('O');
+		resp.push_back('K');
+		SendPacket(client, 0, resp);
+		break;
+
+	case NURCMD_GETMODE:
+		resp.push_back(cmd);
+		resp.push_back(NUR_NO_ERROR);
+		resp.push_back('A');
+		SendPacket(client, 0, resp);
+		break;
+
+	case NURCMD_VERSIONS:
+		resp.push_back(cmd);
+		resp.push_back(NUR_NO_ERROR);
+		resp.push_back(5);
+		resp.push_back(11);
+		resp.push_back('A');
+		resp.push_back(3);
+		resp.push_back(0);
+		resp.push_back('A');
+		SendPacket(client, 0, resp);
+		break;
+
+	case NURCMD_STOPCONT:
+		StopStream(client);
+		SendStatus(client, cmd, NUR_NO_ERROR);
+		break;
+
+	case NURCMD_CLEARIDBUF:
+		{
+			std::lock_guard<std::mutex> guard(emu->lock);
+			ClearTagBuffer(emu);
+		}
+		SendStatus(client, cmd, NUR_NO_ERROR);
+		break;
+
+	case NURCMD_GETIDBUF:
+	case NURCMD_GETMETABUF:
+		HandleGetMetaBuffer(client, cmd, p, plen);
+		break;
+
+	case NURCMD_GETREADERINFO:
+		HandleReaderInfo(client);
+		break;
+
+	case NURCMD_GETDEVCAPS:
+		HandleDeviceCaps(client);
+		break;
+
+	case NURCMD_LOADSETUP:
+		HandleLoadSetup(client, p, plen);
+		break;
+
+	case NURCMD_INVENTORY:
+	case NURCMD_INVENTORYSEL:
+		{
+			EmuInventoryParams params;
+			DefaultInventoryParams(emu, &params);
+			if (plen >= 2)
+			{
+				params.Q = p[0];
+				params.session = p[1];
+			}
+			if (plen >= 3)
+				params.rounds = p[2];
+			if ((cmd == NURCMD_INVENTORYSEL && !ParseSelectBlock(p + 3, plen - 3, &params))
+				|| params.Q > 15 || params.session > 3)
+			{
+				SendStatus(client, cmd, NUR_ERROR_INVALID_PARAMETER);
+				break;
+			}
+			HandleInventory(client, cmd, params);
+		}
+		break;
+
+	case NURCMD_READ:
+		HandleRead(client, p, plen);
+		break;
+
+	case NURCMD_INVENTORYREAD:
+		HandleInventoryRead(client, p, plen);
+		break;
+
+	case NURCMD_INVSTREAM:
+		if (plen == 0)
+		{
+			StopStream(client);
+			SendStatus(client, cmd, NUR_NO_ERROR);
+		}
+		else
+		{
+			EmuInventoryParams params;
+			DefaultInventoryParams(emu, &params);
+			if (plen >= 3)
+			{
+				params.Q = p[0];
+				params.session = p[1];
+				params.rounds = p[2];
+			}
+			if (plen > 3 && !ParseSelectBlock(p + 3, plen - 3, &params))
+			{
+				SendStatus(client, cmd, NUR_ERROR_INVALID_PARAMETER);
+				break;
+			}
+			SendStatus(client, cmd, NUR_NO_ERROR);
+			StartStream(client, NURNOTIF_INVENTORY, params);
+		}
+		break;
+
+	case NURCMD_INVENTORYEX:
+		if (plen == 0)
+		{
+			StopStream(client);
+			SendStatus(client, cmd, NUR_NO_ERROR);
+		}
+		else
+		{
+			EmuInventoryParams params;
+			BOOL continuous;
+			if (!ParseInventoryEx(p, plen, &params, &continuous))
+			{
+				SendStatus(client, cmd, NUR_ERROR_INVALID_PARAMETER);
+				break;
+			}
+			if (continuous)
+			{
+				SendStatus(client, cmd, NUR_NO_ERROR);
+				StartStream(client, NURNOTIF_INVENTORYEX, params);
+			}
+			else
+			{
+				HandleInventory(client, cmd, params);
+			}
+		}
+		break;
+
+	case NURCMD_TAGTRACKING:
+		if (plen == 0)
+		{
+			StopStream(client);
+			SendStatus(client, cmd, NUR_NO_ERROR);
+		}
+		else
+		{
+			// Tag tracking is an inventory stream, the host side does the tracking
+			EmuInventoryParams params;
+			BOOL continuous;
+			DefaultInventoryParams(emu, &params);
+			if (plen > 5 && !ParseInventoryEx(p + 5, plen - 5, &params, &continuous))
+			{
+				SendStatus(client, cmd, NUR_ERROR_INVALID_PARAMETER);
+				break;
+			}
+			SendStatus(client, cmd, NUR_NO_ERROR);
+			StartStream(client, NURNOTIF_TAGTRACKING, params);
+		}
+		break;
+
+	case NURCMD_DIAG:
+		HandleDiag(client, p, plen);
+		break;
+
+	default:
+		if (emu->cfg.verbose)
+		{
+			printf("EMU: unsupported command 0x%02x\r\n", cmd);
+			fflush(stdout);
+		}
+		{
+			std::lock_guard<std::mutex> guard(emu->lock);
+			emu->diag.invalidCmds++;
+		}
+		SendStatus(client, cmd, NUR_ERROR_INVALID_COMMAND);
+		break;
+	}
+}
+
+/// <summary>
+/// Receives and validates frames from one client. Header checksum or CRC failures resync on next preamble.
+/// </summary>
+static void ClientThread(EmuClient *client)
+{
+	NurEmulator *emu = client->emu;
+	std::vector<BYTE> rx;
+	BYTE buf[4096];
+
+	while (emu->running)
+	{
+		struct pollfd pfd = { client->fd, POLLIN, 0 };
+		int ret = poll(&pfd, 1, 100);
+		if (ret < 0 && errno != EINTR)
+			break;
+		PollDiagNotify(client);
+		if (ret <= 0)
+			continue;
+
+		ssize_t n = recv(client->fd, buf, sizeof(buf), 0);
+		if (n <= 0)
+			break;
+		emu->bytesIn += (DWORD)n;
+		rx.insert(rx.end(), buf, buf + n);
+
+		size_t pos = 0;
+		while (rx.size() - pos >= NUR_HDR_SIZE)
+		{
+			const BYTE *hdr = &rx[pos];
+			if (hdr[0] != NUR_PREAMBLE)
+			{
+				emu->bytesIgnored++;
+				pos++;
+				continue;
+			}
+			BYTE cs = 0xFF;
+			for (int i = 0; i < NUR_HDR_SIZE - 1; i++)
+				cs ^= hdr[i];
+			WORD len = GetWord(&hdr[1]);
+			if (cs != hdr[5] || len <= NUR_CRC_SIZE)
+			{
+				emu->bytesIgnored++;
+				pos++;
+				continue;
+			}
+			if (rx.size() - pos < (size_t)(NUR_HDR_SIZE + len))
+				break;
+
+			const BYTE *payload = hdr + NUR_HDR_SIZE;
+			int plen = len - NUR_CRC_SIZE;
+			if (NurExtCRC16(NUR_EXT_CRC16_INIT, payload, plen) == GetWord(&payload[plen]))
+				HandleCommand(client, payload, plen);
+			pos += NUR_HDR_SIZE + len;
+		}
+		rx.erase(rx.begin(), rx.begin() + pos);
+	}
+
+	StopStream(client);
+	shutdown(client->fd, SHUT_RDWR);
+}
+
+static void AcceptThread(NurEmulator *emu)
+{
+	while (emu->running)
+	{
+		struct pollfd pfd = { emu->listenFd, POLLIN, 0 };
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+
+		int fd = accept(emu->listenFd, NULL, NULL);
+		if (fd < 0)
+			continue;
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		EmuClient *client = new EmuClient();
+		client->emu = emu;
+		client->fd = fd;
+		std::lock_guard<std::mutex> guard(emu->clientLock);
+		emu->clients.push_back(client);
+		client->rxThread = std::thread(ClientThread, client);
+	}
+}
+
+void NurEmuDefaultConfig(struct NUR_EMU_CONFIG *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->port = NUR_EMU_DEFAULT_PORT;
+	cfg->tagCount = 1000;
+	cfg->epcLen = 12;
+	cfg->visibility = 50;
+	cfg->roundTimeMs = 20;
+	cfg->accessTimeMs = 5;
+	cfg->antennaCount = 4;
+	cfg->tagBufferSize = 2000;
+	cfg->seed = 1;
+	cfg->verbose = FALSE;
+}
+
+HANDLE NurEmuCreate(const struct NUR_EMU_CONFIG *cfg)
+{
+	if (cfg == NULL || cfg->tagCount < 0 || cfg->epcLen < 2 || cfg->epcLen > NUR_MAX_EPC_LENGTH
+		|| cfg->visibility < 1 || cfg->visibility > 100 || cfg->antennaCount < 1 || cfg->antennaCount > (int)NUR_MAX_ANTENNAS_EX
+		|| cfg->taggedAntennas < 0 || cfg->taggedAntennas > cfg->antennaCount
+		|| cfg->tagBufferSize < 1 || cfg->clockDriftPpm < -100000 || cfg->clockDriftPpm > 100000)
+	{
+		return NULL;
+	}
+
+	NurEmulator *emu = new NurEmulator();
+	emu->cfg = *cfg;
+	emu->rng.seed(cfg->seed);
+	emu->irActive = false;
+	emu->irType = NUR_IR_EPCDATA;
+	emu->irBank = 0;
+	emu->irAddress = 0;
+	emu->irWords = 0;
+	emu->listenFd = -1;
+	emu->port = -1;
+	emu->running = false;
+	emu->startTick = EmuTick();
+	ResetDiag(emu);
+
+	// Whole tag buffer must fit into a single meta buffer response
+	emu->tagBufferSize = std::min(cfg->tagBufferSize, (NUR_MAX_PAYLOAD - 2) / META_BLOCK_SIZE(cfg->epcLen));
+	emu->bufferSlot.assign(cfg->tagCount, -1);
+
+	GeneratePopulation(emu);
+	InitSetup(emu);
+	return (HANDLE)emu;
+}
+
+int NurEmuStart(HANDLE hEmu)
+{
+	NurEmulator *emu = (NurEmulator *)hEmu;
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int one = 1;
+
+	if (emu == NULL)
+		return NUR_ERROR_INVALID_PARAMETER;
+	if (emu->running)
+		return NUR_NO_ERROR;
+
+	emu->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if (emu->listenFd < 0)
+		return NUR_ERROR_TR_NOT_CONNECTED;
+	setsockopt(emu->listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons((uint16_t)emu->cfg.port);
+	if (bind(emu->listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(emu->listenFd, 8) < 0
+		|| getsockname(emu->listenFd, (struct sockaddr *)&addr, &addrLen) < 0)
+	{
+		close(emu->listenFd);
+		emu->listenFd = -1;
+		return NUR_ERROR_TR_NOT_CONNECTED;
+	}
+
+	emu->port = ntohs(addr.sin_port);
+	emu->running = true;
+	emu->acceptThread = std::thread(AcceptThread, emu);
+	return NUR_NO_ERROR;
+}
+
+int NurEmuStop(HANDLE hEmu)
+{
+	NurEmulator *emu = (NurEmulator *)hEmu;
+	if (emu == NULL)
+		return NUR_ERROR_INVALID_PARAMETER;
+	if (!emu->running)
+		return NUR_NO_ERROR;
+
+	emu->running = false;
+	emu->acceptThread.join();
+
+	std::lock_guard<std::mutex> guard(emu->clientLock);
+	for (size_t i = 0; i < emu->clients.size(); i++)
+	{
+		EmuClient *client = emu->clients[i];
+		client->rxThread.join();
+		close(client->fd);
+		delete client;
+	}
+	emu->clients.clear();
+
+	close(emu->listenFd);
+	emu->listenFd = -1;
+	emu->port = -1;
+	return NUR_NO_ERROR;
+}
+
+int NurEmuGetPort(HANDLE hEmu)
+{
+	NurEmulator *emu = (NurEmulator *)hEmu;
+	return emu ? emu->port : -1;
+}
+
+void NurEmuFree(HANDLE hEmu)
+{
+	NurEmulator *emu = (NurEmulator *)hEmu;
+	if (emu == NULL)
+		return;
+	NurEmuStop(hEmu);
+	delete emu;
+}
@@ -0,0 +1,78 @@
+#ifndef _NUREMULATOR_H_
+#define _NUREMULATOR_H_ 1
+
+#include <NurAPI.h>
+
+/// <summary>
+/// Default TCP port of the emulator. Same as the Sampo/Ethernet reader default.
+/// </summary>
+#define NUR_EMU_DEFAULT_PORT	4333
+
+/// <summary>
+/// Emulator configuration: listening port, synthetic tag population and simulated air timing.
+/// </summary>
+struct NUR_EMU_CONFIG
+{
+	int port;				/**< TCP port to listen on. 0 = pick a free port, see NurEmuGetPort(). */
+	int tagCount;			/**< Number of synthetic tags in the field. */
+	int epcLen;				/**< EPC length of the synthetic tags in bytes (2 - NUR_MAX_EPC_LENGTH). */
+	int visibility;			/**< Percentage (1 - 100) of the population answering in a single inventory. */
+	int roundTimeMs;		/**< Simulated air time of one inventory in milliseconds. 0 = no delay. */
+	int accessTimeMs;		/**< Simulated air time of one singulated tag memory read in milliseconds. 0 = no delay. */
+	int antennaCount;		/**< Number of antennas reported by the emulated module. */
+	int taggedAntennas;		/**< Antennas that see tags, from antenna 0; the others see none. 0 = all antennas. */
+	int tagBufferSize;		/**< Emulated module tag buffer size (NUR_DEVICECAPS.szTagBuffer). */
+	DWORD seed;				/**< Seed for the population EPCs and per round randomness. */
+	int clockDriftPpm;		/**< Module clock error against the host in ppm. Applies to uptime and tag timestamps. */
+	BOOL verbose;			/**< TRUE to print every received command to stdout. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// <summary>
+/// Fills the configuration with defaults: 1000 96-bit tags, 50% visibility, 20ms rounds, 5ms reads, 4 antennas.
+/// </summary>
+/// <param name="cfg">The configuration.</param>
+void NurEmuDefaultConfig(struct NUR_EMU_CONFIG *cfg);
+
+/// <summary>
+/// Creates an emulator instance. The synthetic tag population is generated here.
+/// </summary>
+/// <param name="cfg">The configuration. Copied.</param>
+/// <returns>Emulator handle, or NULL on invalid configuration.</returns>
+HANDLE NurEmuCreate(const struct NUR_EMU_CONFIG *cfg);
+
+/// <summary>
+/// Starts listening. Clients connect using NurApiConnectSocket(hApi, "127.0.0.1", port).
+/// </summary>
+/// <param name="hEmu">The emulator.</param>
+/// <returns>NUR_NO_ERROR or NurApi error code.</returns>
+int NurEmuStart(HANDLE hEmu);
+
+/// <summary>
+/// Stops listening and disconnects all clients.
+/// </summary>
+/// <param name="hEmu">The emulator.</param>
+/// <returns>NUR_NO_ERROR or NurApi error code.</returns>
+int NurEmuStop(HANDLE hEmu);
+
+/// <summary>
+/// Gets the TCP port the emulator is listening on.
+/// </summary>
+/// <param name="hEmu">The emulator.</param>
+/// <returns>Port number, or -1 if not started.</returns>
+int NurEmuGetPort(HANDLE hEmu);
+
+/// <summary>
+/// Stops the emulator if needed and frees it.
+/// </summary>
+/// <param name="hEmu">The emulator.</param>
+void NurEmuFree(HANDLE hEmu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
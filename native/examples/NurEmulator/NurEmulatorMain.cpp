@@ -0,0 +1,89 @@
+#include "NurEmulator.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t gQuit = 0;
+
+static void OnSignal(int sig)
+{
+	gQuit = 1;
+}
+
+/// <summary>
+/// Prints the command line usage.
+/// </summary>
+static void PrintUsage(const char *prog)
+{
+	_tprintf(_T("Usage: %s [options]\r\n"), prog);
+	_tprintf(_T("  -p <port>     TCP port to listen on (default %d)\r\n"), NUR_EMU_DEFAULT_PORT);
+	_tprintf(_T("  -n <tags>     Synthetic tag population size (default 1000)\r\n"));
+	_tprintf(_T("  -l <bytes>    EPC length in bytes (default 12)\r\n"));
+	_tprintf(_T("  -v <percent>  Population visibility per inventory (default 50)\r\n"));
+	_tprintf(_T("  -r <ms>       Simulated inventory air time (default 20)\r\n"));
+	_tprintf(_T("  -m <ms>       Simulated tag memory read air time (default 5)\r\n"));
+	_tprintf(_T("  -a <count>    Antenna count (default 4)\r\n"));
+	_tprintf(_T("  -t <count>    Antennas that see tags, from antenna 0 (default all)\r\n"));
+	_tprintf(_T("  -b <tags>     Module tag buffer size (default 2000)\r\n"));
+	_tprintf(_T("  -s <seed>     Population seed (default 1)\r\n"));
+	_tprintf(_T("  -c <ppm>      Module clock drift against the host (default 0)\r\n"));
+	_tprintf(_T("  -d            Print received commands\r\n"));
+}
+
+int main(int argc, char* argv[])
+{
+	struct NUR_EMU_CONFIG cfg;
+	HANDLE hEmu;
+	int opt, error;
+
+	NurEmuDefaultConfig(&cfg);
+	while ((opt = getopt(argc, argv, "p:n:l:v:r:m:a:t:b:s:c:dh")) != -1)
+	{
+		switch (opt)
+		{
+		case 'p': cfg.port = atoi(optarg); break;
+		case 'n': cfg.tagCount = atoi(optarg); break;
+		case 'l': cfg.epcLen = atoi(optarg); break;
+		case 'v': cfg.visibility = atoi(optarg); break;
+		case 'r': cfg.roundTimeMs = atoi(optarg); break;
+		case 'm': cfg.accessTimeMs = atoi(optarg); break;
+		case 'a': cfg.antennaCount = atoi(optarg); break;
+		case 't': cfg.taggedAntennas = atoi(optarg); break;
+		case 'b': cfg.tagBufferSize = atoi(optarg); break;
+		case 's': cfg.seed = (DWORD)strtoul(optarg, NULL, 0); break;
+		case 'c': cfg.clockDriftPpm = atoi(optarg); break;
+		case 'd': cfg.verbose = TRUE; break;
+		default:
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	hEmu = NurEmuCreate(&cfg);
+	if (hEmu == NULL)
+	{
+		_tprintf(_T("Invalid emulator configuration\r\n"));
+		return 1;
+	}
+
+	error = NurEmuStart(hEmu);
+	if (error != NUR_NO_ERROR)
+	{
+		_tprintf(_T("Could not listen on port %d (error %d)\r\n"), cfg.port, error);
+		NurEmuFree(hEmu);
+		return 1;
+	}
+
+	_tprintf(_T("NUR emulator listening on 127.0.0.1:%d, %d tags\r\n"), NurEmuGetPort(hEmu), cfg.tagCount);
+	_tprintf(_T("Connect with NurApiConnectSocket(hApi, \"127.0.0.1\", %d)\r\n"), NurEmuGetPort(hEmu));
+	fflush(stdout);
+
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+	while (!gQuit)
+		usleep(100 * 1000);
+
+	_tprintf(_T("Stopping emulator...\r\n"));
+	NurEmuFree(hEmu);
+	return 0;
+}
@@ -0,0 +1,207 @@
+#include <NurAPI.h>
+#include "NurExtLog.h"
+
+// Conflicts w/ g++ stdlib
+#undef min
+#undef max
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+
+static const char gLevelChars[] = "VEUD";
+
+/// <summary>
+/// Prints the command line usage.
+/// </summary>
+static void PrintUsage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options] <file>\n", prog);
+	fprintf(stderr, "Decodes a binary log written by NurExtLogOpen().\n\n");
+	fprintf(stderr, "  -r     Timestamps in seconds since the log was opened instead of wall clock\n");
+	fprintf(stderr, "  -s     Print record count per event instead of the records\n");
+	fprintf(stderr, "  -h     Show this help\n");
+}
+
+/// <summary>
+/// Formats the record with the format of its event. Each conversion takes one argument,
+/// %E takes a byte count and the bytes packed into the following arguments.
+/// </summary>
+static std::string FormatRecord(const char *format, const struct NUR_EXT_LOG_RECORD &rec)
+{
+	std::string out;
+	int arg = 0;
+
+	for (const char *p = format; *p; p++)
+	{
+		if (*p != '%')
+		{
+			out += *p;
+			continue;
+		}
+		if (p[1] == '%')
+		{
+			out += '%';
+			p++;
+			continue;
+		}
+
+		// Flags and width are passed to printf, length modifiers are replaced with ll
+		std::string spec = "%";
+		for (p++; *p && strchr("-+ #0123456789.", *p); p++)
+			spec += *p;
+		while (*p && strchr("hlzjt", *p))
+			p++;
+		if (!*p)
+			break;
+
+		char buf[256];
+		if (arg >= rec.argCount)
+		{
+			snprintf(buf, sizeof(buf), "<missing>");
+		}
+		else if (*p == 'E')
+		{
+			size_t len = (size_t)rec.args[arg++];
+			size_t avail = (rec.argCount - arg) * sizeof(ULONGLONG);
+			const BYTE *bytes = (const BYTE *)&rec.args[arg];
+			buf[0] = 0;
+			for (size_t i = 0; i < len && i < avail; i++)
+				snprintf(buf + i * 2, sizeof(buf) - i * 2, "%02X", bytes[i]);
+			arg = rec.argCount;
+		}
+		else if (*p == 'd' || *p == 'i')
+		{
+			snprintf(buf, sizeof(buf), (spec + "lld").c_str(), (long long)rec.args[arg++]);
+		}
+		else if (*p == 'u' || *p == 'x' || *p == 'X' || *p == 'c')
+		{
+			snprintf(buf, sizeof(buf), (spec + (*p == 'c' ? "c" : std::string("ll") + *p)).c_str(), (unsigned long long)rec.args[arg++]);
+		}
+		else
+		{
+			snprintf(buf, sizeof(buf), "<%%%c?>", *p);
+		}
+		out += buf;
+	}
+	return out;
+}
+
+static void PrintTimestamp(const struct NUR_EXT_LOG_HEADER &hdr, ULONGLONG timestampNs, bool relative)
+{
+	long long sinceOpen = (long long)(timestampNs - hdr.monotonicNs);
+
+	if (relative)
+	{
+		printf("%12.6f ", sinceOpen / 1e9);
+		return;
+	}
+
+	ULONGLONG wallNs = hdr.realtimeNs + sinceOpen;
+	time_t sec = (time_t)(wallNs / 1000000000ULL);
+	struct tm tm;
+	char buf[32];
+	localtime_r(&sec, &tm);
+	strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+	printf("%s.%06u ", buf, (unsigned)(wallNs % 1000000000ULL / 1000));
+}
+
+int main(int argc, char* argv[])
+{
+	struct NUR_EXT_LOG_HEADER hdr;
+	struct NUR_EXT_LOG_RECORD rec;
+	std::map<WORD, std::string> formats;
+	std::map<WORD, ULONGLONG> counts;
+	bool relative = false;
+	bool summary = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "rsh")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r': relative = true; break;
+		case 's': summary = true; break;
+		default:
+			PrintUsage(argv[0]);
+			return (opt == 'h') ? 0 : 1;
+		}
+	}
+	if (optind != argc - 1)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	FILE *fp = fopen(argv[optind], "rb");
+	if (!fp)
+	{
+		fprintf(stderr, "Could not open %s\n", argv[optind]);
+		return 1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || memcmp(hdr.magic, NUR_EXT_LOG_MAGIC, sizeof(hdr.magic)) != 0
+		|| hdr.recordSize != sizeof(rec))
+	{
+		fprintf(stderr, "%s is not a binary NurApi log\n", argv[optind]);
+		fclose(fp);
+		return 1;
+	}
+
+	// Definitions may be written after the first records using them, so collect them first
+	std::map<WORD, std::string> pending;
+	while (fread(&rec, sizeof(rec), 1, fp) == 1)
+	{
+		if (rec.eventId != NUR_EXT_LOGEV_DEFINE)
+			continue;
+		WORD id = (WORD)(rec.args[0] & 0xFFFF);
+		if ((rec.args[0] >> 16) == 0)
+			pending[id].clear();
+		const char *chunk = (const char *)&rec.args[1];
+		size_t len = strnlen(chunk, (NUR_EXT_LOG_MAX_ARGS - 1) * sizeof(ULONGLONG));
+		pending[id].append(chunk, len);
+		if (len < (NUR_EXT_LOG_MAX_ARGS - 1) * sizeof(ULONGLONG))
+			formats[id] = pending[id];
+	}
+
+	fseek(fp, sizeof(hdr), SEEK_SET);
+	while (fread(&rec, sizeof(rec), 1, fp) == 1)
+	{
+		if (rec.eventId == NUR_EXT_LOGEV_DEFINE)
+			continue;
+		if (summary)
+		{
+			counts[rec.eventId]++;
+			continue;
+		}
+
+		PrintTimestamp(hdr, rec.timestampNs, relative);
+		printf("%c ", rec.level < sizeof(gLevelChars) - 1 ? gLevelChars[rec.level] : '?');
+		if (rec.handle)
+			printf("%08x ", rec.handle);
+		else
+			printf("-        ");
+
+		std::map<WORD, std::string>::iterator it = formats.find(rec.eventId);
+		if (it != formats.end())
+		{
+			printf("%s\n", FormatRecord(it->second.c_str(), rec).c_str());
+			continue;
+		}
+		printf("event 0x%04x", rec.eventId);
+		for (int i = 0; i < rec.argCount && i < NUR_EXT_LOG_MAX_ARGS; i++)
+			printf(" %llu", (unsigned long long)rec.args[i]);
+		printf("\n");
+	}
+	fclose(fp);
+
+	for (std::map<WORD, ULONGLONG>::iterator it = counts.begin(); it != counts.end(); ++it)
+	{
+		std::map<WORD, std::string>::iterator f = formats.find(it->first);
+		printf("%10llu  0x%04x  %s\n", (unsigned long long)it->second, it->first, f != formats.end() ? f->second.c_str() : "");
+	}
+	return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * NurApiExt.h
+ *
+ *  Host side extensions to NurApi. Built on top of the public NurApi functions,
+ *  see Makefile for building libNurApiExt.a.
+ */
+
+#ifndef _NURAPIEXT_H_
+#define _NURAPIEXT_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup EXTAPI NurApi host side extensions.
+ *  Functions that operate on a NurApi handle and keep their own per handle state.
+ *  @{
+ */
+
+/** @fn void NurExtFree(HANDLE hApi)
+ *
+ * Release all extension state associated with the NurApi handle.
+ * Call before NurApiFree().
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ */
+void NURAPICONV NurExtFree(HANDLE hApi);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "NurExtCRC.h"
+#include "NurExtStats.h"
+#include "NurExtTime.h"
+#include "NurExtTagDrain.h"
+#include "NurExtTagIndex.h"
+#include "NurExtNotify.h"
+#include "NurExtDispatch.h"
+#include "NurExtTagRing.h"
+#include "NurExtStreamGroup.h"
+#include "NurExtDedup.h"
+#include "NurExtTagBus.h"
+#include "NurExtFanout.h"
+#include "NurExtQControl.h"
+#include "NurExtSplit.h"
+#include "NurExtBulkRead.h"
+#include "NurExtAsync.h"
+#include "NurExtReactor.h"
+#include "NurExtMetrics.h"
+#include "NurExtLog.h"
+
+#endif
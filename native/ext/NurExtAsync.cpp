@@ -0,0 +1,263 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <chrono>
+
+static void AsyncThread(NurExtContext *ctx);
+
+/// <summary>
+/// Reports a finished request. Caller holds ctx->asyncLock.
+/// </summary>
+static void Complete(NurExtContext *ctx, const NurExtAsyncRequest &req, std::unique_lock<std::mutex> &lock)
+{
+	if (req.completion)
+	{
+		lock.unlock();
+		req.completion(ctx->hApi, req.id, req.error, req.arg);
+		lock.lock();
+	}
+	else
+	{
+		if (ctx->asyncDone.empty() && ctx->asyncFd >= 0)
+		{
+			eventfd_write(ctx->asyncFd, 1);
+		}
+		ctx->asyncDone.push_back(req);
+	}
+	// After the completion has returned, so that a waiter may free the request's arg
+	ctx->asyncLastId = req.id;
+	ctx->asyncCond.notify_all();
+}
+
+/// <summary>
+/// Executes the first queued request. Caller holds ctx->asyncLock.
+/// </summary>
+static void RunOne(NurExtContext *ctx, std::unique_lock<std::mutex> &lock)
+{
+	NurExtAsyncRequest req = ctx->asyncQueue.front();
+	lock.unlock();
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	DWORD waitUs = NurExtElapsedUs(req.submitted);
+	ctx->statRequestWait.Add(waitUs);
+	req.error = req.func(ctx->hApi, req.arg);
+	DWORD execUs = NurExtElapsedUs(t0);
+	ctx->statRequestExec.Add(execUs);
+	if (NurExtLogEnabled(NUR_LOG_VERBOSE))
+	{
+		ULONGLONG args[4] = { req.id, (ULONGLONG)req.error, waitUs, execUs };
+		NurExtLogEvent(ctx->hApi, NUR_LOG_VERBOSE, NUR_EXT_LOGEV_REQUEST, args, 4);
+	}
+	lock.lock();
+
+	ctx->asyncQueue.pop_front();
+	Complete(ctx, req, lock);
+}
+
+/// <summary>
+/// Starts the handle's own request thread if needed. Caller holds ctx->asyncLock.
+/// </summary>
+static void StartThread(NurExtContext *ctx)
+{
+	if (!ctx->asyncThread.joinable())
+		ctx->asyncThread = std::thread(AsyncThread, ctx);
+}
+
+/// <summary>
+/// Reactor task: runs one request of the handle and requeues itself while requests remain,
+/// so that handles sharing a reactor take turns.
+/// </summary>
+static void ReactorStep(std::shared_ptr<NurExtContext> ctx)
+{
+	{
+		std::unique_lock<std::mutex> lock(ctx->asyncLock);
+		// Detached by NurExtReactorFree(): the step only hands the request over to the own thread below
+		if (!ctx->asyncStop && ctx->asyncReactor && !ctx->asyncQueue.empty())
+			RunOne(ctx.get(), lock);
+	}
+
+	std::lock_guard<std::mutex> reactorGuard(gReactorLock);
+	std::lock_guard<std::mutex> guard(ctx->asyncLock);
+
+	if (ctx->asyncStop || ctx->asyncQueue.empty())
+	{
+		ctx->asyncScheduled = false;
+	}
+	else if (ctx->asyncReactor)
+	{
+		NurExtReactorPost(ctx->asyncReactor, std::bind(ReactorStep, ctx));
+	}
+	else
+	{
+		// Detached meanwhile, continue on own thread
+		ctx->asyncScheduled = false;
+		StartThread(ctx.get());
+	}
+	ctx->asyncCond.notify_all();
+}
+
+static void AsyncThread(NurExtContext *ctx)
+{
+	std::unique_lock<std::mutex> lock(ctx->asyncLock);
+
+	for (;;)
+	{
+		ctx->asyncCond.wait(lock, [ctx] { return ctx->asyncStop || ctx->asyncReactor || !ctx->asyncQueue.empty(); });
+		// Attached to a reactor: let it take over
+		if (ctx->asyncStop || ctx->asyncReactor)
+			break;
+
+		RunOne(ctx, lock);
+	}
+}
+
+void NurExtStopAsync(NurExtContext *ctx)
+{
+	{
+		std::lock_guard<std::mutex> reactorGuard(gReactorLock);
+		std::lock_guard<std::mutex> guard(ctx->asyncLock);
+		ctx->asyncStop = true;
+		NurExtReactorForget(ctx);
+		ctx->asyncCond.notify_all();
+	}
+
+	std::unique_lock<std::mutex> lock(ctx->asyncLock);
+
+	if (ctx->asyncThread.joinable())
+	{
+		lock.unlock();
+		ctx->asyncThread.join();
+		lock.lock();
+	}
+	// Queued reactor task sees asyncStop and returns
+	ctx->asyncCond.wait(lock, [ctx] { return !ctx->asyncScheduled; });
+
+	while (!ctx->asyncQueue.empty())
+	{
+		NurExtAsyncRequest req = ctx->asyncQueue.front();
+		ctx->asyncQueue.pop_front();
+		req.error = NUR_ERROR_INVALID_HANDLE;
+		Complete(ctx, req, lock);
+	}
+
+	if (ctx->asyncFd >= 0)
+	{
+		close(ctx->asyncFd);
+		ctx->asyncFd = -1;
+	}
+}
+
+void NurExtJoinAsyncThread(NurExtContext *ctx)
+{
+	std::unique_lock<std::mutex> lock(ctx->asyncLock);
+	if (ctx->asyncThread.joinable())
+	{
+		lock.unlock();
+		ctx->asyncThread.join();
+	}
+}
+
+int NURAPICONV NurExtSubmit(HANDLE hApi, NurExtAsyncFunction func, NurExtAsyncCompletion completion, LPVOID arg, DWORD *requestId)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!func)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> reactorGuard(gReactorLock);
+	std::lock_guard<std::mutex> guard(ctx->asyncLock);
+	if (ctx->asyncStop)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (ctx->asyncQueue.size() >= NUR_EXT_ASYNC_MAX_QUEUE)
+		return NUR_ERROR_BUFFER_TOO_SMALL;
+
+	NurExtAsyncRequest req;
+	req.id = ctx->asyncNextId++;
+	req.func = func;
+	req.completion = completion;
+	req.arg = arg;
+	req.error = NUR_NO_ERROR;
+	req.submitted = std::chrono::steady_clock::now();
+	ctx->asyncQueue.push_back(req);
+
+	if (ctx->asyncReactor)
+	{
+		if (!ctx->asyncScheduled)
+		{
+			ctx->asyncScheduled = true;
+			NurExtReactorPost(ctx->asyncReactor, std::bind(ReactorStep, ctx));
+		}
+	}
+	else if (!ctx->asyncScheduled)
+	{
+		StartThread(ctx.get());
+	}
+	ctx->asyncCond.notify_all();
+
+	if (requestId)
+		*requestId = req.id;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetCompletion(HANDLE hApi, DWORD *requestId, int *error, LPVOID *arg)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!requestId || !error)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> guard(ctx->asyncLock);
+	if (ctx->asyncDone.empty())
+		return NUR_ERROR_NOT_READY;
+
+	const NurExtAsyncRequest &req = ctx->asyncDone.front();
+	*requestId = req.id;
+	*error = req.error;
+	if (arg)
+		*arg = req.arg;
+	ctx->asyncDone.pop_front();
+
+	if (ctx->asyncDone.empty() && ctx->asyncFd >= 0)
+	{
+		eventfd_t value;
+		eventfd_read(ctx->asyncFd, &value);
+	}
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetCompletionFd(HANDLE hApi)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return -1;
+
+	std::lock_guard<std::mutex> guard(ctx->asyncLock);
+	if (ctx->asyncFd < 0)
+	{
+		ctx->asyncFd = eventfd(ctx->asyncDone.empty() ? 0 : 1, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+	return ctx->asyncFd;
+}
+
+int NURAPICONV NurExtWaitRequest(HANDLE hApi, DWORD requestId, DWORD timeoutMs)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	std::unique_lock<std::mutex> lock(ctx->asyncLock);
+	if ((int)(requestId - ctx->asyncNextId) >= 0)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	// Requests complete in submission order
+	bool done = ctx->asyncCond.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+		[&ctx, requestId] { return (int)(ctx->asyncLastId - requestId) >= 0; });
+	return done ? NUR_NO_ERROR : NUR_ERROR_TR_TIMEOUT;
+}
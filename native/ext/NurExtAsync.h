@@ -0,0 +1,100 @@
+/*
+ * NurExtAsync.h
+ *
+ *  Asynchronous submission of NurApi calls.
+ */
+
+#ifndef _NUREXTASYNC_H_
+#define _NUREXTASYNC_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Maximum number of submitted, not yet completed requests per handle. */
+#define NUR_EXT_ASYNC_MAX_QUEUE		1024
+
+/**
+ * Work of an asynchronous request. Performs any synchronous NurApi call(s) on <i>hApi</i>.
+ * @return NurApi error code, passed to the completion.
+ */
+typedef int (NURAPICALLBACK *NurExtAsyncFunction)(HANDLE hApi, LPVOID arg);
+
+/**
+ * Completion of an asynchronous request. Called on the request thread of the handle.
+ */
+typedef void (NURAPICALLBACK *NurExtAsyncCompletion)(HANDLE hApi, DWORD requestId, int error, LPVOID arg);
+
+/** @fn int NurExtSubmit(HANDLE hApi, NurExtAsyncFunction func, NurExtAsyncCompletion completion, LPVOID arg, DWORD *requestId)
+ *
+ * Submit a NurApi call without waiting for it. Requests of a handle are executed in submission order
+ * on a request thread of the handle, back to back: the next command is sent as soon as the previous response
+ * is in, without a round trip through the application.
+ *
+ * Completion is reported either by calling <i>completion</i>, or, if it is NULL, by queuing the result for
+ * NurExtGetCompletion(). The completion queue can be waited for with NurExtGetCompletionFd().
+ *
+ * @note The module executes one command at a time and NurApi waits for each response, so requests are
+ *       not overlapped on the wire.
+ *
+ * @sa NurExtGetCompletion(), NurExtWaitRequest()
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	func		Function that performs the call(s).
+ * @param	completion	Completion function or NULL.
+ * @param	arg			Passed to <i>func</i> and <i>completion</i>.
+ * @param	requestId	Request id is received in this pointer. May be NULL.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_BUFFER_TOO_SMALL if NUR_EXT_ASYNC_MAX_QUEUE requests are pending. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtSubmit(HANDLE hApi, NurExtAsyncFunction func, NurExtAsyncCompletion completion, LPVOID arg, DWORD *requestId);
+
+/** @fn int NurExtGetCompletion(HANDLE hApi, DWORD *requestId, int *error, LPVOID *arg)
+ *
+ * Get next completed request submitted without a completion function. Does not block.
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	requestId	Request id is received in this pointer.
+ * @param	error		Result of the request function is received in this pointer.
+ * @param	arg			Argument given in NurExtSubmit() is received in this pointer. May be NULL.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if no completions are queued. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetCompletion(HANDLE hApi, DWORD *requestId, int *error, LPVOID *arg);
+
+/** @fn int NurExtGetCompletionFd(HANDLE hApi)
+ *
+ * Get file descriptor that is readable while NurExtGetCompletion() has completions queued.
+ * For use with poll(), select() or epoll. Do not read from or close the descriptor.
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ *
+ * @return	File descriptor, or -1 on error.
+ */
+int NURAPICONV NurExtGetCompletionFd(HANDLE hApi);
+
+/** @fn int NurExtWaitRequest(HANDLE hApi, DWORD requestId, DWORD timeoutMs)
+ *
+ * Wait until a request has been executed and its completion function, if any, has returned.
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	requestId	Request id from NurExtSubmit().
+ * @param	timeoutMs	Timeout in milliseconds.
+ *
+ * @return	Zero when the request has been executed, NUR_ERROR_TR_TIMEOUT on timeout. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtWaitRequest(HANDLE hApi, DWORD requestId, DWORD timeoutMs);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
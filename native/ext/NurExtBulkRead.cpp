@@ -0,0 +1,413 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <limits.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+#define BULKREAD_COST_WEIGHT	8		// Singulated read time is averaged over about this many reads
+
+/// <summary>
+/// State of one bulk read job.
+/// </summary>
+struct NurExtBulkJob
+{
+	HANDLE hApi;
+	struct NUR_EXT_BULKREAD_CONFIG cfg;
+	std::vector<struct NUR_EXT_BULKREAD_TAG> tags;
+	std::vector<bool> done;					// Read, failed for good or out of attempts
+	std::unordered_map<std::string, int> byEpc;
+	struct NUR_EXT_BULKREAD_STATS stats;
+	int left;								// Tags not done
+	bool invReadOk;							// The range can be read by inventory + read
+	bool invReadOn;							// Inventory + read configured to the module
+	bool invReadSaved;						// invReadPrev holds the application's inventory + read setup
+	struct NUR_IRINFORMATION invReadPrev;
+	bool invReadDone;						// An inventory read no new tags
+	double invCostNs;						// Time of the latest inventory per tag it read
+	double readCostNs;						// Average time of a singulated read, 0 = none timed yet
+	ULONGLONG deadlineNs;					// 0 = no time limit
+};
+
+/// <summary>
+/// Singulated read errors that may pass on another try: the tag was not found or the air exchange failed.
+/// </summary>
+static bool IsRetryable(int error)
+{
+	return error == NUR_ERROR_NO_TAG || error == NUR_ERROR_G2_SELECT || error == NUR_ERROR_G2_READ
+		|| error == NUR_ERROR_G2_RD_PART || error == NUR_ERROR_G2_TAG_INSUF_POWER;
+}
+
+/// <summary>
+/// Errors answered by the tag or of its access. The tag is given up, the job goes on.
+/// </summary>
+static bool IsTagError(int error)
+{
+	return error == NUR_ERROR_G2_ACCESS || error == NUR_ERROR_G2_TAG_RESP
+		|| (error >= NUR_ERROR_G2_TAG_MEM_OVERRUN && error <= NUR_ERROR_G2_TAG_NON_SPECIFIC)
+		|| (error >= NUR_ERROR_G2_TAG_OTHER_ERROR && error <= NUR_ERROR_G2_TAG_SEC_TIMEOUT);
+}
+
+static std::string EpcKey(const BYTE *epc, int epcLen)
+{
+	return std::string((const char *)epc, (size_t)epcLen);
+}
+
+static void Finish(NurExtBulkJob *job, int idx, int status, int method)
+{
+	struct NUR_EXT_BULKREAD_TAG &tag = job->tags[idx];
+
+	tag.status = status;
+	if (status == NUR_NO_ERROR)
+	{
+		tag.method = method;
+		tag.dataLen = (WORD)(job->cfg.wordCount * 2);
+		job->stats.read++;
+		if (method == NUR_EXT_BULKREAD_INVREAD)
+			job->stats.invReads++;
+		else
+			job->stats.singulatedReads++;
+	}
+	job->done[idx] = true;
+	job->left--;
+}
+
+static bool Expired(const NurExtBulkJob *job)
+{
+	return job->deadlineNs != 0 && NurExtGetMonotonicNs() >= job->deadlineNs;
+}
+
+/// <summary>
+/// True when the next tags should be read by an inventory + read inventory rather than singulated.
+/// </summary>
+static bool UseInvRead(const NurExtBulkJob *job)
+{
+	if (!job->invReadOk || job->invReadDone || job->cfg.method == NUR_EXT_BULKREAD_SINGULATED)
+		return false;
+	if (job->cfg.method == NUR_EXT_BULKREAD_INVREAD)
+		return true;
+	if (job->left < job->cfg.invReadMinTags)
+		return false;
+	if (job->stats.inventories == 0)
+		return true;
+	// Time a singulated read before comparing
+	if (job->readCostNs == 0)
+		return false;
+	return job->invCostNs < job->readCostNs;
+}
+
+/// <summary>
+/// Copy the tags of the tag storage and clear it, unless it holds more than capacity tags.
+/// </summary>
+static int TakeStorage(NurExtContext *ctx, std::vector<struct NUR_TAG_DATA_EX> &stored, int capacity, int *tagCount)
+{
+	std::lock_guard<std::mutex> guard(ctx->drainLock);
+	HANDLE hApi = ctx->hApi;
+	int count = 0;
+	int error;
+
+	error = NurApiLockTagStorage(hApi, TRUE);
+	if (error != NUR_NO_ERROR)
+		return error;
+
+	error = NurApiGetTagCount(hApi, &count);
+	if (error == NUR_NO_ERROR && count > capacity)
+	{
+		*tagCount = count;
+		error = NUR_ERROR_BUFFER_TOO_SMALL;
+	}
+	else if (error == NUR_NO_ERROR && count > 0)
+	{
+		stored.resize(count);
+		error = NurApiGetAllTagDataEx(hApi, stored.data(), &count, sizeof(struct NUR_TAG_DATA_EX));
+		stored.resize(error == NUR_NO_ERROR ? count : 0);
+		// NurApiClearTags() clears the module tag buffer instead when the storage is empty, so only call it with tags stored
+		if (error == NUR_NO_ERROR)
+			error = NurApiClearTags(hApi);
+	}
+	NurApiLockTagStorage(hApi, FALSE);
+	return error;
+}
+
+/// <summary>
+/// One inventory + read inventory. The tags found are taken from the tag storage, leaving it empty,
+/// and the data of the job's tags is copied.
+/// </summary>
+static int InvReadRound(NurExtContext *ctx, NurExtBulkJob *job)
+{
+	HANDLE hApi = job->hApi;
+	const struct NUR_EXT_BULKREAD_CONFIG &cfg = job->cfg;
+	struct NUR_INVENTORY_RESPONSE resp;
+	ULONGLONG startNs = NurExtGetMonotonicNs();
+	std::vector<struct NUR_TAG_DATA_EX> stored;
+	int count;
+	int error;
+
+	if (!job->invReadOn)
+	{
+		job->invReadSaved = (NurApiGetInventoryRead(hApi, &job->invReadPrev) == NUR_NO_ERROR);
+		error = NurApiInventoryRead(hApi, TRUE, NUR_IR_EPCDATA, cfg.bank, cfg.wordAddress, cfg.wordCount);
+		if (error != NUR_NO_ERROR)
+			return error;
+		job->invReadOn = true;
+
+		// Tags already stored would not be given the inventory's data
+		error = TakeStorage(ctx, stored, INT_MAX, &count);
+		if (error != NUR_NO_ERROR)
+			return error;
+	}
+
+	memset(&resp, 0, sizeof(resp));
+	error = NurApiInventory(hApi, cfg.rounds, cfg.Q, cfg.session, &resp);
+	job->stats.inventories++;
+	if (error == NUR_ERROR_NO_TAG)
+	{
+		job->invReadDone = true;
+		return NUR_NO_ERROR;
+	}
+	if (error == NUR_NO_ERROR && resp.numTagsFound > 0)
+		error = NurApiFetchTags(hApi, TRUE, NULL);
+	if (error != NUR_NO_ERROR)
+		return error;
+
+	// Cleared each round, so that the tags of the next inventory are stored anew with their data
+	stored.clear();
+	error = TakeStorage(ctx, stored, INT_MAX, &count);
+	if (error != NUR_NO_ERROR)
+		return error;
+
+	int newTags = 0;
+	for (size_t i = 0; i < stored.size(); i++)
+	{
+		const struct NUR_TAG_DATA_EX &t = stored[i];
+
+		// Tags whose read failed are inventoried without data
+		if (t.dataLen != cfg.wordCount * 2)
+			continue;
+		std::unordered_map<std::string, int>::const_iterator it = job->byEpc.find(EpcKey(t.epc, t.epcLen));
+		if (it == job->byEpc.end() || job->done[it->second])
+			continue;
+		memcpy(job->tags[it->second].data, t.data, t.dataLen);
+		Finish(job, it->second, NUR_NO_ERROR, NUR_EXT_BULKREAD_INVREAD);
+		newTags++;
+	}
+
+	// Tags read again by later inventories make them dearer per new tag
+	if (newTags == 0)
+		job->invReadDone = true;
+	else
+		job->invCostNs = (double)(NurExtGetMonotonicNs() - startNs) / newTags;
+	return NUR_NO_ERROR;
+}
+
+/// <summary>
+/// Give the application's inventory + read setup back, or turn inventory + read off if it could not be read.
+/// </summary>
+static void RestoreInvRead(NurExtBulkJob *job)
+{
+	const struct NUR_IRINFORMATION &prev = job->invReadPrev;
+
+	if (job->invReadSaved && prev.bank != 0 && prev.wLength != 0)
+		NurApiInventoryRead(job->hApi, prev.active, prev.type, prev.bank, prev.wAddress, prev.wLength);
+	else
+		NurApiInventoryReadCtl(job->hApi, FALSE);
+}
+
+/// <summary>
+/// Singulated reads of the tags left, each tried once. Returns early when inventory + read becomes cheaper.
+/// </summary>
+static int SingulatedPass(NurExtBulkJob *job, bool *progress)
+{
+	const struct NUR_EXT_BULKREAD_CONFIG &cfg = job->cfg;
+	BYTE buf[NUR_EXT_BULKREAD_MAX_WORDS * 2];
+
+	*progress = false;
+	for (size_t i = 0; i < job->tags.size() && job->left > 0; i++)
+	{
+		struct NUR_EXT_BULKREAD_TAG &tag = job->tags[i];
+
+		if (job->done[i])
+			continue;
+		if (Expired(job))
+			break;
+
+		ULONGLONG startNs = NurExtGetMonotonicNs();
+		int error = NurApiReadTagByEPC(job->hApi, cfg.passwd, cfg.secured, tag.epc, tag.epcLen,
+			cfg.bank, cfg.wordAddress, cfg.wordCount * 2, buf);
+		double ns = (double)(NurExtGetMonotonicNs() - startNs);
+
+		job->readCostNs = (job->readCostNs == 0) ? ns : job->readCostNs + (ns - job->readCostNs) / BULKREAD_COST_WEIGHT;
+		job->stats.readCommands++;
+		tag.attempts++;
+		*progress = true;
+
+		if (error == NUR_NO_ERROR)
+		{
+			memcpy(tag.data, buf, cfg.wordCount * 2);
+			Finish(job, (int)i, NUR_NO_ERROR, NUR_EXT_BULKREAD_SINGULATED);
+		}
+		else if (IsRetryable(error))
+		{
+			tag.status = error;
+			if (tag.attempts >= cfg.maxAttempts)
+				Finish(job, (int)i, error, 0);
+		}
+		else if (IsTagError(error))
+		{
+			Finish(job, (int)i, error, 0);
+		}
+		else
+		{
+			// Transport or module error, every read would fail the same way
+			tag.status = error;
+			return error;
+		}
+
+		if (cfg.method == NUR_EXT_BULKREAD_AUTO && UseInvRead(job))
+			break;
+	}
+	return NUR_NO_ERROR;
+}
+
+void NURAPICONV NurExtBulkReadDefaultConfig(struct NUR_EXT_BULKREAD_CONFIG *cfg)
+{
+	if (!cfg)
+		return;
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->bank = NUR_BANK_TID;
+	cfg->wordAddress = 0;
+	cfg->wordCount = 2;
+	cfg->passwd = 0;
+	cfg->secured = FALSE;
+	cfg->method = NUR_EXT_BULKREAD_AUTO;
+	cfg->flags = 0;
+	cfg->maxAttempts = 3;
+	cfg->invReadMinTags = 8;
+	cfg->Q = 0;
+	cfg->session = NUR_SESSION_S0;
+	cfg->rounds = 0;
+	cfg->timeoutMs = 0;
+}
+
+int NURAPICONV NurExtBulkRead(HANDLE hApi, const struct NUR_EXT_BULKREAD_CONFIG *cfg, struct NUR_EXT_BULKREAD_TAG *tags, int *tagCount, DWORD szTag, struct NUR_EXT_BULKREAD_STATS *stats, DWORD szStats)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!cfg || !tags || !tagCount || *tagCount < 0
+		|| szTag == 0 || szTag > sizeof(struct NUR_EXT_BULKREAD_TAG)
+		|| (stats && (szStats == 0 || szStats > sizeof(struct NUR_EXT_BULKREAD_STATS))))
+		return NUR_ERROR_INVALID_PARAMETER;
+	if (cfg->bank > NUR_BANK_USER || cfg->wordCount < 1 || cfg->wordCount > NUR_EXT_BULKREAD_MAX_WORDS
+		|| cfg->method < NUR_EXT_BULKREAD_AUTO || cfg->method > NUR_EXT_BULKREAD_SINGULATED
+		|| cfg->maxAttempts < 1 || cfg->maxAttempts > 255)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	NurExtBulkJob job;
+	bool invReadOk = !cfg->secured && cfg->bank >= NUR_BANK_EPC && cfg->wordCount <= NUR_MAX_IRDATA_LENGTH / 2;
+
+	if (cfg->method == NUR_EXT_BULKREAD_INVREAD && !invReadOk)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	// One job at a time, the inventory + read configuration of the module is the job's
+	std::lock_guard<std::mutex> guard(ctx->bulkReadLock);
+	ULONGLONG startNs = NurExtGetMonotonicNs();
+	BYTE *user = (BYTE *)tags;
+	int count = *tagCount;
+
+	job.hApi = hApi;
+	job.cfg = *cfg;
+	memset(&job.stats, 0, sizeof(job.stats));
+	job.invReadOk = invReadOk;
+	job.invReadOn = false;
+	job.invReadSaved = false;
+	memset(&job.invReadPrev, 0, sizeof(job.invReadPrev));
+	job.invReadDone = false;
+	job.invCostNs = 0;
+	job.readCostNs = 0;
+	job.deadlineNs = cfg->timeoutMs ? startNs + cfg->timeoutMs * 1000000ULL : 0;
+
+	if (cfg->flags & NUR_EXT_BULKREAD_STORAGE)
+	{
+		std::vector<struct NUR_TAG_DATA_EX> stored;
+		int error = TakeStorage(ctx.get(), stored, count, tagCount);
+		if (error != NUR_NO_ERROR)
+			return error;
+
+		count = (int)stored.size();
+		job.tags.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			memset(&job.tags[i], 0, sizeof(job.tags[i]));
+			job.tags[i].epcLen = std::min((WORD)stored[i].epcLen, (WORD)NUR_MAX_EPC_LENGTH_EX);
+			memcpy(job.tags[i].epc, stored[i].epc, job.tags[i].epcLen);
+		}
+	}
+	else
+	{
+		job.tags.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			memset(&job.tags[i], 0, sizeof(job.tags[i]));
+			memcpy(&job.tags[i], user + i * szTag, szTag);
+			if (job.tags[i].epcLen > NUR_MAX_EPC_LENGTH_EX)
+				return NUR_ERROR_INVALID_PARAMETER;
+		}
+	}
+
+	job.done.assign(count, false);
+	job.left = count;
+	for (int i = 0; i < count; i++)
+	{
+		struct NUR_EXT_BULKREAD_TAG &tag = job.tags[i];
+
+		tag.status = NUR_ERROR_NO_TAG;
+		tag.method = 0;
+		tag.attempts = 0;
+		tag.dataLen = 0;
+		memset(tag.data, 0, sizeof(tag.data));
+		// A tag listed twice is read once, by its first entry; the later ones are left unread
+		if (!job.byEpc.insert(std::make_pair(EpcKey(tag.epc, tag.epcLen), i)).second)
+			Finish(&job, i, NUR_ERROR_INVALID_PARAMETER, 0);
+	}
+
+	int error = NUR_NO_ERROR;
+	while (job.left > 0 && !Expired(&job))
+	{
+		if (UseInvRead(&job))
+		{
+			error = InvReadRound(ctx.get(), &job);
+		}
+		else
+		{
+			bool progress;
+			if (job.cfg.method == NUR_EXT_BULKREAD_INVREAD)
+				break;
+			error = SingulatedPass(&job, &progress);
+			if (error == NUR_NO_ERROR && !progress)
+				break;
+		}
+		if (error != NUR_NO_ERROR)
+			break;
+	}
+
+	if (job.invReadOn)
+		RestoreInvRead(&job);
+
+	for (int i = 0; i < count; i++)
+		memcpy(user + i * szTag, &job.tags[i], szTag);
+	*tagCount = count;
+
+	if (stats)
+	{
+		job.stats.tags = count;
+		job.stats.failed = count - job.stats.read;
+		job.stats.elapsedMs = (DWORD)((NurExtGetMonotonicNs() - startNs) / 1000000ULL);
+		memcpy(stats, &job.stats, szStats);
+	}
+	return error;
+}
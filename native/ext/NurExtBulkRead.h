@@ -0,0 +1,139 @@
+/*
+ * NurExtBulkRead.h
+ *
+ *  Bulk tag memory read: one bank range read from many tags as one job.
+ */
+
+#ifndef _NUREXTBULKREAD_H_
+#define _NUREXTBULKREAD_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Most words read per tag. */
+#define NUR_EXT_BULKREAD_MAX_WORDS	64
+
+/** Read method chosen by the job. */
+#define NUR_EXT_BULKREAD_AUTO		0
+/** Read method: inventory + read, the data is read by the module as each tag is singulated in an inventory. */
+#define NUR_EXT_BULKREAD_INVREAD	1
+/** Read method: one NurApiReadTagByEPC() per tag. */
+#define NUR_EXT_BULKREAD_SINGULATED	2
+
+/** NUR_EXT_BULKREAD_CONFIG.flags: read the tags in the tag storage of the handle instead of the tags given. */
+#define NUR_EXT_BULKREAD_STORAGE	0x0001
+
+/**
+ * Bulk read job configuration.
+ * @sa NurExtBulkRead()
+ */
+struct NUR_EXT_BULKREAD_CONFIG
+{
+	BYTE bank;					/**< Memory bank to read, NUR_BANK_PASSWD - NUR_BANK_USER. */
+	DWORD wordAddress;			/**< <b>Word</b> address of the first word read. */
+	int wordCount;				/**< Words read from each tag, 1 - NUR_EXT_BULKREAD_MAX_WORDS. */
+	DWORD passwd;				/**< Access password of secured reads. */
+	BOOL secured;				/**< TRUE to access the tags with <i>passwd</i>. Secured reads are always singulated. */
+	int method;					/**< NUR_EXT_BULKREAD_AUTO, NUR_EXT_BULKREAD_INVREAD or NUR_EXT_BULKREAD_SINGULATED. */
+	DWORD flags;				/**< NUR_EXT_BULKREAD_STORAGE or 0. */
+	int maxAttempts;			/**< Singulated reads tried per tag before it is given up, 1 - 255. */
+	int invReadMinTags;			/**< NUR_EXT_BULKREAD_AUTO: tags left to read needed for an inventory + read. */
+	int Q;						/**< Q of the inventory + read inventories, 0 = chosen by the module. */
+	int session;				/**< Session of the inventory + read inventories. */
+	int rounds;					/**< Rounds of the inventory + read inventories, 0 = chosen by the module. */
+	DWORD timeoutMs;			/**< The job ends with the tags left unread after this many milliseconds. 0 = no time limit. */
+};
+
+/**
+ * One tag of a bulk read job.
+ * @sa NurExtBulkRead()
+ */
+struct NUR_EXT_BULKREAD_TAG
+{
+	BYTE epc[NUR_MAX_EPC_LENGTH_EX];		/**< EPC of the tag. */
+	WORD epcLen;							/**< Bytes in <i>epc</i>. */
+	int status;								/**< Zero when read, otherwise the error of the last read attempt, NUR_ERROR_NO_TAG if the tag was not found. */
+	int method;								/**< NUR_EXT_BULKREAD_INVREAD or NUR_EXT_BULKREAD_SINGULATED when read, otherwise 0. */
+	int attempts;							/**< Singulated reads tried. */
+	WORD dataLen;							/**< Bytes in <i>data</i>, wordCount * 2 when read, otherwise 0. */
+	BYTE data[NUR_EXT_BULKREAD_MAX_WORDS * 2];	/**< Data read. */
+};
+
+/**
+ * Counters of a bulk read job.
+ * @sa NurExtBulkRead()
+ */
+struct NUR_EXT_BULKREAD_STATS
+{
+	int tags;					/**< Tags of the job. */
+	int read;					/**< Tags read. */
+	int failed;					/**< Tags left unread. */
+	int invReads;				/**< Tags read by inventory + read. */
+	int singulatedReads;		/**< Tags read by singulated reads. */
+	int inventories;			/**< Inventory + read inventories run. */
+	int readCommands;			/**< Singulated reads tried. */
+	DWORD elapsedMs;			/**< Duration of the job in milliseconds. */
+};
+
+/** @fn void NurExtBulkReadDefaultConfig(struct NUR_EXT_BULKREAD_CONFIG *cfg)
+ *
+ * Fill the configuration with defaults: 2 words of NUR_BANK_TID from address 0, not secured, NUR_EXT_BULKREAD_AUTO
+ * with inventory + read from 8 tags, the tags given, 3 attempts, Q and rounds chosen by the module in NUR_SESSION_S0,
+ * no time limit.
+ *
+ * @param	cfg		Pointer to the NUR_EXT_BULKREAD_CONFIG structure.
+ */
+void NURAPICONV NurExtBulkReadDefaultConfig(struct NUR_EXT_BULKREAD_CONFIG *cfg);
+
+/** @fn int NurExtBulkRead(HANDLE hApi, const struct NUR_EXT_BULKREAD_CONFIG *cfg, struct NUR_EXT_BULKREAD_TAG *tags, int *tagCount, DWORD szTag, struct NUR_EXT_BULKREAD_STATS *stats, DWORD szStats)
+ *
+ * Read the same memory range from every tag of a list and return the data and status of each tag.
+ *
+ * With inventory + read, NurApiInventoryRead(), the module reads the data of each tag it singulates in an inventory,
+ * so one inventory command reads every tag in the field that answers, without a select and access command
+ * and a host round trip per tag. Tags not read that way are read one by one with NurApiReadTagByEPC(), tried up to
+ * <i>maxAttempts</i> times while the tag is not found or the read fails on the air. Tag memory errors, such as
+ * NUR_ERROR_G2_TAG_MEM_OVERRUN, are final.
+ *
+ * NUR_EXT_BULKREAD_AUTO runs inventory + read inventories while at least <i>invReadMinTags</i> tags are left and an
+ * inventory costs less per tag read than a singulated read, both timed as the job runs. Inventories repeat
+ * the tags already read, so their cost per new tag grows until the rest are read singulated.
+ * Inventory + read is used for up to 32 words of NUR_BANK_EPC - NUR_BANK_USER without <i>secured</i>, otherwise
+ * the reads are singulated. NUR_EXT_BULKREAD_INVREAD only runs inventories, until one reads no new tags.
+ *
+ * The inventories use the tag storage of the handle: it is cleared before the first one, as tags already stored would
+ * not be given the inventory's data, and the tags found are taken out of it after each one. They are not passed on
+ * as for NUR_NOTIFICATION_INVENTORYEX. Drain the storage before the job to keep its tags. The inventory + read setup
+ * of the module, NurApiGetInventoryRead(), is restored when the job ends.
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	cfg			Job configuration.
+ * @param	tags		Tags to read, <i>epc</i> and <i>epcLen</i> set, the rest filled in by the job. With
+ *						NUR_EXT_BULKREAD_STORAGE the tags of the storage are filled in and the storage is cleared.
+ *						A tag listed again is read by its first entry, the later ones get NUR_ERROR_INVALID_PARAMETER.
+ * @param	tagCount	Number of entries in <i>tags</i>. With NUR_EXT_BULKREAD_STORAGE the capacity of <i>tags</i>,
+ *						on return the number of tags taken from the storage.
+ * @param	szTag		sizeof(struct NUR_EXT_BULKREAD_TAG)
+ * @param	stats		Pointer to the NUR_EXT_BULKREAD_STATS structure. May be NULL.
+ * @param	szStats		sizeof(struct NUR_EXT_BULKREAD_STATS)
+ *
+ * @return	Zero when the job ran, also when tags were left unread. NUR_ERROR_BUFFER_TOO_SMALL if the storage holds more tags
+ *			than <i>tags</i>, <i>tagCount</i> is set to the tags stored. On other error non-zero error code is returned,
+ *			the tags read until then are filled in.
+ */
+int NURAPICONV NurExtBulkRead(HANDLE hApi, const struct NUR_EXT_BULKREAD_CONFIG *cfg, struct NUR_EXT_BULKREAD_TAG *tags, int *tagCount, DWORD szTag, struct NUR_EXT_BULKREAD_STATS *stats, DWORD szStats);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
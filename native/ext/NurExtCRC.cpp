@@ -0,0 +1,45 @@
+#include "NurApiExt.h"
+
+#define CRC16_POLY		0x1021
+
+/// <summary>
+/// table[k][b]: CRC contribution of byte b followed by k zero bytes.
+/// </summary>
+struct CRC16Tables
+{
+	WORD table[8][256];
+
+	CRC16Tables()
+	{
+		for (int b = 0; b < 256; b++)
+		{
+			DWORD c = b << 8;
+			for (int j = 0; j < 8; j++)
+				c = (c & 0x8000) ? CRC16_POLY ^ (c << 1) : (c << 1);
+			table[0][b] = (WORD)c;
+		}
+		for (int k = 1; k < 8; k++)
+		{
+			for (int b = 0; b < 256; b++)
+				table[k][b] = (WORD)((table[k - 1][b] << 8) ^ table[0][table[k - 1][b] >> 8]);
+		}
+	}
+};
+
+static const CRC16Tables gCRC16;
+
+WORD NURAPICONV NurExtCRC16(WORD crc, const BYTE *buf, DWORD len)
+{
+	const WORD (*t)[256] = gCRC16.table;
+
+	while (len >= 8)
+	{
+		crc = t[7][buf[0] ^ (crc >> 8)] ^ t[6][buf[1] ^ (crc & 0xFF)]
+			^ t[5][buf[2]] ^ t[4][buf[3]] ^ t[3][buf[4]] ^ t[2][buf[5]] ^ t[1][buf[6]] ^ t[0][buf[7]];
+		buf += 8;
+		len -= 8;
+	}
+	while (len--)
+		crc = (WORD)((crc << 8) ^ t[0][((crc >> 8) ^ *buf++) & 0xFF]);
+	return crc;
+}
@@ -0,0 +1,46 @@
+/*
+ * NurExtCRC.h
+ *
+ *  NUR protocol CRC-16.
+ */
+
+#ifndef _NUREXTCRC_H_
+#define _NUREXTCRC_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Initial value of the NUR protocol CRC-16. */
+#define NUR_EXT_CRC16_INIT		0xFFFF
+
+/** @fn WORD NurExtCRC16(WORD crc, const BYTE *buf, DWORD len)
+ *
+ * Calculate NUR protocol CRC-16 (CCITT, polynomial 0x1021, not reflected), see embedded/NUR_CRC16_explained.pdf.
+ * The packet CRC is calculated over the payload starting from NUR_EXT_CRC16_INIT and is sent low byte first.
+ * Data can be given in pieces by passing the previous result as <i>crc</i>.
+ *
+ * Uses slice-by-8 tables: eight bytes per step instead of one.
+ * Thread safe; no NurApi handle needed.
+ *
+ * @param	crc		NUR_EXT_CRC16_INIT, or result of the previous piece.
+ * @param	buf		Data.
+ * @param	len		Number of bytes in <i>buf</i>.
+ *
+ * @return	The CRC.
+ */
+WORD NURAPICONV NurExtCRC16(WORD crc, const BYTE *buf, DWORD len);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
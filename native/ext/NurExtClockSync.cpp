@@ -0,0 +1,260 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#define CLOCKSYNC_BURST				4
+#define CLOCKSYNC_MIN_DRIFT_SPAN_MS	10000	// Shorter spans give the nominal rate, 1 ms resolution is too coarse
+#define CLOCKSYNC_MAX_STEP_NS		1000000000LL	// Larger jump against the model is a module clock restart
+#define CLOCKSYNC_TAG_AHEAD_MS		1000	// Allowed model error when unwrapping tag timestamps
+
+/// <summary>
+/// Reads the module clock with a timed round trip.
+/// The module time is assumed to be read halfway; it is floored to milliseconds, so the host time of
+/// moduleMs.000 is half a millisecond earlier on average.
+/// </summary>
+static int TakeSample(HANDLE hApi, NurExtClockSample *sample)
+{
+	struct NUR_DIAG_REPORT report;
+
+	ULONGLONG t0 = NurExtGetMonotonicNs();
+	int error = NurApiDiagGetReport(hApi, 0, &report, sizeof(report));
+	ULONGLONG t1 = NurExtGetMonotonicNs();
+	if (error != NUR_NO_ERROR)
+		return error;
+
+	sample->hostNs = t0 + (t1 - t0) / 2 - 500000;
+	sample->moduleMs = report.uptime;
+	sample->rttNs = (DWORD)std::min(t1 - t0, (ULONGLONG)0xFFFFFFFF);
+	return NUR_NO_ERROR;
+}
+
+/// <summary>
+/// Fits host time against module time over the samples. Caller holds ctx->clockLock.
+/// Samples with more than twice the shortest round trip are left out.
+/// </summary>
+static void FitClock(NurExtContext *ctx)
+{
+	const NurExtClockSample &last = ctx->clockSamples.back();
+	DWORD minRtt = 0xFFFFFFFF;
+	double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+	int span = 0;
+
+	for (size_t i = 0; i < ctx->clockSamples.size(); i++)
+		minRtt = std::min(minRtt, ctx->clockSamples[i].rttNs);
+
+	for (size_t i = 0; i < ctx->clockSamples.size(); i++)
+	{
+		const NurExtClockSample &s = ctx->clockSamples[i];
+		if (s.rttNs > 2 * (ULONGLONG)minRtt)
+			continue;
+		// Relative to the latest sample to keep the sums small
+		double x = (int)(s.moduleMs - last.moduleMs);
+		double y = (double)(long long)(s.hostNs - last.hostNs);
+		n++;
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+		span = std::max(span, (int)(last.moduleMs - s.moduleMs));
+	}
+
+	double nsPerMs = 1000000.0;
+	if (span >= CLOCKSYNC_MIN_DRIFT_SPAN_MS && n * sxx - sx * sx > 0)
+		nsPerMs = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+	double intercept = (sy - nsPerMs * sx) / n;
+
+	ctx->clockNsPerMs = nsPerMs;
+	ctx->clock.refModuleMs = last.moduleMs;
+	ctx->clock.refHostNs = last.hostNs + (long long)llround(intercept);
+	ctx->clock.driftPpb = (int)llround((1000000.0 / nsPerMs - 1.0) * 1e9);
+	ctx->clock.rttNs = last.rttNs;
+	ctx->clock.sampleCount = (DWORD)n;
+}
+
+/// <summary>
+/// Host time of a module time with the current model. Caller holds ctx->clockLock.
+/// </summary>
+static ULONGLONG ModuleToHost(NurExtContext *ctx, DWORD moduleMs)
+{
+	int dm = (int)(moduleMs - ctx->clock.refModuleMs);
+	return ctx->clock.refHostNs + (long long)llround(dm * ctx->clockNsPerMs);
+}
+
+/// <summary>
+/// Does one burst of round trips and adds the best to the fit.
+/// </summary>
+static int SyncOnce(NurExtContext *ctx)
+{
+	NurExtClockSample best = { 0, 0, 0 };
+	NurExtClockSample sample;
+	int errors = 0, error = NUR_NO_ERROR;
+
+	for (int i = 0; i < CLOCKSYNC_BURST; i++)
+	{
+		error = TakeSample(ctx->hApi, &sample);
+		if (error != NUR_NO_ERROR)
+			errors++;
+		else if (best.rttNs == 0 || sample.rttNs < best.rttNs)
+			best = sample;
+	}
+
+	std::lock_guard<std::mutex> guard(ctx->clockLock);
+	ctx->clock.samples += CLOCKSYNC_BURST;
+	ctx->clock.errors += errors;
+	if (best.rttNs == 0)
+		return error;
+
+	if (!ctx->clockSamples.empty())
+	{
+		// Module clock went back or jumped, e.g. the module rebooted while the connection stayed up
+		long long step = (long long)(best.hostNs - ModuleToHost(ctx, best.moduleMs));
+		if ((int)(best.moduleMs - ctx->clockSamples.back().moduleMs) < 0 || llabs(step) > CLOCKSYNC_MAX_STEP_NS)
+		{
+			ctx->clockSamples.clear();
+			ctx->clock.resets++;
+		}
+	}
+
+	ctx->clockSamples.push_back(best);
+	if (ctx->clockSamples.size() > NUR_EXT_CLOCKSYNC_WINDOW)
+		ctx->clockSamples.pop_front();
+	FitClock(ctx);
+	return NUR_NO_ERROR;
+}
+
+static void ClockThread(NurExtContext *ctx)
+{
+	std::unique_lock<std::mutex> lock(ctx->clockLock);
+
+	for (;;)
+	{
+		ctx->clockCond.wait_for(lock, std::chrono::milliseconds(ctx->clockInterval), [ctx] { return ctx->clockStop; });
+		if (ctx->clockStop)
+			break;
+
+		lock.unlock();
+		SyncOnce(ctx);
+		lock.lock();
+	}
+}
+
+/// <summary>
+/// Stops and joins the sync thread. Caller holds ctx->clockStartLock.
+/// </summary>
+static void StopThread(NurExtContext *ctx)
+{
+	{
+		std::lock_guard<std::mutex> guard(ctx->clockLock);
+		ctx->clockStop = true;
+		ctx->clockCond.notify_all();
+	}
+	if (ctx->clockThread.joinable())
+		ctx->clockThread.join();
+}
+
+void NurExtStopClock(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> startGuard(ctx->clockStartLock);
+	StopThread(ctx);
+}
+
+int NURAPICONV NurExtStartClockSync(HANDLE hApi, DWORD intervalMs)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	// Held from stop to the new thread, so that concurrent starts replace each other in turn
+	std::lock_guard<std::mutex> startGuard(ctx->clockStartLock);
+	StopThread(ctx.get());
+
+	int error = SyncOnce(ctx.get());
+	if (error != NUR_NO_ERROR || intervalMs == 0)
+		return error;
+
+	std::lock_guard<std::mutex> guard(ctx->clockLock);
+	ctx->clockStop = false;
+	ctx->clockInterval = intervalMs;
+	ctx->clockThread = std::thread(ClockThread, ctx.get());
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtStopClockSync(HANDLE hApi)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtFindContext(hApi);
+
+	if (ctx)
+		NurExtStopClock(ctx.get());
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetClockSync(HANDLE hApi, struct NUR_EXT_CLOCKSYNC *sync, DWORD szSync)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	struct NUR_EXT_CLOCKSYNC tmp;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!sync || szSync == 0 || szSync > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->clockLock);
+		if (ctx->clockNsPerMs == 0)
+			return NUR_ERROR_NOT_READY;
+		tmp = ctx->clock;
+	}
+	memcpy(sync, &tmp, szSync);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtModuleTimeToHost(HANDLE hApi, DWORD moduleMs, ULONGLONG *hostNs)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!hostNs)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> guard(ctx->clockLock);
+	if (ctx->clockNsPerMs == 0)
+		return NUR_ERROR_NOT_READY;
+	*hostNs = ModuleToHost(ctx.get(), moduleMs);
+	return NUR_NO_ERROR;
+}
+
+bool NurExtClockTagTime(NurExtContext *ctx, WORD tagTimestamp, ULONGLONG rxTimeNs, ULONGLONG *hostNs)
+{
+	std::lock_guard<std::mutex> guard(ctx->clockLock);
+	if (ctx->clockNsPerMs == 0)
+		return false;
+
+	// Module time at receive, then the latest time before it with the tag's low 16 bits
+	long long dh = (long long)(rxTimeNs - ctx->clock.refHostNs);
+	DWORD rxModuleMs = ctx->clock.refModuleMs + (DWORD)(long long)llround(dh / ctx->clockNsPerMs);
+	DWORD moduleMs = (rxModuleMs & 0xFFFF0000) | tagTimestamp;
+	if ((int)(moduleMs - rxModuleMs) > CLOCKSYNC_TAG_AHEAD_MS)
+		moduleMs -= 0x10000;
+
+	*hostNs = ModuleToHost(ctx, moduleMs);
+	return true;
+}
+
+int NURAPICONV NurExtTagTimeToHost(HANDLE hApi, WORD tagTimestamp, ULONGLONG rxTimeNs, ULONGLONG *hostNs)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!hostNs)
+		return NUR_ERROR_INVALID_PARAMETER;
+	if (rxTimeNs == 0)
+		rxTimeNs = NurExtGetMonotonicNs();
+
+	return NurExtClockTagTime(ctx.get(), tagTimestamp, rxTimeNs, hostNs) ? NUR_NO_ERROR : NUR_ERROR_NOT_READY;
+}
@@ -0,0 +1,73 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <map>
+
+NurExtContext::~NurExtContext()
+{
+	NurExtQControlForget(this);
+	NurExtSplitForget(this);
+	NurExtStreamGroupForget(this);
+	NurExtDedupForget(this);
+	NurExtTagBusForget(this);
+	NurExtFanoutForget(this);
+	NurExtStopClock(this);
+	NurExtStopDispatch(this);
+	NurExtStopAsync(this);
+}
+
+static std::mutex gContextLock;
+static std::map<HANDLE, std::shared_ptr<NurExtContext> > gContexts;
+
+std::shared_ptr<NurExtContext> NurExtGetContext(HANDLE hApi)
+{
+	if (hApi == NULL || hApi == INVALID_HANDLE_VALUE)
+		return std::shared_ptr<NurExtContext>();
+
+	std::lock_guard<std::mutex> guard(gContextLock);
+	std::shared_ptr<NurExtContext> &ctx = gContexts[hApi];
+	if (!ctx)
+		ctx = std::make_shared<NurExtContext>(hApi);
+	return ctx;
+}
+
+std::shared_ptr<NurExtContext> NurExtFindContext(HANDLE hApi)
+{
+	std::lock_guard<std::mutex> guard(gContextLock);
+	std::map<HANDLE, std::shared_ptr<NurExtContext> >::iterator it = gContexts.find(hApi);
+	if (it == gContexts.end())
+		return std::shared_ptr<NurExtContext>();
+	return it->second;
+}
+
+void NURAPICONV NurExtFree(HANDLE hApi)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtFindContext(hApi);
+	if (!ctx)
+		return;
+
+	NurExtStopMetrics(hApi);
+
+	{
+		// Give notifications back to the application before the context goes
+		std::lock_guard<std::mutex> guard(ctx->notifyLock);
+		if (ctx->dispatcherInstalled)
+			NurApiSetNotificationCallback(hApi, ctx->appCallback.load());
+	}
+
+	NurExtQControlForget(ctx.get());
+	NurExtSplitForget(ctx.get());
+	NurExtStreamGroupForget(ctx.get());
+	NurExtDedupForget(ctx.get());
+	NurExtTagBusForget(ctx.get());
+	NurExtFanoutForget(ctx.get());
+	NurExtStopClock(ctx.get());
+	NurExtStopDispatch(ctx.get());
+	NurExtStopAsync(ctx.get());
+
+	{
+		std::lock_guard<std::mutex> guard(gContextLock);
+		gContexts.erase(hApi);
+	}
+	// Context is destroyed here, or by the last user still holding it
+}
@@ -0,0 +1,446 @@
+/*
+ * NurExtContext.h
+ *
+ *  Internal: per NurApi handle state of the extensions.
+ */
+
+#ifndef _NUREXTCONTEXT_H_
+#define _NUREXTCONTEXT_H_ 1
+
+#include "NurAPI.h"
+#include "NurExtAsync.h"
+#include "NurExtDispatch.h"
+#include "NurExtStats.h"
+#include "NurExtLog.h"
+#include "NurExtTime.h"
+
+// Conflicts w/ g++ stdlib
+#undef min
+#undef max
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// NurExtEnableTagRing() ring. head is written only by the notification thread, tail only by the reader.
+/// </summary>
+struct NurExtTagRing
+{
+	std::vector<struct NUR_TAG_DATA_EX> tags;
+	std::vector<ULONGLONG> rxTimes;					// Receive time of each entry in tags
+	size_t mask;
+	std::atomic<ULONGLONG> head;
+	std::atomic<ULONGLONG> tail;
+	std::atomic<ULONGLONG> overflow;
+	std::atomic<DWORD> highWater;
+	std::vector<struct NUR_TAG_DATA_EX> staging;	// Producer side drain buffer
+	std::vector<ULONGLONG> stagingTimes;
+
+	explicit NurExtTagRing(size_t capacity)
+		: tags(capacity), rxTimes(capacity), mask(capacity - 1), head(0), tail(0), overflow(0), highWater(0),
+		  staging(256), stagingTimes(256) { }
+};
+
+/// <summary>
+/// NurExtSubmit() request.
+/// </summary>
+struct NurExtAsyncRequest
+{
+	DWORD id;
+	NurExtAsyncFunction func;
+	NurExtAsyncCompletion completion;
+	LPVOID arg;
+	int error;
+	std::chrono::steady_clock::time_point submitted;
+};
+
+/// <summary>
+/// Lock free NUR_EXT_HISTOGRAM. Values are added with relaxed atomics from any thread.
+/// </summary>
+struct NurExtHistogram
+{
+	std::atomic<ULONGLONG> count;
+	std::atomic<ULONGLONG> sumUs;
+	std::atomic<DWORD> minUs;		// 0xFFFFFFFF while empty
+	std::atomic<DWORD> maxUs;
+	std::atomic<ULONGLONG> bucket[NUR_EXT_HIST_BUCKETS];
+
+	NurExtHistogram() { Reset(); }
+	void Add(DWORD us);
+	void Read(struct NUR_EXT_HISTOGRAM *hist) const;
+	void Reset();
+};
+
+/// <summary>
+/// Notification copied for delivery on a dispatch worker.
+/// </summary>
+struct NurExtNotification
+{
+	DWORD timestamp;
+	DWORD status;			// NurApiGetLastNotificationStatus() at receive
+	int dataLen;
+	bool hasData;
+	std::vector<BYTE> data;
+	std::chrono::steady_clock::time_point received;
+	ULONGLONG rxTimeNs;		// NurExtGetNotificationTime()
+};
+
+/// <summary>
+/// Queue of one notification type. busy is set while a worker delivers from it, to keep the type in order.
+/// </summary>
+struct NurExtDispatchQueue
+{
+	struct NUR_EXT_DISPATCH_ROUTE route;
+	struct NUR_EXT_DISPATCH_STATS stats;
+	std::deque<NurExtNotification> queue;
+	bool busy;
+
+	NurExtDispatchQueue() : route(), stats(), busy(false) { }
+};
+
+/// <summary>
+/// NurExtStartClockSync() sample: host time when the module clock read moduleMs.
+/// </summary>
+struct NurExtClockSample
+{
+	ULONGLONG hostNs;
+	DWORD moduleMs;
+	DWORD rttNs;
+};
+
+#define NUR_EXT_INDEX_SHARDS	16
+
+/// <summary>
+/// Tags of one EPC index shard: EPC -> position in tags. Immutable once shared with a snapshot.
+/// </summary>
+struct NurExtIndexData
+{
+	std::unordered_map<std::string, size_t> map;
+	std::vector<struct NUR_TAG_DATA_EX> tags;
+};
+
+/// <summary>
+/// EPC index shard. The writer copies data before changing it if a snapshot has taken it since the last copy.
+/// </summary>
+struct NurExtIndexShard
+{
+	std::mutex lock;
+	std::shared_ptr<NurExtIndexData> data;
+	bool shared;							// data was taken by a snapshot, set and cleared under lock
+
+	NurExtIndexShard() : shared(false) { }
+};
+
+struct NurExtReactor;
+struct NurExtStreamGroup;
+struct NurExtGroupSource;
+struct NurExtDedup;
+struct NurExtTagBus;
+struct NurExtFanout;
+struct NurExtQControl;
+struct NurExtSplit;
+
+/// <summary>
+/// Extension state of one NurApi handle. Created on first use, released in NurExtFree().
+/// </summary>
+struct NurExtContext
+{
+	HANDLE hApi;
+
+	// NurExtDrainTags(): tags removed from the storage but not yet returned to the caller
+	std::mutex drainLock;
+	std::vector<struct NUR_TAG_DATA_EX> drainPending;
+	std::vector<ULONGLONG> drainPendingTime;	// Receive time of each entry in drainPending
+	size_t drainPendingPos;
+	std::atomic<ULONGLONG> tagRxNs;			// Receive time of the latest notification that stored tags, 0 = none since last drain
+	NurExtDedup *dedup;						// NurExtDedupAttach(), protected by drainLock
+
+	// NurExtSetTagIndexMode(): indexLock is held by the writer for a whole batch and by snapshots, before the shard locks
+	std::mutex indexLock;
+	std::atomic<DWORD> indexMode;
+	std::atomic<int> indexCount;
+	NurExtIndexShard indexShards[NUR_EXT_INDEX_SHARDS];
+
+	// NurExtSetNotificationCallback(): application callback behind the extension dispatcher
+	std::mutex notifyLock;
+	std::atomic<NotificationCallback> appCallback;
+	bool dispatcherInstalled;
+
+	// NurExtEnableTagRing(): ringLock is taken by the producer, enable/disable and the stats, never by the reader
+	std::mutex ringLock;
+	std::unique_ptr<NurExtTagRing> ring;
+
+	// NurExtSubmit(): requests run in order on asyncThread, or on asyncReactor if attached.
+	// asyncFd is readable while asyncDone has entries.
+	std::mutex asyncLock;
+	std::condition_variable asyncCond;
+	std::deque<NurExtAsyncRequest> asyncQueue;
+	std::deque<NurExtAsyncRequest> asyncDone;
+	std::thread asyncThread;
+	NurExtReactor *asyncReactor;	// Protected by gReactorLock and asyncLock
+	bool asyncScheduled;			// A reactor task of this context is queued or running
+	bool asyncStop;
+	DWORD asyncNextId;
+	DWORD asyncLastId;
+	int asyncFd;
+
+	// NurExtSetDispatchRoute(): notifications queued per type and delivered on dispatchThreads
+	std::mutex dispatchLock;
+	std::condition_variable dispatchCond;
+	NurExtDispatchQueue dispatchQueues[NUR_NOTIFICATION_LAST];
+	std::vector<std::thread> dispatchThreads;
+	bool dispatchStop;
+
+	// NurExtGetHostStats()
+	NurExtHistogram statDispatchDelay[NUR_NOTIFICATION_LAST];
+	NurExtHistogram statCallback[NUR_NOTIFICATION_LAST];
+	NurExtHistogram statRequestWait;
+	NurExtHistogram statRequestExec;
+
+	// NurExtStartMetrics(): latest diagnostics reports and rates computed from the two latest
+	std::mutex metricsLock;
+	bool metricsEnabled;
+	std::string metricsLabel;
+	struct NUR_DIAG_REPORT metricsReport;
+	ULONGLONG metricsReports;			// Reports received, 0 = metricsReport not valid
+	ULONGLONG metricsReportErrors;		// Failed polls
+	std::chrono::steady_clock::time_point metricsReportTime;
+	bool metricsRatesValid;
+	double metricsInvTagsRate;			// Per second
+	double metricsReadErrorsRate;		// Per second
+	double metricsRfDuty;				// 0 - 1
+	std::atomic<bool> metricsPollPending;
+
+	// NurExtStartClockSync(): host = clock.refHostNs + (module - clock.refModuleMs) * clockNsPerMs, 0 = not synced.
+	// clockStartLock is taken by start/stop, never by the sync thread, before clockLock
+	std::mutex clockStartLock;
+	std::mutex clockLock;
+	std::condition_variable clockCond;
+	std::thread clockThread;
+	bool clockStop;
+	DWORD clockInterval;
+	std::deque<NurExtClockSample> clockSamples;
+	struct NUR_EXT_CLOCKSYNC clock;
+	double clockNsPerMs;
+
+	// NurExtStreamGroupAdd(): groupLock is taken by the producer and membership changes, before the group lock
+	std::mutex groupLock;
+	NurExtStreamGroup *streamGroup;
+	NurExtGroupSource *groupSource;
+	std::vector<struct NUR_TAG_DATA_EX> groupStaging;
+	std::vector<ULONGLONG> groupStagingTimes;
+
+	// NurExtTagBusPublish(): busLock is taken by the producer and publish/stop, before drainLock
+	std::mutex busLock;
+	NurExtTagBus *bus;						// Written under busLock and drainLock, published to under drainLock
+	std::vector<struct NUR_TAG_DATA_EX> busStaging;
+
+	// NurExtStartFanout(): fanoutLock is taken by the producer and start/stop, before drainLock
+	std::mutex fanoutLock;
+	NurExtFanout *fanout;					// Written under fanoutLock and drainLock, published to under drainLock
+	std::vector<struct NUR_TAG_DATA_EX> fanoutStaging;
+
+	// NurExtStartQControl(): qctlLock is taken by start/stop and the stats, never by the controller thread
+	std::mutex qctlLock;
+	NurExtQControl *qctl;
+
+	// NurExtStartSplitPlanner(): splitLock is taken by the split inventory and start/stop, before drainLock
+	std::mutex splitLock;
+	NurExtSplit *split;						// Written under splitLock and drainLock, learns under drainLock
+
+	// NurExtBulkRead(): one job at a time, taken before drainLock
+	std::mutex bulkReadLock;
+
+	explicit NurExtContext(HANDLE h)
+		: hApi(h), drainPendingPos(0), tagRxNs(0), dedup(NULL), indexMode(0), indexCount(0), appCallback(NULL), dispatcherInstalled(false),
+		  asyncReactor(NULL), asyncScheduled(false), asyncStop(false), asyncNextId(1), asyncLastId(0), asyncFd(-1),
+		  dispatchStop(false), metricsEnabled(false), metricsReport(), metricsReports(0), metricsReportErrors(0),
+		  metricsRatesValid(false), metricsInvTagsRate(0), metricsReadErrorsRate(0), metricsRfDuty(0),
+		  metricsPollPending(false), clockStop(false), clockInterval(0), clock(), clockNsPerMs(0),
+		  streamGroup(NULL), groupSource(NULL), groupStaging(256), groupStagingTimes(256),
+		  bus(NULL), busStaging(256), fanout(NULL), fanoutStaging(256), qctl(NULL), split(NULL) { }
+	~NurExtContext();
+};
+
+/// <summary>
+/// Gets the context of the handle, creating it if needed.
+/// </summary>
+/// <returns>The context, or empty pointer if hApi is not a valid handle.</returns>
+std::shared_ptr<NurExtContext> NurExtGetContext(HANDLE hApi);
+
+/// <summary>
+/// Gets the context of the handle if one exists.
+/// </summary>
+std::shared_ptr<NurExtContext> NurExtFindContext(HANDLE hApi);
+
+/// <summary>
+/// Routes the NurApi notifications of the handle through the extensions.
+/// </summary>
+int NurExtInstallDispatcher(NurExtContext *ctx);
+
+/// <summary>
+/// NurExtDrainTagsEx() for a known context.
+/// </summary>
+int NurExtDrainContext(NurExtContext *ctx, struct NUR_TAG_DATA_EX *tagDataBuffer, ULONGLONG *rxTimeNs, int *tagDataCount, DWORD szSingleEntry);
+
+/// <summary>
+/// Microseconds since the time point, saturated to DWORD.
+/// </summary>
+DWORD NurExtElapsedUs(std::chrono::steady_clock::time_point since);
+
+/// <summary>
+/// Passes a notification to the application according to its route. Called on the notification thread.
+/// </summary>
+void NurExtDispatch(NurExtContext *ctx, DWORD timestamp, ULONGLONG rxTimeNs, int type, LPVOID data, int dataLen);
+
+/// <summary>
+/// Stops the dispatch workers after they have delivered the queued notifications.
+/// </summary>
+void NurExtStopDispatch(NurExtContext *ctx);
+
+/// <summary>
+/// Stops the request thread. Requests not yet executed complete with NUR_ERROR_INVALID_HANDLE.
+/// </summary>
+void NurExtStopAsync(NurExtContext *ctx);
+
+/// <summary>
+/// Stops the clock sync thread.
+/// </summary>
+void NurExtStopClock(NurExtContext *ctx);
+
+/// <summary>
+/// Tag read time from the module clock model, see NurExtTagTimeToHost().
+/// </summary>
+/// <returns>false if the clock has not been synced.</returns>
+bool NurExtClockTagTime(NurExtContext *ctx, WORD tagTimestamp, ULONGLONG rxTimeNs, ULONGLONG *hostNs);
+
+/// <summary>
+/// Passes tags just stored in the tag storage to the stream group, tag ring, tag bus or fan-out server of the handle.
+/// Called on the notification thread, or by an extension that fetched the tags itself.
+/// </summary>
+void NurExtProduceTags(NurExtContext *ctx, ULONGLONG rxTimeNs);
+
+/// <summary>
+/// Drains the tag storage to the stream group of the handle. Called on the notification thread.
+/// </summary>
+/// <returns>false if the handle is not in a group.</returns>
+bool NurExtStreamGroupProduce(NurExtContext *ctx, ULONGLONG rxTimeNs);
+
+/// <summary>
+/// Removes the handle from its stream group.
+/// </summary>
+void NurExtStreamGroupForget(NurExtContext *ctx);
+
+/// <summary>
+/// Joins the handle's own request thread after it has been attached to a reactor.
+/// </summary>
+void NurExtJoinAsyncThread(NurExtContext *ctx);
+
+/// <summary>
+/// Protects reactor attachments. Taken before any NurExtContext lock.
+/// </summary>
+extern std::mutex gReactorLock;
+
+/// <summary>
+/// Queues a task to run on a reactor thread. Caller holds gReactorLock.
+/// </summary>
+void NurExtReactorPost(NurExtReactor *reactor, const std::function<void()> &task);
+
+/// <summary>
+/// Removes the context from its reactor. Caller holds gReactorLock and ctx->asyncLock.
+/// </summary>
+void NurExtReactorForget(NurExtContext *ctx);
+
+/// <summary>
+/// True if the binary log is open with the level enabled. Check before collecting NurExtLogEvent() arguments.
+/// </summary>
+bool NurExtLogEnabled(DWORD level);
+
+/// <summary>
+/// Stores a diagnostics report for NurExtStartMetrics(). Called on the notification or request thread.
+/// </summary>
+void NurExtMetricsReport(NurExtContext *ctx, const struct NUR_DIAG_REPORT *report);
+
+/// <summary>
+/// Drains the tag storage to the ring. Called on the notification thread.
+/// </summary>
+/// <returns>false if the ring is not enabled.</returns>
+bool NurExtTagRingProduce(NurExtContext *ctx);
+
+/// <summary>
+/// Drains the tag storage when only the tag bus takes the tags. Called on the notification thread.
+/// </summary>
+/// <returns>false if the handle does not publish.</returns>
+bool NurExtTagBusProduce(NurExtContext *ctx);
+
+/// <summary>
+/// Publishes drained tags to the tag bus of the handle if publishing. Caller holds ctx->drainLock.
+/// </summary>
+void NurExtTagBusPublishTags(NurExtContext *ctx, const BYTE *tags, int count, DWORD szEntry, ULONGLONG rxTimeNs);
+
+/// <summary>
+/// Stops publishing and removes the tag bus.
+/// </summary>
+void NurExtTagBusForget(NurExtContext *ctx);
+
+/// <summary>
+/// Drains the tag storage when only the fan-out server takes the tags. Called on the notification thread.
+/// </summary>
+/// <returns>false if the fan-out server is not running.</returns>
+bool NurExtFanoutProduce(NurExtContext *ctx);
+
+/// <summary>
+/// Gives drained tags to the fan-out server of the handle if running. Caller holds ctx->drainLock.
+/// </summary>
+void NurExtFanoutPublishTags(NurExtContext *ctx, const BYTE *tags, int count, DWORD szEntry, ULONGLONG rxTimeNs);
+
+/// <summary>
+/// Stops the fan-out server.
+/// </summary>
+void NurExtFanoutForget(NurExtContext *ctx);
+
+/// <summary>
+/// Stops the inventory controller.
+/// </summary>
+void NurExtQControlForget(NurExtContext *ctx);
+
+/// <summary>
+/// Counts drained tags in the EPC distribution of the split planner if started. Caller holds ctx->drainLock.
+/// </summary>
+void NurExtSplitLearnTags(NurExtContext *ctx, const BYTE *tags, int count, DWORD szEntry);
+
+/// <summary>
+/// Stops the split planner.
+/// </summary>
+void NurExtSplitForget(NurExtContext *ctx);
+
+/// <summary>
+/// Adds drained tags to the EPC index if enabled. In NUR_EXT_TAGINDEX_UNIQUE mode tags already
+/// in the index are removed from the array.
+/// </summary>
+/// <param name="tags">Array of NUR_TAG_DATA_EX entries, szEntry bytes each.</param>
+/// <returns>Number of tags left in the array.</returns>
+int NurExtIndexTags(NurExtContext *ctx, BYTE *tags, int count, DWORD szEntry);
+
+/// <summary>
+/// Passes drained tags through the deduplication engine of the handle if attached. Caller holds ctx->drainLock.
+/// Duplicates are removed from the array, and in NUR_EXT_DEDUP_SUMMARY mode all tags.
+/// </summary>
+/// <returns>Number of tags left in the array.</returns>
+int NurExtDedupTags(NurExtContext *ctx, BYTE *tags, int count, DWORD szEntry, ULONGLONG rxTimeNs);
+
+/// <summary>
+/// Detaches the handle from its deduplication engine.
+/// </summary>
+void NurExtDedupForget(NurExtContext *ctx);
+
+#endif
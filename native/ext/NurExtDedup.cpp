@@ -0,0 +1,360 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <string.h>
+#include <algorithm>
+#include <set>
+
+#define DEDUP_MAGIC			0x4e455844
+#define DEDUP_SHARDS		16		// Handles drain on their own notification threads, shard to keep them apart
+#define DEDUP_MAX_TAGS		(1 << 24)
+
+/// <summary>
+/// EPCs hashed to one shard. order holds the windows by start time; an entry is stale when the EPC has
+/// since started a new window.
+/// </summary>
+struct NurExtDedupShard
+{
+	std::mutex lock;
+	std::unordered_map<std::string, struct NUR_EXT_DEDUP_TAG> tags;
+	std::deque<std::pair<ULONGLONG, std::string> > order;
+	ULONGLONG reads;
+	ULONGLONG windows;
+	ULONGLONG suppressed;
+	ULONGLONG evicted;
+
+	NurExtDedupShard() : reads(0), windows(0), suppressed(0), evicted(0) { }
+};
+
+struct NurExtDedup
+{
+	DWORD magic;
+	struct NUR_EXT_DEDUP_CONFIG cfg;
+	ULONGLONG windowNs;
+	size_t maxPerShard;
+	NurExtDedupShard shards[DEDUP_SHARDS];
+
+	// Closed windows in NUR_EXT_DEDUP_SUMMARY mode; taken after a shard lock
+	std::mutex eventLock;
+	std::deque<struct NUR_EXT_DEDUP_TAG> events;
+	ULONGLONG eventsDropped;
+
+	std::set<NurExtContext*> attached;	// Protected by gDedupLock
+};
+
+// Attachments; taken before NurExtContext::drainLock
+static std::mutex gDedupLock;
+
+static NurExtDedup *GetDedup(HANDLE hDedup)
+{
+	NurExtDedup *dedup = (NurExtDedup *)hDedup;
+	if (dedup == NULL || dedup == INVALID_HANDLE_VALUE || dedup->magic != DEDUP_MAGIC)
+		return NULL;
+	return dedup;
+}
+
+static NurExtDedupShard &ShardOf(NurExtDedup *dedup, const std::string &key)
+{
+	return dedup->shards[std::hash<std::string>()(key) % DEDUP_SHARDS];
+}
+
+/// <summary>
+/// Closes the window of the EPC at it. Caller holds the shard lock.
+/// </summary>
+static void CloseWindow(NurExtDedup *dedup, NurExtDedupShard &shard, std::unordered_map<std::string, struct NUR_EXT_DEDUP_TAG>::iterator it)
+{
+	if (dedup->cfg.mode == NUR_EXT_DEDUP_SUMMARY)
+	{
+		std::lock_guard<std::mutex> guard(dedup->eventLock);
+		if (dedup->events.size() < (size_t)dedup->cfg.eventCapacity)
+			dedup->events.push_back(it->second);
+		else
+			dedup->eventsDropped++;
+	}
+	shard.tags.erase(it);
+}
+
+/// <summary>
+/// Closes the oldest window of the shard. Caller holds the shard lock.
+/// </summary>
+/// <param name="due">Close only if the window ended by this time.</param>
+/// <returns>false if there was nothing to close.</returns>
+static bool CloseOldest(NurExtDedup *dedup, NurExtDedupShard &shard, ULONGLONG due)
+{
+	while (!shard.order.empty() && shard.order.front().first + dedup->windowNs <= due)
+	{
+		std::pair<ULONGLONG, std::string> front = shard.order.front();
+		shard.order.pop_front();
+
+		std::unordered_map<std::string, struct NUR_EXT_DEDUP_TAG>::iterator it = shard.tags.find(front.second);
+		if (it != shard.tags.end() && it->second.firstSeenNs == front.first)
+		{
+			CloseWindow(dedup, shard, it);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void Sweep(NurExtDedup *dedup, NurExtDedupShard &shard, ULONGLONG now)
+{
+	while (CloseOldest(dedup, shard, now))
+		;
+}
+
+/// <summary>
+/// Adds one read to its window. Caller holds the shard lock.
+/// </summary>
+/// <returns>true if the read started a window.</returns>
+static bool AddRead(NurExtDedup *dedup, NurExtDedupShard &shard, const std::string &key,
+	const struct NUR_TAG_DATA_EX *tag, HANDLE hApi, ULONGLONG rxTimeNs)
+{
+	shard.reads++;
+
+	std::unordered_map<std::string, struct NUR_EXT_DEDUP_TAG>::iterator it = shard.tags.find(key);
+	if (it != shard.tags.end() && rxTimeNs >= it->second.firstSeenNs + dedup->windowNs)
+	{
+		// Window ended but not swept yet
+		CloseWindow(dedup, shard, it);
+		it = shard.tags.end();
+	}
+
+	if (it != shard.tags.end())
+	{
+		struct NUR_EXT_DEDUP_TAG &t = it->second;
+		t.reads++;
+		t.lastSeenNs = std::max(t.lastSeenNs, rxTimeNs);
+		if (tag->rssi > t.bestRssi)
+		{
+			t.bestRssi = tag->rssi;
+			t.bestAntenna = tag->antennaId;
+			t.bestApi = hApi;
+		}
+		shard.suppressed++;
+		return false;
+	}
+
+	if (shard.tags.size() >= dedup->maxPerShard && CloseOldest(dedup, shard, ~0ULL - dedup->windowNs))
+		shard.evicted++;
+
+	struct NUR_EXT_DEDUP_TAG &t = shard.tags[key];
+	t.firstSeenNs = rxTimeNs;
+	t.lastSeenNs = rxTimeNs;
+	t.reads = 1;
+	t.firstApi = hApi;
+	t.bestApi = hApi;
+	t.bestAntenna = tag->antennaId;
+	t.bestRssi = tag->rssi;
+	t.pc = tag->pc;
+	t.epcLen = tag->epcLen;
+	memset(t.epc, 0, sizeof(t.epc));
+	memcpy(t.epc, tag->epc, tag->epcLen);
+	shard.order.push_back(std::make_pair(rxTimeNs, key));
+	shard.windows++;
+	return true;
+}
+
+int NurExtDedupTags(NurExtContext *ctx, BYTE *tags, int count, DWORD szEntry, ULONGLONG rxTimeNs)
+{
+	NurExtDedup *dedup = ctx->dedup;
+	int kept = 0;
+
+	if (!dedup)
+		return count;
+
+	for (int i = 0; i < count; i++)
+	{
+		BYTE *entry = tags + i * szEntry;
+		const struct NUR_TAG_DATA_EX *tag = (const struct NUR_TAG_DATA_EX *)entry;
+		std::string key((const char *)tag->epc, tag->epcLen);
+		NurExtDedupShard &shard = ShardOf(dedup, key);
+		bool started;
+
+		{
+			std::lock_guard<std::mutex> guard(shard.lock);
+			Sweep(dedup, shard, rxTimeNs);
+			started = AddRead(dedup, shard, key, tag, ctx->hApi, rxTimeNs);
+		}
+
+		if (!started || dedup->cfg.mode != NUR_EXT_DEDUP_FIRST)
+			continue;
+		if (kept != i)
+			memmove(tags + kept * szEntry, entry, szEntry);
+		kept++;
+	}
+	return kept;
+}
+
+/// <summary>
+/// Detaches the handle. Caller holds gDedupLock.
+/// </summary>
+static void Detach(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(ctx->drainLock);
+	if (ctx->dedup)
+	{
+		ctx->dedup->attached.erase(ctx);
+		ctx->dedup = NULL;
+	}
+}
+
+void NurExtDedupForget(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(gDedupLock);
+	Detach(ctx);
+}
+
+void NURAPICONV NurExtDedupDefaultConfig(struct NUR_EXT_DEDUP_CONFIG *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->windowMs = 1000;
+	cfg->mode = NUR_EXT_DEDUP_FIRST;
+	cfg->maxTags = 100000;
+	cfg->eventCapacity = 10000;
+}
+
+HANDLE NURAPICONV NurExtDedupCreate(const struct NUR_EXT_DEDUP_CONFIG *cfg)
+{
+	if (!cfg || cfg->windowMs == 0 || cfg->maxTags <= 0 || cfg->maxTags > DEDUP_MAX_TAGS
+		|| (cfg->mode != NUR_EXT_DEDUP_FIRST && cfg->mode != NUR_EXT_DEDUP_SUMMARY)
+		|| (cfg->mode == NUR_EXT_DEDUP_SUMMARY && cfg->eventCapacity <= 0))
+		return NULL;
+
+	NurExtDedup *dedup = new NurExtDedup();
+	dedup->magic = DEDUP_MAGIC;
+	dedup->cfg = *cfg;
+	dedup->windowNs = cfg->windowMs * 1000000ULL;
+	dedup->maxPerShard = (cfg->maxTags + DEDUP_SHARDS - 1) / DEDUP_SHARDS;
+	dedup->eventsDropped = 0;
+	return (HANDLE)dedup;
+}
+
+int NURAPICONV NurExtDedupFree(HANDLE hDedup)
+{
+	NurExtDedup *dedup = GetDedup(hDedup);
+
+	if (!dedup)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	{
+		// Drains hold the handle's drainLock while using the engine
+		std::lock_guard<std::mutex> guard(gDedupLock);
+		while (!dedup->attached.empty())
+			Detach(*dedup->attached.begin());
+	}
+
+	dedup->magic = 0;
+	delete dedup;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtDedupAttach(HANDLE hDedup, HANDLE hApi)
+{
+	NurExtDedup *dedup = NULL;
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (hDedup)
+	{
+		dedup = GetDedup(hDedup);
+		if (!dedup)
+			return NUR_ERROR_INVALID_HANDLE;
+	}
+
+	std::lock_guard<std::mutex> guard(gDedupLock);
+	Detach(ctx.get());
+	if (dedup)
+	{
+		std::lock_guard<std::mutex> drainGuard(ctx->drainLock);
+		dedup->attached.insert(ctx.get());
+		ctx->dedup = dedup;
+	}
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtDedupRead(HANDLE hDedup, struct NUR_EXT_DEDUP_TAG *tags, int *tagCount, DWORD szSingleEntry)
+{
+	NurExtDedup *dedup = GetDedup(hDedup);
+	BYTE *dst = (BYTE *)tags;
+
+	if (!dedup)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!tags || !tagCount || *tagCount < 0
+		|| szSingleEntry == 0 || szSingleEntry > sizeof(struct NUR_EXT_DEDUP_TAG))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	// Windows of EPCs no longer read are closed here
+	ULONGLONG now = NurExtGetMonotonicNs();
+	for (int i = 0; i < DEDUP_SHARDS; i++)
+	{
+		std::lock_guard<std::mutex> guard(dedup->shards[i].lock);
+		Sweep(dedup, dedup->shards[i], now);
+	}
+
+	std::lock_guard<std::mutex> guard(dedup->eventLock);
+	int n = (int)std::min(dedup->events.size(), (size_t)*tagCount);
+	for (int i = 0; i < n; i++)
+	{
+		memcpy(dst + i * szSingleEntry, &dedup->events.front(), szSingleEntry);
+		dedup->events.pop_front();
+	}
+	*tagCount = n;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtDedupGetTag(HANDLE hDedup, const BYTE *epc, int epcLen, struct NUR_EXT_DEDUP_TAG *tag, DWORD szEntry)
+{
+	NurExtDedup *dedup = GetDedup(hDedup);
+
+	if (!dedup)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!epc || epcLen < 0 || epcLen > NUR_MAX_EPC_LENGTH_EX
+		|| (tag && (szEntry == 0 || szEntry > sizeof(struct NUR_EXT_DEDUP_TAG))))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::string key((const char *)epc, epcLen);
+	NurExtDedupShard &shard = ShardOf(dedup, key);
+	std::lock_guard<std::mutex> guard(shard.lock);
+	Sweep(dedup, shard, NurExtGetMonotonicNs());
+
+	std::unordered_map<std::string, struct NUR_EXT_DEDUP_TAG>::const_iterator it = shard.tags.find(key);
+	if (it == shard.tags.end())
+		return NUR_ERROR_NO_TAG;
+	if (tag)
+		memcpy(tag, &it->second, szEntry);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtDedupGetStats(HANDLE hDedup, struct NUR_EXT_DEDUP_STATS *stats, DWORD szStats)
+{
+	NurExtDedup *dedup = GetDedup(hDedup);
+	struct NUR_EXT_DEDUP_STATS tmp;
+
+	if (!dedup)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!stats || szStats == 0 || szStats > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	memset(&tmp, 0, sizeof(tmp));
+	for (int i = 0; i < DEDUP_SHARDS; i++)
+	{
+		NurExtDedupShard &shard = dedup->shards[i];
+		std::lock_guard<std::mutex> guard(shard.lock);
+		tmp.reads += shard.reads;
+		tmp.windows += shard.windows;
+		tmp.suppressed += shard.suppressed;
+		tmp.evicted += shard.evicted;
+		tmp.tags += (DWORD)shard.tags.size();
+	}
+	{
+		std::lock_guard<std::mutex> guard(dedup->eventLock);
+		tmp.eventsDropped = dedup->eventsDropped;
+	}
+	{
+		std::lock_guard<std::mutex> guard(gDedupLock);
+		tmp.handles = (DWORD)dedup->attached.size();
+	}
+	memcpy(stats, &tmp, szStats);
+	return NUR_NO_ERROR;
+}
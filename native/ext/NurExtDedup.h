@@ -0,0 +1,160 @@
+/*
+ * NurExtDedup.h
+ *
+ *  EPC deduplication shared by several NurApi handles.
+ */
+
+#ifndef _NUREXTDEDUP_H_
+#define _NUREXTDEDUP_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** First read of each window is returned by the drain of the handle that read it, the rest are removed. */
+#define NUR_EXT_DEDUP_FIRST			0
+/** All reads are removed from the drain. One NUR_EXT_DEDUP_TAG per window is read with NurExtDedupRead() when the window closes. */
+#define NUR_EXT_DEDUP_SUMMARY		1
+
+/**
+ * Deduplication engine configuration.
+ * @sa NurExtDedupCreate()
+ */
+struct NUR_EXT_DEDUP_CONFIG
+{
+	DWORD windowMs;				/**< Window length. A window starts at the first read of an EPC not in a window. */
+	int mode;					/**< NUR_EXT_DEDUP_FIRST or NUR_EXT_DEDUP_SUMMARY. */
+	int maxTags;				/**< Maximum number of EPCs in a window. When full, the oldest window is closed early. */
+	int eventCapacity;			/**< Maximum number of closed windows waiting for NurExtDedupRead() in NUR_EXT_DEDUP_SUMMARY mode. */
+};
+
+/**
+ * State of one EPC in its window.
+ * @sa NurExtDedupRead(), NurExtDedupGetTag()
+ */
+struct NUR_EXT_DEDUP_TAG
+{
+	ULONGLONG firstSeenNs;		/**< Receive time of the first read in the window, see NurExtDrainTagsEx(). */
+	ULONGLONG lastSeenNs;		/**< Receive time of the latest read. */
+	DWORD reads;				/**< Reads in the window from all handles. */
+	HANDLE firstApi;			/**< Handle of the first read. */
+	HANDLE bestApi;				/**< Handle of the read with the strongest RSSI. */
+	BYTE bestAntenna;			/**< Antenna of the read with the strongest RSSI. */
+	signed char bestRssi;		/**< Strongest RSSI. */
+	WORD pc;					/**< Tag PC word. */
+	BYTE epcLen;				/**< Number of bytes stored in epc field. */
+	BYTE epc[NUR_MAX_EPC_LENGTH_EX];	/**< Tag EPC. */
+};
+
+/**
+ * Deduplication counters.
+ * @sa NurExtDedupGetStats()
+ */
+struct NUR_EXT_DEDUP_STATS
+{
+	ULONGLONG reads;			/**< Tag reads seen from all attached handles. */
+	ULONGLONG windows;			/**< Windows started, i.e. reads passed on in NUR_EXT_DEDUP_FIRST mode. */
+	ULONGLONG suppressed;		/**< Reads removed as duplicates. */
+	ULONGLONG evicted;			/**< Windows closed early because maxTags was reached. */
+	ULONGLONG eventsDropped;	/**< Closed windows dropped because eventCapacity was reached. */
+	DWORD tags;					/**< EPCs currently in a window. */
+	DWORD handles;				/**< Attached handles. */
+};
+
+/** @fn void NurExtDedupDefaultConfig(struct NUR_EXT_DEDUP_CONFIG *cfg)
+ *
+ * Fill the configuration with defaults: 1 second windows, NUR_EXT_DEDUP_FIRST, 100000 EPCs, 10000 events.
+ *
+ * @param	cfg		Pointer to the NUR_EXT_DEDUP_CONFIG structure.
+ */
+void NURAPICONV NurExtDedupDefaultConfig(struct NUR_EXT_DEDUP_CONFIG *cfg);
+
+/** @fn HANDLE NurExtDedupCreate(const struct NUR_EXT_DEDUP_CONFIG *cfg)
+ *
+ * Create a deduplication engine keyed by EPC. Tags drained from the attached handles, by NurExtDrainTags(),
+ * NurExtEnableTagRing() or NurExtStreamGroupAdd(), pass through the engine after the handle's own tag index:
+ * an EPC read by any of the handles opens a window of <i>windowMs</i>, and further reads of it by any handle
+ * within the window only update its NUR_EXT_DEDUP_TAG state. Reads after the window open a new window.
+ *
+ * @sa NurExtDedupAttach(), NurExtDedupRead(), NurExtDedupGetTag(), NurExtDedupFree()
+ *
+ * @param	cfg		Engine configuration. Copied.
+ *
+ * @return	Engine handle, or NULL on invalid configuration.
+ */
+HANDLE NURAPICONV NurExtDedupCreate(const struct NUR_EXT_DEDUP_CONFIG *cfg);
+
+/** @fn int NurExtDedupFree(HANDLE hDedup)
+ *
+ * Detach all handles and free the engine.
+ *
+ * @param	hDedup	Engine handle.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtDedupFree(HANDLE hDedup);
+
+/** @fn int NurExtDedupAttach(HANDLE hDedup, HANDLE hApi)
+ *
+ * Pass tags drained from <i>hApi</i> through the engine. A handle is attached to one engine at a time;
+ * it is detached by NurExtFree().
+ *
+ * @param	hDedup	Engine handle, NULL to detach <i>hApi</i> from its engine.
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtDedupAttach(HANDLE hDedup, HANDLE hApi);
+
+/** @fn int NurExtDedupRead(HANDLE hDedup, struct NUR_EXT_DEDUP_TAG *tags, int *tagCount, DWORD szSingleEntry)
+ *
+ * Read the windows closed since the previous call, in NUR_EXT_DEDUP_SUMMARY mode. Does not block.
+ *
+ * @param	hDedup			Engine handle.
+ * @param	tags			Pointer to NUR_EXT_DEDUP_TAG structures. Must contain at least <i>tagCount</i> entries.
+ * @param	tagCount		Number of entries in <i>tags</i>. On return number of valid entries is received in this pointer.
+ * @param	szSingleEntry	sizeof(struct NUR_EXT_DEDUP_TAG)
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtDedupRead(HANDLE hDedup, struct NUR_EXT_DEDUP_TAG *tags, int *tagCount, DWORD szSingleEntry);
+
+/** @fn int NurExtDedupGetTag(HANDLE hDedup, const BYTE *epc, int epcLen, struct NUR_EXT_DEDUP_TAG *tag, DWORD szEntry)
+ *
+ * Get the state of an EPC in its current window.
+ *
+ * @param	hDedup		Engine handle.
+ * @param	epc			EPC bytes.
+ * @param	epcLen		Number of EPC bytes.
+ * @param	tag			Pointer to NUR_EXT_DEDUP_TAG structure where the state is stored. May be NULL to only test presence.
+ * @param	szEntry		sizeof(struct NUR_EXT_DEDUP_TAG)
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NO_TAG if the EPC is not in a window. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtDedupGetTag(HANDLE hDedup, const BYTE *epc, int epcLen, struct NUR_EXT_DEDUP_TAG *tag, DWORD szEntry);
+
+/** @fn int NurExtDedupGetStats(HANDLE hDedup, struct NUR_EXT_DEDUP_STATS *stats, DWORD szStats)
+ *
+ * Get deduplication counters.
+ *
+ * @param	hDedup	Engine handle.
+ * @param	stats	Pointer to the NUR_EXT_DEDUP_STATS structure.
+ * @param	szStats	sizeof(struct NUR_EXT_DEDUP_STATS)
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtDedupGetStats(HANDLE hDedup, struct NUR_EXT_DEDUP_STATS *stats, DWORD szStats);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,278 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <string.h>
+#include <algorithm>
+
+#define DISPATCH_MAX_WORKERS	64
+
+// Handle of the notification being delivered on this thread, see NurExtGetLastNotificationStatus()
+static thread_local HANDLE tDispatchApi = NULL;
+static thread_local DWORD tDispatchStatus = 0;
+static thread_local ULONGLONG tDispatchRxTime = 0;
+
+/// <summary>
+/// Selects the queue to deliver from next: highest priority, then oldest notification.
+/// Caller holds ctx->dispatchLock.
+/// </summary>
+/// <returns>Notification type, or -1 if nothing can be delivered now.</returns>
+static int PickQueue(NurExtContext *ctx)
+{
+	int best = -1;
+
+	for (int type = 0; type < NUR_NOTIFICATION_LAST; type++)
+	{
+		const NurExtDispatchQueue &q = ctx->dispatchQueues[type];
+		if (q.busy || q.queue.empty())
+			continue;
+
+		if (best >= 0)
+		{
+			const NurExtDispatchQueue &b = ctx->dispatchQueues[best];
+			if (q.route.priority < b.route.priority)
+				continue;
+			if (q.route.priority == b.route.priority && q.queue.front().received >= b.queue.front().received)
+				continue;
+		}
+		best = type;
+	}
+	return best;
+}
+
+static void DispatchThread(NurExtContext *ctx)
+{
+	std::unique_lock<std::mutex> lock(ctx->dispatchLock);
+	int type = -1;
+
+	tDispatchApi = ctx->hApi;
+
+	for (;;)
+	{
+		// Queued notifications are delivered before stopping
+		ctx->dispatchCond.wait(lock, [ctx, &type] { type = PickQueue(ctx); return type >= 0 || ctx->dispatchStop; });
+		if (type < 0)
+			break;
+
+		NurExtDispatchQueue &q = ctx->dispatchQueues[type];
+		NurExtNotification n = std::move(q.queue.front());
+		q.queue.pop_front();
+		q.busy = true;
+
+		DWORD delayUs = NurExtElapsedUs(n.received);
+		if (delayUs > q.stats.maxDelayUs)
+			q.stats.maxDelayUs = delayUs;
+
+		lock.unlock();
+		ctx->statDispatchDelay[type].Add(delayUs);
+		NotificationCallback appCallback = ctx->appCallback.load();
+		if (appCallback)
+		{
+			std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+			tDispatchStatus = n.status;
+			tDispatchRxTime = n.rxTimeNs;
+			appCallback(ctx->hApi, n.timestamp, type, n.hasData ? n.data.data() : NULL, n.dataLen);
+			ctx->statCallback[type].Add(NurExtElapsedUs(t0));
+		}
+		lock.lock();
+
+		q.busy = false;
+		q.stats.delivered++;
+		ctx->dispatchCond.notify_all();
+	}
+}
+
+static void LogDrop(NurExtContext *ctx, int type, const NurExtDispatchQueue &q)
+{
+	if (NurExtLogEnabled(NUR_LOG_ERROR))
+	{
+		ULONGLONG args[2] = { (ULONGLONG)type, q.queue.size() };
+		NurExtLogEvent(ctx->hApi, NUR_LOG_ERROR, NUR_EXT_LOGEV_DISPATCH_DROP, args, 2);
+	}
+}
+
+/// <summary>
+/// Copies the notification to the queue according to the route. Caller holds ctx->dispatchLock.
+/// </summary>
+static void Enqueue(NurExtContext *ctx, NurExtDispatchQueue &q, DWORD timestamp, ULONGLONG rxTimeNs, int type, LPVOID data, int dataLen)
+{
+	if (q.route.policy == NUR_EXT_DISPATCH_DROP_NEWEST && q.queue.size() >= q.route.capacity)
+	{
+		q.stats.dropped++;
+		LogDrop(ctx, type, q);
+		return;
+	}
+
+	NurExtNotification n;
+	n.timestamp = timestamp;
+	n.status = NurApiGetLastNotificationStatus(ctx->hApi);
+	n.dataLen = dataLen;
+	n.hasData = (data != NULL);
+	n.received = std::chrono::steady_clock::now();
+	n.rxTimeNs = rxTimeNs;
+	if (data)
+	{
+		// Data is valid only during the NurApi callback. Log data is a TCHAR string.
+		size_t size = (type == NUR_NOTIFICATION_LOG) ? (_tcslen((const TCHAR *)data) + 1) * sizeof(TCHAR) : (size_t)std::max(dataLen, 0);
+		n.data.assign((const BYTE *)data, (const BYTE *)data + size);
+	}
+
+	if (q.route.policy == NUR_EXT_DISPATCH_COALESCE && !q.queue.empty())
+	{
+		q.stats.coalesced += q.queue.size();
+		q.queue.clear();
+	}
+	else if (q.route.policy == NUR_EXT_DISPATCH_DROP_OLDEST)
+	{
+		while (!q.queue.empty() && q.queue.size() >= q.route.capacity)
+		{
+			q.queue.pop_front();
+			q.stats.dropped++;
+			LogDrop(ctx, type, q);
+		}
+	}
+
+	q.queue.push_back(std::move(n));
+	if (q.queue.size() > q.stats.highWater)
+		q.stats.highWater = (DWORD)q.queue.size();
+	ctx->dispatchCond.notify_one();
+}
+
+void NurExtDispatch(NurExtContext *ctx, DWORD timestamp, ULONGLONG rxTimeNs, int type, LPVOID data, int dataLen)
+{
+	bool known = (type >= 0 && type < NUR_NOTIFICATION_LAST);
+
+	if (known)
+	{
+		std::lock_guard<std::mutex> guard(ctx->dispatchLock);
+		NurExtDispatchQueue &q = ctx->dispatchQueues[type];
+
+		q.stats.received++;
+		if (q.route.policy == NUR_EXT_DISPATCH_DISCARD)
+		{
+			q.stats.dropped++;
+			return;
+		}
+		// Without workers queued routes are delivered inline
+		if (q.route.policy != NUR_EXT_DISPATCH_INLINE && !ctx->dispatchThreads.empty() && !ctx->dispatchStop)
+		{
+			Enqueue(ctx, q, timestamp, rxTimeNs, type, data, dataLen);
+			return;
+		}
+		q.stats.delivered++;
+	}
+
+	NotificationCallback appCallback = ctx->appCallback.load();
+	if (appCallback)
+	{
+		// Valid only during the call, the notification thread may serve several handles
+		HANDLE prevApi = tDispatchApi;
+		DWORD prevStatus = tDispatchStatus;
+		ULONGLONG prevRxTime = tDispatchRxTime;
+		tDispatchApi = ctx->hApi;
+		tDispatchStatus = NurApiGetLastNotificationStatus(ctx->hApi);
+		tDispatchRxTime = rxTimeNs;
+
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		appCallback(ctx->hApi, timestamp, type, data, dataLen);
+
+		tDispatchApi = prevApi;
+		tDispatchStatus = prevStatus;
+		tDispatchRxTime = prevRxTime;
+		if (known)
+		{
+			ctx->statDispatchDelay[type].Add(0);
+			ctx->statCallback[type].Add(NurExtElapsedUs(t0));
+		}
+	}
+}
+
+void NurExtStopDispatch(NurExtContext *ctx)
+{
+	std::vector<std::thread> threads;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->dispatchLock);
+		ctx->dispatchStop = true;
+		threads.swap(ctx->dispatchThreads);
+		ctx->dispatchCond.notify_all();
+	}
+
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+int NURAPICONV NurExtSetDispatchWorkers(HANDLE hApi, int workerCount)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (workerCount < 0 || workerCount > DISPATCH_MAX_WORKERS)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	NurExtStopDispatch(ctx.get());
+	if (workerCount == 0)
+		return NUR_NO_ERROR;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->dispatchLock);
+		ctx->dispatchStop = false;
+		for (int i = 0; i < workerCount; i++)
+			ctx->dispatchThreads.push_back(std::thread(DispatchThread, ctx.get()));
+	}
+	return NurExtInstallDispatcher(ctx.get());
+}
+
+int NURAPICONV NurExtSetDispatchRoute(HANDLE hApi, int type, const struct NUR_EXT_DISPATCH_ROUTE *route)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (type < 0 || type >= NUR_NOTIFICATION_LAST || !route
+		|| route->policy < NUR_EXT_DISPATCH_INLINE || route->policy >= NUR_EXT_DISPATCH_LAST)
+		return NUR_ERROR_INVALID_PARAMETER;
+	if ((route->policy == NUR_EXT_DISPATCH_DROP_NEWEST || route->policy == NUR_EXT_DISPATCH_DROP_OLDEST) && route->capacity == 0)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->dispatchLock);
+		ctx->dispatchQueues[type].route = *route;
+	}
+
+	return (route->policy != NUR_EXT_DISPATCH_INLINE) ? NurExtInstallDispatcher(ctx.get()) : NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetDispatchStats(HANDLE hApi, int type, struct NUR_EXT_DISPATCH_STATS *stats, DWORD szStats)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	struct NUR_EXT_DISPATCH_STATS tmp;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (type < 0 || type >= NUR_NOTIFICATION_LAST || !stats || szStats == 0 || szStats > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->dispatchLock);
+		const NurExtDispatchQueue &q = ctx->dispatchQueues[type];
+		tmp = q.stats;
+		tmp.queued = (DWORD)q.queue.size();
+	}
+	memcpy(stats, &tmp, szStats);
+	return NUR_NO_ERROR;
+}
+
+DWORD NURAPICONV NurExtGetLastNotificationStatus(HANDLE hApi)
+{
+	if (tDispatchApi != NULL && tDispatchApi == hApi)
+		return tDispatchStatus;
+	return NurApiGetLastNotificationStatus(hApi);
+}
+
+ULONGLONG NURAPICONV NurExtGetNotificationTime(HANDLE hApi)
+{
+	if (tDispatchApi != NULL && tDispatchApi == hApi)
+		return tDispatchRxTime;
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * NurExtDispatch.h
+ *
+ *  Notification dispatch to the application through per type queues and a worker pool.
+ */
+
+#ifndef _NUREXTDISPATCH_H_
+#define _NUREXTDISPATCH_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/**
+ * Notification dispatch policies.
+ * @sa NurExtSetDispatchRoute()
+ */
+enum NUR_EXT_DISPATCH
+{
+	NUR_EXT_DISPATCH_INLINE = 0,		/**< Call application on the NurApi notification thread. Default for all types. */
+	NUR_EXT_DISPATCH_DROP_NEWEST,		/**< Queue to the worker pool. When queue is full, the new notification is dropped. */
+	NUR_EXT_DISPATCH_DROP_OLDEST,		/**< Queue to the worker pool. When queue is full, the oldest queued notification is dropped. */
+	NUR_EXT_DISPATCH_COALESCE,			/**< Queue to the worker pool. Only the latest notification is kept queued, older ones are replaced. */
+	NUR_EXT_DISPATCH_DISCARD,			/**< Never pass to the application. */
+	NUR_EXT_DISPATCH_LAST
+};
+
+/**
+ * Routing of one notification type.
+ * @sa NurExtSetDispatchRoute()
+ */
+struct NUR_EXT_DISPATCH_ROUTE
+{
+	int policy;				/**< One of enum NUR_EXT_DISPATCH. */
+	int priority;			/**< Queued notifications of higher priority types are delivered first. */
+	DWORD capacity;			/**< Maximum number of queued notifications. Used with NUR_EXT_DISPATCH_DROP_NEWEST and NUR_EXT_DISPATCH_DROP_OLDEST. */
+};
+
+/**
+ * Dispatch counters of one notification type.
+ * @sa NurExtGetDispatchStats()
+ */
+struct NUR_EXT_DISPATCH_STATS
+{
+	ULONGLONG received;		/**< Notifications received from NurApi. */
+	ULONGLONG delivered;	/**< Notifications passed to the application. */
+	ULONGLONG dropped;		/**< Notifications dropped because the queue was full or by NUR_EXT_DISPATCH_DISCARD. */
+	ULONGLONG coalesced;	/**< Notifications replaced by a newer one by NUR_EXT_DISPATCH_COALESCE. */
+	DWORD queued;			/**< Notifications currently queued. */
+	DWORD highWater;		/**< Highest number of queued notifications. */
+	DWORD maxDelayUs;		/**< Longest time from NurApi notification to application call, in microseconds. */
+};
+
+/** @fn int NurExtSetDispatchWorkers(HANDLE hApi, int workerCount)
+ *
+ * Set number of worker threads that deliver queued notifications to the application function
+ * given in NurExtSetNotificationCallback(). Notifications of one type are delivered one at a time in order;
+ * different types are delivered in parallel, higher NUR_EXT_DISPATCH_ROUTE.priority first.
+ *
+ * Queued notifications are delivered before the workers exit. With no workers, queued routes are delivered inline.
+ * Must not be called from the application notification function.
+ *
+ * @sa NurExtSetDispatchRoute()
+ *
+ * @param	hApi			Handle to valid NurApi object instance.
+ * @param	workerCount		Number of worker threads, 0 to stop the workers.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtSetDispatchWorkers(HANDLE hApi, int workerCount);
+
+/** @fn int NurExtSetDispatchRoute(HANDLE hApi, int type, const struct NUR_EXT_DISPATCH_ROUTE *route)
+ *
+ * Set how notifications of one type are passed to the application.
+ * For example, queuing NUR_NOTIFICATION_LOG and NUR_NOTIFICATION_DEVSEARCH with NUR_EXT_DISPATCH_DROP_OLDEST
+ * keeps slow handlers of those off the NurApi notification thread, so that NUR_NOTIFICATION_TRIGGERREAD and
+ * NUR_NOTIFICATION_INVENTORYSTREAM are not delayed by them.
+ *
+ * Extensions (e.g. NurExtEnableTagRing()) always handle the notification on the NurApi notification thread first.
+ * Notification data is copied when queued. NurApiGetLastNotificationStatus() is not valid on the worker threads,
+ * use NurExtGetLastNotificationStatus() instead.
+ *
+ * @sa NurExtSetDispatchWorkers(), NurExtGetDispatchStats(), NurExtSetNotificationCallback()
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	type	Notification type, see enum NUR_NOTIFICATION.
+ * @param	route	Routing of the type.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtSetDispatchRoute(HANDLE hApi, int type, const struct NUR_EXT_DISPATCH_ROUTE *route);
+
+/** @fn int NurExtGetDispatchStats(HANDLE hApi, int type, struct NUR_EXT_DISPATCH_STATS *stats, DWORD szStats)
+ *
+ * Get dispatch counters of a notification type.
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	type	Notification type, see enum NUR_NOTIFICATION.
+ * @param	stats	Pointer to the NUR_EXT_DISPATCH_STATS structure.
+ * @param	szStats	sizeof(struct NUR_EXT_DISPATCH_STATS)
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetDispatchStats(HANDLE hApi, int type, struct NUR_EXT_DISPATCH_STATS *stats, DWORD szStats);
+
+/** @fn DWORD NurExtGetLastNotificationStatus(HANDLE hApi)
+ *
+ * NurApiGetLastNotificationStatus() of the notification being handled.
+ * Valid only when called from the application notification function, on a worker thread or inline.
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Status of the notification.
+ */
+DWORD NURAPICONV NurExtGetLastNotificationStatus(HANDLE hApi);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,609 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+
+#define FANOUT_CLIENT_MAGIC		0x4e454643
+#define FANOUT_MAX_CAPACITY		(1 << 22)
+#define FANOUT_MAX_EVENTS		32
+#define FANOUT_SEND_BATCH		64		// Tags copied out of the ring per client at a time
+#define FANOUT_CONNECT_TIMEOUT_MS	5000
+// epoll user data of the listening socket and the wake up eventfd; clients use their descriptor
+#define FANOUT_LISTEN_ID		((ULONGLONG)-1)
+#define FANOUT_WAKE_ID			((ULONGLONG)-2)
+
+/// <summary>
+/// Connected client. Only used by the server thread.
+/// </summary>
+struct NurExtFanoutClient
+{
+	int fd;
+	ULONGLONG pos;				// Sequence of the next tag to copy out of the ring
+	std::vector<BYTE> out;		// Copied, not yet sent
+	size_t outPos;
+	bool wantWrite;				// EPOLLOUT armed
+};
+
+struct NurExtFanout
+{
+	int listenFd;
+	int epollFd;
+	int wakeFd;
+	int port;
+	int maxClients;
+	int sendBuffer;
+	std::thread thread;
+	std::atomic<bool> stop;
+	std::map<int, NurExtFanoutClient> clients;
+
+	// Tag ring shared by the clients and counters
+	std::mutex lock;
+	std::vector<struct NUR_EXT_BUS_TAG> tags;
+	ULONGLONG mask;
+	ULONGLONG head;
+	DWORD clientCount;
+	ULONGLONG accepted;
+	ULONGLONG rejected;
+	ULONGLONG sent;
+	ULONGLONG lost;
+
+	NurExtFanout()
+		: listenFd(-1), epollFd(-1), wakeFd(-1), port(0), maxClients(0), sendBuffer(0), stop(false),
+		  mask(0), head(0), clientCount(0), accepted(0), rejected(0), sent(0), lost(0) { }
+};
+
+/// <summary>
+/// Copies the next tags of the client out of the ring.
+/// </summary>
+/// <returns>false if there are none.</returns>
+static bool Refill(NurExtFanout *fo, NurExtFanoutClient &client)
+{
+	std::lock_guard<std::mutex> guard(fo->lock);
+	ULONGLONG capacity = fo->mask + 1;
+
+	if (fo->head - client.pos > capacity)
+	{
+		fo->lost += fo->head - capacity - client.pos;
+		client.pos = fo->head - capacity;
+	}
+
+	int n = (int)std::min(fo->head - client.pos, (ULONGLONG)FANOUT_SEND_BATCH);
+	if (n == 0)
+		return false;
+
+	client.out.resize(n * sizeof(struct NUR_EXT_BUS_TAG));
+	client.outPos = 0;
+	for (int i = 0; i < n; i++)
+		memcpy(&client.out[i * sizeof(struct NUR_EXT_BUS_TAG)], &fo->tags[(client.pos + i) & fo->mask], sizeof(struct NUR_EXT_BUS_TAG));
+	client.pos += n;
+	fo->sent += n;
+	return true;
+}
+
+static void WatchClient(NurExtFanout *fo, NurExtFanoutClient &client, bool write)
+{
+	if (client.wantWrite == write)
+		return;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN | (write ? EPOLLOUT : 0);
+	ev.data.u64 = (ULONGLONG)client.fd;
+	epoll_ctl(fo->epollFd, EPOLL_CTL_MOD, client.fd, &ev);
+	client.wantWrite = write;
+}
+
+/// <summary>
+/// Sends until the client is up to date or its socket is full.
+/// </summary>
+/// <returns>false if the connection failed.</returns>
+static bool Flush(NurExtFanout *fo, NurExtFanoutClient &client)
+{
+	for (;;)
+	{
+		if (client.outPos == client.out.size() && !Refill(fo, client))
+		{
+			WatchClient(fo, client, false);
+			return true;
+		}
+
+		ssize_t n = send(client.fd, &client.out[client.outPos], client.out.size() - client.outPos, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n > 0)
+		{
+			client.outPos += n;
+		}
+		else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			// Continued on EPOLLOUT; the ring keeps the client's tags meanwhile
+			WatchClient(fo, client, true);
+			return true;
+		}
+		else if (n < 0 && errno != EINTR)
+		{
+			return false;
+		}
+	}
+}
+
+static void CloseClient(NurExtFanout *fo, int fd)
+{
+	epoll_ctl(fo->epollFd, EPOLL_CTL_DEL, fd, NULL);
+	close(fd);
+	fo->clients.erase(fd);
+
+	std::lock_guard<std::mutex> guard(fo->lock);
+	fo->clientCount = (DWORD)fo->clients.size();
+}
+
+static void Accept(NurExtFanout *fo)
+{
+	for (;;)
+	{
+		int fd = accept4(fo->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+
+		if ((int)fo->clients.size() >= fo->maxClients)
+		{
+			close(fd);
+			std::lock_guard<std::mutex> guard(fo->lock);
+			fo->rejected++;
+			continue;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		if (fo->sendBuffer > 0)
+			setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &fo->sendBuffer, sizeof(fo->sendBuffer));
+
+		NurExtFanoutClient &client = fo->clients[fd];
+		struct NUR_EXT_FANOUT_HELLO hello = { NUR_EXT_FANOUT_MAGIC, NUR_EXT_FANOUT_VERSION, sizeof(struct NUR_EXT_BUS_TAG), 0 };
+		{
+			std::lock_guard<std::mutex> guard(fo->lock);
+			hello.capacity = (DWORD)(fo->mask + 1);
+			client.pos = fo->head;
+			fo->accepted++;
+			fo->clientCount = (DWORD)fo->clients.size();
+		}
+		client.fd = fd;
+		client.out.assign((const BYTE *)&hello, (const BYTE *)(&hello + 1));
+		client.outPos = 0;
+		client.wantWrite = true;
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN | EPOLLOUT;
+		ev.data.u64 = (ULONGLONG)fd;
+		if (epoll_ctl(fo->epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		{
+			close(fd);
+			fo->clients.erase(fd);
+		}
+	}
+}
+
+/// <summary>
+/// Handles input of a client. Clients are read-only, anything sent is discarded.
+/// </summary>
+/// <returns>false if the client closed the connection.</returns>
+static bool Discard(int fd)
+{
+	char buf[256];
+
+	for (;;)
+	{
+		ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (n > 0)
+			continue;
+		return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+	}
+}
+
+static void FanoutThread(NurExtFanout *fo)
+{
+	struct epoll_event events[FANOUT_MAX_EVENTS];
+
+	while (!fo->stop)
+	{
+		int n = epoll_wait(fo->epollFd, events, FANOUT_MAX_EVENTS, -1);
+		if (n < 0 && errno != EINTR)
+			break;
+
+		for (int i = 0; i < n && !fo->stop; i++)
+		{
+			ULONGLONG id = events[i].data.u64;
+			if (id == FANOUT_WAKE_ID)
+			{
+				eventfd_t value;
+				eventfd_read(fo->wakeFd, &value);
+
+				// New tags: clients waiting on EPOLLOUT continue from there
+				std::vector<int> failed;
+				for (std::map<int, NurExtFanoutClient>::iterator it = fo->clients.begin(); it != fo->clients.end(); ++it)
+				{
+					if (!it->second.wantWrite && !Flush(fo, it->second))
+						failed.push_back(it->first);
+				}
+				for (size_t k = 0; k < failed.size(); k++)
+					CloseClient(fo, failed[k]);
+			}
+			else if (id == FANOUT_LISTEN_ID)
+			{
+				Accept(fo);
+			}
+			else
+			{
+				std::map<int, NurExtFanoutClient>::iterator it = fo->clients.find((int)id);
+				if (it == fo->clients.end())
+					continue;
+				bool ok = !(events[i].events & (EPOLLERR | EPOLLHUP));
+				if (ok && (events[i].events & EPOLLIN))
+					ok = Discard(it->first);
+				if (ok && (events[i].events & EPOLLOUT))
+					ok = Flush(fo, it->second);
+				if (!ok)
+					CloseClient(fo, it->first);
+			}
+		}
+	}
+}
+
+static void DestroyFanout(NurExtFanout *fo)
+{
+	if (fo->thread.joinable())
+	{
+		fo->stop = true;
+		eventfd_write(fo->wakeFd, 1);
+		fo->thread.join();
+	}
+	for (std::map<int, NurExtFanoutClient>::iterator it = fo->clients.begin(); it != fo->clients.end(); ++it)
+		close(it->first);
+	if (fo->listenFd >= 0)
+		close(fo->listenFd);
+	if (fo->epollFd >= 0)
+		close(fo->epollFd);
+	if (fo->wakeFd >= 0)
+		close(fo->wakeFd);
+	delete fo;
+}
+
+static int OpenListener(const char *bindAddress, int port, int *boundPort)
+{
+	struct sockaddr_in addr;
+	socklen_t addrLen = sizeof(addr);
+	int one = 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	if (inet_pton(AF_INET, bindAddress ? bindAddress : "127.0.0.1", &addr.sin_addr) != 1)
+		return -1;
+
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0
+		|| getsockname(fd, (struct sockaddr *)&addr, &addrLen) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	*boundPort = ntohs(addr.sin_port);
+	return fd;
+}
+
+void NurExtFanoutPublishTags(NurExtContext *ctx, const BYTE *tags, int count, DWORD szEntry, ULONGLONG rxTimeNs)
+{
+	NurExtFanout *fo = ctx->fanout;
+	if (!fo || count == 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(fo->lock);
+		for (int i = 0; i < count; i++)
+		{
+			struct NUR_EXT_BUS_TAG &t = fo->tags[(fo->head + i) & fo->mask];
+			t.seq = fo->head + i;
+			t.rxTimeNs = rxTimeNs;
+			memcpy(&t.tag, tags + i * szEntry, szEntry);
+			memset((BYTE *)&t.tag + szEntry, 0, sizeof(t.tag) - szEntry);
+		}
+		fo->head += count;
+	}
+	eventfd_write(fo->wakeFd, 1);
+}
+
+bool NurExtFanoutProduce(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(ctx->fanoutLock);
+	int count;
+
+	if (!ctx->fanout)
+		return false;
+
+	// The drain publishes; the tags are not needed here
+	do
+	{
+		count = (int)ctx->fanoutStaging.size();
+		if (NurExtDrainContext(ctx, ctx->fanoutStaging.data(), NULL, &count, sizeof(struct NUR_TAG_DATA_EX)) != NUR_NO_ERROR)
+			break;
+	} while (count == (int)ctx->fanoutStaging.size());
+	return true;
+}
+
+/// <summary>
+/// Installs a fan-out in place of the current one and returns the one replaced. Caller holds ctx->fanoutLock.
+/// </summary>
+static NurExtFanout *SwapFanout(NurExtContext *ctx, NurExtFanout *fo)
+{
+	std::lock_guard<std::mutex> drainGuard(ctx->drainLock);
+	NurExtFanout *previous = ctx->fanout;
+	ctx->fanout = fo;
+	return previous;
+}
+
+void NurExtFanoutForget(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(ctx->fanoutLock);
+	NurExtFanout *fo = SwapFanout(ctx, NULL);
+
+	if (fo)
+		DestroyFanout(fo);
+}
+
+void NURAPICONV NurExtFanoutDefaultConfig(struct NUR_EXT_FANOUT_CONFIG *cfg)
+{
+	if (!cfg)
+		return;
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->port = NUR_EXT_FANOUT_DEFAULT_PORT;
+	cfg->maxClients = 16;
+	cfg->capacity = 65536;
+	cfg->sendBuffer = 65536;
+}
+
+int NURAPICONV NurExtStartFanout(HANDLE hApi, const struct NUR_EXT_FANOUT_CONFIG *cfg)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	size_t size = 1;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!cfg || cfg->port < 0 || cfg->port > 65535 || cfg->maxClients <= 0
+		|| cfg->capacity <= 0 || cfg->capacity > FANOUT_MAX_CAPACITY || cfg->sendBuffer < 0)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	// Held from the old fan-out to the new one, so that concurrent starts replace each other in turn
+	std::unique_lock<std::mutex> guard(ctx->fanoutLock);
+	NurExtFanout *previous = SwapFanout(ctx.get(), NULL);
+
+	// Closed first, so that the new listener can take the same port
+	if (previous)
+		DestroyFanout(previous);
+
+	while ((int)size < cfg->capacity)
+		size <<= 1;
+
+	NurExtFanout *fo = new NurExtFanout();
+	fo->maxClients = cfg->maxClients;
+	fo->sendBuffer = cfg->sendBuffer;
+	fo->tags.resize(size);
+	fo->mask = size - 1;
+	fo->listenFd = OpenListener(cfg->bindAddress, cfg->port, &fo->port);
+	fo->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	fo->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fo->listenFd < 0 || fo->epollFd < 0 || fo->wakeFd < 0)
+	{
+		DestroyFanout(fo);
+		return NUR_ERROR_TRANSPORT;
+	}
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u64 = FANOUT_LISTEN_ID;
+	epoll_ctl(fo->epollFd, EPOLL_CTL_ADD, fo->listenFd, &ev);
+	ev.data.u64 = FANOUT_WAKE_ID;
+	epoll_ctl(fo->epollFd, EPOLL_CTL_ADD, fo->wakeFd, &ev);
+	fo->thread = std::thread(FanoutThread, fo);
+	SwapFanout(ctx.get(), fo);
+	guard.unlock();
+
+	return NurExtInstallDispatcher(ctx.get());
+}
+
+int NURAPICONV NurExtStopFanout(HANDLE hApi)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtFindContext(hApi);
+
+	if (ctx)
+		NurExtFanoutForget(ctx.get());
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetFanoutStats(HANDLE hApi, struct NUR_EXT_FANOUT_STATS *stats, DWORD szStats)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	struct NUR_EXT_FANOUT_STATS tmp;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!stats || szStats == 0 || szStats > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	memset(&tmp, 0, sizeof(tmp));
+	{
+		std::lock_guard<std::mutex> guard(ctx->fanoutLock);
+		NurExtFanout *fo = ctx->fanout;
+		if (!fo)
+			return NUR_ERROR_NOT_READY;
+
+		std::lock_guard<std::mutex> foGuard(fo->lock);
+		tmp.port = fo->port;
+		tmp.clients = fo->clientCount;
+		tmp.accepted = fo->accepted;
+		tmp.rejected = fo->rejected;
+		tmp.published = fo->head;
+		tmp.sent = fo->sent;
+		tmp.lost = fo->lost;
+	}
+	memcpy(stats, &tmp, szStats);
+	return NUR_NO_ERROR;
+}
+
+/// <summary>
+/// Client side connection.
+/// </summary>
+struct NurExtFanoutConn
+{
+	DWORD magic;
+	int fd;
+	std::vector<BYTE> buf;		// Received, not yet returned
+	bool closed;
+};
+
+static NurExtFanoutConn *GetConn(HANDLE hClient)
+{
+	NurExtFanoutConn *conn = (NurExtFanoutConn *)hClient;
+	if (conn == NULL || conn == INVALID_HANDLE_VALUE || conn->magic != FANOUT_CLIENT_MAGIC)
+		return NULL;
+	return conn;
+}
+
+/// <summary>
+/// Receives what is available into conn->buf, waiting up to timeoutMs for something.
+/// </summary>
+static void Receive(NurExtFanoutConn *conn, int timeoutMs)
+{
+	struct pollfd pfd = { conn->fd, POLLIN, 0 };
+	if (poll(&pfd, 1, timeoutMs) <= 0)
+		return;
+
+	size_t len = conn->buf.size();
+	conn->buf.resize(len + 64 * sizeof(struct NUR_EXT_BUS_TAG));
+	ssize_t n = recv(conn->fd, &conn->buf[len], conn->buf.size() - len, MSG_DONTWAIT);
+	conn->buf.resize(len + (n > 0 ? n : 0));
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		conn->closed = true;
+}
+
+HANDLE NURAPICONV NurExtFanoutConnect(const char *address, int port)
+{
+	struct addrinfo hints, *res = NULL;
+	char service[16];
+	int fd = -1;
+
+	if (!address || port <= 0 || port > 65535)
+		return NULL;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(service, sizeof(service), "%d", port);
+	if (getaddrinfo(address, service, &hints, &res) != 0)
+		return NULL;
+	for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next)
+	{
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) < 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		return NULL;
+
+	NurExtFanoutConn *conn = new NurExtFanoutConn();
+	conn->magic = FANOUT_CLIENT_MAGIC;
+	conn->fd = fd;
+	conn->closed = false;
+
+	ULONGLONG deadline = NurExtGetMonotonicNs() + FANOUT_CONNECT_TIMEOUT_MS * 1000000ULL;
+	while (conn->buf.size() < sizeof(struct NUR_EXT_FANOUT_HELLO) && !conn->closed)
+	{
+		ULONGLONG now = NurExtGetMonotonicNs();
+		if (now >= deadline)
+			break;
+		Receive(conn, (int)((deadline - now) / 1000000) + 1);
+	}
+
+	// Records are the server's structure as is
+	struct NUR_EXT_FANOUT_HELLO hello;
+	memset(&hello, 0, sizeof(hello));
+	if (conn->buf.size() >= sizeof(hello))
+		memcpy(&hello, conn->buf.data(), sizeof(hello));
+	if (hello.magic != NUR_EXT_FANOUT_MAGIC || hello.version != NUR_EXT_FANOUT_VERSION
+		|| hello.recordSize != sizeof(struct NUR_EXT_BUS_TAG))
+	{
+		NurExtFanoutClose((HANDLE)conn);
+		return NULL;
+	}
+	conn->buf.erase(conn->buf.begin(), conn->buf.begin() + sizeof(hello));
+	return (HANDLE)conn;
+}
+
+int NURAPICONV NurExtFanoutClose(HANDLE hClient)
+{
+	NurExtFanoutConn *conn = GetConn(hClient);
+
+	if (!conn)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	close(conn->fd);
+	conn->magic = 0;
+	delete conn;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtFanoutRead(HANDLE hClient, struct NUR_EXT_BUS_TAG *tagBuffer, int *tagCount, DWORD szSingleEntry, DWORD timeoutMs)
+{
+	NurExtFanoutConn *conn = GetConn(hClient);
+	BYTE *dst = (BYTE *)tagBuffer;
+
+	if (!conn)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!tagBuffer || !tagCount || *tagCount <= 0
+		|| szSingleEntry == 0 || szSingleEntry > sizeof(struct NUR_EXT_BUS_TAG))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	ULONGLONG deadline = NurExtGetMonotonicNs() + timeoutMs * 1000000ULL;
+	int capacity = *tagCount;
+	bool received = false;
+	*tagCount = 0;
+
+	for (;;)
+	{
+		int n = (int)std::min(conn->buf.size() / sizeof(struct NUR_EXT_BUS_TAG), (size_t)capacity);
+		if (n > 0)
+		{
+			for (int i = 0; i < n; i++)
+				memcpy(dst + i * szSingleEntry, &conn->buf[i * sizeof(struct NUR_EXT_BUS_TAG)], szSingleEntry);
+			conn->buf.erase(conn->buf.begin(), conn->buf.begin() + n * sizeof(struct NUR_EXT_BUS_TAG));
+			*tagCount = n;
+			return NUR_NO_ERROR;
+		}
+		if (conn->closed)
+			return NUR_ERROR_TR_NOT_CONNECTED;
+
+		// At least one receive, also with no timeout
+		ULONGLONG now = NurExtGetMonotonicNs();
+		int waitMs = (now < deadline) ? (int)((deadline - now + 999999) / 1000000) : 0;
+		if (waitMs == 0 && received)
+			return NUR_NO_ERROR;
+		Receive(conn, waitMs);
+		received = true;
+	}
+}
@@ -0,0 +1,160 @@
+/*
+ * NurExtFanout.h
+ *
+ *  TCP fan-out of the tag stream of one NurApi handle to many read-only clients.
+ */
+
+#ifndef _NUREXTFANOUT_H_
+#define _NUREXTFANOUT_H_ 1
+
+#include "NurAPI.h"
+#include "NurExtTagBus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Default TCP port of the fan-out server. */
+#define NUR_EXT_FANOUT_DEFAULT_PORT		4340
+/** NUR_EXT_FANOUT_HELLO.magic */
+#define NUR_EXT_FANOUT_MAGIC			0x54554f46
+/** NUR_EXT_FANOUT_HELLO.version */
+#define NUR_EXT_FANOUT_VERSION			1
+
+/**
+ * Fan-out server configuration.
+ * @sa NurExtStartFanout()
+ */
+struct NUR_EXT_FANOUT_CONFIG
+{
+	int port;					/**< TCP port to listen on. 0 = any free port, see NUR_EXT_FANOUT_STATS.port. */
+	const char *bindAddress;	/**< IPv4 address to listen on. NULL = 127.0.0.1. */
+	int maxClients;				/**< Maximum number of connected clients. Further connections are closed at once. */
+	int capacity;				/**< Tags kept for the clients, rounded up to power of two. A client further behind loses the oldest. */
+	int sendBuffer;				/**< Socket send buffer of each client in bytes, bounds the tags queued outside the ring. 0 = system default. */
+};
+
+/**
+ * Sent by the server when a client connects, followed by the tags as NUR_EXT_BUS_TAG records of <i>recordSize</i> bytes
+ * in the server's byte order. A gap in NUR_EXT_BUS_TAG.seq means the client was too slow and tags were skipped.
+ */
+struct NUR_EXT_FANOUT_HELLO
+{
+	DWORD magic;				/**< NUR_EXT_FANOUT_MAGIC */
+	DWORD version;				/**< NUR_EXT_FANOUT_VERSION */
+	DWORD recordSize;			/**< sizeof(struct NUR_EXT_BUS_TAG) of the server. */
+	DWORD capacity;				/**< Server capacity in tags. */
+};
+
+/**
+ * Fan-out server counters.
+ * @sa NurExtGetFanoutStats()
+ */
+struct NUR_EXT_FANOUT_STATS
+{
+	int port;					/**< Port listened on. */
+	DWORD clients;				/**< Connected clients. */
+	ULONGLONG accepted;			/**< Clients connected since started. */
+	ULONGLONG rejected;			/**< Connections closed because maxClients was reached. */
+	ULONGLONG published;		/**< Tags given to the server. */
+	ULONGLONG sent;				/**< Tags sent, summed over clients. */
+	ULONGLONG lost;				/**< Tags skipped for slow clients, summed over clients. */
+};
+
+/** @fn void NurExtFanoutDefaultConfig(struct NUR_EXT_FANOUT_CONFIG *cfg)
+ *
+ * Fill the configuration with defaults: 127.0.0.1:NUR_EXT_FANOUT_DEFAULT_PORT, 16 clients, 65536 tags, 64 kB send buffers.
+ *
+ * @param	cfg		Pointer to the NUR_EXT_FANOUT_CONFIG structure.
+ */
+void NURAPICONV NurExtFanoutDefaultConfig(struct NUR_EXT_FANOUT_CONFIG *cfg);
+
+/** @fn int NurExtStartFanout(HANDLE hApi, const struct NUR_EXT_FANOUT_CONFIG *cfg)
+ *
+ * Serve the tag stream of the handle to read-only TCP clients. The application owning the handle keeps control
+ * of the module; clients only receive. Every tag drained from the tag storage is sent to all clients, drained the
+ * same way as for NurExtTagBusPublish().
+ *
+ * Tags are kept once in a ring shared by the clients, each client sending from its own position on a server thread
+ * with non-blocking sockets. A slow client never delays the notification thread or the other clients: when it falls
+ * more than <i>capacity</i> tags behind, it skips to the oldest tag kept.
+ *
+ * Use NurExtSetNotificationCallback() instead of NurApiSetNotificationCallback() while serving.
+ *
+ * @sa NurExtStopFanout(), NurExtFanoutConnect(), NUR_EXT_FANOUT_HELLO
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	cfg		Server configuration.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_TRANSPORT if the port could not be opened. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStartFanout(HANDLE hApi, const struct NUR_EXT_FANOUT_CONFIG *cfg);
+
+/** @fn int NurExtStopFanout(HANDLE hApi)
+ *
+ * Stop the fan-out server and disconnect its clients. Also done by NurExtFree().
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStopFanout(HANDLE hApi);
+
+/** @fn int NurExtGetFanoutStats(HANDLE hApi, struct NUR_EXT_FANOUT_STATS *stats, DWORD szStats)
+ *
+ * Get fan-out server counters.
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	stats	Pointer to the NUR_EXT_FANOUT_STATS structure.
+ * @param	szStats	sizeof(struct NUR_EXT_FANOUT_STATS)
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the server is not running. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetFanoutStats(HANDLE hApi, struct NUR_EXT_FANOUT_STATS *stats, DWORD szStats);
+
+/** @fn HANDLE NurExtFanoutConnect(const char *address, int port)
+ *
+ * Connect to a fan-out server as a client.
+ *
+ * @param	address		Host name or address of the server.
+ * @param	port		Server port.
+ *
+ * @return	Client handle, or NULL if the connection failed or the server is not compatible.
+ */
+HANDLE NURAPICONV NurExtFanoutConnect(const char *address, int port);
+
+/** @fn int NurExtFanoutClose(HANDLE hClient)
+ *
+ * Disconnect and free the client handle.
+ *
+ * @param	hClient		Client handle.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtFanoutClose(HANDLE hClient);
+
+/** @fn int NurExtFanoutRead(HANDLE hClient, struct NUR_EXT_BUS_TAG *tagBuffer, int *tagCount, DWORD szSingleEntry, DWORD timeoutMs)
+ *
+ * Read tags received from the server. Waits up to <i>timeoutMs</i> for at least one tag.
+ *
+ * @param	hClient			Client handle.
+ * @param	tagBuffer		Pointer to NUR_EXT_BUS_TAG structures. Must contain at least <i>tagCount</i> entries.
+ * @param	tagCount		Number of entries in <i>tagBuffer</i>. On return number of valid entries is received in this pointer, 0 on timeout.
+ * @param	szSingleEntry	Size of one NUR_EXT_BUS_TAG entry.
+ * @param	timeoutMs		Time to wait in milliseconds, 0 = do not wait.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_TR_NOT_CONNECTED if the server closed the connection. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtFanoutRead(HANDLE hClient, struct NUR_EXT_BUS_TAG *tagBuffer, int *tagCount, DWORD szSingleEntry, DWORD timeoutMs);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
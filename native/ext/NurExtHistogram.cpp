@@ -0,0 +1,89 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <algorithm>
+
+static int BucketIndex(DWORD us)
+{
+	int i = 0;
+	while (us != 0 && i < NUR_EXT_HIST_BUCKETS - 1)
+	{
+		us >>= 1;
+		i++;
+	}
+	return i;
+}
+
+DWORD NurExtElapsedUs(std::chrono::steady_clock::time_point since)
+{
+	long long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+	if (us < 0)
+		return 0;
+	return (us > 0xFFFFFFFFLL) ? 0xFFFFFFFF : (DWORD)us;
+}
+
+void NurExtHistogram::Add(DWORD us)
+{
+	count.fetch_add(1, std::memory_order_relaxed);
+	sumUs.fetch_add(us, std::memory_order_relaxed);
+	bucket[BucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+
+	DWORD cur = minUs.load(std::memory_order_relaxed);
+	while (us < cur && !minUs.compare_exchange_weak(cur, us, std::memory_order_relaxed))
+		;
+	cur = maxUs.load(std::memory_order_relaxed);
+	while (us > cur && !maxUs.compare_exchange_weak(cur, us, std::memory_order_relaxed))
+		;
+}
+
+void NurExtHistogram::Read(struct NUR_EXT_HISTOGRAM *hist) const
+{
+	hist->count = count.load(std::memory_order_relaxed);
+	hist->sumUs = sumUs.load(std::memory_order_relaxed);
+	hist->minUs = minUs.load(std::memory_order_relaxed);
+	hist->maxUs = maxUs.load(std::memory_order_relaxed);
+	if (hist->count == 0)
+		hist->minUs = 0;
+	for (int i = 0; i < NUR_EXT_HIST_BUCKETS; i++)
+		hist->bucket[i] = bucket[i].load(std::memory_order_relaxed);
+}
+
+void NurExtHistogram::Reset()
+{
+	count.store(0, std::memory_order_relaxed);
+	sumUs.store(0, std::memory_order_relaxed);
+	minUs.store(0xFFFFFFFF, std::memory_order_relaxed);
+	maxUs.store(0, std::memory_order_relaxed);
+	for (int i = 0; i < NUR_EXT_HIST_BUCKETS; i++)
+		bucket[i].store(0, std::memory_order_relaxed);
+}
+
+void NURAPICONV NurExtHistogramAdd(struct NUR_EXT_HISTOGRAM *hist, DWORD us)
+{
+	if (hist->count == 0 || us < hist->minUs)
+		hist->minUs = us;
+	if (us > hist->maxUs)
+		hist->maxUs = us;
+	hist->count++;
+	hist->sumUs += us;
+	hist->bucket[BucketIndex(us)]++;
+}
+
+DWORD NURAPICONV NurExtHistogramPercentile(const struct NUR_EXT_HISTOGRAM *hist, double percentile)
+{
+	if (hist->count == 0)
+		return 0;
+
+	ULONGLONG rank = (ULONGLONG)(hist->count * percentile / 100.0);
+	ULONGLONG seen = 0;
+	for (int i = 0; i < NUR_EXT_HIST_BUCKETS; i++)
+	{
+		seen += hist->bucket[i];
+		if (seen > rank || seen == hist->count)
+		{
+			DWORD upper = (i == 0) ? 0 : (DWORD)((1ULL << i) - 1);
+			return std::min(std::max(upper, hist->minUs), hist->maxUs);
+		}
+	}
+	return hist->maxUs;
+}
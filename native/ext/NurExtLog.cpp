@@ -0,0 +1,368 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_MAX_CAPACITY		(1 << 24)
+#define LOG_FLUSH_INTERVAL_MS	50
+#define LOG_WRITE_BATCH			1024
+// Format characters per NUR_EXT_LOGEV_DEFINE record
+#define LOG_DEFINE_CHUNK		((NUR_EXT_LOG_MAX_ARGS - 1) * 8)
+
+/// <summary>
+/// Ring slot. seq == position + 1 when the record is ready for the writer, position + capacity when free.
+/// </summary>
+struct NurExtLogCell
+{
+	std::atomic<ULONGLONG> seq;
+	struct NUR_EXT_LOG_RECORD rec;
+};
+
+/// <summary>
+/// Open binary log: bounded multi producer / single consumer ring, drained to the file by the writer thread.
+/// </summary>
+struct NurExtBinLog
+{
+	std::unique_ptr<NurExtLogCell[]> cells;
+	size_t mask;
+	std::atomic<ULONGLONG> head;
+	std::atomic<ULONGLONG> tail;			// Written by the writer thread only
+	std::atomic<ULONGLONG> dropped;
+	std::atomic<DWORD> highWater;
+
+	FILE *fp;
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable cond;
+	bool stop;
+	size_t defsWritten;						// Entries of gLogDefs written to the file
+	ULONGLONG droppedReported;
+	ULONGLONG records;
+	ULONGLONG bytes;
+};
+
+static std::atomic<DWORD> gLogLevels(0);
+static std::atomic<NurExtBinLog*> gLog(NULL);
+static std::atomic<int> gLogUsers(0);		// Producers that may be using gLog
+static std::mutex gLogLock;					// Open, close, gLogDefs, stats
+static std::vector<std::pair<WORD, std::string> > gLogDefs;
+
+static ULONGLONG ClockNs(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (ULONGLONG)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static BYTE LevelBit(DWORD level)
+{
+	BYTE bit = 0;
+	while (level > 1)
+	{
+		level >>= 1;
+		bit++;
+	}
+	return bit;
+}
+
+static bool LogPush(NurExtBinLog *log, const struct NUR_EXT_LOG_RECORD &rec)
+{
+	ULONGLONG pos = log->head.load(std::memory_order_relaxed);
+	NurExtLogCell *cell;
+
+	for (;;)
+	{
+		cell = &log->cells[pos & log->mask];
+		long long diff = (long long)(cell->seq.load(std::memory_order_acquire) - pos);
+		if (diff == 0)
+		{
+			if (log->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			log->dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else
+		{
+			pos = log->head.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->rec = rec;
+	cell->seq.store(pos + 1, std::memory_order_release);
+
+	// Approximate, the writer may be draining at the same time
+	DWORD used = (DWORD)(pos + 1 - log->tail.load(std::memory_order_relaxed));
+	if (used > log->highWater.load(std::memory_order_relaxed))
+		log->highWater.store(used, std::memory_order_relaxed);
+	return true;
+}
+
+static bool LogPop(NurExtBinLog *log, struct NUR_EXT_LOG_RECORD *rec)
+{
+	ULONGLONG tail = log->tail.load(std::memory_order_relaxed);
+	NurExtLogCell *cell = &log->cells[tail & log->mask];
+	if (cell->seq.load(std::memory_order_acquire) != tail + 1)
+		return false;
+	*rec = cell->rec;
+	cell->seq.store(tail + log->mask + 1, std::memory_order_release);
+	log->tail.store(tail + 1, std::memory_order_relaxed);
+	return true;
+}
+
+static void LogWrite(NurExtBinLog *log, const struct NUR_EXT_LOG_RECORD *recs, size_t count)
+{
+	if (count == 0)
+		return;
+	size_t n = fwrite(recs, sizeof(struct NUR_EXT_LOG_RECORD), count, log->fp);
+	std::lock_guard<std::mutex> guard(gLogLock);
+	log->records += n;
+	log->bytes += n * sizeof(struct NUR_EXT_LOG_RECORD);
+}
+
+/// <summary>
+/// Writes the event definitions added since the last call. Caller holds gLogLock.
+/// </summary>
+static void LogWriteDefs(NurExtBinLog *log, std::vector<struct NUR_EXT_LOG_RECORD> &out)
+{
+	for (; log->defsWritten < gLogDefs.size(); log->defsWritten++)
+	{
+		const std::pair<WORD, std::string> &def = gLogDefs[log->defsWritten];
+		size_t len = def.second.size() + 1;
+
+		for (size_t pos = 0, chunk = 0; pos < len; pos += LOG_DEFINE_CHUNK, chunk++)
+		{
+			struct NUR_EXT_LOG_RECORD rec;
+			memset(&rec, 0, sizeof(rec));
+			rec.timestampNs = ClockNs(CLOCK_MONOTONIC);
+			rec.eventId = NUR_EXT_LOGEV_DEFINE;
+			rec.argCount = NUR_EXT_LOG_MAX_ARGS;
+			rec.args[0] = def.first | (chunk << 16);
+			memcpy(&rec.args[1], def.second.c_str() + pos, std::min((size_t)LOG_DEFINE_CHUNK, len - pos));
+			out.push_back(rec);
+		}
+	}
+}
+
+/// <summary>
+/// Drains the ring to the file every LOG_FLUSH_INTERVAL_MS, and once more when stopping.
+/// </summary>
+static void LogThread(NurExtBinLog *log)
+{
+	std::vector<struct NUR_EXT_LOG_RECORD> batch;
+	bool stop = false;
+
+	while (!stop)
+	{
+		{
+			std::unique_lock<std::mutex> lock(log->lock);
+			log->cond.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS), [log] { return log->stop; });
+			stop = log->stop;
+		}
+
+		batch.clear();
+		{
+			std::lock_guard<std::mutex> guard(gLogLock);
+			LogWriteDefs(log, batch);
+		}
+		LogWrite(log, batch.data(), batch.size());
+
+		// Gaps are marked where they are noticed
+		ULONGLONG dropped = log->dropped.load(std::memory_order_relaxed);
+		if (dropped != log->droppedReported)
+		{
+			struct NUR_EXT_LOG_RECORD rec;
+			memset(&rec, 0, sizeof(rec));
+			rec.timestampNs = ClockNs(CLOCK_MONOTONIC);
+			rec.eventId = NUR_EXT_LOGEV_LOST;
+			rec.level = LevelBit(NUR_LOG_ERROR);
+			rec.argCount = 1;
+			rec.args[0] = dropped - log->droppedReported;
+			log->droppedReported = dropped;
+			LogWrite(log, &rec, 1);
+		}
+
+		batch.resize(LOG_WRITE_BATCH);
+		size_t n;
+		do
+		{
+			for (n = 0; n < batch.size() && LogPop(log, &batch[n]); n++)
+				;
+			LogWrite(log, batch.data(), n);
+		} while (n == batch.size());
+		fflush(log->fp);
+	}
+}
+
+/// <summary>
+/// Adds the formats of the built-in events. Caller holds gLogLock.
+/// </summary>
+static void DefineBuiltinEvents()
+{
+	static const char *formats[NUR_EXT_LOGEV_LAST] = {
+		"",
+		"%u records lost",
+		"notification type %u len %d status %u",
+		"tag ant %u rssi %d epc %E",
+		"notification type %u dropped, %u queued",
+		"request %u error %d wait %u us exec %u us",
+		"diag report uptime %u ms inventoried %u read errors %u rf active %u ms",
+	};
+
+	for (int id = NUR_EXT_LOGEV_LOST; id < NUR_EXT_LOGEV_LAST; id++)
+	{
+		bool found = false;
+		for (size_t i = 0; i < gLogDefs.size() && !found; i++)
+			found = (gLogDefs[i].first == id);
+		if (!found)
+			gLogDefs.push_back(std::make_pair((WORD)id, std::string(formats[id])));
+	}
+}
+
+bool NurExtLogEnabled(DWORD level)
+{
+	return (gLogLevels.load(std::memory_order_relaxed) & level) != 0;
+}
+
+int NURAPICONV NurExtLogOpen(const char *file, DWORD levels, DWORD capacity)
+{
+	size_t size = 1;
+
+	if (!file || capacity > LOG_MAX_CAPACITY)
+		return NUR_ERROR_INVALID_PARAMETER;
+	if (capacity == 0)
+		capacity = NUR_EXT_LOG_DEFAULT_CAPACITY;
+	while (size < capacity)
+		size <<= 1;
+
+	std::lock_guard<std::mutex> guard(gLogLock);
+	if (gLog.load())
+		return NUR_ERROR_NOT_READY;
+
+	FILE *fp = fopen(file, "wb");
+	if (!fp)
+		return NUR_ERROR_FILE_NOT_FOUND;
+
+	struct NUR_EXT_LOG_HEADER hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, NUR_EXT_LOG_MAGIC, sizeof(hdr.magic));
+	hdr.recordSize = sizeof(struct NUR_EXT_LOG_RECORD);
+	hdr.realtimeNs = ClockNs(CLOCK_REALTIME);
+	hdr.monotonicNs = ClockNs(CLOCK_MONOTONIC);
+	if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+	{
+		fclose(fp);
+		return NUR_ERROR_FILE_INVALID;
+	}
+
+	NurExtBinLog *log = new NurExtBinLog();
+	log->cells.reset(new NurExtLogCell[size]);
+	for (size_t i = 0; i < size; i++)
+		log->cells[i].seq.store(i, std::memory_order_relaxed);
+	log->mask = size - 1;
+	log->head = 0;
+	log->tail = 0;
+	log->dropped = 0;
+	log->highWater = 0;
+	log->fp = fp;
+	log->stop = false;
+	log->defsWritten = 0;
+	log->droppedReported = 0;
+	log->records = 0;
+	log->bytes = sizeof(hdr);
+
+	DefineBuiltinEvents();
+	log->thread = std::thread(LogThread, log);
+	gLog.store(log);
+	gLogLevels.store(levels);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtLogClose()
+{
+	std::unique_lock<std::mutex> lock(gLogLock);
+	NurExtBinLog *log = gLog.exchange(NULL);
+	if (!log)
+		return NUR_ERROR_NOT_READY;
+	gLogLevels.store(0);
+	lock.unlock();
+
+	// Producers that saw the log finish their push before it goes
+	while (gLogUsers.load() != 0)
+		std::this_thread::yield();
+
+	{
+		std::lock_guard<std::mutex> guard(log->lock);
+		log->stop = true;
+		log->cond.notify_all();
+	}
+	log->thread.join();
+	int error = (fclose(log->fp) == 0) ? NUR_NO_ERROR : NUR_ERROR_FILE_INVALID;
+	delete log;
+	return error;
+}
+
+int NURAPICONV NurExtLogSetLevels(DWORD levels)
+{
+	std::lock_guard<std::mutex> guard(gLogLock);
+	if (!gLog.load())
+		return NUR_ERROR_NOT_READY;
+	gLogLevels.store(levels);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtLogDefineEvent(WORD eventId, const char *format)
+{
+	if (eventId < NUR_EXT_LOG_USER_EVENT || !format)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> guard(gLogLock);
+	gLogDefs.push_back(std::make_pair(eventId, std::string(format)));
+	return NUR_NO_ERROR;
+}
+
+void NURAPICONV NurExtLogEvent(HANDLE hApi, DWORD level, WORD eventId, const ULONGLONG *args, int argCount)
+{
+	if (!NurExtLogEnabled(level) || argCount < 0 || argCount > NUR_EXT_LOG_MAX_ARGS || (argCount > 0 && !args))
+		return;
+
+	struct NUR_EXT_LOG_RECORD rec;
+	rec.timestampNs = ClockNs(CLOCK_MONOTONIC);
+	rec.handle = (DWORD)(size_t)hApi;
+	rec.eventId = eventId;
+	rec.level = LevelBit(level);
+	rec.argCount = (BYTE)argCount;
+	memcpy(rec.args, args, argCount * sizeof(ULONGLONG));
+	memset(rec.args + argCount, 0, (NUR_EXT_LOG_MAX_ARGS - argCount) * sizeof(ULONGLONG));
+
+	gLogUsers.fetch_add(1);
+	NurExtBinLog *log = gLog.load();
+	if (log)
+		LogPush(log, rec);
+	gLogUsers.fetch_sub(1);
+}
+
+int NURAPICONV NurExtLogGetStats(struct NUR_EXT_LOG_STATS *stats, DWORD szStats)
+{
+	struct NUR_EXT_LOG_STATS tmp;
+
+	if (!stats || szStats == 0 || szStats > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> guard(gLogLock);
+	NurExtBinLog *log = gLog.load();
+	if (!log)
+		return NUR_ERROR_NOT_READY;
+
+	tmp.records = log->records;
+	tmp.bytes = log->bytes;
+	tmp.dropped = log->dropped.load(std::memory_order_relaxed);
+	tmp.capacity = (DWORD)(log->mask + 1);
+	tmp.highWater = log->highWater.load(std::memory_order_relaxed);
+	memcpy(stats, &tmp, szStats);
+	return NUR_NO_ERROR;
+}
@@ -0,0 +1,170 @@
+/*
+ * NurExtLog.h
+ *
+ *  Binary event log: fixed size records formatted only when the log file is decoded.
+ */
+
+#ifndef _NUREXTLOG_H_
+#define _NUREXTLOG_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Maximum number of arguments of a log record. */
+#define NUR_EXT_LOG_MAX_ARGS		6
+
+/** Default ring capacity in records. */
+#define NUR_EXT_LOG_DEFAULT_CAPACITY	65536
+
+/** First event id available to the application. Smaller ids are used by the extensions. */
+#define NUR_EXT_LOG_USER_EVENT		0x100
+
+/** Log file magic, first 8 bytes of the file. */
+#define NUR_EXT_LOG_MAGIC			"NURBLOG1"
+
+/**
+ * Events logged by the extensions.
+ * @sa NurExtLogOpen()
+ */
+enum NUR_EXT_LOGEV
+{
+	NUR_EXT_LOGEV_DEFINE = 0,		/**< File only: event format definition. */
+	NUR_EXT_LOGEV_LOST,				/**< Records dropped because the ring was full. NUR_LOG_ERROR. */
+	NUR_EXT_LOGEV_NOTIFICATION,		/**< NurApi notification received. NUR_LOG_VERBOSE. */
+	NUR_EXT_LOGEV_TAG,				/**< Tag drained from the tag storage. NUR_LOG_DATA. */
+	NUR_EXT_LOGEV_DISPATCH_DROP,	/**< Notification dropped by its dispatch route. NUR_LOG_ERROR. */
+	NUR_EXT_LOGEV_REQUEST,			/**< NurExtSubmit() request executed. NUR_LOG_VERBOSE. */
+	NUR_EXT_LOGEV_DIAG_REPORT,		/**< Diagnostics report received by the metrics exporter. NUR_LOG_VERBOSE. */
+	NUR_EXT_LOGEV_LAST
+};
+
+/**
+ * Log file header. Followed by NUR_EXT_LOG_RECORD entries.
+ */
+struct NUR_EXT_LOG_HEADER
+{
+	char magic[8];				/**< NUR_EXT_LOG_MAGIC, not null terminated. */
+	DWORD recordSize;			/**< sizeof(struct NUR_EXT_LOG_RECORD). */
+	DWORD reserved;
+	ULONGLONG realtimeNs;		/**< CLOCK_REALTIME when the log was opened. */
+	ULONGLONG monotonicNs;		/**< CLOCK_MONOTONIC when the log was opened. */
+};
+
+/**
+ * Log record, 64 bytes.
+ *
+ * NUR_EXT_LOGEV_DEFINE records carry the format of an event: args[0] is the event id in the low 16 bits and the
+ * chunk index in bits 16 - 31, args[1] - args[5] hold 40 characters of the format, the last chunk is null terminated.
+ */
+struct NUR_EXT_LOG_RECORD
+{
+	ULONGLONG timestampNs;		/**< CLOCK_MONOTONIC. */
+	DWORD handle;				/**< Low 32 bits of the NurApi handle, 0 if none. */
+	WORD eventId;				/**< enum NUR_EXT_LOGEV or application event id. */
+	BYTE level;					/**< Bit number of the NUR_LOG_* level. */
+	BYTE argCount;				/**< Number of valid args. */
+	ULONGLONG args[NUR_EXT_LOG_MAX_ARGS];
+};
+
+/**
+ * Binary log counters.
+ * @sa NurExtLogGetStats()
+ */
+struct NUR_EXT_LOG_STATS
+{
+	ULONGLONG records;			/**< Records written to the file. */
+	ULONGLONG dropped;			/**< Records dropped because the ring was full. */
+	ULONGLONG bytes;			/**< Bytes written to the file. */
+	DWORD capacity;				/**< Ring capacity in records. */
+	DWORD highWater;			/**< Highest number of records waiting in the ring. */
+};
+
+/** @fn int NurExtLogOpen(const char *file, DWORD levels, DWORD capacity)
+ *
+ * Open the process wide binary log. Records are queued to a lock-free ring without formatting and written to
+ * the file by a background thread. Logging never blocks: when the ring is full records are dropped, counted,
+ * and a NUR_EXT_LOGEV_LOST record is written.
+ *
+ * The extensions log the events of enum NUR_EXT_LOGEV. With NUR_LOG_DATA every drained tag is logged,
+ * which is cheap enough to keep on in production, unlike NurApiSetLogLevel(NUR_LOG_DATA).
+ * Decode the file with the NurLogDecode example.
+ *
+ * @sa NurExtLogClose(), NurExtLogEvent(), NurExtLogDefineEvent()
+ *
+ * @param	file		Log file, truncated.
+ * @param	levels		One or more of enum NUR_LOG.
+ * @param	capacity	Ring capacity in records, rounded up to power of two. 0 = NUR_EXT_LOG_DEFAULT_CAPACITY.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtLogOpen(const char *file, DWORD levels, DWORD capacity);
+
+/** @fn int NurExtLogClose()
+ *
+ * Write the records in the ring and close the binary log.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtLogClose();
+
+/** @fn int NurExtLogSetLevels(DWORD levels)
+ *
+ * Change the levels of the open binary log.
+ *
+ * @param	levels		One or more of enum NUR_LOG.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtLogSetLevels(DWORD levels);
+
+/** @fn int NurExtLogDefineEvent(WORD eventId, const char *format)
+ *
+ * Define the format of an application event. The format is stored in the log file and applied by the decoder.
+ * Each conversion takes one argument: %d %i %u %x %X %c, and %E which takes a byte count followed by the bytes,
+ * 8 per argument, printed as hex.
+ *
+ * @param	eventId		Event id, NUR_EXT_LOG_USER_EVENT or greater.
+ * @param	format		printf like format.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtLogDefineEvent(WORD eventId, const char *format);
+
+/** @fn void NurExtLogEvent(HANDLE hApi, DWORD level, WORD eventId, const ULONGLONG *args, int argCount)
+ *
+ * Log an event. Does nothing if the log is not open or the level is not enabled. Safe to call from any thread,
+ * also from the notification function.
+ *
+ * @param	hApi		NurApi handle the event relates to, or NULL.
+ * @param	level		One of enum NUR_LOG.
+ * @param	eventId		Event id.
+ * @param	args		Arguments, may be NULL if argCount is 0.
+ * @param	argCount	Number of arguments, at most NUR_EXT_LOG_MAX_ARGS.
+ */
+void NURAPICONV NurExtLogEvent(HANDLE hApi, DWORD level, WORD eventId, const ULONGLONG *args, int argCount);
+
+/** @fn int NurExtLogGetStats(struct NUR_EXT_LOG_STATS *stats, DWORD szStats)
+ *
+ * Get binary log counters.
+ *
+ * @param	stats	Pointer to the NUR_EXT_LOG_STATS structure.
+ * @param	szStats	sizeof(struct NUR_EXT_LOG_STATS)
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the log is not open. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtLogGetStats(struct NUR_EXT_LOG_STATS *stats, DWORD szStats);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
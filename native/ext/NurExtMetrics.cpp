@@ -0,0 +1,817 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <set>
+
+#define METRICS_CONTENT_TYPE	"application/openmetrics-text; version=1.0.0; charset=utf-8"
+#define METRICS_MAX_REQUEST		2048
+#define METRICS_IO_TIMEOUT_MS	1000
+// Histogram buckets exported as le bounds: every other log2 bucket from 15us to 16.8s
+#define METRICS_FIRST_LE_BUCKET	4
+#define METRICS_LAST_LE_BUCKET	24
+
+// Label values of enum NUR_NOTIFICATION
+static const char *gNotificationNames[] = {
+	"none", "log", "periodic_inventory", "prgprogress", "trdisconnected", "moduleboot", "trconnected",
+	"tracetag", "iochange", "triggerread", "hopevent", "inventorystream", "inventoryex", "devsearch",
+	"clientconnected", "clientdisconnected", "easalarm", "epcenum", "extin", "general", "tuneevent",
+	"wlan_search", "tt_stream", "tt_changed", "tt_scanevent", "diag_report", "accessory"
+};
+static_assert(sizeof(gNotificationNames) / sizeof(gNotificationNames[0]) == NUR_NOTIFICATION_LAST, "Notification names");
+
+struct DiagCounter
+{
+	const char *name;
+	const char *help;
+	size_t offset;
+};
+
+// NUR_DIAG_REPORT counters exported as name_total
+static const DiagCounter gDiagCounters[] = {
+	{ "nur_diag_bytes_in", "Bytes received by the module.", offsetof(struct NUR_DIAG_REPORT, bytesIn) },
+	{ "nur_diag_bytes_out", "Bytes sent by the module.", offsetof(struct NUR_DIAG_REPORT, bytesOut) },
+	{ "nur_diag_bytes_ignored", "Invalid bytes ignored by the module.", offsetof(struct NUR_DIAG_REPORT, bytesIgnored) },
+	{ "nur_diag_antenna_errors", "Bad antenna errors.", offsetof(struct NUR_DIAG_REPORT, antennaErrors) },
+	{ "nur_diag_hw_errors", "Automatically recovered internal HW failures.", offsetof(struct NUR_DIAG_REPORT, hwErrors) },
+	{ "nur_diag_inventoried_tags", "Successfully inventoried tags.", offsetof(struct NUR_DIAG_REPORT, invTags) },
+	{ "nur_diag_inventory_collisions", "Collisions during inventory.", offsetof(struct NUR_DIAG_REPORT, invColl) },
+	{ "nur_diag_read_tags", "Successful read tag commands.", offsetof(struct NUR_DIAG_REPORT, readTags) },
+	{ "nur_diag_read_errors", "Failed read tag commands.", offsetof(struct NUR_DIAG_REPORT, readErrors) },
+	{ "nur_diag_write_tags", "Successful write tag commands.", offsetof(struct NUR_DIAG_REPORT, writeTags) },
+	{ "nur_diag_write_errors", "Failed write tag commands.", offsetof(struct NUR_DIAG_REPORT, writeErrors) },
+	{ "nur_diag_error_conditions", "Temporary error conditions (over temperature, low voltage).", offsetof(struct NUR_DIAG_REPORT, errorConds) },
+	{ "nur_diag_setup_errors", "Invalid setup errors.", offsetof(struct NUR_DIAG_REPORT, setupErrs) },
+	{ "nur_diag_invalid_commands", "Invalid (not supported) commands received.", offsetof(struct NUR_DIAG_REPORT, invalidCmds) },
+};
+
+/// <summary>
+/// Metrics of one handle, copied so that every family is written from the same state.
+/// </summary>
+struct MetricsSnapshot
+{
+	std::string labels;			// reader="..."
+	bool hasReport;
+	struct NUR_DIAG_REPORT report;
+	bool enabled;
+	ULONGLONG reports;
+	ULONGLONG reportErrors;
+	bool ratesValid;
+	double invTagsRate;
+	double readErrorsRate;
+	double rfDuty;
+	struct NUR_EXT_DISPATCH_STATS dispatch[NUR_NOTIFICATION_LAST];
+	struct NUR_EXT_HISTOGRAM dispatchDelay[NUR_NOTIFICATION_LAST];
+	struct NUR_EXT_HISTOGRAM callback[NUR_NOTIFICATION_LAST];
+	struct NUR_EXT_HISTOGRAM requestWait;
+	struct NUR_EXT_HISTOGRAM requestExec;
+	bool hasRing;
+	struct NUR_EXT_TAGRING_STATS ring;
+};
+
+/// <summary>
+/// OpenMetrics text. Family metadata is written with the first sample, families without samples are left out.
+/// </summary>
+struct MetricsText
+{
+	std::string text;
+	std::string header;
+
+	void Family(const char *name, const char *type, const char *unit, const char *help)
+	{
+		header = std::string("# TYPE ") + name + " " + type + "\n";
+		if (unit)
+			header += std::string("# UNIT ") + name + " " + unit + "\n";
+		header += std::string("# HELP ") + name + " " + help + "\n";
+	}
+
+	void Sample(const std::string &name, const std::string &labels, const char *value)
+	{
+		text += header;
+		header.clear();
+		text += name + "{" + labels + "} " + value + "\n";
+	}
+
+	void Counter(const std::string &name, const std::string &labels, ULONGLONG value)
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%llu", (unsigned long long)value);
+		Sample(name, labels, buf);
+	}
+
+	void Gauge(const std::string &name, const std::string &labels, double value)
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%.9g", value);
+		Sample(name, labels, buf);
+	}
+
+	void Histogram(const std::string &name, const std::string &labels, const struct NUR_EXT_HISTOGRAM &hist)
+	{
+		// Count from the buckets, the relaxed counters may be momentarily apart
+		ULONGLONG cumulative = 0;
+		for (int i = 0; i < NUR_EXT_HIST_BUCKETS; i++)
+		{
+			cumulative += hist.bucket[i];
+			if (i < METRICS_FIRST_LE_BUCKET || i > METRICS_LAST_LE_BUCKET || (i - METRICS_FIRST_LE_BUCKET) % 2)
+				continue;
+			// Bucket i holds values up to 2^i - 1 us
+			char le[48];
+			snprintf(le, sizeof(le), ",le=\"%.6f\"", ((1UL << i) - 1) / 1e6);
+			Counter(name + "_bucket", labels + le, cumulative);
+		}
+		Counter(name + "_bucket", labels + ",le=\"+Inf\"", cumulative);
+		Counter(name + "_count", labels, cumulative);
+		Gauge(name + "_sum", labels, hist.sumUs / 1e6);
+	}
+};
+
+/// <summary>
+/// Exporter registration of one handle.
+/// </summary>
+struct MetricsEntry
+{
+	std::shared_ptr<NurExtContext> ctx;
+	int port;
+	std::string file;
+	DWORD interval;
+	bool poll;
+	bool restoreDiag;				// Module diagnostics config was changed, restore on stop
+	DWORD diagFlags;
+	DWORD diagInterval;
+	std::chrono::steady_clock::time_point nextDue;
+};
+
+// Entries and listeners change only under gMetricsLock while gMetricsThread is stopped,
+// so that the thread can use them without locking.
+static std::mutex gMetricsLock;
+static std::map<HANDLE, MetricsEntry> gMetricsEntries;
+static std::map<int, int> gMetricsListeners;	// Port -> listening socket
+static std::thread gMetricsThread;
+static std::atomic<bool> gMetricsStop(false);
+static int gMetricsWakeFd = -1;
+
+static std::string EscapeLabel(const std::string &value)
+{
+	std::string out;
+	for (size_t i = 0; i < value.size(); i++)
+	{
+		if (value[i] == '\\' || value[i] == '"')
+			out += '\\';
+		if (value[i] == '\n')
+			out += "\\n";
+		else
+			out += value[i];
+	}
+	return out;
+}
+
+static void TakeSnapshot(NurExtContext *ctx, MetricsSnapshot *s)
+{
+	std::string label;
+	{
+		std::lock_guard<std::mutex> guard(ctx->metricsLock);
+		label = ctx->metricsLabel;
+		s->enabled = ctx->metricsEnabled;
+		s->hasReport = ctx->metricsEnabled && ctx->metricsReports > 0;
+		s->report = ctx->metricsReport;
+		s->reports = ctx->metricsReports;
+		s->reportErrors = ctx->metricsReportErrors;
+		s->ratesValid = ctx->metricsRatesValid;
+		s->invTagsRate = ctx->metricsInvTagsRate;
+		s->readErrorsRate = ctx->metricsReadErrorsRate;
+		s->rfDuty = ctx->metricsRfDuty;
+	}
+	if (label.empty())
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%p", ctx->hApi);
+		label = buf;
+	}
+	s->labels = "reader=\"" + EscapeLabel(label) + "\"";
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->dispatchLock);
+		for (int type = 0; type < NUR_NOTIFICATION_LAST; type++)
+		{
+			s->dispatch[type] = ctx->dispatchQueues[type].stats;
+			s->dispatch[type].queued = (DWORD)ctx->dispatchQueues[type].queue.size();
+		}
+	}
+	for (int type = 0; type < NUR_NOTIFICATION_LAST; type++)
+	{
+		ctx->statDispatchDelay[type].Read(&s->dispatchDelay[type]);
+		ctx->statCallback[type].Read(&s->callback[type]);
+	}
+	ctx->statRequestWait.Read(&s->requestWait);
+	ctx->statRequestExec.Read(&s->requestExec);
+
+	std::lock_guard<std::mutex> guard(ctx->ringLock);
+	NurExtTagRing *ring = ctx->ring.get();
+	s->hasRing = (ring != NULL);
+	if (ring)
+	{
+		s->ring.popped = ring->tail.load(std::memory_order_acquire);
+		s->ring.pushed = ring->head.load(std::memory_order_acquire);
+		s->ring.capacity = (DWORD)ring->tags.size();
+		s->ring.count = (DWORD)(s->ring.pushed - s->ring.popped);
+		s->ring.highWater = ring->highWater.load(std::memory_order_relaxed);
+		s->ring.overflow = ring->overflow.load(std::memory_order_relaxed);
+	}
+}
+
+static std::string RenderMetrics(const std::vector<NurExtContext*> &ctxs)
+{
+	std::vector<MetricsSnapshot> snaps(ctxs.size());
+	MetricsText m;
+	size_t i;
+
+	for (i = 0; i < ctxs.size(); i++)
+		TakeSnapshot(ctxs[i], &snaps[i]);
+
+	m.Family("nur_diag_reports", "counter", NULL, "Diagnostics reports received from the module.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].enabled)
+			m.Counter("nur_diag_reports_total", snaps[i].labels, snaps[i].reports);
+	}
+	m.Family("nur_diag_report_errors", "counter", NULL, "Failed diagnostics report polls.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].enabled)
+			m.Counter("nur_diag_report_errors_total", snaps[i].labels, snaps[i].reportErrors);
+	}
+
+	m.Family("nur_diag_uptime_seconds", "gauge", "seconds", "Module uptime.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].hasReport)
+			m.Gauge("nur_diag_uptime_seconds", snaps[i].labels, snaps[i].report.uptime / 1000.0);
+	}
+	m.Family("nur_diag_rf_active_seconds", "counter", "seconds", "Module RF on time.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].hasReport)
+			m.Gauge("nur_diag_rf_active_seconds_total", snaps[i].labels, snaps[i].report.rfActiveTime / 1000.0);
+	}
+	m.Family("nur_diag_temperature_celsius", "gauge", "celsius", "Module temperature.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		// 1000 if not supported
+		if (snaps[i].hasReport && snaps[i].report.temperature != 1000)
+			m.Gauge("nur_diag_temperature_celsius", snaps[i].labels, snaps[i].report.temperature);
+	}
+	for (size_t c = 0; c < sizeof(gDiagCounters) / sizeof(gDiagCounters[0]); c++)
+	{
+		m.Family(gDiagCounters[c].name, "counter", NULL, gDiagCounters[c].help);
+		for (i = 0; i < snaps.size(); i++)
+		{
+			if (snaps[i].hasReport)
+			{
+				DWORD value;
+				memcpy(&value, (const BYTE *)&snaps[i].report + gDiagCounters[c].offset, sizeof(value));
+				m.Counter(std::string(gDiagCounters[c].name) + "_total", snaps[i].labels, value);
+			}
+		}
+	}
+
+	m.Family("nur_diag_inventoried_tags_per_second", "gauge", NULL, "Inventoried tags per second between the two latest reports.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].hasReport && snaps[i].ratesValid)
+			m.Gauge("nur_diag_inventoried_tags_per_second", snaps[i].labels, snaps[i].invTagsRate);
+	}
+	m.Family("nur_diag_read_errors_per_second", "gauge", NULL, "Failed read tag commands per second between the two latest reports.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].hasReport && snaps[i].ratesValid)
+			m.Gauge("nur_diag_read_errors_per_second", snaps[i].labels, snaps[i].readErrorsRate);
+	}
+	m.Family("nur_diag_rf_duty_ratio", "gauge", "ratio", "Share of time RF was on between the two latest reports.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].hasReport && snaps[i].ratesValid)
+			m.Gauge("nur_diag_rf_duty_ratio", snaps[i].labels, snaps[i].rfDuty);
+	}
+
+	// Host side: notification types that have been seen
+	static const struct { const char *name; const char *help; size_t offset; } dispatchCounters[] = {
+		{ "nur_ext_notifications_received", "Notifications received from NurApi.", offsetof(struct NUR_EXT_DISPATCH_STATS, received) },
+		{ "nur_ext_notifications_delivered", "Notifications passed to the application.", offsetof(struct NUR_EXT_DISPATCH_STATS, delivered) },
+		{ "nur_ext_notifications_dropped", "Notifications dropped by the dispatch route.", offsetof(struct NUR_EXT_DISPATCH_STATS, dropped) },
+		{ "nur_ext_notifications_coalesced", "Notifications replaced by a newer one.", offsetof(struct NUR_EXT_DISPATCH_STATS, coalesced) },
+	};
+	for (size_t c = 0; c < sizeof(dispatchCounters) / sizeof(dispatchCounters[0]); c++)
+	{
+		m.Family(dispatchCounters[c].name, "counter", NULL, dispatchCounters[c].help);
+		for (i = 0; i < snaps.size(); i++)
+		{
+			for (int type = 0; type < NUR_NOTIFICATION_LAST; type++)
+			{
+				if (snaps[i].dispatch[type].received == 0)
+					continue;
+				ULONGLONG value;
+				memcpy(&value, (const BYTE *)&snaps[i].dispatch[type] + dispatchCounters[c].offset, sizeof(value));
+				m.Counter(std::string(dispatchCounters[c].name) + "_total",
+					snaps[i].labels + ",type=\"" + gNotificationNames[type] + "\"", value);
+			}
+		}
+	}
+	m.Family("nur_ext_notifications_queued", "gauge", NULL, "Notifications queued for the dispatch workers.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		for (int type = 0; type < NUR_NOTIFICATION_LAST; type++)
+		{
+			if (snaps[i].dispatch[type].received > 0)
+				m.Gauge("nur_ext_notifications_queued", snaps[i].labels + ",type=\"" + gNotificationNames[type] + "\"", snaps[i].dispatch[type].queued);
+		}
+	}
+	m.Family("nur_ext_dispatch_delay_seconds", "histogram", "seconds", "Time from NurApi notification to application call.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		for (int type = 0; type < NUR_NOTIFICATION_LAST; type++)
+		{
+			if (snaps[i].dispatchDelay[type].count > 0)
+				m.Histogram("nur_ext_dispatch_delay_seconds", snaps[i].labels + ",type=\"" + gNotificationNames[type] + "\"", snaps[i].dispatchDelay[type]);
+		}
+	}
+	m.Family("nur_ext_callback_seconds", "histogram", "seconds", "Execution time of the application notification function.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		for (int type = 0; type < NUR_NOTIFICATION_LAST; type++)
+		{
+			if (snaps[i].callback[type].count > 0)
+				m.Histogram("nur_ext_callback_seconds", snaps[i].labels + ",type=\"" + gNotificationNames[type] + "\"", snaps[i].callback[type]);
+		}
+	}
+	m.Family("nur_ext_request_wait_seconds", "histogram", "seconds", "Time from NurExtSubmit() to start of the request.");
+	for (i = 0; i < snaps.size(); i++)
+		m.Histogram("nur_ext_request_wait_seconds", snaps[i].labels, snaps[i].requestWait);
+	m.Family("nur_ext_request_exec_seconds", "histogram", "seconds", "Execution time of NurExtSubmit() requests.");
+	for (i = 0; i < snaps.size(); i++)
+		m.Histogram("nur_ext_request_exec_seconds", snaps[i].labels, snaps[i].requestExec);
+
+	m.Family("nur_ext_tag_ring_tags", "gauge", NULL, "Tags in the tag ring.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].hasRing)
+			m.Gauge("nur_ext_tag_ring_tags", snaps[i].labels, snaps[i].ring.count);
+	}
+	m.Family("nur_ext_tag_ring_pushed", "counter", NULL, "Tags added to the tag ring.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].hasRing)
+			m.Counter("nur_ext_tag_ring_pushed_total", snaps[i].labels, snaps[i].ring.pushed);
+	}
+	m.Family("nur_ext_tag_ring_overflow", "counter", NULL, "Tags dropped because the tag ring was full.");
+	for (i = 0; i < snaps.size(); i++)
+	{
+		if (snaps[i].hasRing)
+			m.Counter("nur_ext_tag_ring_overflow_total", snaps[i].labels, snaps[i].ring.overflow);
+	}
+
+	m.text += "# EOF\n";
+	return m.text;
+}
+
+void NurExtMetricsReport(NurExtContext *ctx, const struct NUR_DIAG_REPORT *report)
+{
+	std::lock_guard<std::mutex> guard(ctx->metricsLock);
+	const struct NUR_DIAG_REPORT &prev = ctx->metricsReport;
+
+	if (!ctx->metricsEnabled)
+		return;
+
+	// Module reboot or statistics reset starts the rates over
+	DWORD elapsedMs = report->uptime - prev.uptime;
+	ctx->metricsRatesValid = (ctx->metricsReports > 0 && report->uptime > prev.uptime
+		&& report->invTags >= prev.invTags && report->readErrors >= prev.readErrors && report->rfActiveTime >= prev.rfActiveTime);
+	if (ctx->metricsRatesValid)
+	{
+		ctx->metricsInvTagsRate = (report->invTags - prev.invTags) * 1000.0 / elapsedMs;
+		ctx->metricsReadErrorsRate = (report->readErrors - prev.readErrors) * 1000.0 / elapsedMs;
+		ctx->metricsRfDuty = std::min(1.0, (double)(report->rfActiveTime - prev.rfActiveTime) / elapsedMs);
+	}
+
+	if (NurExtLogEnabled(NUR_LOG_VERBOSE))
+	{
+		ULONGLONG args[4] = { report->uptime, report->invTags, report->readErrors, report->rfActiveTime };
+		NurExtLogEvent(ctx->hApi, NUR_LOG_VERBOSE, NUR_EXT_LOGEV_DIAG_REPORT, args, 4);
+	}
+
+	ctx->metricsReport = *report;
+	ctx->metricsReports++;
+	ctx->metricsReportTime = std::chrono::steady_clock::now();
+}
+
+static int NURAPICALLBACK PollReport(HANDLE hApi, LPVOID arg)
+{
+	NurExtContext *ctx = (NurExtContext *)arg;
+	struct NUR_DIAG_REPORT report;
+
+	int error = NurApiDiagGetReport(hApi, NUR_DIAG_GETREPORT_NONE, &report, sizeof(report));
+	if (error == NUR_NO_ERROR)
+	{
+		NurExtMetricsReport(ctx, &report);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> guard(ctx->metricsLock);
+		ctx->metricsReportErrors++;
+	}
+	return error;
+}
+
+static void NURAPICALLBACK PollDone(HANDLE hApi, DWORD requestId, int error, LPVOID arg)
+{
+	NurExtContext *ctx = (NurExtContext *)arg;
+	ctx->metricsPollPending = false;
+}
+
+/// <summary>
+/// Submits a report poll if polling, or if periodic reports have not arrived for two intervals.
+/// </summary>
+static void PollIfNeeded(const MetricsEntry &e, std::chrono::steady_clock::time_point now)
+{
+	NurExtContext *ctx = e.ctx.get();
+	bool stale;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->metricsLock);
+		stale = (ctx->metricsReports == 0 || now - ctx->metricsReportTime > std::chrono::seconds(2 * e.interval));
+	}
+	if (!e.poll && !stale)
+		return;
+	if (ctx->metricsPollPending.exchange(true))
+		return;
+	if (NurExtSubmit(ctx->hApi, PollReport, PollDone, ctx, NULL) != NUR_NO_ERROR)
+		ctx->metricsPollPending = false;
+}
+
+/// <summary>
+/// Metrics of the handles exported to the port, or to the file if port is 0.
+/// </summary>
+static std::string RenderSink(int port, const std::string &file)
+{
+	std::vector<NurExtContext*> ctxs;
+	for (std::map<HANDLE, MetricsEntry>::iterator it = gMetricsEntries.begin(); it != gMetricsEntries.end(); ++it)
+	{
+		if ((port != 0 && it->second.port == port) || (port == 0 && it->second.file == file))
+			ctxs.push_back(it->second.ctx.get());
+	}
+	return RenderMetrics(ctxs);
+}
+
+static void WriteFileSink(const std::string &file)
+{
+	std::string text = RenderSink(0, file);
+	std::string tmp = file + ".tmp";
+
+	// Readers never see a partial file
+	FILE *fp = fopen(tmp.c_str(), "w");
+	if (!fp)
+		return;
+	bool ok = (fwrite(text.data(), 1, text.size(), fp) == text.size());
+	ok = (fclose(fp) == 0) && ok;
+	if (ok)
+		rename(tmp.c_str(), file.c_str());
+	else
+		unlink(tmp.c_str());
+}
+
+static bool SendAll(int fd, const char *buf, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			if (n < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+/// <summary>
+/// Serves one HTTP/1.x request of a scraper and closes the connection.
+/// </summary>
+static void ServeHttp(int listenFd, int port)
+{
+	int fd = accept(listenFd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	struct timeval tv = { METRICS_IO_TIMEOUT_MS / 1000, (METRICS_IO_TIMEOUT_MS % 1000) * 1000 };
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	char req[METRICS_MAX_REQUEST];
+	size_t len = 0;
+	req[0] = 0;
+	while (len < sizeof(req) - 1 && strstr(req, "\r\n\r\n") == NULL)
+	{
+		ssize_t n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+		if (n <= 0)
+			break;
+		len += n;
+		req[len] = 0;
+	}
+
+	bool head = (strncmp(req, "HEAD ", 5) == 0);
+	const char *path = head ? req + 5 : (strncmp(req, "GET ", 4) == 0 ? req + 4 : NULL);
+	size_t pathLen = path ? strcspn(path, " ?\r\n") : 0;
+	std::string status = "200 OK";
+	std::string type = METRICS_CONTENT_TYPE;
+	std::string body;
+
+	if (!path)
+	{
+		status = "405 Method Not Allowed";
+		type = "text/plain";
+		body = "Method not allowed\n";
+	}
+	else if (std::string(path, pathLen) != "/metrics" && std::string(path, pathLen) != "/")
+	{
+		status = "404 Not Found";
+		type = "text/plain";
+		body = "Not found\n";
+	}
+	else
+	{
+		body = RenderSink(port, std::string());
+	}
+
+	char header[256];
+	snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+		status.c_str(), type.c_str(), (unsigned)body.size());
+	if (SendAll(fd, header, strlen(header)) && !head)
+		SendAll(fd, body.data(), body.size());
+	close(fd);
+}
+
+static void MetricsThread()
+{
+	std::vector<struct pollfd> fds;
+	std::vector<int> ports;
+
+	for (std::map<int, int>::iterator it = gMetricsListeners.begin(); it != gMetricsListeners.end(); ++it)
+	{
+		struct pollfd pfd = { it->second, POLLIN, 0 };
+		fds.push_back(pfd);
+		ports.push_back(it->first);
+	}
+	struct pollfd wake = { gMetricsWakeFd, POLLIN, 0 };
+	fds.push_back(wake);
+
+	while (!gMetricsStop)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point next = now + std::chrono::seconds(1);
+		for (std::map<HANDLE, MetricsEntry>::iterator it = gMetricsEntries.begin(); it != gMetricsEntries.end(); ++it)
+			next = std::min(next, it->second.nextDue);
+
+		int timeoutMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+		int n = poll(fds.data(), fds.size(), std::max(0, timeoutMs));
+		if (n < 0 && errno != EINTR)
+			break;
+		if (gMetricsStop)
+			break;
+
+		for (size_t i = 0; n > 0 && i < ports.size(); i++)
+		{
+			if (fds[i].revents & POLLIN)
+				ServeHttp(fds[i].fd, ports[i]);
+		}
+
+		std::set<std::string> files;
+		now = std::chrono::steady_clock::now();
+		for (std::map<HANDLE, MetricsEntry>::iterator it = gMetricsEntries.begin(); it != gMetricsEntries.end(); ++it)
+		{
+			MetricsEntry &e = it->second;
+			if (now < e.nextDue)
+				continue;
+			e.nextDue = now + std::chrono::seconds(e.interval);
+			PollIfNeeded(e, now);
+			if (!e.file.empty())
+				files.insert(e.file);
+		}
+		for (std::set<std::string>::iterator it = files.begin(); it != files.end(); ++it)
+			WriteFileSink(*it);
+	}
+}
+
+/// <summary>
+/// Stops the exporter thread. Caller holds gMetricsLock.
+/// </summary>
+static void StopThread()
+{
+	if (!gMetricsThread.joinable())
+		return;
+	gMetricsStop = true;
+	eventfd_write(gMetricsWakeFd, 1);
+	gMetricsThread.join();
+	close(gMetricsWakeFd);
+	gMetricsWakeFd = -1;
+}
+
+/// <summary>
+/// Starts the exporter thread if any handle is registered. Caller holds gMetricsLock.
+/// </summary>
+static void StartThread()
+{
+	if (gMetricsEntries.empty())
+		return;
+	gMetricsWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	gMetricsStop = false;
+	gMetricsThread = std::thread(MetricsThread);
+}
+
+static int OpenListener(const char *bindAddress, int port)
+{
+	struct sockaddr_in addr;
+	int one = 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t)port);
+	if (inet_pton(AF_INET, bindAddress ? bindAddress : "127.0.0.1", &addr.sin_addr) != 1)
+		return -1;
+
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/// <summary>
+/// Closes listeners no handle uses. Caller holds gMetricsLock with the thread stopped.
+/// </summary>
+static void CloseUnusedListeners()
+{
+	std::map<int, int>::iterator it = gMetricsListeners.begin();
+	while (it != gMetricsListeners.end())
+	{
+		bool used = false;
+		for (std::map<HANDLE, MetricsEntry>::iterator e = gMetricsEntries.begin(); e != gMetricsEntries.end(); ++e)
+			used = used || (e->second.port == it->first);
+		if (used)
+		{
+			++it;
+			continue;
+		}
+		close(it->second);
+		gMetricsListeners.erase(it++);
+	}
+}
+
+void NURAPICONV NurExtMetricsDefaultConfig(struct NUR_EXT_METRICS_CONFIG *cfg)
+{
+	if (!cfg)
+		return;
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->port = NUR_EXT_METRICS_DEFAULT_PORT;
+	cfg->interval = 10;
+	cfg->poll = FALSE;
+}
+
+int NURAPICONV NurExtStartMetrics(HANDLE hApi, const struct NUR_EXT_METRICS_CONFIG *cfg)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!cfg || cfg->interval == 0 || cfg->port < 0 || cfg->port > 65535)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	NurExtStopMetrics(hApi);
+
+	MetricsEntry e;
+	e.ctx = ctx;
+	e.port = cfg->port;
+	e.file = cfg->file ? cfg->file : "";
+	e.interval = cfg->interval;
+	e.poll = (cfg->poll != FALSE);
+	e.restoreDiag = false;
+	e.diagFlags = 0;
+	e.diagInterval = 0;
+	e.nextDue = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->metricsLock);
+		ctx->metricsEnabled = true;
+		ctx->metricsLabel = cfg->reader ? cfg->reader : "";
+		ctx->metricsReports = 0;
+		ctx->metricsReportErrors = 0;
+		ctx->metricsRatesValid = false;
+		ctx->metricsReportTime = e.nextDue;
+	}
+
+	if (!e.poll)
+	{
+		// Modules without diagnostics support are polled, polls fail and are counted
+		int error = NurExtInstallDispatcher(ctx.get());
+		if (error == NUR_NO_ERROR)
+			error = NurApiDiagGetConfig(hApi, &e.diagFlags, &e.diagInterval);
+		if (error == NUR_NO_ERROR)
+			error = NurApiDiagSetConfig(hApi, e.diagFlags | NUR_DIAG_CFG_NOTIFY_PERIODIC, e.interval);
+		e.restoreDiag = (error == NUR_NO_ERROR);
+		e.poll = !e.restoreDiag;
+	}
+
+	int error = NUR_NO_ERROR;
+	{
+		std::lock_guard<std::mutex> guard(gMetricsLock);
+		StopThread();
+		if (e.port != 0 && gMetricsListeners.count(e.port) == 0)
+		{
+			int fd = OpenListener(cfg->bindAddress, e.port);
+			if (fd < 0)
+				error = NUR_ERROR_TR_NOT_CONNECTED;
+			else
+				gMetricsListeners[e.port] = fd;
+		}
+		if (error == NUR_NO_ERROR)
+			gMetricsEntries[hApi] = e;
+		StartThread();
+	}
+
+	if (error != NUR_NO_ERROR)
+	{
+		{
+			std::lock_guard<std::mutex> guard(ctx->metricsLock);
+			ctx->metricsEnabled = false;
+		}
+		if (e.restoreDiag)
+			NurApiDiagSetConfig(hApi, e.diagFlags, e.diagInterval);
+	}
+	return error;
+}
+
+int NURAPICONV NurExtStopMetrics(HANDLE hApi)
+{
+	MetricsEntry e;
+
+	if (hApi == NULL || hApi == INVALID_HANDLE_VALUE)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	{
+		std::lock_guard<std::mutex> guard(gMetricsLock);
+		std::map<HANDLE, MetricsEntry>::iterator it = gMetricsEntries.find(hApi);
+		if (it == gMetricsEntries.end())
+			return NUR_NO_ERROR;
+
+		StopThread();
+		e = it->second;
+		gMetricsEntries.erase(it);
+		CloseUnusedListeners();
+		StartThread();
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(e.ctx->metricsLock);
+		e.ctx->metricsEnabled = false;
+	}
+	if (e.restoreDiag)
+		NurApiDiagSetConfig(hApi, e.diagFlags, e.diagInterval);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetMetricsText(HANDLE hApi, char *buf, DWORD bufSize, DWORD *textLen)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!buf && bufSize > 0)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::vector<NurExtContext*> ctxs(1, ctx.get());
+	std::string text = RenderMetrics(ctxs);
+	if (textLen)
+		*textLen = (DWORD)text.size();
+	if (text.size() + 1 > bufSize)
+		return NUR_ERROR_BUFFER_TOO_SMALL;
+	memcpy(buf, text.c_str(), text.size() + 1);
+	return NUR_NO_ERROR;
+}
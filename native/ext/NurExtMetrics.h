@@ -0,0 +1,99 @@
+/*
+ * NurExtMetrics.h
+ *
+ *  OpenMetrics exporter of module diagnostics and host side statistics.
+ */
+
+#ifndef _NUREXTMETRICS_H_
+#define _NUREXTMETRICS_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Default HTTP port of the metrics endpoint. */
+#define NUR_EXT_METRICS_DEFAULT_PORT	9433
+
+/**
+ * Metrics exporter configuration.
+ * @sa NurExtStartMetrics()
+ */
+struct NUR_EXT_METRICS_CONFIG
+{
+	int port;					/**< HTTP port serving GET /metrics. 0 = no HTTP endpoint. Handles with the same port are served together. */
+	const char *bindAddress;	/**< IPv4 address to listen on. NULL = 127.0.0.1. The first handle started on a port decides. */
+	const char *file;			/**< File sink, rewritten atomically every interval. NULL = none. Handles with the same file are written together. */
+	DWORD interval;				/**< Diagnostics report interval in seconds. */
+	BOOL poll;					/**< TRUE to poll NurApiDiagGetReport(). FALSE to use NUR_DIAG_CFG_NOTIFY_PERIODIC reports, falls back to polling if the module does not send them. */
+	const char *reader;			/**< Value of the reader label. NULL = handle address. */
+};
+
+/** @fn void NurExtMetricsDefaultConfig(struct NUR_EXT_METRICS_CONFIG *cfg)
+ *
+ * Fill the configuration with defaults: HTTP on 127.0.0.1:NUR_EXT_METRICS_DEFAULT_PORT, no file,
+ * 10 second periodic report notifications.
+ *
+ * @param	cfg		Pointer to the NUR_EXT_METRICS_CONFIG structure.
+ */
+void NURAPICONV NurExtMetricsDefaultConfig(struct NUR_EXT_METRICS_CONFIG *cfg);
+
+/** @fn int NurExtStartMetrics(HANDLE hApi, const struct NUR_EXT_METRICS_CONFIG *cfg)
+ *
+ * Start exporting metrics of the handle in OpenMetrics text format:
+ * - NUR_DIAG_REPORT counters, and inventoried tags, read errors and RF duty rates computed from consecutive reports
+ * - Notification dispatch counters and NurExtGetHostStats() histograms
+ * - Tag ring counters if NurExtEnableTagRing() is used
+ *
+ * Without <i>poll</i> the module is configured with NurApiDiagSetConfig(NUR_DIAG_CFG_NOTIFY_PERIODIC) and
+ * reports arrive as NUR_DIAG_REPORT notifications; the previous module configuration is restored by NurExtStopMetrics().
+ * Polls are submitted with NurExtSubmit() and do not block the caller. Must be called with the transport connected
+ * to use notifications. Use NurExtSetNotificationCallback() instead of NurApiSetNotificationCallback() while started.
+ * Restarts the exporter of the handle if already started.
+ *
+ * @sa NurExtStopMetrics(), NurExtGetMetricsText()
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	cfg		Exporter configuration. Copied.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStartMetrics(HANDLE hApi, const struct NUR_EXT_METRICS_CONFIG *cfg);
+
+/** @fn int NurExtStopMetrics(HANDLE hApi)
+ *
+ * Stop exporting metrics of the handle. The HTTP endpoint is closed when no handle uses it.
+ * Called by NurExtFree().
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStopMetrics(HANDLE hApi);
+
+/** @fn int NurExtGetMetricsText(HANDLE hApi, char *buf, DWORD bufSize, DWORD *textLen)
+ *
+ * Get metrics of the handle in OpenMetrics text format, e.g. to be served by the application's own HTTP server.
+ * The text ends with "# EOF" and is null terminated. Diagnostics metrics are present only while the exporter is started.
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	buf		Buffer for the text.
+ * @param	bufSize	Size of <i>buf</i> in bytes.
+ * @param	textLen	Length of the text without the null terminator is received here, also when <i>buf</i> is too small. May be NULL.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_BUFFER_TOO_SMALL if the text does not fit. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetMetricsText(HANDLE hApi, char *buf, DWORD bufSize, DWORD *textLen);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+void NurExtProduceTags(NurExtContext *ctx, ULONGLONG rxTimeNs)
+{
+	ctx->tagRxNs.store(rxTimeNs, std::memory_order_relaxed);
+	// The tag bus and fan-out are fed by whichever of these drains the storage
+	if (!NurExtStreamGroupProduce(ctx, rxTimeNs) && !NurExtTagRingProduce(ctx)
+		&& !NurExtTagBusProduce(ctx))
+		NurExtFanoutProduce(ctx);
+}
+
+/// <summary>
+/// NurApi notification function of handles with extensions that need notifications.
+/// Extensions handle the notification first, then it is passed to the application.
+/// </summary>
+static void NURAPICALLBACK NurExtNotificationFunc(HANDLE hApi, DWORD timestamp, int type, LPVOID data, int dataLen)
+{
+	// As close to the frame arrival as the host can see it, before the context lookup
+	ULONGLONG rxTimeNs = NurExtGetMonotonicNs();
+	std::shared_ptr<NurExtContext> ctx = NurExtFindContext(hApi);
+	if (!ctx)
+		return;
+
+	if (NurExtLogEnabled(NUR_LOG_VERBOSE))
+	{
+		ULONGLONG args[3] = { (ULONGLONG)type, (ULONGLONG)dataLen, NurApiGetLastNotificationStatus(hApi) };
+		NurExtLogEvent(hApi, NUR_LOG_VERBOSE, NUR_EXT_LOGEV_NOTIFICATION, args, 3);
+	}
+
+	switch (type)
+	{
+	case NUR_NOTIFICATION_INVENTORYSTREAM:
+	case NUR_NOTIFICATION_INVENTORYEX:
+		NurExtProduceTags(ctx.get(), rxTimeNs);
+		break;
+
+	case NUR_NOTIFICATION_DIAG_REPORT:
+		if (data && dataLen >= (int)sizeof(struct NUR_DIAG_REPORT))
+			NurExtMetricsReport(ctx.get(), (const struct NUR_DIAG_REPORT *)data);
+		break;
+
+	default:
+		break;
+	}
+
+	NurExtDispatch(ctx.get(), timestamp, rxTimeNs, type, data, dataLen);
+}
+
+int NurExtInstallDispatcher(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(ctx->notifyLock);
+	int error = NUR_NO_ERROR;
+
+	if (!ctx->dispatcherInstalled)
+	{
+		error = NurApiSetNotificationCallback(ctx->hApi, NurExtNotificationFunc);
+		if (error == NUR_NO_ERROR)
+			ctx->dispatcherInstalled = true;
+	}
+	return error;
+}
+
+int NURAPICONV NurExtSetNotificationCallback(HANDLE hApi, NotificationCallback nFunc)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	ctx->appCallback.store(nFunc);
+	return NurExtInstallDispatcher(ctx.get());
+}
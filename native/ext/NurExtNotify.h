@@ -0,0 +1,43 @@
+/*
+ * NurExtNotify.h
+ *
+ *  Notification routing between NurApi, the extensions and the application.
+ */
+
+#ifndef _NUREXTNOTIFY_H_
+#define _NUREXTNOTIFY_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** @fn int NurExtSetNotificationCallback(HANDLE hApi, NotificationCallback nFunc)
+ *
+ * Set application notification receive function when extensions that need notifications are used
+ * (e.g. NurExtEnableTagRing()). NurApi has one notification function per handle; the extension
+ * installs its own and calls <i>nFunc</i> after handling each notification, on the NurApi notification thread
+ * or on a dispatch worker, see NurExtSetDispatchRoute().
+ * Do not call NurApiSetNotificationCallback() directly while such extensions are enabled.
+ *
+ * @sa NurApiSetNotificationCallback(), NotificationCallback, NurExtSetDispatchRoute()
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	nFunc	Pointer to a function. NULL to remove.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtSetNotificationCallback(HANDLE hApi, NotificationCallback nFunc);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
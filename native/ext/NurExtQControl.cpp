@@ -0,0 +1,498 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#define QCTL_SCHOUTE			2.39	// Expected tags in a colliding slot when the frame size matches the population
+#define QCTL_SATURATED_PCT		90		// Collision share above which the estimate is only a lower bound
+#define QCTL_MORE_ROUNDS_PCT	15		// Average collision share that adds a round
+#define QCTL_FEWER_ROUNDS_PCT	70		// Average empty share that removes a round
+#define QCTL_ERROR_DELAY_MS		100
+#define QCTL_BUFFER_USE			0.9		// Share of the module tag buffer the expected tags of an inventory may fill
+#define QCTL_YIELD_WEIGHT		0.25	// Weight of the latest inventory in the smoothed yield of an antenna
+
+/// <summary>
+/// Controller state of one antenna. estimate is kept as double, state.estimate is its rounded copy.
+/// </summary>
+struct NurExtQAntenna
+{
+	int id;
+	struct NUR_EXT_QCTL_ANTENNA state;
+	double estimate;
+	ULONGLONG sparseSinceNs;	// Estimate has been below denseTags / 4 since, 0 = not below
+	double yield;				// Smoothed tags found per inventory
+	double credit;				// Weighted round robin balance
+	ULONGLONG lastNs;			// Start of the latest inventory, 0 = none yet
+};
+
+struct NurExtQControl
+{
+	NurExtContext *ctx;
+	struct NUR_EXT_QCTL_CONFIG cfg;
+	std::thread thread;
+	int savedAntenna;			// Selected antenna before start, restored at stop
+	int bufferTags;				// Module tag buffer size, 0 = not known
+
+	// State and counters, read by the stats functions
+	std::mutex lock;
+	std::condition_variable cond;
+	bool stop;
+	std::vector<NurExtQAntenna> antennas;
+	size_t next;				// Next antenna in equal turns
+	struct NUR_EXT_QCTL_STATS stats;
+
+	NurExtQControl() : ctx(NULL), cfg(), savedAntenna(-1), bufferTags(0), stop(false), next(0), stats() { }
+};
+
+/// <summary>
+/// Changes the session of an antenna. A flipping target starts over from A.
+/// </summary>
+static void SetSession(NurExtQControl *qc, struct NUR_EXT_QCTL_ANTENNA &st, int session)
+{
+	st.session = session;
+	st.sessionChanges++;
+	if (qc->cfg.target == NUR_EXT_QCTL_TARGET_FLIP)
+	{
+		st.target = NUR_INVTARGET_A;
+		st.passTags = 0;
+	}
+}
+
+/// <summary>
+/// Chooses the parameters of the antenna's next inventory from the result of the previous. Caller holds qc->lock.
+/// </summary>
+static void Adapt(NurExtQControl *qc, NurExtQAntenna &ant, const struct NUR_INVEX_PARAMS &params,
+				  const struct NUR_INVENTORY_RESPONSE &resp, ULONGLONG nowNs)
+{
+	const struct NUR_EXT_QCTL_CONFIG &cfg = qc->cfg;
+	struct NUR_EXT_QCTL_ANTENNA &st = ant.state;
+	int rounds = std::max(1, resp.roundsDone);
+	int usedQ = (resp.Q > 0) ? resp.Q : params.Q;
+	long long slots = (long long)rounds << usedQ;
+	long long found = std::max(0, resp.numTagsFound);
+	long long collisions = std::min((long long)std::max(0, resp.collisions), slots);
+	long long empty = std::max(0LL, slots - found - collisions);
+
+	st.collisionPct = (DWORD)(collisions * 100 / slots);
+	st.emptyPct = (DWORD)(empty * 100 / slots);
+	st.inventories++;
+	st.tagsFound += found;
+	st.collisions += collisions;
+	st.slots += slots;
+
+	// Tags left unread collide again in the following rounds, so the collisions are averaged over the rounds
+	double estimate = found + QCTL_SCHOUTE * collisions / rounds;
+	if (st.collisionPct >= QCTL_SATURATED_PCT)
+		estimate = std::max(estimate, 4.0 * (1 << usedQ));
+
+	// Up at once, down halfway per inventory
+	ant.estimate = (estimate >= ant.estimate) ? estimate : (ant.estimate + estimate) / 2;
+	st.estimate = (int)llround(ant.estimate);
+	ant.yield += (found - ant.yield) * QCTL_YIELD_WEIGHT;
+	st.yield = (int)llround(ant.yield);
+
+	if (cfg.target == NUR_EXT_QCTL_TARGET_FLIP && st.session != NUR_SESSION_S0)
+	{
+		// Tags found in session 1 - 3 leave the target state, so every tag found in a pass is new to it
+		st.passTags += (DWORD)found;
+		double limit = st.passTags * cfg.flipPct / 100.0;
+		if (found <= limit && collisions <= limit)
+		{
+			// Pass done: the tags read wait in the other state, size the frame for all of them at once
+			st.target = (st.target == NUR_INVTARGET_A) ? NUR_INVTARGET_B : NUR_INVTARGET_A;
+			st.flips++;
+			ant.estimate = std::max(ant.estimate, (double)st.passTags);
+			st.estimate = (int)llround(ant.estimate);
+			st.passTags = 0;
+		}
+	}
+
+	// Frame of as many slots as tags singulates the most per slot
+	int targetQ = (int)lround(log2(std::max(ant.estimate, 1.0)));
+	targetQ = std::max(cfg.minQ, std::min(cfg.maxQ, targetQ));
+	int Q = st.Q;
+	if (targetQ > Q)
+		Q = targetQ;
+	else if (targetQ < Q)
+		Q--;
+	if (Q != st.Q)
+	{
+		st.Q = Q;
+		st.qChanges++;
+	}
+
+	if (st.collisionPct >= QCTL_SATURATED_PCT)
+	{
+		// Further rounds of a full frame find next to nothing, probe the next Q at once
+		st.rounds = 1;
+	}
+	else if (resp.numTagsMem > 0 && resp.numTagsFound > resp.numTagsMem)
+	{
+		// Tags singulated after the buffer filled are lost, and in session 1 - 3 silent until their flag persists
+		st.overflows++;
+		st.rounds = std::max(st.rounds - 1, 1);
+	}
+	else if (st.collisionPct >= QCTL_MORE_ROUNDS_PCT && resp.roundsDone >= params.rounds)
+		st.rounds = std::min(st.rounds + 1, cfg.maxRounds);
+	else if (st.emptyPct >= QCTL_FEWER_ROUNDS_PCT)
+		st.rounds = std::max(st.rounds - 1, 1);
+
+	if (qc->bufferTags > 0)
+	{
+		// No more rounds than are expected to fill the buffer; a round of L slots singulates n * e^(-n / L) of n tags
+		double frame = (double)(1 << st.Q);
+		double left = ant.estimate, expected = 0;
+		int maxRounds = 0;
+		while (maxRounds < st.rounds)
+		{
+			double singulated = left * exp(-left / frame);
+			if (maxRounds > 0 && expected + singulated > qc->bufferTags * QCTL_BUFFER_USE)
+				break;
+			expected += singulated;
+			left -= singulated;
+			maxRounds++;
+		}
+		st.rounds = maxRounds;
+	}
+
+	if (cfg.denseTags <= 0 || cfg.denseSession == cfg.session)
+		return;
+
+	if (st.session != cfg.denseSession)
+	{
+		if (ant.estimate >= cfg.denseTags)
+		{
+			SetSession(qc, st, cfg.denseSession);
+			ant.sparseSinceNs = 0;
+		}
+	}
+	else if (ant.estimate * 4 >= cfg.denseTags)
+	{
+		ant.sparseSinceNs = 0;
+	}
+	else if (ant.sparseSinceNs == 0)
+	{
+		ant.sparseSinceNs = nowNs;
+	}
+	else if (nowNs - ant.sparseSinceNs >= cfg.denseHoldMs * 1000000ULL)
+	{
+		// Read tags have had time to reply again; a dense population would have raised the estimate
+		SetSession(qc, st, cfg.session);
+		ant.sparseSinceNs = 0;
+	}
+}
+
+/// <summary>
+/// Chooses the antenna of the next inventory. Caller holds qc->lock.
+/// An antenna not inventoried for revisitMs goes first, otherwise smooth weighted round robin on the yields
+/// gives each antenna inventories in proportion to its yield, and antennas without yield only the revisits.
+/// </summary>
+static size_t NextAntenna(NurExtQControl *qc, ULONGLONG nowNs)
+{
+	std::vector<NurExtQAntenna> &ants = qc->antennas;
+	size_t best = ants.size();
+
+	if (qc->cfg.revisitMs == 0 || ants.size() == 1)
+	{
+		best = qc->next;
+		qc->next = (qc->next + 1) % ants.size();
+		return best;
+	}
+
+	for (size_t i = 0; i < ants.size(); i++)
+	{
+		if (nowNs - ants[i].lastNs >= qc->cfg.revisitMs * 1000000ULL
+			&& (best == ants.size() || ants[i].lastNs < ants[best].lastNs))
+			best = i;
+	}
+	if (best < ants.size())
+	{
+		if (ants[best].lastNs != 0)
+			ants[best].state.revisits++;
+		return best;
+	}
+
+	// Equal turns while no antenna finds anything
+	double total = 0;
+	for (size_t i = 0; i < ants.size(); i++)
+		total += ants[i].yield;
+	for (size_t i = 0; i < ants.size(); i++)
+	{
+		ants[i].credit += (total > 0) ? ants[i].yield : 1.0;
+		if (best == ants.size() || ants[i].credit > ants[best].credit)
+			best = i;
+	}
+	ants[best].credit -= (total > 0) ? total : (double)ants.size();
+	return best;
+}
+
+/// <summary>
+/// Waits for the time or until stopped.
+/// </summary>
+/// <returns>false if stopped.</returns>
+static bool Pause(NurExtQControl *qc, DWORD ms)
+{
+	std::unique_lock<std::mutex> lock(qc->lock);
+	if (ms > 0)
+		qc->cond.wait_for(lock, std::chrono::milliseconds(ms), [qc] { return qc->stop; });
+	return !qc->stop;
+}
+
+static void QControlThread(NurExtQControl *qc)
+{
+	HANDLE hApi = qc->ctx->hApi;
+	int selected = -1;
+
+	while (Pause(qc, 0))
+	{
+		size_t idx;
+		NurExtQAntenna ant;
+		{
+			std::lock_guard<std::mutex> guard(qc->lock);
+			ULONGLONG nowNs = NurExtGetMonotonicNs();
+			idx = NextAntenna(qc, nowNs);
+			qc->antennas[idx].lastNs = nowNs;
+			ant = qc->antennas[idx];
+		}
+
+		if (qc->cfg.antennaMask != 0 && ant.id != selected)
+		{
+			struct NUR_MODULESETUP setup;
+			memset(&setup, 0, sizeof(setup));
+			setup.selectedAntenna = ant.id;
+			int error = NurApiSetModuleSetup(hApi, NUR_SETUP_SELECTEDANT, &setup, sizeof(setup));
+			if (error != NUR_NO_ERROR)
+			{
+				{
+					std::lock_guard<std::mutex> guard(qc->lock);
+					qc->stats.errors++;
+				}
+				Pause(qc, std::max(qc->cfg.intervalMs, (DWORD)QCTL_ERROR_DELAY_MS));
+				continue;
+			}
+			selected = ant.id;
+		}
+
+		struct NUR_INVEX_PARAMS params;
+		struct NUR_INVENTORY_RESPONSE resp;
+		params.Q = ant.state.Q;
+		params.session = ant.state.session;
+		params.rounds = ant.state.rounds;
+		params.transitTime = 0;
+		params.inventoryTarget = ant.state.target;
+		params.inventorySelState = NUR_SELSTATE_ALL;
+		memset(&resp, 0, sizeof(resp));
+
+		int error = NurApiInventoryEx(hApi, &params, NULL, 0, &resp);
+		if (error == NUR_ERROR_NO_TAG)
+		{
+			resp.numTagsFound = 0;
+			if (resp.roundsDone <= 0)
+				resp.roundsDone = params.rounds;	// No reply at all: every slot was empty
+			error = NUR_NO_ERROR;
+		}
+		if (error == NUR_NO_ERROR && resp.numTagsFound > 0)
+		{
+			error = NurApiFetchTags(hApi, TRUE, NULL);
+			if (error == NUR_NO_ERROR)
+				NurExtProduceTags(qc->ctx, NurExtGetMonotonicNs());
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(qc->lock);
+			if (error != NUR_NO_ERROR)
+			{
+				qc->stats.errors++;
+			}
+			else
+			{
+				qc->stats.inventories++;
+				qc->stats.tagsFound += std::max(0, resp.numTagsFound);
+				Adapt(qc, qc->antennas[idx], params, resp, NurExtGetMonotonicNs());
+			}
+		}
+		Pause(qc, (error != NUR_NO_ERROR) ? std::max(qc->cfg.intervalMs, (DWORD)QCTL_ERROR_DELAY_MS) : qc->cfg.intervalMs);
+	}
+}
+
+/// <summary>
+/// Stop and delete the controller of the context, if any, and restore the selected antenna. Caller holds ctx->qctlLock.
+/// </summary>
+static void StopQControl(NurExtContext *ctx)
+{
+	NurExtQControl *qc = ctx->qctl;
+
+	if (!qc)
+		return;
+	ctx->qctl = NULL;
+
+	{
+		std::lock_guard<std::mutex> qcGuard(qc->lock);
+		qc->stop = true;
+		qc->cond.notify_all();
+	}
+	if (qc->thread.joinable())
+		qc->thread.join();
+
+	if (qc->cfg.antennaMask != 0)
+	{
+		struct NUR_MODULESETUP setup;
+		memset(&setup, 0, sizeof(setup));
+		setup.selectedAntenna = qc->savedAntenna;
+		NurApiSetModuleSetup(ctx->hApi, NUR_SETUP_SELECTEDANT, &setup, sizeof(setup));
+	}
+	delete qc;
+}
+
+void NurExtQControlForget(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(ctx->qctlLock);
+	StopQControl(ctx);
+}
+
+void NURAPICONV NurExtQControlDefaultConfig(struct NUR_EXT_QCTL_CONFIG *cfg)
+{
+	if (!cfg)
+		return;
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->initialQ = 4;
+	cfg->minQ = 1;
+	cfg->maxQ = 15;
+	cfg->maxRounds = 4;
+	cfg->session = NUR_SESSION_S0;
+	cfg->denseSession = NUR_SESSION_S1;
+	cfg->denseTags = 256;
+	cfg->denseHoldMs = 5000;
+	cfg->target = NUR_INVTARGET_A;
+	cfg->flipPct = 1;
+	cfg->revisitMs = 1000;
+}
+
+int NURAPICONV NurExtStartQControl(HANDLE hApi, const struct NUR_EXT_QCTL_CONFIG *cfg)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!cfg || cfg->minQ < 1 || cfg->maxQ > 15 || cfg->minQ > cfg->maxQ
+		|| cfg->initialQ < cfg->minQ || cfg->initialQ > cfg->maxQ || cfg->maxRounds < 1 || cfg->maxRounds > 10
+		|| cfg->session < NUR_SESSION_S0 || cfg->session > NUR_SESSION_S3
+		|| cfg->denseSession < NUR_SESSION_S0 || cfg->denseSession > NUR_SESSION_S3
+		|| cfg->denseTags < 0 || (cfg->target != NUR_EXT_QCTL_TARGET_FLIP && (cfg->target < NUR_INVTARGET_A || cfg->target > NUR_INVTARGET_AB))
+		|| cfg->flipPct < 0 || cfg->flipPct > 100)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	// Held until the new controller is installed, so that concurrent starts replace each other in turn
+	std::lock_guard<std::mutex> guard(ctx->qctlLock);
+	StopQControl(ctx.get());
+
+	NurExtQControl *qc = new NurExtQControl();
+	qc->ctx = ctx.get();
+	qc->cfg = *cfg;
+	qc->stats.antennaMask = cfg->antennaMask;
+
+	if (cfg->antennaMask != 0)
+	{
+		struct NUR_MODULESETUP setup;
+		int error = NurApiGetModuleSetup(hApi, NUR_SETUP_SELECTEDANT, &setup, sizeof(setup));
+		if (error != NUR_NO_ERROR)
+		{
+			delete qc;
+			return error;
+		}
+		qc->savedAntenna = setup.selectedAntenna;
+	}
+
+	struct NUR_DEVICECAPS caps;
+	if (NurApiGetDeviceCaps(hApi, &caps) == NUR_NO_ERROR)
+		qc->bufferTags = caps.szTagBuffer;
+
+	for (int id = 0; id < 32; id++)
+	{
+		if (cfg->antennaMask != 0 && !(cfg->antennaMask & (1UL << id)))
+			continue;
+
+		NurExtQAntenna ant;
+		memset(&ant.state, 0, sizeof(ant.state));
+		ant.id = id;
+		ant.state.Q = cfg->initialQ;
+		ant.state.rounds = std::min(2, cfg->maxRounds);
+		ant.state.session = cfg->session;
+		ant.state.target = (cfg->target == NUR_EXT_QCTL_TARGET_FLIP) ? NUR_INVTARGET_A : cfg->target;
+		ant.estimate = 0;
+		ant.sparseSinceNs = 0;
+		ant.yield = 0;
+		ant.credit = 0;
+		ant.lastNs = 0;
+		qc->antennas.push_back(ant);
+
+		if (cfg->antennaMask == 0)
+			break;
+	}
+
+	ctx->qctl = qc;
+	qc->thread = std::thread(QControlThread, qc);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtStopQControl(HANDLE hApi)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtFindContext(hApi);
+
+	if (ctx)
+		NurExtQControlForget(ctx.get());
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetQControlAntenna(HANDLE hApi, int antennaId, struct NUR_EXT_QCTL_ANTENNA *state, DWORD szState)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	struct NUR_EXT_QCTL_ANTENNA tmp;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!state || szState == 0 || szState > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->qctlLock);
+		NurExtQControl *qc = ctx->qctl;
+		if (!qc)
+			return NUR_ERROR_NOT_READY;
+
+		std::lock_guard<std::mutex> qcGuard(qc->lock);
+		std::vector<NurExtQAntenna>::const_iterator it = qc->antennas.begin();
+		while (it != qc->antennas.end() && it->id != antennaId)
+			++it;
+		if (it == qc->antennas.end())
+			return NUR_ERROR_INVALID_PARAMETER;
+		tmp = it->state;
+	}
+	memcpy(state, &tmp, szState);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetQControlStats(HANDLE hApi, struct NUR_EXT_QCTL_STATS *stats, DWORD szStats)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	struct NUR_EXT_QCTL_STATS tmp;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!stats || szStats == 0 || szStats > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->qctlLock);
+		NurExtQControl *qc = ctx->qctl;
+		if (!qc)
+			return NUR_ERROR_NOT_READY;
+
+		std::lock_guard<std::mutex> qcGuard(qc->lock);
+		tmp = qc->stats;
+	}
+	memcpy(stats, &tmp, szStats);
+	return NUR_NO_ERROR;
+}
@@ -0,0 +1,171 @@
+/*
+ * NurExtQControl.h
+ *
+ *  Host side adaptive Q, rounds and session control of extended inventories.
+ */
+
+#ifndef _NUREXTQCONTROL_H_
+#define _NUREXTQCONTROL_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** NUR_EXT_QCTL_CONFIG.target: alternate between NUR_INVTARGET_A and NUR_INVTARGET_B in session 1 - 3. */
+#define NUR_EXT_QCTL_TARGET_FLIP	0x100
+
+/**
+ * Inventory controller configuration.
+ * @sa NurExtStartQControl()
+ */
+struct NUR_EXT_QCTL_CONFIG
+{
+	DWORD antennaMask;			/**< Antennas to inventory, bit 0 = antenna 0, each with its own Q, rounds and session. 0 = the module's antenna selection. */
+	int initialQ;				/**< Q of the first inventory, 1 - 15. */
+	int minQ;					/**< Smallest Q used, 1 - 15. */
+	int maxQ;					/**< Largest Q used, minQ - 15. */
+	int maxRounds;				/**< Rounds are adapted from 1 to maxRounds, 1 - 10. */
+	int session;				/**< Session of sparse populations, normally NUR_SESSION_S0. */
+	int denseSession;			/**< Session when the population estimate reaches denseTags, so that read tags stop replying. */
+	int denseTags;				/**< Population estimate that switches to denseSession. 0 = always use session. */
+	DWORD denseHoldMs;			/**< Time the estimate must stay below denseTags / 4 before returning to session. Longer than the tag persistence of denseSession. */
+	int target;					/**< Inventory target, enum NUR_INVENTORY_TARGET or NUR_EXT_QCTL_TARGET_FLIP. */
+	int flipPct;				/**< With NUR_EXT_QCTL_TARGET_FLIP: the target flips when an inventory finds, and collides on, at most this percentage of the tags of the pass. */
+	DWORD intervalMs;			/**< Pause between inventories in milliseconds, 0 = back to back. */
+	DWORD revisitMs;			/**< With several antennas: inventories go to the antennas in proportion to their recent tag yield, but each antenna is inventoried at least once per revisitMs. 0 = equal turns. */
+};
+
+/**
+ * Controller state of one antenna.
+ * @sa NurExtGetQControlAntenna()
+ */
+struct NUR_EXT_QCTL_ANTENNA
+{
+	int Q;						/**< Q of the next inventory. */
+	int rounds;					/**< Rounds of the next inventory. */
+	int session;				/**< Session of the next inventory. */
+	int estimate;				/**< Estimated number of tags replying. */
+	DWORD collisionPct;			/**< Share of colliding slots in the latest inventory, 0 - 100. */
+	DWORD emptyPct;				/**< Share of empty slots in the latest inventory, 0 - 100. */
+	ULONGLONG inventories;		/**< Inventories done. */
+	ULONGLONG tagsFound;		/**< Tags singulated, summed over inventories. */
+	ULONGLONG collisions;		/**< Colliding slots, summed over inventories. */
+	ULONGLONG slots;			/**< Slots, summed over inventories. */
+	DWORD qChanges;				/**< Times Q was changed. */
+	DWORD sessionChanges;		/**< Times the session was changed. */
+	DWORD overflows;			/**< Inventories that found more tags than the module tag buffer holds. Rounds are reduced, as the rest are lost. */
+	int target;					/**< Inventory target of the next inventory. */
+	DWORD passTags;				/**< Tags found since the target last flipped. */
+	DWORD flips;				/**< Times the target was flipped. */
+	int yield;					/**< Recent tags found per inventory, smoothed. Share of the inventories the antenna gets. */
+	DWORD revisits;				/**< Inventories given because revisitMs had passed. */
+};
+
+/**
+ * Inventory controller counters.
+ * @sa NurExtGetQControlStats()
+ */
+struct NUR_EXT_QCTL_STATS
+{
+	DWORD antennaMask;			/**< Antennas controlled, 0 = the module's antenna selection. */
+	ULONGLONG inventories;		/**< Inventories done. */
+	ULONGLONG tagsFound;		/**< Tags singulated. */
+	ULONGLONG errors;			/**< Failed inventory, fetch or antenna selection commands. */
+};
+
+/** @fn void NurExtQControlDefaultConfig(struct NUR_EXT_QCTL_CONFIG *cfg)
+ *
+ * Fill the configuration with defaults: module's antenna selection, Q 4 within 1 - 15, up to 4 rounds,
+ * NUR_SESSION_S0 switching to NUR_SESSION_S1 at 256 tags and back after 5 seconds, target A (flipping at 1%), back to back inventories,
+ * antennas revisited at least once a second.
+ *
+ * @param	cfg		Pointer to the NUR_EXT_QCTL_CONFIG structure.
+ */
+void NURAPICONV NurExtQControlDefaultConfig(struct NUR_EXT_QCTL_CONFIG *cfg);
+
+/** @fn int NurExtStartQControl(HANDLE hApi, const struct NUR_EXT_QCTL_CONFIG *cfg)
+ *
+ * Run extended inventories on a thread of the handle, choosing Q, rounds and session of each antenna from the
+ * results of its previous inventory instead of the module's automatic Q.
+ *
+ * After each inventory the population is estimated from the singulated tags and colliding slots, and Q is set
+ * to the nearest power of two: a dense population gets a large Q at once rather than growing one step per round.
+ * When every slot collides the estimate is a lower bound, Q grows by two and a single round is run.
+ * Q is lowered one step at a time. Rounds are added while collisions remain after all rounds, and removed while
+ * most slots are empty or the tags found would not fit in the module tag buffer.
+ * When the estimate reaches <i>denseTags</i> the controller switches to <i>denseSession</i>, so that read tags
+ * stop replying and the rest are found in fewer slots.
+ *
+ * With NUR_EXT_QCTL_TARGET_FLIP, tags read in session 1 - 3 move to the other inventoried state and the target follows
+ * them: a pass reads the tags of one state until the tags found, the new tag yield of the pass, fall to
+ * <i>flipPct</i> of the pass. The next pass queries the other state with Q sized for the tags of the previous pass.
+ * Use with NUR_SESSION_S2 or NUR_SESSION_S3 as <i>denseSession</i> to count a static population over and over,
+ * where a fixed target would only read the tags once; new tags in either state are found within a pass.
+ *
+ * With several antennas in <i>antennaMask</i>, antennas that find tags get more of the inventories: the share of
+ * an antenna follows its recent tags found per inventory, so a tag coming into view of an active antenna is seen
+ * sooner than with equal turns. An antenna that has found nothing lately is still inventoried once per
+ * <i>revisitMs</i>, and takes its share again as soon as it finds tags. In session 1 - 3 the tags found are the
+ * ones not read within the flag persistence time, so the yield follows new tags.
+ *
+ * The tags found are fetched to the tag storage of the handle and passed on as for NUR_NOTIFICATION_INVENTORYEX:
+ * to NurExtEnableTagRing(), NurExtStreamGroupAdd(), NurExtTagBusPublish() and NurExtStartFanout() if used, otherwise
+ * drain them with NurExtDrainTags(). Restarts the controller if already running.
+ *
+ * @sa NurExtStopQControl(), NurExtGetQControlAntenna(), NurExtGetQControlStats()
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	cfg		Controller configuration.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStartQControl(HANDLE hApi, const struct NUR_EXT_QCTL_CONFIG *cfg);
+
+/** @fn int NurExtStopQControl(HANDLE hApi)
+ *
+ * Stop the controller after the inventory in progress and restore the selected antenna. Also done by NurExtFree().
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStopQControl(HANDLE hApi);
+
+/** @fn int NurExtGetQControlAntenna(HANDLE hApi, int antennaId, struct NUR_EXT_QCTL_ANTENNA *state, DWORD szState)
+ *
+ * Get the controller state of an antenna.
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	antennaId	Antenna in NUR_EXT_QCTL_CONFIG.antennaMask, or 0 if the mask is 0.
+ * @param	state		Pointer to the NUR_EXT_QCTL_ANTENNA structure.
+ * @param	szState		sizeof(struct NUR_EXT_QCTL_ANTENNA)
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the controller is not running. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetQControlAntenna(HANDLE hApi, int antennaId, struct NUR_EXT_QCTL_ANTENNA *state, DWORD szState);
+
+/** @fn int NurExtGetQControlStats(HANDLE hApi, struct NUR_EXT_QCTL_STATS *stats, DWORD szStats)
+ *
+ * Get inventory controller counters.
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	stats	Pointer to the NUR_EXT_QCTL_STATS structure.
+ * @param	szStats	sizeof(struct NUR_EXT_QCTL_STATS)
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the controller is not running. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetQControlStats(HANDLE hApi, struct NUR_EXT_QCTL_STATS *stats, DWORD szStats);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
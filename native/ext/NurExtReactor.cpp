@@ -0,0 +1,287 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <algorithm>
+#include <unistd.h>
+#include <map>
+#include <set>
+
+#define REACTOR_MAGIC		0x4e455852
+#define REACTOR_MAX_EVENTS	32
+// epoll user data of the task wake up eventfd; descriptor registrations start from 1
+#define REACTOR_WAKE_ID		0
+
+struct NurExtReactorFd
+{
+	int fd;
+	DWORD events;
+	NurExtFdCallback func;
+	LPVOID arg;
+};
+
+struct NurExtReactor
+{
+	DWORD magic;
+	int epollFd;
+	int wakeFd;					// Semaphore eventfd, one count per queued task
+	std::vector<std::thread> threads;
+
+	std::mutex lock;
+	std::deque<std::function<void()> > tasks;
+	std::map<ULONGLONG, NurExtReactorFd> fds;
+	ULONGLONG nextFdId;
+	bool stop;
+
+	std::set<NurExtContext*> attached;	// Protected by gReactorLock
+};
+
+std::mutex gReactorLock;
+
+static NurExtReactor *GetReactor(HANDLE hReactor)
+{
+	NurExtReactor *reactor = (NurExtReactor *)hReactor;
+	if (reactor == NULL || reactor == INVALID_HANDLE_VALUE || reactor->magic != REACTOR_MAGIC)
+		return NULL;
+	return reactor;
+}
+
+static void HandleFdEvent(NurExtReactor *reactor, ULONGLONG id, DWORD events)
+{
+	NurExtReactorFd entry;
+	{
+		std::lock_guard<std::mutex> guard(reactor->lock);
+		std::map<ULONGLONG, NurExtReactorFd>::iterator it = reactor->fds.find(id);
+		if (it == reactor->fds.end())
+			return;
+		entry = it->second;
+	}
+
+	entry.func(entry.fd, events, entry.arg);
+
+	// Registered one-shot, so that the descriptor is handled by one thread at a time
+	std::lock_guard<std::mutex> guard(reactor->lock);
+	if (reactor->fds.count(id))
+	{
+		struct epoll_event ev;
+		ev.events = entry.events | EPOLLONESHOT;
+		ev.data.u64 = id;
+		epoll_ctl(reactor->epollFd, EPOLL_CTL_MOD, entry.fd, &ev);
+	}
+}
+
+static void ReactorThread(NurExtReactor *reactor)
+{
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+
+	for (;;)
+	{
+		int n = epoll_wait(reactor->epollFd, events, REACTOR_MAX_EVENTS, -1);
+		if (n < 0 && errno != EINTR)
+			break;
+
+		for (int i = 0; i < n; i++)
+		{
+			if (events[i].data.u64 != REACTOR_WAKE_ID)
+			{
+				HandleFdEvent(reactor, events[i].data.u64, events[i].events);
+				continue;
+			}
+
+			// Another thread may have taken the count already
+			eventfd_t value;
+			if (eventfd_read(reactor->wakeFd, &value) != 0)
+				continue;
+
+			std::function<void()> task;
+			{
+				std::lock_guard<std::mutex> guard(reactor->lock);
+				if (reactor->stop)
+					return;
+				if (reactor->tasks.empty())
+					continue;
+				task = reactor->tasks.front();
+				reactor->tasks.pop_front();
+			}
+			task();
+		}
+	}
+}
+
+void NurExtReactorPost(NurExtReactor *reactor, const std::function<void()> &task)
+{
+	std::lock_guard<std::mutex> guard(reactor->lock);
+	reactor->tasks.push_back(task);
+	eventfd_write(reactor->wakeFd, 1);
+}
+
+void NurExtReactorForget(NurExtContext *ctx)
+{
+	if (ctx->asyncReactor)
+	{
+		ctx->asyncReactor->attached.erase(ctx);
+		ctx->asyncReactor = NULL;
+	}
+}
+
+HANDLE NURAPICONV NurExtReactorCreate(int threadCount)
+{
+	if (threadCount < 0)
+		return NULL;
+	if (threadCount == 0)
+		threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+
+	NurExtReactor *reactor = new NurExtReactor();
+	reactor->magic = REACTOR_MAGIC;
+	reactor->nextFdId = REACTOR_WAKE_ID + 1;
+	reactor->stop = false;
+	reactor->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	reactor->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC | EFD_SEMAPHORE);
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u64 = REACTOR_WAKE_ID;
+	if (reactor->epollFd < 0 || reactor->wakeFd < 0
+		|| epoll_ctl(reactor->epollFd, EPOLL_CTL_ADD, reactor->wakeFd, &ev) != 0)
+	{
+		if (reactor->epollFd >= 0)
+			close(reactor->epollFd);
+		if (reactor->wakeFd >= 0)
+			close(reactor->wakeFd);
+		delete reactor;
+		return NULL;
+	}
+
+	for (int i = 0; i < threadCount; i++)
+		reactor->threads.push_back(std::thread(ReactorThread, reactor));
+	return (HANDLE)reactor;
+}
+
+int NURAPICONV NurExtReactorFree(HANDLE hReactor)
+{
+	NurExtReactor *reactor = GetReactor(hReactor);
+
+	if (!reactor)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	{
+		// Handles with queued requests continue on their own threads
+		std::lock_guard<std::mutex> reactorGuard(gReactorLock);
+		for (std::set<NurExtContext*>::iterator it = reactor->attached.begin(); it != reactor->attached.end(); ++it)
+		{
+			std::lock_guard<std::mutex> guard((*it)->asyncLock);
+			(*it)->asyncReactor = NULL;
+		}
+		reactor->attached.clear();
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(reactor->lock);
+		reactor->stop = true;
+		reactor->fds.clear();
+		eventfd_write(reactor->wakeFd, reactor->threads.size());
+	}
+	for (size_t i = 0; i < reactor->threads.size(); i++)
+		reactor->threads[i].join();
+
+	// Tasks left are reactor steps of the handles detached above; they start the handle threads without running a request
+	while (!reactor->tasks.empty())
+	{
+		std::function<void()> task = reactor->tasks.front();
+		reactor->tasks.pop_front();
+		task();
+	}
+
+	close(reactor->wakeFd);
+	close(reactor->epollFd);
+	reactor->magic = 0;
+	delete reactor;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtReactorAttach(HANDLE hReactor, HANDLE hApi)
+{
+	NurExtReactor *reactor = NULL;
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (hReactor)
+	{
+		reactor = GetReactor(hReactor);
+		if (!reactor)
+			return NUR_ERROR_INVALID_HANDLE;
+	}
+
+	{
+		std::lock_guard<std::mutex> reactorGuard(gReactorLock);
+		std::lock_guard<std::mutex> guard(ctx->asyncLock);
+
+		if (!ctx->asyncQueue.empty() || ctx->asyncScheduled)
+			return NUR_ERROR_NOT_READY;
+		// From a completion on the handle's own request thread, which would have to join itself
+		if (reactor && ctx->asyncThread.get_id() == std::this_thread::get_id())
+			return NUR_ERROR_NOT_READY;
+
+		NurExtReactorForget(ctx.get());
+		if (reactor)
+		{
+			reactor->attached.insert(ctx.get());
+			ctx->asyncReactor = reactor;
+		}
+		ctx->asyncCond.notify_all();
+	}
+
+	// Own request thread exits when attached
+	if (reactor)
+		NurExtJoinAsyncThread(ctx.get());
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtReactorAddFd(HANDLE hReactor, int fd, DWORD events, NurExtFdCallback func, LPVOID arg)
+{
+	NurExtReactor *reactor = GetReactor(hReactor);
+
+	if (!reactor)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (fd < 0 || !func)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> guard(reactor->lock);
+	NurExtReactorFd entry;
+	entry.fd = fd;
+	entry.events = events;
+	entry.func = func;
+	entry.arg = arg;
+
+	struct epoll_event ev;
+	ev.events = events | EPOLLONESHOT;
+	ev.data.u64 = reactor->nextFdId;
+	if (epoll_ctl(reactor->epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	reactor->fds[reactor->nextFdId++] = entry;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtReactorRemoveFd(HANDLE hReactor, int fd)
+{
+	NurExtReactor *reactor = GetReactor(hReactor);
+
+	if (!reactor)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	std::lock_guard<std::mutex> guard(reactor->lock);
+	for (std::map<ULONGLONG, NurExtReactorFd>::iterator it = reactor->fds.begin(); it != reactor->fds.end(); ++it)
+	{
+		if (it->second.fd == fd)
+		{
+			epoll_ctl(reactor->epollFd, EPOLL_CTL_DEL, fd, NULL);
+			reactor->fds.erase(it);
+			return NUR_NO_ERROR;
+		}
+	}
+	return NUR_ERROR_INVALID_PARAMETER;
+}
@@ -0,0 +1,98 @@
+/*
+ * NurExtReactor.h
+ *
+ *  Shared epoll reactor for extension work of many NurApi handles.
+ */
+
+#ifndef _NUREXTREACTOR_H_
+#define _NUREXTREACTOR_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/**
+ * File descriptor event function. Called on a reactor thread, never concurrently for the same descriptor.
+ * @param	fd		The descriptor.
+ * @param	events	EPOLL* events that occurred.
+ * @param	arg		Argument given in NurExtReactorAddFd().
+ */
+typedef void (NURAPICALLBACK *NurExtFdCallback)(int fd, DWORD events, LPVOID arg);
+
+/** @fn HANDLE NurExtReactorCreate(int threadCount)
+ *
+ * Create a reactor: a fixed set of threads waiting on one epoll instance.
+ * Attached NurApi handles run their NurExtSubmit() requests on the reactor threads instead of a thread of their own,
+ * so extension thread count is O(threads) instead of O(handles). Requests of one handle still run one at a time in order.
+ *
+ * @note NurApi transport and notification threads are internal to NurApi and remain per handle.
+ *
+ * @sa NurExtReactorAttach(), NurExtReactorAddFd(), NurExtReactorFree()
+ *
+ * @param	threadCount		Number of threads. 0 = number of CPU cores.
+ *
+ * @return	Reactor handle, or NULL on failure.
+ */
+HANDLE NURAPICONV NurExtReactorCreate(int threadCount);
+
+/** @fn int NurExtReactorFree(HANDLE hReactor)
+ *
+ * Stop reactor threads and free the reactor. Attached handles are detached and registered descriptors are removed.
+ * Must not be called from a reactor thread.
+ *
+ * @param	hReactor	Reactor handle.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtReactorFree(HANDLE hReactor);
+
+/** @fn int NurExtReactorAttach(HANDLE hReactor, HANDLE hApi)
+ *
+ * Run NurExtSubmit() requests of <i>hApi</i> on the reactor threads.
+ *
+ * @param	hReactor	Reactor handle, NULL to detach <i>hApi</i> from its reactor.
+ * @param	hApi		Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the handle has unfinished requests or when called to attach from a completion
+ *			function of the handle. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtReactorAttach(HANDLE hReactor, HANDLE hApi);
+
+/** @fn int NurExtReactorAddFd(HANDLE hReactor, int fd, DWORD events, NurExtFdCallback func, LPVOID arg)
+ *
+ * Watch a file descriptor on the reactor, e.g. NurExtGetCompletionFd() of many handles.
+ *
+ * @param	hReactor	Reactor handle.
+ * @param	fd			File descriptor.
+ * @param	events		EPOLLIN, EPOLLOUT etc.
+ * @param	func		Event function.
+ * @param	arg			Passed to <i>func</i>.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtReactorAddFd(HANDLE hReactor, int fd, DWORD events, NurExtFdCallback func, LPVOID arg);
+
+/** @fn int NurExtReactorRemoveFd(HANDLE hReactor, int fd)
+ *
+ * Stop watching a file descriptor. The event function may still be running on another reactor thread when this returns.
+ *
+ * @param	hReactor	Reactor handle.
+ * @param	fd			File descriptor.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtReactorRemoveFd(HANDLE hReactor, int fd);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,352 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#define SPLIT_SCHOUTE			2.39	// Expected tags in a colliding slot when the frame size matches the population
+#define SPLIT_SATURATED_PCT		90		// Collision share above which the estimate is only a lower bound
+#define SPLIT_MIN_LEARNED		64		// Learned tags needed before splitting
+#define SPLIT_MAX_ALIGN			3		// Group bounds on multiples of 8 values need at most NUR_MAX_FILTERS prefixes
+
+/// <summary>
+/// Learned EPC value distribution. counts[p][v] is the number of tags with value v in EPC byte p.
+/// </summary>
+struct NurExtSplit
+{
+	struct NUR_EXT_SPLIT_CONFIG cfg;
+	DWORD counts[NUR_EXT_SPLIT_BYTES][256];
+	DWORD learned;			// Tags counted since the last halving
+	int epcLen;				// Bytes in the shortest EPC learned, 0 = none
+	double estimate;		// Population estimate, 0 = none yet
+};
+
+/// <summary>
+/// One sub-inventory: EPC byte values lo - hi - 1 of the split byte.
+/// </summary>
+struct NurExtSplitGroup
+{
+	int lo;
+	int hi;
+	double share;			// Learned share of the population
+};
+
+void NurExtSplitLearnTags(NurExtContext *ctx, const BYTE *tags, int count, DWORD szEntry)
+{
+	NurExtSplit *split = ctx->split;
+
+	if (!split)
+		return;
+
+	for (int i = 0; i < count; i++)
+	{
+		const struct NUR_TAG_DATA_EX *tag = (const struct NUR_TAG_DATA_EX *)(tags + i * szEntry);
+		int len = std::min((int)tag->epcLen, NUR_EXT_SPLIT_BYTES);
+
+		if (len <= 0)
+			continue;
+		for (int p = 0; p < len; p++)
+			split->counts[p][tag->epc[p]]++;
+		if (split->epcLen == 0 || len < split->epcLen)
+			split->epcLen = len;
+
+		if (++split->learned >= (DWORD)split->cfg.learnTags)
+		{
+			// Older tags weigh less, the distribution follows the population as it changes
+			for (int p = 0; p < NUR_EXT_SPLIT_BYTES; p++)
+				for (int v = 0; v < 256; v++)
+					split->counts[p][v] /= 2;
+			split->learned /= 2;
+		}
+	}
+}
+
+void NurExtSplitForget(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(ctx->splitLock);
+	NurExtSplit *split;
+
+	{
+		std::lock_guard<std::mutex> drainGuard(ctx->drainLock);
+		split = ctx->split;
+		ctx->split = NULL;
+	}
+	delete split;
+}
+
+/// <summary>
+/// Number of aligned prefix blocks values lo - hi - 1 decompose into.
+/// </summary>
+static int PrefixCount(int lo, int hi)
+{
+	int n = 0;
+	while (lo < hi)
+	{
+		int size = 256;
+		while (lo % size != 0 || lo + size > hi)
+			size /= 2;
+		lo += size;
+		n++;
+	}
+	return n;
+}
+
+/// <summary>
+/// Selects the values lo - hi - 1 of EPC byte p with one G2 Select per aligned prefix block.
+/// </summary>
+/// <returns>Number of filters written.</returns>
+static int BuildFilters(int p, int lo, int hi, struct NUR_INVEX_FILTER *filters)
+{
+	int n = 0;
+	while (lo < hi)
+	{
+		int size = 256, bits = 0;
+		while (lo % size != 0 || lo + size > hi)
+		{
+			size /= 2;
+			bits++;
+		}
+
+		struct NUR_INVEX_FILTER &f = filters[n];
+		memset(&f, 0, sizeof(f));
+		f.truncate = FALSE;
+		f.target = NUR_SESSION_SL;
+		f.action = (n == 0) ? NUR_FACTION_0 : NUR_FACTION_1;	// First clears SL of the rest of the population
+		f.bank = NUR_BANK_EPC;
+		f.address = 0x20 + p * 8;
+		f.maskBitLength = bits;
+		f.maskData[0] = (BYTE)lo;
+		n++;
+		lo += size;
+	}
+	return n;
+}
+
+/// <summary>
+/// Plans the groups of the next split inventory from the learned distribution. Caller holds ctx->drainLock.
+/// </summary>
+/// <returns>EPC byte to split on, -1 to inventory the population at once.</returns>
+static int Plan(const NurExtSplit *split, std::vector<NurExtSplitGroup> &groups)
+{
+	const struct NUR_EXT_SPLIT_CONFIG &cfg = split->cfg;
+	int wanted = std::min(cfg.maxGroups, (int)ceil(split->estimate / cfg.groupTags));
+	int best = -1;
+	double bestBits = 0;
+
+	groups.clear();
+	if (wanted > 1 && split->learned >= SPLIT_MIN_LEARNED)
+	{
+		// The byte whose values spread the most divides the population the most evenly
+		for (int p = 0; p < split->epcLen; p++)
+		{
+			double total = 0, sum = 0;
+			for (int v = 0; v < 256; v++)
+			{
+				double c = split->counts[p][v];
+				total += c;
+				if (c > 0)
+					sum += c * log2(c);
+			}
+			if (total <= 0)
+				continue;
+			double bits = log2(total) - sum / total;
+			if (bits > bestBits + 0.01)
+			{
+				bestBits = bits;
+				best = p;
+			}
+		}
+		// No more groups than the byte has values in effect
+		wanted = std::min(wanted, (int)exp2(bestBits));
+	}
+	if (best < 0 || wanted < 2)
+	{
+		NurExtSplitGroup all = { 0, 256, 1.0 };
+		groups.push_back(all);
+		return -1;
+	}
+
+	const DWORD *counts = split->counts[best];
+	double cum[257];
+	cum[0] = 0;
+	for (int v = 0; v < 256; v++)
+		cum[v + 1] = cum[v] + counts[v];
+
+	for (int align = 0; align <= SPLIT_MAX_ALIGN; align++)
+	{
+		int step = 1 << align;
+		std::vector<int> bounds(1, 0);
+
+		// Cut where the cumulative count is nearest to an equal share, empty groups merged into the next
+		for (int k = 1; k < wanted; k++)
+		{
+			double target = cum[256] * k / wanted;
+			int cut = bounds.back() + step;
+			for (int v = cut + step; v < 256; v += step)
+			{
+				if (fabs(cum[v] - target) < fabs(cum[cut] - target))
+					cut = v;
+			}
+			if (cut < 256 && cum[cut] > cum[bounds.back()])
+				bounds.push_back(cut);
+		}
+		bounds.push_back(256);
+
+		bool fits = true;
+		for (size_t i = 0; i + 1 < bounds.size() && fits; i++)
+			fits = PrefixCount(bounds[i], bounds[i + 1]) <= NUR_MAX_FILTERS;
+		if (!fits && align < SPLIT_MAX_ALIGN)
+			continue;
+
+		for (size_t i = 0; i + 1 < bounds.size(); i++)
+		{
+			NurExtSplitGroup g = { bounds[i], bounds[i + 1], (cum[bounds[i + 1]] - cum[bounds[i]]) / cum[256] };
+			groups.push_back(g);
+		}
+		break;
+	}
+	return (groups.size() > 1) ? best : -1;
+}
+
+void NURAPICONV NurExtSplitDefaultConfig(struct NUR_EXT_SPLIT_CONFIG *cfg)
+{
+	if (!cfg)
+		return;
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->groupTags = 256;
+	cfg->maxGroups = 8;
+	cfg->learnTags = 10000;
+}
+
+int NURAPICONV NurExtStartSplitPlanner(HANDLE hApi, const struct NUR_EXT_SPLIT_CONFIG *cfg)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!cfg || cfg->groupTags <= 0 || cfg->maxGroups < 1 || cfg->maxGroups > NUR_EXT_SPLIT_MAX_GROUPS
+		|| cfg->learnTags < SPLIT_MIN_LEARNED * 2)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	NurExtSplit *split = new NurExtSplit();
+	memset(split, 0, sizeof(*split));
+	split->cfg = *cfg;
+
+	NurExtSplit *previous;
+	{
+		// The previous planner, also one installed by a concurrent start, is replaced in one step
+		std::lock_guard<std::mutex> guard(ctx->splitLock);
+		std::lock_guard<std::mutex> drainGuard(ctx->drainLock);
+		previous = ctx->split;
+		ctx->split = split;
+	}
+	delete previous;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtStopSplitPlanner(HANDLE hApi)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	NurExtSplitForget(ctx.get());
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtSplitInventory(HANDLE hApi, const struct NUR_INVEX_PARAMS *params, struct NUR_EXT_SPLIT_RESULT *result, DWORD szResult)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!params || (result && (szResult == 0 || szResult > sizeof(struct NUR_EXT_SPLIT_RESULT))))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	// One split inventory at a time; drainLock is only held while planning, the groups' tags are drained through it
+	std::lock_guard<std::mutex> guard(ctx->splitLock);
+	std::vector<NurExtSplitGroup> groups;
+	struct NUR_EXT_SPLIT_RESULT res;
+	double estimate;
+
+	memset(&res, 0, sizeof(res));
+	{
+		std::lock_guard<std::mutex> drainGuard(ctx->drainLock);
+		if (!ctx->split)
+			return NUR_ERROR_NOT_READY;
+		res.splitByte = Plan(ctx->split, groups);
+		estimate = ctx->split->estimate;
+	}
+
+	double found = 0;
+	for (size_t i = 0; i < groups.size(); i++)
+	{
+		const NurExtSplitGroup &g = groups[i];
+		struct NUR_INVEX_FILTER filters[NUR_MAX_FILTERS];
+		struct NUR_INVEX_PARAMS p = *params;
+		struct NUR_INVENTORY_RESPONSE resp;
+		int filterCount = 0;
+
+		if (res.splitByte >= 0)
+		{
+			filterCount = BuildFilters(res.splitByte, g.lo, g.hi, filters);
+			p.inventorySelState = NUR_SELSTATE_SL;
+		}
+		if (p.Q == 0 && estimate > 0)
+		{
+			// Frame of as many slots as the group has tags
+			p.Q = (int)lround(log2(std::max(estimate * g.share, 1.0)));
+			p.Q = std::max(1, std::min(15, p.Q));
+		}
+		memset(&resp, 0, sizeof(resp));
+
+		int error = NurApiInventoryEx(hApi, &p, filterCount ? filters : NULL, filterCount, &resp);
+		if (error == NUR_ERROR_NO_TAG)
+		{
+			resp.numTagsFound = 0;
+			error = NUR_NO_ERROR;
+		}
+		if (error == NUR_NO_ERROR && resp.numTagsFound > 0)
+		{
+			error = NurApiFetchTags(hApi, TRUE, NULL);
+			if (error == NUR_NO_ERROR)
+				NurExtProduceTags(ctx.get(), NurExtGetMonotonicNs());
+		}
+		if (error != NUR_NO_ERROR)
+			return error;
+
+		int rounds = std::max(1, resp.roundsDone);
+		int usedQ = (resp.Q > 0) ? resp.Q : p.Q;
+		int tags = std::max(0, resp.numTagsFound);
+		int collisions = std::max(0, resp.collisions);
+
+		// Tags left unread collide again in the following rounds, so the collisions are averaged over the rounds
+		double groupEstimate = tags + SPLIT_SCHOUTE * collisions / rounds;
+		if (usedQ > 0 && collisions * 100LL >= ((long long)rounds << usedQ) * SPLIT_SATURATED_PCT)
+			groupEstimate = std::max(groupEstimate, 4.0 * (1 << usedQ));
+		found += groupEstimate;
+
+		res.groups++;
+		res.filters += filterCount;
+		res.tagsFound += tags;
+		res.collisions += collisions;
+		res.largestGroup = std::max(res.largestGroup, tags);
+	}
+
+	{
+		std::lock_guard<std::mutex> drainGuard(ctx->drainLock);
+		if (ctx->split)
+		{
+			// Up at once, down halfway per inventory
+			NurExtSplit *split = ctx->split;
+			split->estimate = (found >= split->estimate) ? found : (split->estimate + found) / 2;
+			res.estimate = (int)llround(split->estimate);
+		}
+	}
+
+	if (result)
+		memcpy(result, &res, szResult);
+	return NUR_NO_ERROR;
+}
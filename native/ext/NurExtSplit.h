@@ -0,0 +1,116 @@
+/*
+ * NurExtSplit.h
+ *
+ *  Population splitting inventory: large populations inventoried as balanced EPC prefix groups.
+ */
+
+#ifndef _NUREXTSPLIT_H_
+#define _NUREXTSPLIT_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Most sub-inventories of one split inventory. */
+#define NUR_EXT_SPLIT_MAX_GROUPS	16
+/** EPC bytes, from the first, whose value distribution is learned. */
+#define NUR_EXT_SPLIT_BYTES			32
+
+/**
+ * Split planner configuration.
+ * @sa NurExtStartSplitPlanner()
+ */
+struct NUR_EXT_SPLIT_CONFIG
+{
+	int groupTags;				/**< Tags aimed at per sub-inventory. The population is split into estimate / groupTags groups. */
+	int maxGroups;				/**< Most sub-inventories per split inventory, 1 - NUR_EXT_SPLIT_MAX_GROUPS. */
+	int learnTags;				/**< Counts of the EPC distribution are halved when this many tags have been learned, so that older tags weigh less. */
+};
+
+/**
+ * Result of a split inventory.
+ * @sa NurExtSplitInventory()
+ */
+struct NUR_EXT_SPLIT_RESULT
+{
+	int groups;					/**< Sub-inventories run. */
+	int splitByte;				/**< EPC byte the population was split on, -1 if it was not split. */
+	int filters;				/**< Select commands sent, summed over the sub-inventories. */
+	int tagsFound;				/**< Tags found, summed over the sub-inventories. */
+	int collisions;				/**< Colliding slots, summed over the sub-inventories. */
+	int largestGroup;			/**< Tags found in the largest sub-inventory. */
+	int estimate;				/**< Population estimate the next split inventory is planned for. */
+};
+
+/** @fn void NurExtSplitDefaultConfig(struct NUR_EXT_SPLIT_CONFIG *cfg)
+ *
+ * Fill the configuration with defaults: 256 tags per group, at most 8 groups, distribution halved every 10000 tags.
+ *
+ * @param	cfg		Pointer to the NUR_EXT_SPLIT_CONFIG structure.
+ */
+void NURAPICONV NurExtSplitDefaultConfig(struct NUR_EXT_SPLIT_CONFIG *cfg);
+
+/** @fn int NurExtStartSplitPlanner(HANDLE hApi, const struct NUR_EXT_SPLIT_CONFIG *cfg)
+ *
+ * Start learning the EPC value distribution of the population for NurExtSplitInventory(). Every tag drained from
+ * the tag storage of the handle, by NurExtDrainTags() or the other extensions that drain it, is counted.
+ * Restarts learning if already started.
+ *
+ * @sa NurExtSplitInventory(), NurExtStopSplitPlanner()
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	cfg		Planner configuration.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStartSplitPlanner(HANDLE hApi, const struct NUR_EXT_SPLIT_CONFIG *cfg);
+
+/** @fn int NurExtStopSplitPlanner(HANDLE hApi)
+ *
+ * Stop learning and forget the distribution. Also done by NurExtFree().
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStopSplitPlanner(HANDLE hApi);
+
+/** @fn int NurExtSplitInventory(HANDLE hApi, const struct NUR_INVEX_PARAMS *params, struct NUR_EXT_SPLIT_RESULT *result, DWORD szResult)
+ *
+ * Inventory the population in balanced groups, each a NurApiInventoryEx() of its own, run back to back.
+ * Every group sees a fraction of the population, so fewer slots collide than in one inventory of all tags.
+ *
+ * The groups are planned from the population estimate of the previous split inventory and the learned distribution:
+ * the EPC byte, within the shortest EPC learned, whose values spread the most is chosen, and its value range is cut where the learned tags divide
+ * evenly. A group is selected with prefix masks on that byte, at most NUR_MAX_FILTERS G2 Select commands asserting SL,
+ * and is inventoried with Q sized for its share of the estimate. Until there is an estimate and learned tags,
+ * the whole population is inventoried at once.
+ *
+ * The tags of each group are fetched to the tag storage of the handle and passed on as for NUR_NOTIFICATION_INVENTORYEX.
+ * Drain them, e.g. with NurExtDrainTags(), before the next split inventory so that they are learned.
+ *
+ * @sa NurExtStartSplitPlanner()
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	params		Session, rounds, target and transit time of the sub-inventories. Q 0 = sized per group,
+ *						or chosen by the module while there is no estimate. <i>inventorySelState</i> is ignored when split.
+ * @param	result		Pointer to the NUR_EXT_SPLIT_RESULT structure. May be NULL.
+ * @param	szResult	sizeof(struct NUR_EXT_SPLIT_RESULT)
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the planner is not started. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtSplitInventory(HANDLE hApi, const struct NUR_INVEX_PARAMS *params, struct NUR_EXT_SPLIT_RESULT *result, DWORD szResult);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
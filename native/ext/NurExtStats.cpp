@@ -0,0 +1,55 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <string.h>
+
+int NURAPICONV NurExtGetHostStats(HANDLE hApi, int stat, int code, struct NUR_EXT_HISTOGRAM *hist, DWORD szHist)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	const NurExtHistogram *src = NULL;
+	struct NUR_EXT_HISTOGRAM tmp;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!hist || szHist == 0 || szHist > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	switch (stat)
+	{
+	case NUR_EXT_STAT_DISPATCH_DELAY:
+	case NUR_EXT_STAT_CALLBACK:
+		if (code < 0 || code >= NUR_NOTIFICATION_LAST)
+			return NUR_ERROR_INVALID_PARAMETER;
+		src = (stat == NUR_EXT_STAT_CALLBACK) ? &ctx->statCallback[code] : &ctx->statDispatchDelay[code];
+		break;
+	case NUR_EXT_STAT_REQUEST_WAIT:
+		src = &ctx->statRequestWait;
+		break;
+	case NUR_EXT_STAT_REQUEST_EXEC:
+		src = &ctx->statRequestExec;
+		break;
+	default:
+		return NUR_ERROR_INVALID_PARAMETER;
+	}
+
+	src->Read(&tmp);
+	memcpy(hist, &tmp, szHist);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtResetHostStats(HANDLE hApi)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	for (int i = 0; i < NUR_NOTIFICATION_LAST; i++)
+	{
+		ctx->statDispatchDelay[i].Reset();
+		ctx->statCallback[i].Reset();
+	}
+	ctx->statRequestWait.Reset();
+	ctx->statRequestExec.Reset();
+	return NUR_NO_ERROR;
+}
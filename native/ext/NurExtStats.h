@@ -0,0 +1,104 @@
+/*
+ * NurExtStats.h
+ *
+ *  Host side latency histograms.
+ */
+
+#ifndef _NUREXTSTATS_H_
+#define _NUREXTSTATS_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Number of buckets in NUR_EXT_HISTOGRAM. */
+#define NUR_EXT_HIST_BUCKETS	32
+
+/**
+ * Latency histogram with power of two buckets.
+ * bucket[0] counts values below 1us, bucket[i] values from 2^(i-1) to 2^i - 1 us. Last bucket counts the rest.
+ * @sa NurExtGetHostStats(), NurExtHistogramAdd(), NurExtHistogramPercentile()
+ */
+struct NUR_EXT_HISTOGRAM
+{
+	ULONGLONG count;						/**< Number of values. */
+	ULONGLONG sumUs;						/**< Sum of values in microseconds. */
+	DWORD minUs;							/**< Smallest value, 0 if count is 0. */
+	DWORD maxUs;							/**< Largest value. */
+	ULONGLONG bucket[NUR_EXT_HIST_BUCKETS];	/**< Value counts per bucket. */
+};
+
+/**
+ * Host side statistics of a NurApi handle.
+ * @sa NurExtGetHostStats()
+ */
+enum NUR_EXT_STAT
+{
+	NUR_EXT_STAT_DISPATCH_DELAY = 0,	/**< Per notification type: time from NurApi notification to application call. Zero when inline. */
+	NUR_EXT_STAT_CALLBACK,				/**< Per notification type: execution time of the application notification function. */
+	NUR_EXT_STAT_REQUEST_WAIT,			/**< NurExtSubmit() requests: time from submit to start. Code is 0. */
+	NUR_EXT_STAT_REQUEST_EXEC,			/**< NurExtSubmit() requests: execution time of the request function. Code is 0. */
+	NUR_EXT_STAT_LAST
+};
+
+/** @fn int NurExtGetHostStats(HANDLE hApi, int stat, int code, struct NUR_EXT_HISTOGRAM *hist, DWORD szHist)
+ *
+ * Get a host side latency histogram of the handle. Statistics are collected with relaxed atomic counters and
+ * are always on. Notification statistics are collected for notifications passed through
+ * NurExtSetNotificationCallback().
+ *
+ * @sa NurExtResetHostStats(), enum NUR_EXT_STAT
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	stat	One of enum NUR_EXT_STAT.
+ * @param	code	Notification type for the notification statistics, otherwise 0.
+ * @param	hist	Pointer to the NUR_EXT_HISTOGRAM structure.
+ * @param	szHist	sizeof(struct NUR_EXT_HISTOGRAM)
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetHostStats(HANDLE hApi, int stat, int code, struct NUR_EXT_HISTOGRAM *hist, DWORD szHist);
+
+/** @fn int NurExtResetHostStats(HANDLE hApi)
+ *
+ * Clear all host side histograms of the handle.
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtResetHostStats(HANDLE hApi);
+
+/** @fn void NurExtHistogramAdd(struct NUR_EXT_HISTOGRAM *hist, DWORD us)
+ *
+ * Add a value to a histogram owned by the application. Not thread safe.
+ *
+ * @param	hist	The histogram, zero initialized before first use.
+ * @param	us		Value in microseconds.
+ */
+void NURAPICONV NurExtHistogramAdd(struct NUR_EXT_HISTOGRAM *hist, DWORD us);
+
+/** @fn DWORD NurExtHistogramPercentile(const struct NUR_EXT_HISTOGRAM *hist, double percentile)
+ *
+ * Estimate a percentile from a histogram: upper bound of the bucket the percentile falls in, limited to maxUs.
+ *
+ * @param	hist		The histogram.
+ * @param	percentile	0 - 100.
+ *
+ * @return	Value in microseconds, 0 if the histogram is empty.
+ */
+DWORD NURAPICONV NurExtHistogramPercentile(const struct NUR_EXT_HISTOGRAM *hist, double percentile);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,376 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <string.h>
+#include <algorithm>
+#include <list>
+#include <queue>
+
+#define GROUP_MAGIC				0x4e455847
+#define GROUP_MAX_CAPACITY		(1 << 24)
+
+/// <summary>
+/// Tags of one member, sorted by time. ctx is NULL once the member is removed; the source is
+/// dropped when its last tag has been read.
+/// </summary>
+struct NurExtGroupSource
+{
+	NurExtContext *ctx;
+	std::deque<struct NUR_EXT_GROUP_TAG> queue;
+	ULONGLONG lastRxNs;			// Latest stream notification
+	ULONGLONG maxLagNs;			// Longest receive time - merge time seen, at most maxDelayNs
+
+	explicit NurExtGroupSource(NurExtContext *c) : ctx(c), lastRxNs(0), maxLagNs(0) { }
+};
+
+struct NurExtStreamGroup
+{
+	DWORD magic;
+	ULONGLONG maxDelayNs;
+	size_t capacity;
+	DWORD flags;
+
+	std::mutex lock;
+	std::condition_variable cond;
+	std::list<NurExtGroupSource> sources;
+	ULONGLONG lastReadNs;		// Time of the latest tag read, later arrivals before it are late
+	struct NUR_EXT_GROUP_STATS stats;
+};
+
+// Membership changes; taken before NurExtContext::groupLock
+static std::mutex gGroupLock;
+
+static NurExtStreamGroup *GetGroup(HANDLE hGroup)
+{
+	NurExtStreamGroup *group = (NurExtStreamGroup *)hGroup;
+	if (group == NULL || group == INVALID_HANDLE_VALUE || group->magic != GROUP_MAGIC)
+		return NULL;
+	return group;
+}
+
+static bool TimeLess(const struct NUR_EXT_GROUP_TAG &a, const struct NUR_EXT_GROUP_TAG &b)
+{
+	return a.timeNs < b.timeNs;
+}
+
+/// <summary>
+/// Adds a drained batch to the source queue, keeping it sorted. Caller holds group->lock.
+/// </summary>
+static void AddTags(NurExtStreamGroup *group, NurExtGroupSource *src, std::vector<struct NUR_EXT_GROUP_TAG> &batch)
+{
+	size_t room = group->capacity - std::min(group->capacity, (size_t)group->stats.queued);
+	if (batch.size() > room)
+	{
+		group->stats.overflow += batch.size() - room;
+		batch.resize(room);
+	}
+
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		struct NUR_EXT_GROUP_TAG &t = batch[i];
+		if (t.rxTimeNs > t.timeNs)
+			src->maxLagNs = std::max(src->maxLagNs, std::min(t.rxTimeNs - t.timeNs, group->maxDelayNs));
+		if (t.timeNs < group->lastReadNs)
+			t.flags |= NUR_EXT_GROUP_TAG_LATE;
+	}
+
+	std::stable_sort(batch.begin(), batch.end(), TimeLess);
+	size_t mid = src->queue.size();
+	src->queue.insert(src->queue.end(), batch.begin(), batch.end());
+	if (mid > 0 && !batch.empty() && batch.front().timeNs < src->queue[mid - 1].timeNs)
+		std::inplace_merge(src->queue.begin(), src->queue.begin() + mid, src->queue.end(), TimeLess);
+
+	group->stats.received += batch.size();
+	group->stats.queued += (DWORD)batch.size();
+	if (group->stats.queued > group->stats.highWater)
+		group->stats.highWater = group->stats.queued;
+}
+
+bool NurExtStreamGroupProduce(NurExtContext *ctx, ULONGLONG rxTimeNs)
+{
+	std::lock_guard<std::mutex> guard(ctx->groupLock);
+	NurExtStreamGroup *group = ctx->streamGroup;
+	std::vector<struct NUR_EXT_GROUP_TAG> batch;
+	int count;
+
+	if (!group)
+		return false;
+
+	do
+	{
+		count = (int)ctx->groupStaging.size();
+		if (NurExtDrainContext(ctx, ctx->groupStaging.data(), ctx->groupStagingTimes.data(), &count, sizeof(struct NUR_TAG_DATA_EX)) != NUR_NO_ERROR)
+			break;
+
+		batch.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			struct NUR_EXT_GROUP_TAG &t = batch[i];
+			t.rxTimeNs = ctx->groupStagingTimes[i];
+			if ((group->flags & NUR_EXT_GROUP_RX_TIME) || !NurExtClockTagTime(ctx, ctx->groupStaging[i].timestamp, t.rxTimeNs, &t.timeNs))
+				t.timeNs = t.rxTimeNs;
+			t.hApi = ctx->hApi;
+			t.flags = 0;
+			t.tag = ctx->groupStaging[i];
+		}
+
+		std::lock_guard<std::mutex> groupGuard(group->lock);
+		AddTags(group, ctx->groupSource, batch);
+	} while (count == (int)ctx->groupStaging.size());
+
+	{
+		// Also without tags: the notification moves the member's watermark
+		std::lock_guard<std::mutex> groupGuard(group->lock);
+		ctx->groupSource->lastRxNs = std::max(ctx->groupSource->lastRxNs, rxTimeNs);
+	}
+	group->cond.notify_all();
+	return true;
+}
+
+/// <summary>
+/// Removes the member. Caller holds gGroupLock and ctx->groupLock.
+/// </summary>
+static void RemoveMember(NurExtContext *ctx)
+{
+	NurExtStreamGroup *group = ctx->streamGroup;
+
+	{
+		std::lock_guard<std::mutex> groupGuard(group->lock);
+		ctx->groupSource->ctx = NULL;
+		group->stats.members--;
+	}
+	ctx->streamGroup = NULL;
+	ctx->groupSource = NULL;
+	group->cond.notify_all();
+}
+
+void NurExtStreamGroupForget(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(gGroupLock);
+	std::lock_guard<std::mutex> ctxGuard(ctx->groupLock);
+	if (ctx->streamGroup)
+		RemoveMember(ctx);
+}
+
+/// <summary>
+/// Advances the watermark: the earliest time any active member may still deliver, but no further back
+/// than maxDelayNs. Caller holds group->lock.
+/// </summary>
+static ULONGLONG UpdateWatermark(NurExtStreamGroup *group, ULONGLONG now)
+{
+	ULONGLONG watermark = (now > group->maxDelayNs) ? now - group->maxDelayNs : 0;
+	ULONGLONG progress = ~0ULL;
+
+	for (std::list<NurExtGroupSource>::iterator it = group->sources.begin(); it != group->sources.end(); ++it)
+	{
+		if (it->ctx)
+			progress = std::min(progress, (it->lastRxNs > it->maxLagNs) ? it->lastRxNs - it->maxLagNs : 0);
+	}
+	if (progress != ~0ULL)
+		watermark = std::max(watermark, progress);
+
+	group->stats.watermarkNs = std::max(group->stats.watermarkNs, watermark);
+	return group->stats.watermarkNs;
+}
+
+/// <summary>
+/// Heap entry of the k-way merge: queue head time and the source.
+/// </summary>
+typedef std::pair<ULONGLONG, NurExtGroupSource*> MergeHead;
+
+/// <summary>
+/// Copies released tags to the buffer in time order. Caller holds group->lock.
+/// </summary>
+/// <returns>Number of tags copied.</returns>
+static int MergeReleased(NurExtStreamGroup *group, BYTE *dst, int capacity, DWORD szSingleEntry)
+{
+	ULONGLONG watermark = UpdateWatermark(group, NurExtGetMonotonicNs());
+	std::priority_queue<MergeHead, std::vector<MergeHead>, std::greater<MergeHead> > heads;
+	int n = 0;
+
+	for (std::list<NurExtGroupSource>::iterator it = group->sources.begin(); it != group->sources.end(); ++it)
+	{
+		if (!it->queue.empty() && it->queue.front().timeNs <= watermark)
+			heads.push(MergeHead(it->queue.front().timeNs, &*it));
+	}
+
+	while (n < capacity && !heads.empty())
+	{
+		NurExtGroupSource *src = heads.top().second;
+		heads.pop();
+
+		const struct NUR_EXT_GROUP_TAG &t = src->queue.front();
+		memcpy(dst + n * szSingleEntry, &t, szSingleEntry);
+		if (t.flags & NUR_EXT_GROUP_TAG_LATE)
+			group->stats.late++;
+		group->lastReadNs = std::max(group->lastReadNs, t.timeNs);
+		src->queue.pop_front();
+		n++;
+
+		if (!src->queue.empty() && src->queue.front().timeNs <= watermark)
+			heads.push(MergeHead(src->queue.front().timeNs, src));
+	}
+
+	// Removed members are kept until their tags have been read
+	for (std::list<NurExtGroupSource>::iterator it = group->sources.begin(); it != group->sources.end(); )
+	{
+		if (!it->ctx && it->queue.empty())
+			it = group->sources.erase(it);
+		else
+			++it;
+	}
+
+	group->stats.delivered += n;
+	group->stats.queued -= n;
+	return n;
+}
+
+/// <summary>
+/// Time the earliest queued tag is released by maxDelayNs. Caller holds group->lock.
+/// </summary>
+static ULONGLONG NextRelease(NurExtStreamGroup *group)
+{
+	ULONGLONG next = ~0ULL;
+
+	for (std::list<NurExtGroupSource>::iterator it = group->sources.begin(); it != group->sources.end(); ++it)
+	{
+		if (!it->queue.empty())
+			next = std::min(next, it->queue.front().timeNs + group->maxDelayNs);
+	}
+	return next;
+}
+
+HANDLE NURAPICONV NurExtStreamGroupCreate(DWORD maxDelayMs, int capacity, DWORD flags)
+{
+	if (capacity <= 0 || capacity > GROUP_MAX_CAPACITY)
+		return NULL;
+
+	NurExtStreamGroup *group = new NurExtStreamGroup();
+	group->magic = GROUP_MAGIC;
+	group->maxDelayNs = maxDelayMs * 1000000ULL;
+	group->capacity = (size_t)capacity;
+	group->flags = flags;
+	group->lastReadNs = 0;
+	memset(&group->stats, 0, sizeof(group->stats));
+	return (HANDLE)group;
+}
+
+int NURAPICONV NurExtStreamGroupFree(HANDLE hGroup)
+{
+	NurExtStreamGroup *group = GetGroup(hGroup);
+
+	if (!group)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	{
+		// Producers hold the member's groupLock while using the group
+		std::lock_guard<std::mutex> guard(gGroupLock);
+		for (std::list<NurExtGroupSource>::iterator it = group->sources.begin(); it != group->sources.end(); ++it)
+		{
+			NurExtContext *ctx = it->ctx;
+			if (!ctx)
+				continue;
+			std::lock_guard<std::mutex> ctxGuard(ctx->groupLock);
+			RemoveMember(ctx);
+		}
+	}
+
+	group->magic = 0;
+	delete group;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtStreamGroupAdd(HANDLE hGroup, HANDLE hApi)
+{
+	NurExtStreamGroup *group = GetGroup(hGroup);
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!group || !ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	{
+		std::lock_guard<std::mutex> guard(gGroupLock);
+		std::lock_guard<std::mutex> ctxGuard(ctx->groupLock);
+
+		if (ctx->streamGroup == group)
+			return NUR_NO_ERROR;
+		if (ctx->streamGroup)
+			return NUR_ERROR_NOT_READY;
+
+		std::lock_guard<std::mutex> groupGuard(group->lock);
+		group->sources.push_back(NurExtGroupSource(ctx.get()));
+		group->stats.members++;
+		ctx->groupSource = &group->sources.back();
+		ctx->streamGroup = group;
+	}
+
+	return NurExtInstallDispatcher(ctx.get());
+}
+
+int NURAPICONV NurExtStreamGroupRemove(HANDLE hGroup, HANDLE hApi)
+{
+	NurExtStreamGroup *group = GetGroup(hGroup);
+	std::shared_ptr<NurExtContext> ctx = NurExtFindContext(hApi);
+
+	if (!group)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	std::lock_guard<std::mutex> guard(gGroupLock);
+	if (!ctx)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> ctxGuard(ctx->groupLock);
+	if (ctx->streamGroup != group)
+		return NUR_ERROR_INVALID_PARAMETER;
+	RemoveMember(ctx.get());
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtStreamGroupRead(HANDLE hGroup, struct NUR_EXT_GROUP_TAG *tagBuffer, int *tagCount, DWORD szSingleEntry, DWORD timeoutMs)
+{
+	NurExtStreamGroup *group = GetGroup(hGroup);
+
+	if (!group)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!tagBuffer || !tagCount || *tagCount < 0
+		|| szSingleEntry == 0 || szSingleEntry > sizeof(struct NUR_EXT_GROUP_TAG))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	ULONGLONG deadline = NurExtGetMonotonicNs() + timeoutMs * 1000000ULL;
+	std::unique_lock<std::mutex> lock(group->lock);
+	int n;
+
+	for (;;)
+	{
+		n = MergeReleased(group, (BYTE *)tagBuffer, *tagCount, szSingleEntry);
+		ULONGLONG now = NurExtGetMonotonicNs();
+		if (n > 0 || *tagCount == 0 || now >= deadline)
+			break;
+
+		// Woken by member notifications, or when the oldest tag reaches maxDelayNs
+		ULONGLONG wake = std::min(deadline, NextRelease(group));
+		if (wake > now)
+			group->cond.wait_for(lock, std::chrono::nanoseconds(wake - now));
+	}
+
+	*tagCount = n;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtStreamGroupGetStats(HANDLE hGroup, struct NUR_EXT_GROUP_STATS *stats, DWORD szStats)
+{
+	NurExtStreamGroup *group = GetGroup(hGroup);
+	struct NUR_EXT_GROUP_STATS tmp;
+
+	if (!group)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!stats || szStats == 0 || szStats > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	{
+		std::lock_guard<std::mutex> guard(group->lock);
+		tmp = group->stats;
+	}
+	memcpy(stats, &tmp, szStats);
+	return NUR_NO_ERROR;
+}
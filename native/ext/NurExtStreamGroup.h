@@ -0,0 +1,156 @@
+/*
+ * NurExtStreamGroup.h
+ *
+ *  Time ordered merge of the inventory streams of several NurApi handles.
+ */
+
+#ifndef _NUREXTSTREAMGROUP_H_
+#define _NUREXTSTREAMGROUP_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/**
+ * Stream group flags.
+ * @sa NurExtStreamGroupCreate()
+ */
+enum NUR_EXT_GROUP_FLAGS
+{
+	NUR_EXT_GROUP_RX_TIME = (1<<0),		/**< Order by host receive time even if the member's clock is synced. */
+};
+
+/**
+ * Flags of a merged tag.
+ * @sa NUR_EXT_GROUP_TAG
+ */
+enum NUR_EXT_GROUP_TAG_FLAGS
+{
+	NUR_EXT_GROUP_TAG_LATE = (1<<0),	/**< Arrived after a later tag was already read; out of order. */
+};
+
+/**
+ * Tag read from a stream group.
+ * @sa NurExtStreamGroupRead()
+ */
+struct NUR_EXT_GROUP_TAG
+{
+	ULONGLONG timeNs;			/**< Merge time: NurExtTagTimeToHost() of the tag if the member's clock is synced, else rxTimeNs. */
+	ULONGLONG rxTimeNs;			/**< Host receive time, see NurExtDrainTagsEx(). */
+	HANDLE hApi;				/**< Member handle that read the tag. */
+	DWORD flags;				/**< Zero or more of enum NUR_EXT_GROUP_TAG_FLAGS. */
+	struct NUR_TAG_DATA_EX tag;	/**< The tag. Last, so that a smaller entry size truncates it. */
+};
+
+/**
+ * Stream group counters.
+ * @sa NurExtStreamGroupGetStats()
+ */
+struct NUR_EXT_GROUP_STATS
+{
+	ULONGLONG received;			/**< Tags drained from the members. */
+	ULONGLONG delivered;		/**< Tags read by the application. */
+	ULONGLONG late;				/**< Tags delivered with NUR_EXT_GROUP_TAG_LATE. */
+	ULONGLONG overflow;			/**< Tags dropped because the group was full. */
+	ULONGLONG watermarkNs;		/**< Tags up to this time have been released for reading. */
+	DWORD members;				/**< Member handles. */
+	DWORD queued;				/**< Tags waiting in the group. */
+	DWORD highWater;			/**< Highest number of tags waiting. */
+};
+
+/** @fn HANDLE NurExtStreamGroupCreate(DWORD maxDelayMs, int capacity, DWORD flags)
+ *
+ * Create a stream group: tags of the inventory streams of all member handles, read in time order by one consumer.
+ *
+ * Member tags are drained on their NurApi notification threads, kept sorted per member and merged when read.
+ * A tag is released for reading when every member has reported a stream notification past its time, so that no
+ * earlier tag can still arrive, or at the latest <i>maxDelayMs</i> after its time. A member that is slow, stopped or
+ * disconnected delays the others by at most <i>maxDelayMs</i>.
+ *
+ * @sa NurExtStreamGroupAdd(), NurExtStreamGroupRead(), NurExtStreamGroupFree(), NurExtStartClockSync()
+ *
+ * @param	maxDelayMs	Longest time a tag is held back waiting for the other members.
+ * @param	capacity	Maximum number of tags waiting in the group. New tags are dropped when full.
+ * @param	flags		Zero or more of enum NUR_EXT_GROUP_FLAGS.
+ *
+ * @return	Stream group handle, or NULL on invalid parameters.
+ */
+HANDLE NURAPICONV NurExtStreamGroupCreate(DWORD maxDelayMs, int capacity, DWORD flags);
+
+/** @fn int NurExtStreamGroupFree(HANDLE hGroup)
+ *
+ * Remove all members and free the stream group. Tags not read are discarded.
+ * Must not be called while another thread is in NurExtStreamGroupRead().
+ *
+ * @param	hGroup	Stream group handle.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStreamGroupFree(HANDLE hGroup);
+
+/** @fn int NurExtStreamGroupAdd(HANDLE hGroup, HANDLE hApi)
+ *
+ * Add a handle to the group. Tags of its NUR_NOTIFICATION_INVENTORYSTREAM and NUR_NOTIFICATION_INVENTORYEX notifications
+ * go to the group, not to NurExtEnableTagRing(). Start the clock sync of the handle with NurExtStartClockSync() to merge
+ * on tag read times instead of receive times. A handle can be in one group at a time; it is removed by NurExtFree().
+ *
+ * Use NurExtSetNotificationCallback() instead of NurApiSetNotificationCallback() for the member.
+ *
+ * @param	hGroup	Stream group handle.
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the handle is in another group. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStreamGroupAdd(HANDLE hGroup, HANDLE hApi);
+
+/** @fn int NurExtStreamGroupRemove(HANDLE hGroup, HANDLE hApi)
+ *
+ * Remove a handle from the group. Its tags already in the group are still read.
+ *
+ * @param	hGroup	Stream group handle.
+ * @param	hApi	Member handle.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStreamGroupRemove(HANDLE hGroup, HANDLE hApi);
+
+/** @fn int NurExtStreamGroupRead(HANDLE hGroup, struct NUR_EXT_GROUP_TAG *tagBuffer, int *tagCount, DWORD szSingleEntry, DWORD timeoutMs)
+ *
+ * Read released tags in time order. Waits up to <i>timeoutMs</i> for at least one tag.
+ * Call from one thread at a time.
+ *
+ * @param	hGroup			Stream group handle.
+ * @param	tagBuffer		Pointer to NUR_EXT_GROUP_TAG structures. Must contain at least <i>tagCount</i> entries.
+ * @param	tagCount		Number of entries in <i>tagBuffer</i>. On return number of valid entries is received in this pointer, 0 on timeout.
+ * @param	szSingleEntry	Size of one NUR_EXT_GROUP_TAG entry.
+ * @param	timeoutMs		Time to wait in milliseconds, 0 = do not wait.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStreamGroupRead(HANDLE hGroup, struct NUR_EXT_GROUP_TAG *tagBuffer, int *tagCount, DWORD szSingleEntry, DWORD timeoutMs);
+
+/** @fn int NurExtStreamGroupGetStats(HANDLE hGroup, struct NUR_EXT_GROUP_STATS *stats, DWORD szStats)
+ *
+ * Get stream group counters.
+ *
+ * @param	hGroup	Stream group handle.
+ * @param	stats	Pointer to the NUR_EXT_GROUP_STATS structure.
+ * @param	szStats	sizeof(struct NUR_EXT_GROUP_STATS)
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStreamGroupGetStats(HANDLE hGroup, struct NUR_EXT_GROUP_STATS *stats, DWORD szStats);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
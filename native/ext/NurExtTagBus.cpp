@@ -0,0 +1,431 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+#define TAGBUS_MAGIC			0x5355424e		// "NBUS"
+#define TAGBUS_VERSION			1
+#define TAGBUS_SUB_MAGIC		0x4255534e
+#define TAGBUS_MAX_CAPACITY		(1 << 22)
+
+/// <summary>
+/// Start of the shared memory segment. Written by the publisher only; magic last, when the segment is ready.
+/// </summary>
+struct NurExtTagBusHeader
+{
+	std::atomic<DWORD> magic;
+	DWORD version;
+	DWORD capacity;
+	DWORD slotSize;
+	DWORD publisherPid;
+	std::atomic<int> closed;
+	std::atomic<int> wake;			// Futex word, incremented after each batch
+	alignas(64) std::atomic<ULONGLONG> head;
+};
+
+/// <summary>
+/// One tag in the segment. seq is sequence + 1 of the tag stored, 0 while the publisher writes it.
+/// </summary>
+struct NurExtTagBusSlot
+{
+	std::atomic<ULONGLONG> seq;
+	ULONGLONG rxTimeNs;
+	struct NUR_TAG_DATA_EX tag;
+};
+
+struct NurExtTagBus
+{
+	std::string name;
+	dev_t dev;						// Identity of the segment created, to unlink only our own
+	ino_t ino;
+	void *map;
+	size_t mapSize;
+	NurExtTagBusHeader *hdr;
+	NurExtTagBusSlot *slots;
+	ULONGLONG mask;
+};
+
+struct NurExtTagBusSubscriber
+{
+	DWORD magic;
+	void *map;
+	size_t mapSize;
+	const NurExtTagBusHeader *hdr;
+	const NurExtTagBusSlot *slots;
+	ULONGLONG mask;
+	ULONGLONG pos;
+	ULONGLONG received;
+	ULONGLONG lost;
+};
+
+static size_t SegmentSize(DWORD capacity)
+{
+	return ((sizeof(NurExtTagBusHeader) + 63) & ~(size_t)63) + capacity * sizeof(NurExtTagBusSlot);
+}
+
+static void Wake(NurExtTagBusHeader *hdr)
+{
+	hdr->wake.fetch_add(1, std::memory_order_release);
+	syscall(SYS_futex, (int *)&hdr->wake, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static void DestroyBus(NurExtTagBus *bus)
+{
+	bus->hdr->closed.store(1, std::memory_order_release);
+	Wake(bus->hdr);
+	munmap(bus->map, bus->mapSize);
+
+	// The name may have been taken over since a stale segment was replaced, leave another publisher's segment be
+	int fd = shm_open(bus->name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+	if (fd >= 0)
+	{
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_dev == bus->dev && st.st_ino == bus->ino)
+			shm_unlink(bus->name.c_str());
+		close(fd);
+	}
+	delete bus;
+}
+
+/// <summary>
+/// True if a segment of the name is published by a running publisher, that of another handle or process.
+/// </summary>
+static bool NameInUse(const char *name)
+{
+	int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	bool inUse = false;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(NurExtTagBusHeader))
+	{
+		void *map = mmap(NULL, sizeof(NurExtTagBusHeader), PROT_READ, MAP_SHARED, fd, 0);
+		if (map != MAP_FAILED)
+		{
+			const NurExtTagBusHeader *hdr = (const NurExtTagBusHeader *)map;
+			// Closed or left behind by a publisher that has exited: stale
+			inUse = hdr->magic.load(std::memory_order_acquire) == TAGBUS_MAGIC
+				&& !hdr->closed.load(std::memory_order_acquire)
+				&& (kill((pid_t)hdr->publisherPid, 0) == 0 || errno == EPERM);
+			munmap(map, sizeof(NurExtTagBusHeader));
+		}
+	}
+	close(fd);
+	return inUse;
+}
+
+static int CreateBus(const char *name, DWORD capacity, NurExtTagBus **out)
+{
+	size_t size = SegmentSize(capacity);
+
+	if (NameInUse(name))
+		return NUR_ERROR_NOT_READY;
+
+	// Subscribers of a stale bus keep their mapping
+	shm_unlink(name);
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return NUR_ERROR_FILE_NOT_FOUND;
+
+	struct stat st;
+	void *map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && ftruncate(fd, (off_t)size) == 0)
+		map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		shm_unlink(name);
+		return NUR_ERROR_FILE_INVALID;
+	}
+
+	// ftruncate() zero fills, so all slots are unwritten
+	NurExtTagBus *bus = new NurExtTagBus();
+	bus->name = name;
+	bus->dev = st.st_dev;
+	bus->ino = st.st_ino;
+	bus->map = map;
+	bus->mapSize = size;
+	bus->hdr = (NurExtTagBusHeader *)map;
+	bus->slots = (NurExtTagBusSlot *)((BYTE *)map + SegmentSize(0));
+	bus->mask = capacity - 1;
+	bus->hdr->version = TAGBUS_VERSION;
+	bus->hdr->capacity = capacity;
+	bus->hdr->slotSize = sizeof(NurExtTagBusSlot);
+	bus->hdr->publisherPid = (DWORD)getpid();
+	bus->hdr->magic.store(TAGBUS_MAGIC, std::memory_order_release);
+	*out = bus;
+	return NUR_NO_ERROR;
+}
+
+void NurExtTagBusPublishTags(NurExtContext *ctx, const BYTE *tags, int count, DWORD szEntry, ULONGLONG rxTimeNs)
+{
+	NurExtTagBus *bus = ctx->bus;
+	if (!bus || count == 0)
+		return;
+
+	ULONGLONG head = bus->hdr->head.load(std::memory_order_relaxed);
+	for (int i = 0; i < count; i++)
+	{
+		// Seqlock per slot: a subscriber that sees seq change while copying was overrun
+		NurExtTagBusSlot &slot = bus->slots[(head + i) & bus->mask];
+		slot.seq.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.rxTimeNs = rxTimeNs;
+		memcpy(&slot.tag, tags + i * szEntry, szEntry);
+		memset((BYTE *)&slot.tag + szEntry, 0, sizeof(slot.tag) - szEntry);
+		slot.seq.store(head + i + 1, std::memory_order_release);
+	}
+	bus->hdr->head.store(head + count, std::memory_order_release);
+	Wake(bus->hdr);
+}
+
+bool NurExtTagBusProduce(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(ctx->busLock);
+	int count;
+
+	if (!ctx->bus)
+		return false;
+
+	// The drain publishes; the tags are not needed here
+	do
+	{
+		count = (int)ctx->busStaging.size();
+		if (NurExtDrainContext(ctx, ctx->busStaging.data(), NULL, &count, sizeof(struct NUR_TAG_DATA_EX)) != NUR_NO_ERROR)
+			break;
+	} while (count == (int)ctx->busStaging.size());
+	return true;
+}
+
+/// <summary>
+/// Installs a bus in place of the current one and returns the one replaced. Caller holds ctx->busLock.
+/// </summary>
+static NurExtTagBus *SwapBus(NurExtContext *ctx, NurExtTagBus *bus)
+{
+	std::lock_guard<std::mutex> drainGuard(ctx->drainLock);
+	NurExtTagBus *previous = ctx->bus;
+	ctx->bus = bus;
+	return previous;
+}
+
+void NurExtTagBusForget(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(ctx->busLock);
+	NurExtTagBus *bus = SwapBus(ctx, NULL);
+
+	if (bus)
+		DestroyBus(bus);
+}
+
+int NURAPICONV NurExtTagBusPublish(HANDLE hApi, const char *name, int capacity)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	NurExtTagBus *bus = NULL;
+	DWORD size = 1;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (capacity < 0 || capacity > TAGBUS_MAX_CAPACITY || (capacity > 0 && !name))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	{
+		// Held from the old bus to the new one, so that concurrent publishes replace each other in turn
+		std::lock_guard<std::mutex> guard(ctx->busLock);
+		NurExtTagBus *previous = SwapBus(ctx.get(), NULL);
+
+		// Closed first, so that the same name can be published again
+		if (previous)
+			DestroyBus(previous);
+		if (capacity == 0)
+			return NUR_NO_ERROR;
+
+		while ((int)size < capacity)
+			size <<= 1;
+
+		int error = CreateBus(name, size, &bus);
+		if (error != NUR_NO_ERROR)
+			return error;
+		SwapBus(ctx.get(), bus);
+	}
+	return NurExtInstallDispatcher(ctx.get());
+}
+
+static NurExtTagBusSubscriber *GetSubscriber(HANDLE hBus)
+{
+	NurExtTagBusSubscriber *sub = (NurExtTagBusSubscriber *)hBus;
+	if (sub == NULL || sub == INVALID_HANDLE_VALUE || sub->magic != TAGBUS_SUB_MAGIC)
+		return NULL;
+	return sub;
+}
+
+HANDLE NURAPICONV NurExtTagBusOpen(const char *name)
+{
+	struct stat st;
+
+	if (!name)
+		return NULL;
+
+	int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0)
+		return NULL;
+
+	void *map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t)st.st_size >= SegmentSize(0))
+		map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	// A segment still being created by the publisher has no magic yet
+	const NurExtTagBusHeader *hdr = (const NurExtTagBusHeader *)map;
+	if (hdr->magic.load(std::memory_order_acquire) != TAGBUS_MAGIC || hdr->version != TAGBUS_VERSION
+		|| hdr->slotSize != sizeof(NurExtTagBusSlot) || hdr->capacity == 0 || (hdr->capacity & (hdr->capacity - 1)) != 0
+		|| SegmentSize(hdr->capacity) != (size_t)st.st_size)
+	{
+		munmap(map, (size_t)st.st_size);
+		return NULL;
+	}
+
+	NurExtTagBusSubscriber *sub = new NurExtTagBusSubscriber();
+	sub->magic = TAGBUS_SUB_MAGIC;
+	sub->map = map;
+	sub->mapSize = (size_t)st.st_size;
+	sub->hdr = hdr;
+	sub->slots = (const NurExtTagBusSlot *)((const BYTE *)map + SegmentSize(0));
+	sub->mask = hdr->capacity - 1;
+	sub->pos = hdr->head.load(std::memory_order_acquire);
+	sub->received = 0;
+	sub->lost = 0;
+	return (HANDLE)sub;
+}
+
+int NURAPICONV NurExtTagBusClose(HANDLE hBus)
+{
+	NurExtTagBusSubscriber *sub = GetSubscriber(hBus);
+
+	if (!sub)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	munmap(sub->map, sub->mapSize);
+	sub->magic = 0;
+	delete sub;
+	return NUR_NO_ERROR;
+}
+
+/// <summary>
+/// Copies published tags from the segment.
+/// </summary>
+/// <returns>Number of tags copied.</returns>
+static int ReadSlots(NurExtTagBusSubscriber *sub, BYTE *dst, int capacity, DWORD szSingleEntry)
+{
+	int n = 0;
+
+	while (n < capacity)
+	{
+		const NurExtTagBusSlot &slot = sub->slots[sub->pos & sub->mask];
+		ULONGLONG seq = slot.seq.load(std::memory_order_acquire);
+
+		if (seq == sub->pos + 1)
+		{
+			struct NUR_EXT_BUS_TAG *out = (struct NUR_EXT_BUS_TAG *)(dst + n * szSingleEntry);
+			struct NUR_EXT_BUS_TAG tmp;
+			tmp.seq = sub->pos;
+			tmp.rxTimeNs = slot.rxTimeNs;
+			memcpy(&tmp.tag, &slot.tag, sizeof(tmp.tag));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.seq.load(std::memory_order_relaxed) == seq)
+			{
+				memcpy(out, &tmp, szSingleEntry);
+				sub->pos++;
+				sub->received++;
+				n++;
+				continue;
+			}
+		}
+		else
+		{
+			ULONGLONG head = sub->hdr->head.load(std::memory_order_acquire);
+			// Slot still holds the previous lap or is being written for the first time
+			if ((seq != 0 && seq < sub->pos + 1) || head <= sub->pos)
+				break;
+		}
+
+		// Overrun: skip to the oldest tag still in the ring
+		ULONGLONG head = sub->hdr->head.load(std::memory_order_acquire);
+		ULONGLONG oldest = (head > sub->mask + 1) ? head - (sub->mask + 1) : 0;
+		oldest = std::max(oldest, sub->pos + 1);
+		sub->lost += oldest - sub->pos;
+		sub->pos = oldest;
+	}
+	return n;
+}
+
+int NURAPICONV NurExtTagBusRead(HANDLE hBus, struct NUR_EXT_BUS_TAG *tagBuffer, int *tagCount, DWORD szSingleEntry, DWORD timeoutMs)
+{
+	NurExtTagBusSubscriber *sub = GetSubscriber(hBus);
+
+	if (!sub)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!tagBuffer || !tagCount || *tagCount <= 0
+		|| szSingleEntry == 0 || szSingleEntry > sizeof(struct NUR_EXT_BUS_TAG))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	ULONGLONG deadline = NurExtGetMonotonicNs() + timeoutMs * 1000000ULL;
+	int capacity = *tagCount;
+	*tagCount = 0;
+
+	for (;;)
+	{
+		int wake = sub->hdr->wake.load(std::memory_order_acquire);
+		bool closed = sub->hdr->closed.load(std::memory_order_acquire) != 0;
+
+		*tagCount = ReadSlots(sub, (BYTE *)tagBuffer, capacity, szSingleEntry);
+		if (*tagCount > 0)
+			return NUR_NO_ERROR;
+		if (closed)
+			return NUR_ERROR_TR_NOT_CONNECTED;
+
+		ULONGLONG now = NurExtGetMonotonicNs();
+		if (now >= deadline)
+			return NUR_NO_ERROR;
+
+		// Returns at once if the publisher woke since wake was read
+		struct timespec ts;
+		ts.tv_sec = (time_t)((deadline - now) / 1000000000ULL);
+		ts.tv_nsec = (long)((deadline - now) % 1000000000ULL);
+		syscall(SYS_futex, (int *)&sub->hdr->wake, FUTEX_WAIT, wake, &ts, NULL, 0);
+	}
+}
+
+int NURAPICONV NurExtTagBusGetStats(HANDLE hBus, struct NUR_EXT_TAGBUS_STATS *stats, DWORD szStats)
+{
+	NurExtTagBusSubscriber *sub = GetSubscriber(hBus);
+	struct NUR_EXT_TAGBUS_STATS tmp;
+
+	if (!sub)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!stats || szStats == 0 || szStats > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	memset(&tmp, 0, sizeof(tmp));
+	tmp.capacity = sub->hdr->capacity;
+	tmp.publisherPid = sub->hdr->publisherPid;
+	tmp.published = sub->hdr->head.load(std::memory_order_acquire);
+	tmp.received = sub->received;
+	tmp.lost = sub->lost;
+	tmp.closed = sub->hdr->closed.load(std::memory_order_acquire) ? TRUE : FALSE;
+	memcpy(stats, &tmp, szStats);
+	return NUR_NO_ERROR;
+}
@@ -0,0 +1,122 @@
+/*
+ * NurExtTagBus.h
+ *
+ *  Tag stream of one NurApi handle published in POSIX shared memory for local subscriber processes.
+ */
+
+#ifndef _NUREXTTAGBUS_H_
+#define _NUREXTTAGBUS_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/**
+ * Tag read from a tag bus.
+ * @sa NurExtTagBusRead()
+ */
+struct NUR_EXT_BUS_TAG
+{
+	ULONGLONG seq;				/**< Bus sequence number of the tag, from 0. A gap means tags were lost. */
+	ULONGLONG rxTimeNs;			/**< Host receive time, see NurExtDrainTagsEx(). CLOCK_MONOTONIC is shared by all processes of the host. */
+	struct NUR_TAG_DATA_EX tag;	/**< The tag. Last, so that a smaller entry size truncates it. */
+};
+
+/**
+ * Tag bus subscriber counters.
+ * @sa NurExtTagBusGetStats()
+ */
+struct NUR_EXT_TAGBUS_STATS
+{
+	DWORD capacity;				/**< Bus capacity in tags. */
+	DWORD publisherPid;			/**< Process id of the publisher. */
+	ULONGLONG published;		/**< Tags published since the bus was created. */
+	ULONGLONG received;			/**< Tags read by this subscriber. */
+	ULONGLONG lost;				/**< Tags overwritten before this subscriber read them. */
+	BOOL closed;				/**< Publisher has stopped; open the bus again to follow a new publisher. */
+};
+
+/** @fn int NurExtTagBusPublish(HANDLE hApi, const char *name, int capacity)
+ *
+ * Publish the tags of the handle in a POSIX shared memory segment, read by any number of local processes with
+ * NurExtTagBusOpen() and NurExtTagBusRead(). Every tag drained from the tag storage of the handle is published:
+ * on the NurApi notification thread for NUR_NOTIFICATION_INVENTORYSTREAM and NUR_NOTIFICATION_INVENTORYEX, and by
+ * NurExtDrainTags(), NurExtEnableTagRing() and NurExtStreamGroupAdd() if the application also drains the handle.
+ *
+ * The bus is a ring written by the publisher only. The publisher never waits for subscribers: a subscriber that
+ * falls more than <i>capacity</i> tags behind loses the oldest, counted in NUR_EXT_TAGBUS_STATS.lost.
+ * The segment is removed when publishing stops, by NurExtFree() at the latest.
+ *
+ * Use NurExtSetNotificationCallback() instead of NurApiSetNotificationCallback() while publishing.
+ *
+ * @sa NurExtTagBusOpen(), NurExtTagBusRead()
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	name		Shared memory object name, e.g. "/nur0". Replaces an object of the same name left by a stopped publisher.
+ * @param	capacity	Bus capacity in tags, rounded up to power of two. 0 to stop publishing.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if another handle or process publishes the name. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtTagBusPublish(HANDLE hApi, const char *name, int capacity);
+
+/** @fn HANDLE NurExtTagBusOpen(const char *name)
+ *
+ * Subscribe to a tag bus published by NurExtTagBusPublish() in this or another process.
+ * Reading starts from the next tag published.
+ *
+ * @param	name	Shared memory object name given to NurExtTagBusPublish().
+ *
+ * @return	Subscriber handle, or NULL if there is no bus of the name.
+ */
+HANDLE NURAPICONV NurExtTagBusOpen(const char *name);
+
+/** @fn int NurExtTagBusClose(HANDLE hBus)
+ *
+ * Unsubscribe and free the subscriber handle.
+ *
+ * @param	hBus	Subscriber handle.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtTagBusClose(HANDLE hBus);
+
+/** @fn int NurExtTagBusRead(HANDLE hBus, struct NUR_EXT_BUS_TAG *tagBuffer, int *tagCount, DWORD szSingleEntry, DWORD timeoutMs)
+ *
+ * Read published tags directly from the shared memory. Waits up to <i>timeoutMs</i> for at least one tag.
+ * Call from one thread at a time per subscriber handle.
+ *
+ * @param	hBus			Subscriber handle.
+ * @param	tagBuffer		Pointer to NUR_EXT_BUS_TAG structures. Must contain at least <i>tagCount</i> entries.
+ * @param	tagCount		Number of entries in <i>tagBuffer</i>. On return number of valid entries is received in this pointer, 0 on timeout.
+ * @param	szSingleEntry	Size of one NUR_EXT_BUS_TAG entry.
+ * @param	timeoutMs		Time to wait in milliseconds, 0 = do not wait.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_TR_NOT_CONNECTED if the publisher has stopped and all tags are read. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtTagBusRead(HANDLE hBus, struct NUR_EXT_BUS_TAG *tagBuffer, int *tagCount, DWORD szSingleEntry, DWORD timeoutMs);
+
+/** @fn int NurExtTagBusGetStats(HANDLE hBus, struct NUR_EXT_TAGBUS_STATS *stats, DWORD szStats)
+ *
+ * Get tag bus counters of a subscriber.
+ *
+ * @param	hBus	Subscriber handle.
+ * @param	stats	Pointer to the NUR_EXT_TAGBUS_STATS structure.
+ * @param	szStats	sizeof(struct NUR_EXT_TAGBUS_STATS)
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtTagBusGetStats(HANDLE hBus, struct NUR_EXT_TAGBUS_STATS *stats, DWORD szStats);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,179 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <string.h>
+#include <algorithm>
+
+/// <summary>
+/// Copies pending tags to the caller's buffer. Caller holds ctx->drainLock.
+/// </summary>
+/// <returns>Number of tags copied.</returns>
+static int TakePending(NurExtContext *ctx, BYTE *dst, ULONGLONG *rxTimeNs, int capacity, DWORD szSingleEntry)
+{
+	int count = (int)std::min(ctx->drainPending.size() - ctx->drainPendingPos, (size_t)capacity);
+
+	if (count <= 0)
+		return 0;
+
+	const struct NUR_TAG_DATA_EX *src = &ctx->drainPending[ctx->drainPendingPos];
+
+	if (szSingleEntry == sizeof(struct NUR_TAG_DATA_EX))
+	{
+		memcpy(dst, src, count * sizeof(struct NUR_TAG_DATA_EX));
+	}
+	else
+	{
+		// Caller built against an older, smaller NUR_TAG_DATA_EX
+		for (int i = 0; i < count; i++)
+			memcpy(dst + i * szSingleEntry, &src[i], szSingleEntry);
+	}
+	if (rxTimeNs)
+		memcpy(rxTimeNs, &ctx->drainPendingTime[ctx->drainPendingPos], count * sizeof(ULONGLONG));
+
+	ctx->drainPendingPos += count;
+	if (ctx->drainPendingPos == ctx->drainPending.size())
+	{
+		ctx->drainPending.clear();
+		ctx->drainPendingTime.clear();
+		ctx->drainPendingPos = 0;
+	}
+	return count;
+}
+
+/// <summary>
+/// Moves the whole tag storage to the pending list. Caller holds ctx->drainLock and the tag storage lock.
+/// </summary>
+static int StorageToPending(NurExtContext *ctx, int count, ULONGLONG rxTimeNs)
+{
+	if (ctx->drainPendingPos > 0)
+	{
+		ctx->drainPending.erase(ctx->drainPending.begin(), ctx->drainPending.begin() + ctx->drainPendingPos);
+		ctx->drainPendingTime.erase(ctx->drainPendingTime.begin(), ctx->drainPendingTime.begin() + ctx->drainPendingPos);
+		ctx->drainPendingPos = 0;
+	}
+
+	size_t first = ctx->drainPending.size();
+	ctx->drainPending.resize(first + count);
+	int error = NurApiGetAllTagDataEx(ctx->hApi, &ctx->drainPending[first], &count, sizeof(struct NUR_TAG_DATA_EX));
+	if (error == NUR_NO_ERROR)
+	{
+		NurExtSplitLearnTags(ctx, (BYTE*)&ctx->drainPending[first], count, sizeof(struct NUR_TAG_DATA_EX));
+		count = NurExtIndexTags(ctx, (BYTE*)&ctx->drainPending[first], count, sizeof(struct NUR_TAG_DATA_EX));
+		count = NurExtDedupTags(ctx, (BYTE*)&ctx->drainPending[first], count, sizeof(struct NUR_TAG_DATA_EX), rxTimeNs);
+		NurExtTagBusPublishTags(ctx, (BYTE*)&ctx->drainPending[first], count, sizeof(struct NUR_TAG_DATA_EX), rxTimeNs);
+		NurExtFanoutPublishTags(ctx, (BYTE*)&ctx->drainPending[first], count, sizeof(struct NUR_TAG_DATA_EX), rxTimeNs);
+	}
+	ctx->drainPending.resize(first + (error == NUR_NO_ERROR ? count : 0));
+	ctx->drainPendingTime.resize(ctx->drainPending.size(), rxTimeNs);
+	return error;
+}
+
+/// <summary>
+/// Logs the drained tags with NUR_EXT_LOGEV_TAG. EPC is truncated to the arguments left.
+/// </summary>
+static void LogTags(NurExtContext *ctx, const BYTE *tags, int count, DWORD szSingleEntry)
+{
+	const int epcArgs = NUR_EXT_LOG_MAX_ARGS - 3;
+
+	for (int i = 0; i < count; i++)
+	{
+		const struct NUR_TAG_DATA_EX *tag = (const struct NUR_TAG_DATA_EX *)(tags + i * szSingleEntry);
+		ULONGLONG args[NUR_EXT_LOG_MAX_ARGS] = { tag->antennaId, (ULONGLONG)tag->rssi, (ULONGLONG)std::min((int)tag->epcLen, epcArgs * 8) };
+		memcpy(&args[3], tag->epc, (size_t)args[2]);
+		NurExtLogEvent(ctx->hApi, NUR_LOG_DATA, NUR_EXT_LOGEV_TAG, args, NUR_EXT_LOG_MAX_ARGS);
+	}
+}
+
+int NurExtDrainContext(NurExtContext *ctx, struct NUR_TAG_DATA_EX *tagDataBuffer, ULONGLONG *rxTimeNs, int *tagDataCount, DWORD szSingleEntry)
+{
+	HANDLE hApi = ctx->hApi;
+	BYTE *dst = (BYTE*)tagDataBuffer;
+	int capacity, stored = 0;
+	int error;
+
+	if (!tagDataBuffer || !tagDataCount || *tagDataCount < 0
+		|| szSingleEntry == 0 || szSingleEntry > sizeof(struct NUR_TAG_DATA_EX))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	capacity = *tagDataCount;
+	*tagDataCount = 0;
+
+	std::lock_guard<std::mutex> guard(ctx->drainLock);
+
+	error = NurApiLockTagStorage(hApi, TRUE);
+	if (error != NUR_NO_ERROR)
+		return error;
+
+	error = NurApiGetTagCount(hApi, &stored);
+	if (error == NUR_NO_ERROR && stored > 0)
+	{
+		// Tags stored without a stream notification, e.g. by NurApiFetchTags(), arrived just now
+		ULONGLONG rx = ctx->tagRxNs.exchange(0, std::memory_order_relaxed);
+		if (rx == 0)
+			rx = NurExtGetMonotonicNs();
+
+		if (ctx->drainPending.empty() && stored <= capacity)
+		{
+			// Common case: straight to the caller's buffer
+			error = NurApiGetAllTagDataEx(hApi, tagDataBuffer, &stored, szSingleEntry);
+			if (error == NUR_NO_ERROR)
+			{
+				NurExtSplitLearnTags(ctx, dst, stored, szSingleEntry);
+				*tagDataCount = NurExtIndexTags(ctx, dst, stored, szSingleEntry);
+				*tagDataCount = NurExtDedupTags(ctx, dst, *tagDataCount, szSingleEntry, rx);
+				NurExtTagBusPublishTags(ctx, dst, *tagDataCount, szSingleEntry, rx);
+				NurExtFanoutPublishTags(ctx, dst, *tagDataCount, szSingleEntry, rx);
+			}
+			if (rxTimeNs)
+				std::fill(rxTimeNs, rxTimeNs + *tagDataCount, rx);
+		}
+		else
+		{
+			error = StorageToPending(ctx, stored, rx);
+		}
+
+		// NurApiClearTags() clears the module tag buffer instead when the storage is empty, so only call it with tags stored
+		if (error == NUR_NO_ERROR)
+			error = NurApiClearTags(hApi);
+	}
+	NurApiLockTagStorage(hApi, FALSE);
+
+	if (*tagDataCount == 0)
+		*tagDataCount = TakePending(ctx, dst, rxTimeNs, capacity, szSingleEntry);
+
+	if (NurExtLogEnabled(NUR_LOG_DATA))
+		LogTags(ctx, dst, *tagDataCount, szSingleEntry);
+	return error;
+}
+
+int NURAPICONV NurExtDrainTags(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, int *tagDataCount, DWORD szSingleEntry)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	return NurExtDrainContext(ctx.get(), tagDataBuffer, NULL, tagDataCount, szSingleEntry);
+}
+
+int NURAPICONV NurExtDrainTagsEx(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, ULONGLONG *rxTimeNs, int *tagDataCount, DWORD szSingleEntry)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	return NurExtDrainContext(ctx.get(), tagDataBuffer, rxTimeNs, tagDataCount, szSingleEntry);
+}
+
+int NURAPICONV NurExtGetDrainPending(HANDLE hApi, int *count)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!count)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::lock_guard<std::mutex> guard(ctx->drainLock);
+	*count = (int)(ctx->drainPending.size() - ctx->drainPendingPos);
+	return NUR_NO_ERROR;
+}
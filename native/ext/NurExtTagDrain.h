@@ -0,0 +1,79 @@
+/*
+ * NurExtTagDrain.h
+ *
+ *  Bulk transfer of the NurApi tag storage to the application.
+ */
+
+#ifndef _NUREXTTAGDRAIN_H_
+#define _NUREXTTAGDRAIN_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** @fn int NurExtDrainTags(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, int *tagDataCount, DWORD szSingleEntry)
+ *
+ * Move all tags from the NurApi tag storage to the caller's buffer and leave the storage empty.
+ * Replaces the NurApiLockTagStorage(), NurApiGetTagCount(), NurApiGetTagDataEx() per index, NurApiClearTags() sequence
+ * typically done on NUR_NOTIFICATION_INVENTORYSTREAM: the storage is locked once and copied with one bulk copy.
+ *
+ * If the storage holds more tags than fit in <i>tagDataBuffer</i>, the storage is still emptied and the excess is kept
+ * by the extension. Those tags are returned first by the next call, no tags are lost.
+ *
+ * @sa NurExtGetDrainPending(), NurApiGetAllTagDataEx(), NurApiClearTags()
+ *
+ * @param	hApi				Handle to valid NurApi object instance.
+ * @param	tagDataBuffer		Pointer to a NUR_TAG_DATA_EX structures. Must contain at least <i>tagDataCount</i> entries.
+ * @param	tagDataCount		Number of entries in <i>tagDataBuffer</i>. On return number of valid entries is received in this pointer.
+ * @param	szSingleEntry		Size of one NUR_TAG_DATA_EX entry.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtDrainTags(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, int *tagDataCount, DWORD szSingleEntry);
+
+/** @fn int NurExtDrainTagsEx(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, ULONGLONG *rxTimeNs, int *tagDataCount, DWORD szSingleEntry)
+ *
+ * NurExtDrainTags() with the host receive time of each tag. NUR_TAG_DATA_EX.timestamp is a 16-bit millisecond
+ * module time that wraps every 65 seconds; the receive time is a nanosecond NurExtGetMonotonicNs() value.
+ *
+ * Tags stored by NUR_NOTIFICATION_INVENTORYSTREAM or NUR_NOTIFICATION_INVENTORYEX get the NurExtGetNotificationTime()
+ * of the latest such notification before the drain, which requires NurExtSetNotificationCallback().
+ * Tags stored otherwise, e.g. by NurApiFetchTags(), get the time of the drain.
+ *
+ * @sa NurExtDrainTags(), NurExtReadTagRingEx()
+ *
+ * @param	hApi				Handle to valid NurApi object instance.
+ * @param	tagDataBuffer		Pointer to a NUR_TAG_DATA_EX structures. Must contain at least <i>tagDataCount</i> entries.
+ * @param	rxTimeNs			Receive time of each returned tag is received here. Must contain at least <i>tagDataCount</i> entries. May be NULL.
+ * @param	tagDataCount		Number of entries in <i>tagDataBuffer</i>. On return number of valid entries is received in this pointer.
+ * @param	szSingleEntry		Size of one NUR_TAG_DATA_EX entry.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtDrainTagsEx(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, ULONGLONG *rxTimeNs, int *tagDataCount, DWORD szSingleEntry);
+
+/** @fn int NurExtGetDrainPending(HANDLE hApi, int *count)
+ *
+ * Get number of tags already removed from the tag storage by NurExtDrainTags() but not yet returned,
+ * because the caller's buffer was too small.
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	count		Number of pending tags is received in this pointer.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetDrainPending(HANDLE hApi, int *count);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,270 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <string.h>
+#include <algorithm>
+
+#define SNAPSHOT_MAGIC		0x4e455853
+
+/// <summary>
+/// NurExtGetTagIndexSnapshot() view. Shares the shard data that was current when taken.
+/// </summary>
+struct NurExtIndexSnapshot
+{
+	DWORD magic;
+	std::shared_ptr<const NurExtIndexData> shards[NUR_EXT_INDEX_SHARDS];
+	int offsets[NUR_EXT_INDEX_SHARDS + 1];	// Position of the first tag of each shard in the snapshot
+};
+
+static int ShardOf(const std::string &key)
+{
+	return (int)(std::hash<std::string>()(key) % NUR_EXT_INDEX_SHARDS);
+}
+
+/// <summary>
+/// Shard data the writer may change. Caller holds the shard lock.
+/// </summary>
+static NurExtIndexData *WritableShard(NurExtIndexShard &shard)
+{
+	// Not use_count(): it does not order the writes after the last reads of a snapshot freed on another thread
+	if (!shard.data)
+		shard.data = std::make_shared<NurExtIndexData>();
+	else if (shard.shared)
+		shard.data = std::make_shared<NurExtIndexData>(*shard.data);	// Copy on write, snapshots keep the old
+	shard.shared = false;
+	return shard.data.get();
+}
+
+int NurExtIndexTags(NurExtContext *ctx, BYTE *tags, int count, DWORD szEntry)
+{
+	std::lock_guard<std::mutex> guard(ctx->indexLock);
+	DWORD mode = ctx->indexMode.load(std::memory_order_relaxed);
+	int kept = 0;
+
+	if (mode == NUR_EXT_TAGINDEX_OFF)
+		return count;
+
+	for (int i = 0; i < count; i++)
+	{
+		BYTE *entry = tags + i * szEntry;
+		const struct NUR_TAG_DATA_EX *tag = (const struct NUR_TAG_DATA_EX *)entry;
+		std::string key((const char *)tag->epc, tag->epcLen);
+		NurExtIndexShard &shard = ctx->indexShards[ShardOf(key)];
+		bool inserted;
+
+		{
+			std::lock_guard<std::mutex> shardGuard(shard.lock);
+			NurExtIndexData *data = WritableShard(shard);
+			std::pair<std::unordered_map<std::string, size_t>::iterator, bool> res =
+				data->map.insert(std::make_pair(key, data->tags.size()));
+			inserted = res.second;
+			if (inserted)
+			{
+				// New EPC; entry may be an older, smaller NUR_TAG_DATA_EX
+				data->tags.push_back(NUR_TAG_DATA_EX());
+				memset(&data->tags.back(), 0, sizeof(struct NUR_TAG_DATA_EX));
+				ctx->indexCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			memcpy(&data->tags[res.first->second], entry, szEntry);
+		}
+
+		// Update in place: duplicate only refreshed the record, drop it from the array
+		if (!inserted && (mode & NUR_EXT_TAGINDEX_UNIQUE))
+			continue;
+
+		if (kept != i)
+			memmove(tags + kept * szEntry, entry, szEntry);
+		kept++;
+	}
+	return kept;
+}
+
+/// <summary>
+/// Removes all tags. Caller holds ctx->indexLock.
+/// </summary>
+static void ClearShards(NurExtContext *ctx)
+{
+	for (int i = 0; i < NUR_EXT_INDEX_SHARDS; i++)
+	{
+		std::lock_guard<std::mutex> guard(ctx->indexShards[i].lock);
+		ctx->indexShards[i].data.reset();
+		ctx->indexShards[i].shared = false;
+	}
+	ctx->indexCount.store(0, std::memory_order_relaxed);
+}
+
+int NURAPICONV NurExtSetTagIndexMode(HANDLE hApi, DWORD mode)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (mode & ~(NUR_EXT_TAGINDEX_ON | NUR_EXT_TAGINDEX_UNIQUE))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	if (mode & NUR_EXT_TAGINDEX_UNIQUE)
+		mode |= NUR_EXT_TAGINDEX_ON;
+
+	std::lock_guard<std::mutex> guard(ctx->indexLock);
+	ctx->indexMode.store(mode, std::memory_order_relaxed);
+	if (mode == NUR_EXT_TAGINDEX_OFF)
+		ClearShards(ctx.get());
+	return NUR_NO_ERROR;
+}
+
+/// <summary>
+/// Looks up an EPC in shard data.
+/// </summary>
+static int FindTag(const NurExtIndexData *data, const std::string &key, struct NUR_TAG_DATA_EX *tagDataEx, DWORD szEntry)
+{
+	if (!data)
+		return NUR_ERROR_NO_TAG;
+
+	std::unordered_map<std::string, size_t>::const_iterator it = data->map.find(key);
+	if (it == data->map.end())
+		return NUR_ERROR_NO_TAG;
+
+	if (tagDataEx)
+		memcpy(tagDataEx, &data->tags[it->second], szEntry);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetTagByEPC(HANDLE hApi, const BYTE *epc, int epcLen, struct NUR_TAG_DATA_EX *tagDataEx, DWORD szEntry)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!epc || epcLen < 0 || epcLen > NUR_MAX_EPC_LENGTH_EX
+		|| (tagDataEx && (szEntry == 0 || szEntry > sizeof(struct NUR_TAG_DATA_EX))))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	// Only the EPC's shard is locked, the writer continues with the others
+	std::string key((const char *)epc, epcLen);
+	NurExtIndexShard &shard = ctx->indexShards[ShardOf(key)];
+	std::lock_guard<std::mutex> guard(shard.lock);
+	return FindTag(shard.data.get(), key, tagDataEx, szEntry);
+}
+
+int NURAPICONV NurExtGetTagIndexCount(HANDLE hApi, int *count)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!count)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	*count = ctx->indexCount.load(std::memory_order_relaxed);
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtClearTagIndex(HANDLE hApi)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	std::lock_guard<std::mutex> guard(ctx->indexLock);
+	ClearShards(ctx.get());
+	return NUR_NO_ERROR;
+}
+
+HANDLE NURAPICONV NurExtGetTagIndexSnapshot(HANDLE hApi)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+
+	if (!ctx)
+		return NULL;
+
+	NurExtIndexSnapshot *snap = new NurExtIndexSnapshot();
+	snap->magic = SNAPSHOT_MAGIC;
+	snap->offsets[0] = 0;
+	{
+		// Between the writer's batches; only the shard pointers are taken
+		std::lock_guard<std::mutex> guard(ctx->indexLock);
+		for (int i = 0; i < NUR_EXT_INDEX_SHARDS; i++)
+		{
+			std::lock_guard<std::mutex> shardGuard(ctx->indexShards[i].lock);
+			snap->shards[i] = ctx->indexShards[i].data;
+			ctx->indexShards[i].shared = (snap->shards[i] != NULL);
+		}
+	}
+	for (int i = 0; i < NUR_EXT_INDEX_SHARDS; i++)
+		snap->offsets[i + 1] = snap->offsets[i] + (snap->shards[i] ? (int)snap->shards[i]->tags.size() : 0);
+	return (HANDLE)snap;
+}
+
+static NurExtIndexSnapshot *GetSnapshot(HANDLE hSnapshot)
+{
+	NurExtIndexSnapshot *snap = (NurExtIndexSnapshot *)hSnapshot;
+	if (snap == NULL || snap == INVALID_HANDLE_VALUE || snap->magic != SNAPSHOT_MAGIC)
+		return NULL;
+	return snap;
+}
+
+int NURAPICONV NurExtFreeTagIndexSnapshot(HANDLE hSnapshot)
+{
+	NurExtIndexSnapshot *snap = GetSnapshot(hSnapshot);
+
+	if (!snap)
+		return NUR_ERROR_INVALID_HANDLE;
+
+	snap->magic = 0;
+	delete snap;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetSnapshotCount(HANDLE hSnapshot, int *count)
+{
+	NurExtIndexSnapshot *snap = GetSnapshot(hSnapshot);
+
+	if (!snap)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!count)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	*count = snap->offsets[NUR_EXT_INDEX_SHARDS];
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetSnapshotTags(HANDLE hSnapshot, int first, struct NUR_TAG_DATA_EX *tagDataBuffer, int *tagDataCount, DWORD szSingleEntry)
+{
+	NurExtIndexSnapshot *snap = GetSnapshot(hSnapshot);
+	BYTE *dst = (BYTE *)tagDataBuffer;
+
+	if (!snap)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!tagDataBuffer || !tagDataCount || *tagDataCount < 0 || first < 0
+		|| szSingleEntry == 0 || szSingleEntry > sizeof(struct NUR_TAG_DATA_EX))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	int total = snap->offsets[NUR_EXT_INDEX_SHARDS];
+	int n = (first < total) ? std::min(*tagDataCount, total - first) : 0;
+	int shard = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		int pos = first + i;
+		while (pos >= snap->offsets[shard + 1])
+			shard++;
+		memcpy(dst + i * szSingleEntry, &snap->shards[shard]->tags[pos - snap->offsets[shard]], szSingleEntry);
+	}
+	*tagDataCount = n;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetSnapshotTagByEPC(HANDLE hSnapshot, const BYTE *epc, int epcLen, struct NUR_TAG_DATA_EX *tagDataEx, DWORD szEntry)
+{
+	NurExtIndexSnapshot *snap = GetSnapshot(hSnapshot);
+
+	if (!snap)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!epc || epcLen < 0 || epcLen > NUR_MAX_EPC_LENGTH_EX
+		|| (tagDataEx && (szEntry == 0 || szEntry > sizeof(struct NUR_TAG_DATA_EX))))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	std::string key((const char *)epc, epcLen);
+	return FindTag(snap->shards[ShardOf(key)].get(), key, tagDataEx, szEntry);
+}
@@ -0,0 +1,153 @@
+/*
+ * NurExtTagIndex.h
+ *
+ *  EPC keyed index of drained tags.
+ */
+
+#ifndef _NUREXTTAGINDEX_H_
+#define _NUREXTTAGINDEX_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Tag index disabled. Default. */
+#define NUR_EXT_TAGINDEX_OFF			0
+/** Every tag returned by NurExtDrainTags() is added to the EPC index. A tag already in the index updates its record in place. */
+#define NUR_EXT_TAGINDEX_ON				(1<<0)
+/** Update in place: NurExtDrainTags() returns only tags not yet in the index, duplicates only refresh the index record. Implies NUR_EXT_TAGINDEX_ON. */
+#define NUR_EXT_TAGINDEX_UNIQUE			(1<<1)
+
+/** @fn int NurExtSetTagIndexMode(HANDLE hApi, DWORD mode)
+ *
+ * Set EPC index mode. Indexed tags can be looked up in constant time with NurExtGetTagByEPC().
+ * Disabling the index also clears it.
+ *
+ * The index is split into shards by EPC hash. A lookup locks only the shard of the EPC, so lookups from
+ * several threads rarely wait for each other or for the drain adding tags. Use NurExtGetTagIndexSnapshot()
+ * to go through all tags.
+ *
+ * @sa NurExtDrainTags(), NurExtGetTagByEPC()
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	mode	NUR_EXT_TAGINDEX_OFF or combination of NUR_EXT_TAGINDEX_ON and NUR_EXT_TAGINDEX_UNIQUE.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtSetTagIndexMode(HANDLE hApi, DWORD mode);
+
+/** @fn int NurExtGetTagByEPC(HANDLE hApi, const BYTE *epc, int epcLen, struct NUR_TAG_DATA_EX *tagDataEx, DWORD szEntry)
+ *
+ * Get the latest record of a tag by EPC from the index.
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	epc			EPC bytes.
+ * @param	epcLen		Number of EPC bytes.
+ * @param	tagDataEx	Pointer to NUR_TAG_DATA_EX structure where the record is stored. May be NULL to only test presence.
+ * @param	szEntry		Size of the entry.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NO_TAG if the EPC is not in the index. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetTagByEPC(HANDLE hApi, const BYTE *epc, int epcLen, struct NUR_TAG_DATA_EX *tagDataEx, DWORD szEntry);
+
+/** @fn int NurExtGetTagIndexCount(HANDLE hApi, int *count)
+ *
+ * Get number of unique EPCs in the index.
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	count	Number of indexed tags is received in this pointer.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetTagIndexCount(HANDLE hApi, int *count);
+
+/** @fn int NurExtClearTagIndex(HANDLE hApi)
+ *
+ * Remove all tags from the index. Mode is not changed.
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtClearTagIndex(HANDLE hApi);
+
+/** @fn HANDLE NurExtGetTagIndexSnapshot(HANDLE hApi)
+ *
+ * Take an immutable view of all tags in the index. The view is consistent: it holds the index between two drains.
+ * Taking it only waits for a drain in progress and costs a few pointer copies; the drain goes on updating the
+ * index meanwhile, copying a shard the first time it changes one held by a snapshot. Free snapshots when done,
+ * each holds its view in memory.
+ *
+ * A snapshot may be read from several threads at the same time without locking.
+ *
+ * @sa NurExtGetSnapshotCount(), NurExtGetSnapshotTags(), NurExtGetSnapshotTagByEPC(), NurExtFreeTagIndexSnapshot()
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Snapshot handle, or NULL if the handle is not valid.
+ */
+HANDLE NURAPICONV NurExtGetTagIndexSnapshot(HANDLE hApi);
+
+/** @fn int NurExtFreeTagIndexSnapshot(HANDLE hSnapshot)
+ *
+ * Free a snapshot taken with NurExtGetTagIndexSnapshot().
+ *
+ * @param	hSnapshot	Snapshot handle.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtFreeTagIndexSnapshot(HANDLE hSnapshot);
+
+/** @fn int NurExtGetSnapshotCount(HANDLE hSnapshot, int *count)
+ *
+ * Get number of unique EPCs in a snapshot.
+ *
+ * @param	hSnapshot	Snapshot handle.
+ * @param	count		Number of tags is received in this pointer.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetSnapshotCount(HANDLE hSnapshot, int *count);
+
+/** @fn int NurExtGetSnapshotTags(HANDLE hSnapshot, int first, struct NUR_TAG_DATA_EX *tagDataBuffer, int *tagDataCount, DWORD szSingleEntry)
+ *
+ * Copy tags of a snapshot, from position <i>first</i> of 0 to NurExtGetSnapshotCount() - 1. Positions are
+ * stable within a snapshot; the order is by shard, then by first read.
+ *
+ * @param	hSnapshot			Snapshot handle.
+ * @param	first				Position of the first tag to copy.
+ * @param	tagDataBuffer		Pointer to a NUR_TAG_DATA_EX structures. Must contain at least <i>tagDataCount</i> entries.
+ * @param	tagDataCount		Number of entries in <i>tagDataBuffer</i>. On return number of valid entries is received in this pointer.
+ * @param	szSingleEntry		Size of one NUR_TAG_DATA_EX entry.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetSnapshotTags(HANDLE hSnapshot, int first, struct NUR_TAG_DATA_EX *tagDataBuffer, int *tagDataCount, DWORD szSingleEntry);
+
+/** @fn int NurExtGetSnapshotTagByEPC(HANDLE hSnapshot, const BYTE *epc, int epcLen, struct NUR_TAG_DATA_EX *tagDataEx, DWORD szEntry)
+ *
+ * Get the record of a tag by EPC from a snapshot.
+ *
+ * @param	hSnapshot	Snapshot handle.
+ * @param	epc			EPC bytes.
+ * @param	epcLen		Number of EPC bytes.
+ * @param	tagDataEx	Pointer to NUR_TAG_DATA_EX structure where the record is stored. May be NULL to only test presence.
+ * @param	szEntry		Size of the entry.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NO_TAG if the EPC is not in the snapshot. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetSnapshotTagByEPC(HANDLE hSnapshot, const BYTE *epc, int epcLen, struct NUR_TAG_DATA_EX *tagDataEx, DWORD szEntry);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
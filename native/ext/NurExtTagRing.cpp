@@ -0,0 +1,153 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <string.h>
+#include <algorithm>
+
+#define TAGRING_MAX_CAPACITY	(1 << 24)
+
+/// <summary>
+/// Publishes tags to the ring. Only called by the producer.
+/// </summary>
+/// <returns>Number of tags published, rest were dropped.</returns>
+static int RingPush(NurExtTagRing *ring, const struct NUR_TAG_DATA_EX *tags, const ULONGLONG *rxTimes, int count)
+{
+	ULONGLONG head = ring->head.load(std::memory_order_relaxed);
+	ULONGLONG tail = ring->tail.load(std::memory_order_acquire);
+	size_t capacity = ring->tags.size();
+	int n = (int)std::min((ULONGLONG)count, capacity - (head - tail));
+
+	// Copy in at most two pieces: up to the end of the ring, then from the start
+	size_t pos = (size_t)(head & ring->mask);
+	size_t first = std::min((size_t)n, capacity - pos);
+	memcpy(&ring->tags[pos], tags, first * sizeof(struct NUR_TAG_DATA_EX));
+	memcpy(&ring->tags[0], tags + first, (n - first) * sizeof(struct NUR_TAG_DATA_EX));
+	memcpy(&ring->rxTimes[pos], rxTimes, first * sizeof(ULONGLONG));
+	memcpy(&ring->rxTimes[0], rxTimes + first, (n - first) * sizeof(ULONGLONG));
+	ring->head.store(head + n, std::memory_order_release);
+
+	if (n < count)
+		ring->overflow.fetch_add(count - n, std::memory_order_relaxed);
+
+	DWORD used = (DWORD)(head + n - tail);
+	if (used > ring->highWater.load(std::memory_order_relaxed))
+		ring->highWater.store(used, std::memory_order_relaxed);
+	return n;
+}
+
+bool NurExtTagRingProduce(NurExtContext *ctx)
+{
+	std::lock_guard<std::mutex> guard(ctx->ringLock);
+	NurExtTagRing *ring = ctx->ring.get();
+	int count;
+
+	if (!ring)
+		return false;
+
+	do
+	{
+		count = (int)ring->staging.size();
+		if (NurExtDrainContext(ctx, ring->staging.data(), ring->stagingTimes.data(), &count, sizeof(struct NUR_TAG_DATA_EX)) != NUR_NO_ERROR)
+			break;
+		RingPush(ring, ring->staging.data(), ring->stagingTimes.data(), count);
+	} while (count == (int)ring->staging.size());
+	return true;
+}
+
+int NURAPICONV NurExtEnableTagRing(HANDLE hApi, int capacity)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	size_t size = 1;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (capacity < 0 || capacity > TAGRING_MAX_CAPACITY)
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	while ((int)size < capacity)
+		size <<= 1;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->ringLock);
+		if (capacity == 0)
+			ctx->ring.reset();
+		else
+			ctx->ring.reset(new NurExtTagRing(size));
+	}
+
+	return (capacity > 0) ? NurExtInstallDispatcher(ctx.get()) : NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtReadTagRing(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, int *tagDataCount, DWORD szSingleEntry)
+{
+	return NurExtReadTagRingEx(hApi, tagDataBuffer, NULL, tagDataCount, szSingleEntry);
+}
+
+int NURAPICONV NurExtReadTagRingEx(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, ULONGLONG *rxTimeNs, int *tagDataCount, DWORD szSingleEntry)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	BYTE *dst = (BYTE*)tagDataBuffer;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!tagDataBuffer || !tagDataCount || *tagDataCount < 0
+		|| szSingleEntry == 0 || szSingleEntry > sizeof(struct NUR_TAG_DATA_EX))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	// Ring is only replaced on this thread, see NurExtEnableTagRing()
+	NurExtTagRing *ring = ctx->ring.get();
+	if (!ring)
+		return NUR_ERROR_NOT_READY;
+
+	ULONGLONG tail = ring->tail.load(std::memory_order_relaxed);
+	ULONGLONG head = ring->head.load(std::memory_order_acquire);
+	int n = (int)std::min(head - tail, (ULONGLONG)*tagDataCount);
+	size_t pos = (size_t)(tail & ring->mask);
+	size_t first = std::min((size_t)n, ring->tags.size() - pos);
+
+	if (szSingleEntry == sizeof(struct NUR_TAG_DATA_EX))
+	{
+		memcpy(dst, &ring->tags[pos], first * sizeof(struct NUR_TAG_DATA_EX));
+		memcpy(dst + first * sizeof(struct NUR_TAG_DATA_EX), &ring->tags[0], (n - first) * sizeof(struct NUR_TAG_DATA_EX));
+	}
+	else
+	{
+		for (int i = 0; i < n; i++)
+			memcpy(dst + i * szSingleEntry, &ring->tags[(size_t)((tail + i) & ring->mask)], szSingleEntry);
+	}
+	if (rxTimeNs)
+	{
+		memcpy(rxTimeNs, &ring->rxTimes[pos], first * sizeof(ULONGLONG));
+		memcpy(rxTimeNs + first, &ring->rxTimes[0], (n - first) * sizeof(ULONGLONG));
+	}
+	ring->tail.store(tail + n, std::memory_order_release);
+
+	*tagDataCount = n;
+	return NUR_NO_ERROR;
+}
+
+int NURAPICONV NurExtGetTagRingStats(HANDLE hApi, struct NUR_EXT_TAGRING_STATS *stats, DWORD szStats)
+{
+	std::shared_ptr<NurExtContext> ctx = NurExtGetContext(hApi);
+	struct NUR_EXT_TAGRING_STATS tmp;
+
+	if (!ctx)
+		return NUR_ERROR_INVALID_HANDLE;
+	if (!stats || szStats == 0 || szStats > sizeof(tmp))
+		return NUR_ERROR_INVALID_PARAMETER;
+
+	// Any thread may ask; the lock keeps the ring from being disabled and freed meanwhile
+	std::lock_guard<std::mutex> guard(ctx->ringLock);
+	NurExtTagRing *ring = ctx->ring.get();
+	if (!ring)
+		return NUR_ERROR_NOT_READY;
+
+	tmp.popped = ring->tail.load(std::memory_order_acquire);
+	tmp.pushed = ring->head.load(std::memory_order_acquire);
+	tmp.capacity = (DWORD)ring->tags.size();
+	tmp.count = (DWORD)(tmp.pushed - tmp.popped);
+	tmp.highWater = ring->highWater.load(std::memory_order_relaxed);
+	tmp.overflow = ring->overflow.load(std::memory_order_relaxed);
+	memcpy(stats, &tmp, szStats);
+	return NUR_NO_ERROR;
+}
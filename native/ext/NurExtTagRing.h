@@ -0,0 +1,100 @@
+/*
+ * NurExtTagRing.h
+ *
+ *  Lock-free single producer / single consumer tag ring fed from stream notifications.
+ */
+
+#ifndef _NUREXTTAGRING_H_
+#define _NUREXTTAGRING_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/**
+ * Tag ring counters.
+ * @sa NurExtGetTagRingStats()
+ */
+struct NUR_EXT_TAGRING_STATS
+{
+	DWORD capacity;			/**< Ring capacity in tags. */
+	DWORD count;			/**< Tags currently in the ring. */
+	DWORD highWater;		/**< Highest number of tags in the ring since enabled. */
+	ULONGLONG pushed;		/**< Tags added to the ring. */
+	ULONGLONG popped;		/**< Tags read from the ring. */
+	ULONGLONG overflow;		/**< Tags dropped because the ring was full. */
+};
+
+/** @fn int NurExtEnableTagRing(HANDLE hApi, int capacity)
+ *
+ * Enable or disable the tag ring. When enabled, tags of every NUR_NOTIFICATION_INVENTORYSTREAM and
+ * NUR_NOTIFICATION_INVENTORYEX are drained from the tag storage with NurExtDrainTags() on the NurApi
+ * notification thread and published into the ring. The notification thread never waits for the application:
+ * when the ring is full, new tags are dropped and counted in NUR_EXT_TAGRING_STATS.overflow.
+ * The application reads the ring with NurExtReadTagRing() without taking any lock.
+ *
+ * Use NurExtSetNotificationCallback() instead of NurApiSetNotificationCallback() while the ring is enabled.
+ * Enabling, disabling and reading must be done from the same application thread, NurExtGetTagRingStats() may be called from any thread.
+ *
+ * @sa NurExtReadTagRing(), NurExtGetTagRingStats(), NurExtSetNotificationCallback()
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	capacity	Ring capacity in tags, rounded up to power of two. 0 to disable.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtEnableTagRing(HANDLE hApi, int capacity);
+
+/** @fn int NurExtReadTagRing(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, int *tagDataCount, DWORD szSingleEntry)
+ *
+ * Read tags from the ring. Does not block.
+ *
+ * @param	hApi				Handle to valid NurApi object instance.
+ * @param	tagDataBuffer		Pointer to a NUR_TAG_DATA_EX structures. Must contain at least <i>tagDataCount</i> entries.
+ * @param	tagDataCount		Number of entries in <i>tagDataBuffer</i>. On return number of valid entries is received in this pointer.
+ * @param	szSingleEntry		Size of one NUR_TAG_DATA_EX entry.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the ring is not enabled. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtReadTagRing(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, int *tagDataCount, DWORD szSingleEntry);
+
+/** @fn int NurExtReadTagRingEx(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, ULONGLONG *rxTimeNs, int *tagDataCount, DWORD szSingleEntry)
+ *
+ * NurExtReadTagRing() with the host receive time of each tag: the NurExtGetNotificationTime() of the
+ * notification that delivered the tag, see NurExtDrainTagsEx().
+ *
+ * @param	hApi				Handle to valid NurApi object instance.
+ * @param	tagDataBuffer		Pointer to a NUR_TAG_DATA_EX structures. Must contain at least <i>tagDataCount</i> entries.
+ * @param	rxTimeNs			Receive time of each returned tag is received here. Must contain at least <i>tagDataCount</i> entries. May be NULL.
+ * @param	tagDataCount		Number of entries in <i>tagDataBuffer</i>. On return number of valid entries is received in this pointer.
+ * @param	szSingleEntry		Size of one NUR_TAG_DATA_EX entry.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the ring is not enabled. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtReadTagRingEx(HANDLE hApi, struct NUR_TAG_DATA_EX *tagDataBuffer, ULONGLONG *rxTimeNs, int *tagDataCount, DWORD szSingleEntry);
+
+/** @fn int NurExtGetTagRingStats(HANDLE hApi, struct NUR_EXT_TAGRING_STATS *stats, DWORD szStats)
+ *
+ * Get tag ring counters.
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	stats		Pointer to NUR_EXT_TAGRING_STATS structure.
+ * @param	szStats		Size of the structure.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the ring is not enabled. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetTagRingStats(HANDLE hApi, struct NUR_EXT_TAGRING_STATS *stats, DWORD szStats);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
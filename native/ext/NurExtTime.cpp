@@ -0,0 +1,11 @@
+#include "NurExtContext.h"
+#include "NurApiExt.h"
+
+#include <time.h>
+
+ULONGLONG NURAPICONV NurExtGetMonotonicNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ULONGLONG)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,143 @@
+/*
+ * NurExtTime.h
+ *
+ *  Host receive timestamps and module clock synchronization on the CLOCK_MONOTONIC time base.
+ */
+
+#ifndef _NUREXTTIME_H_
+#define _NUREXTTIME_H_ 1
+
+#include "NurAPI.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @addtogroup EXTAPI
+ *  @{
+ */
+
+/** Samples kept for the module clock fit. */
+#define NUR_EXT_CLOCKSYNC_WINDOW	32
+
+/**
+ * Module clock model of a handle: host time = refHostNs + (module ms - refModuleMs) * 1000000 * (1 - driftPpb / 1e9).
+ * @sa NurExtGetClockSync()
+ */
+struct NUR_EXT_CLOCKSYNC
+{
+	ULONGLONG refHostNs;	/**< NurExtGetMonotonicNs() time of refModuleMs. */
+	DWORD refModuleMs;		/**< Module clock of the latest sample. */
+	int driftPpb;			/**< Module clock rate error in parts per billion, positive when the module clock runs fast. 0 until samples span 10 seconds. */
+	DWORD rttNs;			/**< Round trip time of the latest sample. The offset error is within half of it plus the 1 ms module clock resolution. */
+	DWORD sampleCount;		/**< Samples in the fit, at most NUR_EXT_CLOCKSYNC_WINDOW. */
+	ULONGLONG samples;		/**< Round trips done. */
+	ULONGLONG errors;		/**< Failed round trips. */
+	DWORD resets;			/**< Module clock restarts detected, e.g. module reboots. The fit starts over. */
+};
+
+/** @fn ULONGLONG NurExtGetMonotonicNs()
+ *
+ * Current CLOCK_MONOTONIC time in nanoseconds. All receive timestamps of the extensions use this time base,
+ * which does not wrap and is not affected by wall clock changes. Same as clock_gettime(CLOCK_MONOTONIC).
+ *
+ * @return	Nanoseconds since an unspecified starting point.
+ */
+ULONGLONG NURAPICONV NurExtGetMonotonicNs();
+
+/** @fn ULONGLONG NurExtGetNotificationTime(HANDLE hApi)
+ *
+ * Host receive time of the notification being handled, taken when NurApi passed it to the extensions,
+ * before any extension or queueing. Unlike the DWORD millisecond timestamp of NotificationCallback, this is
+ * a nanosecond NurExtGetMonotonicNs() value that does not wrap.
+ * Valid only when called from the application notification function set with NurExtSetNotificationCallback(),
+ * inline or on a dispatch worker. Works for all notification types, e.g. NUR_NOTIFICATION_INVENTORYSTREAM and
+ * NUR_NOTIFICATION_TT_CHANGED.
+ *
+ * @sa NurExtDrainTagsEx(), NurExtReadTagRingEx()
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Receive time in nanoseconds, 0 if not called from the notification function.
+ */
+ULONGLONG NURAPICONV NurExtGetNotificationTime(HANDLE hApi);
+
+/** @fn int NurExtStartClockSync(HANDLE hApi, DWORD intervalMs)
+ *
+ * Start estimating the offset and drift of the module millisecond clock against NurExtGetMonotonicNs().
+ * Each sync does a burst of timed round trips that read the module clock and keeps the one with the shortest round trip,
+ * the module clock is assumed to be read halfway through it. The offset and drift are fitted over the latest
+ * NUR_EXT_CLOCKSYNC_WINDOW syncs; the drift estimate improves as the samples span a longer time.
+ *
+ * The first sync is done before returning, so module times can be converted right after a successful call.
+ * Following syncs run on a thread of the handle and go to the module between the application's commands.
+ * Restarts the sync of the handle if already started.
+ *
+ * @sa NurExtStopClockSync(), NurExtModuleTimeToHost(), NurExtTagTimeToHost(), NurExtGetClockSync()
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	intervalMs	Time between syncs in milliseconds. 0 = sync once now, no thread.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStartClockSync(HANDLE hApi, DWORD intervalMs);
+
+/** @fn int NurExtStopClockSync(HANDLE hApi)
+ *
+ * Stop the clock sync thread of the handle. The latest model stays valid for conversions.
+ * Called by NurExtFree().
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ *
+ * @return	Zero when succeeded, On error non-zero error code is returned.
+ */
+int NURAPICONV NurExtStopClockSync(HANDLE hApi);
+
+/** @fn int NurExtGetClockSync(HANDLE hApi, struct NUR_EXT_CLOCKSYNC *sync, DWORD szSync)
+ *
+ * Get the module clock model and sync counters of the handle.
+ *
+ * @param	hApi	Handle to valid NurApi object instance.
+ * @param	sync	Pointer to the NUR_EXT_CLOCKSYNC structure.
+ * @param	szSync	sizeof(struct NUR_EXT_CLOCKSYNC)
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the clock has not been synced. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtGetClockSync(HANDLE hApi, struct NUR_EXT_CLOCKSYNC *sync, DWORD szSync);
+
+/** @fn int NurExtModuleTimeToHost(HANDLE hApi, DWORD moduleMs, ULONGLONG *hostNs)
+ *
+ * Convert a module clock time, e.g. NUR_DIAG_REPORT.uptime, to NurExtGetMonotonicNs() time.
+ * Times of different handles converted this way can be ordered against each other.
+ *
+ * @param	hApi		Handle to valid NurApi object instance.
+ * @param	moduleMs	Module clock in milliseconds, within 24 days of the latest sync.
+ * @param	hostNs		Host time is received here.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the clock has not been synced. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtModuleTimeToHost(HANDLE hApi, DWORD moduleMs, ULONGLONG *hostNs);
+
+/** @fn int NurExtTagTimeToHost(HANDLE hApi, WORD tagTimestamp, ULONGLONG rxTimeNs, ULONGLONG *hostNs)
+ *
+ * Convert NUR_TAG_DATA_EX.timestamp, the low 16 bits of the module clock, to NurExtGetMonotonicNs() time.
+ * The wrap is resolved with the host receive time: the tag was read within 65 seconds before it was received.
+ *
+ * @sa NurExtDrainTagsEx(), NurExtReadTagRingEx()
+ *
+ * @param	hApi			Handle to valid NurApi object instance.
+ * @param	tagTimestamp	NUR_TAG_DATA_EX.timestamp.
+ * @param	rxTimeNs		Host receive time of the tag. 0 = now.
+ * @param	hostNs			Host time of the tag read is received here.
+ *
+ * @return	Zero when succeeded, NUR_ERROR_NOT_READY if the clock has not been synced. On other error non-zero error code is returned.
+ */
+int NURAPICONV NurExtTagTimeToHost(HANDLE hApi, WORD tagTimestamp, ULONGLONG rxTimeNs, ULONGLONG *hostNs);
+
+/** @} */ // end EXTAPI
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif